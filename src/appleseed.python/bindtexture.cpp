@@ -128,6 +128,7 @@ void bind_texture()
     bpy::enum_<TextureFilteringMode>("TextureFilteringMode")
         .value("Nearest", TextureFilteringNearest)
         .value("Bilinear", TextureFilteringBilinear)
+        .value("Trilinear", TextureFilteringTrilinear)
         .value("Bicubic", TextureFilteringBicubic)
         .value("Feline", TextureFilteringFeline)
         .value("EWA", TextureFilteringEWA)
@@ -38,6 +38,7 @@
 
 // appleseed.foundation headers.
 #include "foundation/image/colorspace.h"
+#include "foundation/image/regularspectrum.h"
 #include "foundation/utility/containers/dictionary.h"
 #include "foundation/utility/foreach.h"
 #include "foundation/utility/iostreamop.h"
@@ -297,7 +298,7 @@ namespace
                 return Color3f(values[0], values[1], values[2]);
             else if (low_wavelength < high_wavelength)
             {
-                float output_spectrum[Spectrum::Samples];
+                float output_spectrum[RegularSpectrum31f::Samples];
                 spectral_values_to_spectrum(
                     low_wavelength,
                     high_wavelength,
@@ -91,6 +91,27 @@ void FilteredTile::add(
     const float         x,
     const float         y,
     const float*        values)
+{
+#ifdef ATOMIC_UPDATES
+    add_impl<true>(x, y, values);
+#else
+    add_impl<false>(x, y, values);
+#endif
+}
+
+void FilteredTile::add_exclusive(
+    const float         x,
+    const float         y,
+    const float*        values)
+{
+    add_impl<false>(x, y, values);
+}
+
+template <bool Atomic>
+void FilteredTile::add_impl(
+    const float         x,
+    const float         y,
+    const float*        values)
 {
     // Convert (x, y) from continuous image space to discrete image space.
     const float dx = x - 0.5f;
@@ -119,19 +140,15 @@ void FilteredTile::add(
         {
             const float weight = m_filter.evaluate(rx - dx, ry - dy);
 
-#ifdef ATOMIC_UPDATES
-            atomic_add(ptr++, weight);
-#else
-            *ptr++ += weight;
-#endif
+            if (Atomic)
+                atomic_add(ptr++, weight);
+            else *ptr++ += weight;
 
             for (size_t i = 0, e = m_channel_count - 1; i < e; ++i)
             {
-#ifdef ATOMIC_UPDATES
-                atomic_add(ptr++, values[i] * weight);
-#else
-                *ptr++ += values[i] * weight;
-#endif
+                if (Atomic)
+                    atomic_add(ptr++, values[i] * weight);
+                else *ptr++ += values[i] * weight;
             }
         }
     }
@@ -125,9 +125,22 @@ class FilteredTile
         const float         y,
         const float*        values);
 
+    // Like add() but without atomic updates. The caller must have exclusive access to the tile.
+    void add_exclusive(
+        const float         x,
+        const float         y,
+        const float*        values);
+
   protected:
     const AABB2u            m_crop_window;
     const Filter2f&         m_filter;
+
+  private:
+    template <bool Atomic>
+    void add_impl(
+        const float         x,
+        const float         y,
+        const float*        values);
 };
 
 
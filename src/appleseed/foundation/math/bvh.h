@@ -33,14 +33,20 @@
 // Interface headers.
 #include "foundation/math/bvh/bvh_bboxsortpredicate.h"
 #include "foundation/math/bvh/bvh_builder.h"
+#include "foundation/math/bvh/bvh_collapser.h"
 #include "foundation/math/bvh/bvh_intersector.h"
 #include "foundation/math/bvh/bvh_medianpartitioner.h"
 #include "foundation/math/bvh/bvh_node.h"
 #include "foundation/math/bvh/bvh_partitionerbase.h"
+#include "foundation/math/bvh/bvh_quantizedwidenode.h"
+#include "foundation/math/bvh/bvh_refitter.h"
 #include "foundation/math/bvh/bvh_sahpartitioner.h"
 #include "foundation/math/bvh/bvh_sbvhpartitioner.h"
 #include "foundation/math/bvh/bvh_spatialbuilder.h"
 #include "foundation/math/bvh/bvh_statistics.h"
 #include "foundation/math/bvh/bvh_tree.h"
+#include "foundation/math/bvh/bvh_wideintersector.h"
+#include "foundation/math/bvh/bvh_widenode.h"
+#include "foundation/math/bvh/bvh_widetree.h"
 
 #endif  // !APPLESEED_FOUNDATION_MATH_BVH_H
@@ -32,11 +32,16 @@
 
 // appleseed.foundation headers.
 #include "foundation/core/concepts/noncopyable.h"
+#include "foundation/platform/compiler.h"
+#include "foundation/utility/job/ijob.h"
+#include "foundation/utility/job/jobqueue.h"
 #include "foundation/utility/stopwatch.h"
 
 // Standard headers.
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
+#include <vector>
 
 namespace foundation {
 namespace bvh {
@@ -59,6 +64,8 @@ namespace bvh {
 //          // 'bbox' is the bounding box of the items in [begin, end).
 //          // Return the index of the first item in the right
 //          // partition, or 'end' if the set is not to be partitioned.
+//          // Parallel builds call this method concurrently on disjoint
+//          // sets of items containing at most half of all the items.
 //          size_t partition(
 //              const size_t        begin,
 //              const size_t        end,
@@ -82,23 +89,71 @@ class Builder
         const size_t    size,
         const size_t    items_per_leaf_hint);
 
+    // Build a tree using the worker threads servicing a given job queue. The top of
+    // the tree is built by the calling thread, the subtrees below it are built
+    // concurrently. The resulting tree is identical to the one built by the
+    // single-threaded method above.
+    template <typename Timer>
+    void build(
+        Tree&           tree,
+        Partitioner&    partitioner,
+        const size_t    size,
+        const size_t    items_per_leaf_hint,
+        JobQueue&       job_queue,
+        const size_t    thread_count);
+
     // Return the construction time.
     double get_build_time() const;
 
   private:
+    typedef typename Tree::NodeVectorType NodeVector;
     typedef typename Tree::NodeType NodeType;
     typedef typename NodeType::AABBType AABBType;
 
+    struct Subtree
+    {
+        size_t          m_node_index;       // index of the root of the subtree in the top of the tree
+        size_t          m_begin;
+        size_t          m_end;
+        AABBType        m_bbox;
+        NodeVector      m_nodes;
+
+        explicit Subtree(const NodeVector& nodes)
+          : m_nodes(nodes.get_allocator())
+        {
+        }
+    };
+
+    typedef std::vector<Subtree*> SubtreeVector;
+
+    class SubtreeJob;
+    friend class SubtreeJob;
+
+    // Sets of items are turned into subtrees when they contain no more than
+    // 1 / (SubtreesPerThread * thread_count) of all the items.
+    static const size_t SubtreesPerThread = 4;
+
     double m_build_time;
 
-    // Recursively subdivide the tree.
+    // Recursively subdivide the tree. Sets of no more than subtree_size items
+    // are not subdivided but appended to 'subtrees', unless 'subtrees' is null.
     void subdivide_recurse(
-        Tree&           tree,
+        NodeVector&     nodes,
         Partitioner&    partitioner,
         const size_t    node_index,
         const size_t    begin,
         const size_t    end,
-        const AABBType& bbox);
+        const AABBType& bbox,
+        SubtreeVector*  subtrees,
+        const size_t    subtree_size);
+
+    // Recursively copy a tree, laying out nodes in the order of a single-threaded build.
+    void relayout_recurse(
+        const NodeVector&       src_nodes,
+        const SubtreeVector*    src_subtrees,
+        const size_t            src_node_index,
+        NodeVector&             dst_nodes,
+        const size_t            dst_node_index);
 };
 
 
@@ -106,6 +161,42 @@ class Builder
 // Builder class implementation.
 //
 
+template <typename Tree, typename Partitioner>
+class Builder<Tree, Partitioner>::SubtreeJob
+  : public IJob
+{
+  public:
+    SubtreeJob(
+        Builder&        builder,
+        Partitioner&    partitioner,
+        Subtree&        subtree)
+      : m_builder(builder)
+      , m_partitioner(partitioner)
+      , m_subtree(subtree)
+    {
+    }
+
+    virtual void execute(const size_t thread_index) APPLESEED_OVERRIDE
+    {
+        m_subtree.m_nodes.push_back(NodeType());
+
+        m_builder.subdivide_recurse(
+            m_subtree.m_nodes,
+            m_partitioner,
+            0,
+            m_subtree.m_begin,
+            m_subtree.m_end,
+            m_subtree.m_bbox,
+            0,
+            0);
+    }
+
+  private:
+    Builder&            m_builder;
+    Partitioner&        m_partitioner;
+    Subtree&            m_subtree;
+};
+
 template <typename Tree, typename Partitioner>
 Builder<Tree, Partitioner>::Builder()
   : m_build_time(0.0)
@@ -142,12 +233,81 @@ void Builder<Tree, Partitioner>::build(
 
     // Recursively subdivide the tree.
     subdivide_recurse(
-        tree,
+        tree.m_nodes,
         partitioner,
         0,              // node index
         0,              // begin
         size,           // end
-        root_bbox);
+        root_bbox,
+        0,              // subtrees
+        0);             // subtree size
+
+    // Measure and save construction time.
+    stopwatch.measure();
+    m_build_time = stopwatch.get_seconds();
+}
+
+template <typename Tree, typename Partitioner>
+template <typename Timer>
+void Builder<Tree, Partitioner>::build(
+    Tree&               tree,
+    Partitioner&        partitioner,
+    const size_t        size,
+    const size_t        items_per_leaf_hint,
+    JobQueue&           job_queue,
+    const size_t        thread_count)
+{
+    assert(thread_count > 0);
+
+    // Start stopwatch.
+    Stopwatch<Timer> stopwatch;
+    stopwatch.start();
+
+    // Clear the tree.
+    tree.m_nodes.clear();
+
+    // Reserve memory for the nodes.
+    const size_t leaf_count_guess = size / items_per_leaf_hint;
+    const size_t node_count_guess = leaf_count_guess > 0 ? 2 * leaf_count_guess - 1 : 0;
+    tree.m_nodes.reserve(node_count_guess);
+
+    // Compute the bounding box of the tree.
+    const AABBType root_bbox(partitioner.compute_bbox(0, size));
+
+    // Build the top of the tree, collecting the roots of the subtrees.
+    // Concurrent partitions must not contain more than half of the items.
+    NodeVector top_nodes(tree.m_nodes.get_allocator());
+    top_nodes.push_back(NodeType());
+    SubtreeVector subtrees;
+    subdivide_recurse(
+        top_nodes,
+        partitioner,
+        0,              // node index
+        0,              // begin
+        size,           // end
+        root_bbox,
+        &subtrees,
+        std::min(size / (SubtreesPerThread * thread_count), size / 2));
+
+    // Build the subtrees concurrently.
+    for (size_t i = 0; i < subtrees.size(); ++i)
+        job_queue.schedule(new SubtreeJob(*this, partitioner, *subtrees[i]));
+    job_queue.wait_until_completion();
+
+    // Assemble the final tree.
+    SubtreeVector subtrees_by_node(top_nodes.size(), 0);
+    for (size_t i = 0; i < subtrees.size(); ++i)
+        subtrees_by_node[subtrees[i]->m_node_index] = subtrees[i];
+    tree.m_nodes.push_back(NodeType());
+    relayout_recurse(
+        top_nodes,
+        &subtrees_by_node,
+        0,
+        tree.m_nodes,
+        0);
+
+    for (size_t i = 0; i < subtrees.size(); ++i)
+        delete subtrees[i];
 
     // Measure and save construction time.
     stopwatch.measure();
@@ -162,14 +322,28 @@ inline double Builder<Tree, Partitioner>::get_build_time() const
 
 template <typename Tree, typename Partitioner>
 void Builder<Tree, Partitioner>::subdivide_recurse(
-    Tree&               tree,
+    NodeVector&         nodes,
     Partitioner&        partitioner,
     const size_t        node_index,
     const size_t        begin,
     const size_t        end,
-    const AABBType&     bbox)
+    const AABBType&     bbox,
+    SubtreeVector*      subtrees,
+    const size_t        subtree_size)
 {
-    assert(node_index < tree.m_nodes.size());
+    assert(node_index < nodes.size());
+
+    // Defer the construction of small enough subtrees.
+    if (subtrees && end - begin <= subtree_size)
+    {
+        Subtree* subtree = new Subtree(nodes);
+        subtree->m_node_index = node_index;
+        subtree->m_begin = begin;
+        subtree->m_end = end;
+        subtree->m_bbox = bbox;
+        subtrees->push_back(subtree);
+        return;
+    }
 
     // Try to partition the set of items.
     size_t pivot = end;
@@ -183,7 +357,7 @@ void Builder<Tree, Partitioner>::subdivide_recurse(
     if (pivot == end)
     {
         // Turn the current node into a leaf node.
-        NodeType& node = tree.m_nodes[node_index];
+        NodeType& node = nodes[node_index];
         node.make_leaf();
         node.set_item_index(begin);
         node.set_item_count(end - begin);
@@ -195,37 +369,89 @@ void Builder<Tree, Partitioner>::subdivide_recurse(
         const AABBType right_bbox(partitioner.compute_bbox(pivot, end));
 
         // Compute the indices of the child nodes.
-        const size_t left_node_index = tree.m_nodes.size();
+        const size_t left_node_index = nodes.size();
         const size_t right_node_index = left_node_index + 1;
 
         // Turn the current node into an interior node.
-        NodeType& node = tree.m_nodes[node_index];
+        NodeType& node = nodes[node_index];
         node.make_interior();
         node.set_left_bbox(left_bbox);
         node.set_right_bbox(right_bbox);
         node.set_child_node_index(left_node_index);
 
         // Create the child nodes.
-        tree.m_nodes.push_back(NodeType());
-        tree.m_nodes.push_back(NodeType());
+        nodes.push_back(NodeType());
+        nodes.push_back(NodeType());
 
         // Recurse into the left subtree.
         subdivide_recurse(
-            tree,
+            nodes,
             partitioner,
             left_node_index,
             begin,
             pivot,
-            left_bbox);
+            left_bbox,
+            subtrees,
+            subtree_size);
 
         // Recurse into the right subtree.
         subdivide_recurse(
-            tree,
+            nodes,
             partitioner,
             right_node_index,
             pivot,
             end,
-            right_bbox);
+            right_bbox,
+            subtrees,
+            subtree_size);
+    }
+}
+
+template <typename Tree, typename Partitioner>
+void Builder<Tree, Partitioner>::relayout_recurse(
+    const NodeVector&       src_nodes,
+    const SubtreeVector*    src_subtrees,
+    const size_t            src_node_index,
+    NodeVector&             dst_nodes,
+    const size_t            dst_node_index)
+{
+    // Continue with the root of the subtree if this node is the root of a subtree.
+    if (src_subtrees && (*src_subtrees)[src_node_index])
+    {
+        relayout_recurse(
+            (*src_subtrees)[src_node_index]->m_nodes,
+            0,
+            0,
+            dst_nodes,
+            dst_node_index);
+
+        return;
+    }
+
+    NodeType node = src_nodes[src_node_index];
+
+    if (node.is_leaf())
+        dst_nodes[dst_node_index] = node;
+    else
+    {
+        // Create the child nodes.
+        const size_t src_child_node_index = node.get_child_node_index();
+        const size_t dst_child_node_index = dst_nodes.size();
+        node.set_child_node_index(dst_child_node_index);
+        dst_nodes[dst_node_index] = node;
+        dst_nodes.push_back(NodeType());
+        dst_nodes.push_back(NodeType());
+
+        // Recurse into the left and right subtrees.
+        for (size_t i = 0; i < 2; ++i)
+        {
+            relayout_recurse(
+                src_nodes,
+                src_subtrees,
+                src_child_node_index + i,
+                dst_nodes,
+                dst_child_node_index + i);
+        }
     }
 }
 
@@ -0,0 +1,232 @@
+
+//
+// This source file is part of appleseed.
+// Visit http://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2017 Francois Beaune, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#ifndef APPLESEED_FOUNDATION_MATH_BVH_BVH_COLLAPSER_H
+#define APPLESEED_FOUNDATION_MATH_BVH_BVH_COLLAPSER_H
+
+// appleseed.foundation headers.
+#include "foundation/core/concepts/noncopyable.h"
+#include "foundation/math/aabb.h"
+#include "foundation/utility/stopwatch.h"
+
+// Standard headers.
+#include <cassert>
+#include <cstddef>
+
+namespace foundation {
+namespace bvh {
+
+//
+// Collapse a binary BVH into a wide BVH.
+//
+// Each wide node is formed by repeatedly opening the interior child with the
+// largest surface area, starting from the two children of a binary interior
+// node, until the wide node is full or only leaves remain.
+//
+// Once collapsed, the binary tree only retains its leaf nodes (in depth-first
+// order); they are referenced by the children of the wide nodes.
+//
+
+template <typename Tree, typename WideTree>
+class Collapser
+  : public NonCopyable
+{
+  public:
+    // Constructor.
+    Collapser();
+
+    // Collapse a binary tree. 'root_bbox' is the bounding box of the whole tree.
+    template <typename Timer>
+    void collapse(
+        Tree&                       tree,
+        WideTree&                   wide_tree,
+        const AABB3d&               root_bbox);
+
+    // Return the collapse time.
+    double get_collapse_time() const;
+
+  private:
+    typedef typename Tree::NodeType NodeType;
+    typedef typename Tree::NodeVectorType NodeVectorType;
+    typedef typename WideTree::NodeType WideNodeType;
+
+    static const size_t Width = WideNodeType::Width;
+
+    double m_collapse_time;
+
+    // Recursively create the wide node corresponding to a binary interior node.
+    size_t collapse_recurse(
+        const NodeVectorType&       nodes,
+        NodeVectorType&             leaves,
+        WideTree&                   wide_tree,
+        const size_t                node_index);
+};
+
+
+//
+// Collapser class implementation.
+//
+
+template <typename Tree, typename WideTree>
+Collapser<Tree, WideTree>::Collapser()
+  : m_collapse_time(0.0)
+{
+}
+
+template <typename Tree, typename WideTree>
+template <typename Timer>
+void Collapser<Tree, WideTree>::collapse(
+    Tree&                           tree,
+    WideTree&                       wide_tree,
+    const AABB3d&                   root_bbox)
+{
+    assert(!tree.m_nodes.empty());
+
+    // Start stopwatch.
+    Stopwatch<Timer> stopwatch;
+    stopwatch.start();
+
+    // Clear the wide tree.
+    wide_tree.m_nodes.clear();
+
+    // A binary tree with n leaves has n - 1 interior nodes.
+    const size_t leaf_count = (tree.m_nodes.size() + 1) / 2;
+    NodeVectorType leaves(tree.m_nodes.get_allocator());
+    leaves.reserve(leaf_count);
+
+    if (tree.m_nodes[0].is_leaf())
+    {
+        // The whole tree is a single leaf: create a root with a single child.
+        wide_tree.m_nodes.push_back(WideNodeType());
+        wide_tree.m_nodes[0].set_child_bboxes(&root_bbox, 1);
+        wide_tree.m_nodes[0].set_child_leaf_index(0, 0);
+        leaves.push_back(tree.m_nodes[0]);
+    }
+    else
+    {
+        // Guess the number of wide nodes, assuming they will be mostly full.
+        wide_tree.m_nodes.reserve(leaf_count / (Width - 1) + 1);
+
+        collapse_recurse(tree.m_nodes, leaves, wide_tree, 0);
+    }
+
+    assert(leaves.size() == leaf_count);
+
+    // Only keep the leaves of the binary tree.
+    tree.m_nodes.swap(leaves);
+
+    // Measure and save collapse time.
+    stopwatch.measure();
+    m_collapse_time = stopwatch.get_seconds();
+}
+
+template <typename Tree, typename WideTree>
+inline double Collapser<Tree, WideTree>::get_collapse_time() const
+{
+    return m_collapse_time;
+}
+
+template <typename Tree, typename WideTree>
+size_t Collapser<Tree, WideTree>::collapse_recurse(
+    const NodeVectorType&           nodes,
+    NodeVectorType&                 leaves,
+    WideTree&                       wide_tree,
+    const size_t                    node_index)
+{
+    const NodeType& node = nodes[node_index];
+    assert(node.is_interior());
+
+    // Start with the two children of the binary node.
+    size_t child_indices[Width];
+    AABB3d child_bboxes[Width];
+    child_indices[0] = node.get_child_node_index();
+    child_indices[1] = node.get_child_node_index() + 1;
+    child_bboxes[0] = AABB3d(node.get_left_bbox());
+    child_bboxes[1] = AABB3d(node.get_right_bbox());
+    size_t child_count = 2;
+
+    // Open interior children, largest first, until the wide node is full.
+    while (child_count < Width)
+    {
+        size_t best_child = Width;
+        double best_area = -1.0;
+
+        for (size_t i = 0; i < child_count; ++i)
+        {
+            if (nodes[child_indices[i]].is_interior())
+            {
+                const double area = half_surface_area(child_bboxes[i]);
+                if (best_area < area)
+                {
+                    best_area = area;
+                    best_child = i;
+                }
+            }
+        }
+
+        if (best_child == Width)
+            break;
+
+        const NodeType& opened = nodes[child_indices[best_child]];
+        child_indices[best_child] = opened.get_child_node_index();
+        child_bboxes[best_child] = AABB3d(opened.get_left_bbox());
+        child_indices[child_count] = opened.get_child_node_index() + 1;
+        child_bboxes[child_count] = AABB3d(opened.get_right_bbox());
+        ++child_count;
+    }
+
+    // Create the wide node.
+    const size_t wide_node_index = wide_tree.m_nodes.size();
+    wide_tree.m_nodes.push_back(WideNodeType());
+
+    wide_tree.m_nodes[wide_node_index].set_child_bboxes(child_bboxes, child_count);
+
+    for (size_t i = 0; i < child_count; ++i)
+    {
+        const NodeType& child = nodes[child_indices[i]];
+
+        if (child.is_leaf())
+        {
+            wide_tree.m_nodes[wide_node_index].set_child_leaf_index(i, leaves.size());
+            leaves.push_back(child);
+        }
+        else
+        {
+            const size_t child_wide_node_index =
+                collapse_recurse(nodes, leaves, wide_tree, child_indices[i]);
+            wide_tree.m_nodes[wide_node_index].set_child_node_index(i, child_wide_node_index);
+        }
+    }
+
+    return wide_node_index;
+}
+
+}       // namespace bvh
+}       // namespace foundation
+
+#endif  // !APPLESEED_FOUNDATION_MATH_BVH_BVH_COLLAPSER_H
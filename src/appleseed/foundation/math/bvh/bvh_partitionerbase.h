@@ -47,6 +47,13 @@ namespace bvh {
 //
 // A base class for BVH partitioners.
 //
+// sort_indices() may be called concurrently on disjoint sets of items
+// as long as none of them contains more than half of all the items.
+//
+// tag_items(), count_left_items(), split_items() and copy_items() are the steps of
+// sort_indices(), for partitioners sorting large sets of items in parallel. Each step
+// processes a chunk of a set of items; the chunks of a step may be processed concurrently.
+//
 
 template <typename AABBVector>
 class PartitionerBase
@@ -80,7 +87,39 @@ class PartitionerBase
         const size_t            end,
         const size_t            pivot);
 
+    // Tag the items in [chunk_begin, chunk_end) along a given dimension as belonging
+    // to the left or to the right partition of a set of items split at 'pivot'.
+    void tag_items(
+        const size_t            dimension,
+        const size_t            chunk_begin,
+        const size_t            chunk_end,
+        const size_t            pivot);
+
+    // Return the number of items in [chunk_begin, chunk_end) along a given dimension
+    // tagged as belonging to the left partition.
+    size_t count_left_items(
+        const size_t            dimension,
+        const size_t            chunk_begin,
+        const size_t            chunk_end) const;
+
+    // Move the items in [chunk_begin, chunk_end) along a given dimension to temporary
+    // storage, left items starting at 'left' and right items starting at 'right'.
+    void split_items(
+        const size_t            dimension,
+        const size_t            chunk_begin,
+        const size_t            chunk_end,
+        size_t                  left,
+        size_t                  right);
+
+    // Copy the items in [chunk_begin, chunk_end) back from temporary storage.
+    void copy_items(
+        const size_t            dimension,
+        const size_t            chunk_begin,
+        const size_t            chunk_end);
+
   private:
+    enum { Left = 0, Right = 1 };
+
     std::vector<size_t>         m_tmp;
     std::vector<uint8>          m_tags;
 };
@@ -138,44 +177,15 @@ void PartitionerBase<AABBVector>::sort_indices(
     const size_t                end,
     const size_t                pivot)
 {
-    const std::vector<size_t>& split_indices = m_indices[dimension];
-
-    enum { Left = 0, Right = 1 };
-
-    for (size_t i = begin; i < pivot; ++i)
-        m_tags[split_indices[i]] = Left;
-
-    for (size_t i = pivot; i < end; ++i)
-        m_tags[split_indices[i]] = Right;
+    tag_items(dimension, begin, end, pivot);
 
     for (size_t d = 0; d < Dimension; ++d)
     {
         if (d != dimension)
         {
-            std::vector<size_t>& indices = m_indices[d];
-
-            size_t left = begin;
-            size_t right = pivot;
-
-            for (size_t i = begin; i < end; ++i)
-            {
-                const size_t index = indices[i];
-
-                if (m_tags[index] == Left)
-                {
-                    assert(left < pivot);
-                    m_tmp[left++] = index;
-                }
-                else
-                {
-                    assert(right < end);
-                    m_tmp[right++] = index;
-                }
-            }
-
-            assert(left == pivot);
-            assert(right == end);
+            split_items(d, begin, end, begin, pivot);
 
+            std::vector<size_t>& indices = m_indices[d];
             const size_t size = indices.size();
 
             if (end - begin > size / 2)
@@ -188,15 +198,75 @@ void PartitionerBase<AABBVector>::sort_indices(
 
                 m_tmp.swap(indices);
             }
-            else
-            {
-                for (size_t i = begin; i < end; ++i)
-                    indices[i] = m_tmp[i];
-            }
+            else copy_items(d, begin, end);
         }
     }
 }
 
+template <typename AABBVector>
+void PartitionerBase<AABBVector>::tag_items(
+    const size_t                dimension,
+    const size_t                chunk_begin,
+    const size_t                chunk_end,
+    const size_t                pivot)
+{
+    const std::vector<size_t>& split_indices = m_indices[dimension];
+
+    for (size_t i = chunk_begin; i < chunk_end; ++i)
+        m_tags[split_indices[i]] = i < pivot ? Left : Right;
+}
+
+template <typename AABBVector>
+size_t PartitionerBase<AABBVector>::count_left_items(
+    const size_t                dimension,
+    const size_t                chunk_begin,
+    const size_t                chunk_end) const
+{
+    const std::vector<size_t>& indices = m_indices[dimension];
+
+    size_t count = 0;
+
+    for (size_t i = chunk_begin; i < chunk_end; ++i)
+    {
+        if (m_tags[indices[i]] == Left)
+            ++count;
+    }
+
+    return count;
+}
+
+template <typename AABBVector>
+void PartitionerBase<AABBVector>::split_items(
+    const size_t                dimension,
+    const size_t                chunk_begin,
+    const size_t                chunk_end,
+    size_t                      left,
+    size_t                      right)
+{
+    const std::vector<size_t>& indices = m_indices[dimension];
+
+    for (size_t i = chunk_begin; i < chunk_end; ++i)
+    {
+        const size_t index = indices[i];
+
+        if (m_tags[index] == Left)
+            m_tmp[left++] = index;
+        else m_tmp[right++] = index;
+    }
+}
+
+template <typename AABBVector>
+void PartitionerBase<AABBVector>::copy_items(
+    const size_t                dimension,
+    const size_t                chunk_begin,
+    const size_t                chunk_end)
+{
+    std::vector<size_t>& indices = m_indices[dimension];
+
+    for (size_t i = chunk_begin; i < chunk_end; ++i)
+        indices[i] = m_tmp[i];
+}
+
 template <typename Tree>
 inline const std::vector<size_t>& PartitionerBase<Tree>::get_item_ordering() const
 {
@@ -0,0 +1,358 @@
+
+//
+// This source file is part of appleseed.
+// Visit http://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2017 Francois Beaune, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#ifndef APPLESEED_FOUNDATION_MATH_BVH_BVH_QUANTIZEDWIDENODE_H
+#define APPLESEED_FOUNDATION_MATH_BVH_BVH_QUANTIZEDWIDENODE_H
+
+// appleseed.foundation headers.
+#include "foundation/math/aabb.h"
+#include "foundation/math/fp.h"
+#include "foundation/platform/compiler.h"
+#include "foundation/platform/types.h"
+#ifdef APPLESEED_USE_SSE
+#include "foundation/platform/sse.h"
+#endif
+
+// Boost headers.
+#include "boost/static_assert.hpp"
+
+// Standard headers.
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+namespace foundation {
+namespace bvh {
+
+//
+// Interior node of a wide (multi-branching) BVH with quantized child bounding boxes.
+//
+// This is a compact alternative to foundation::bvh::WideNode. The bounding boxes of
+// the children are stored as 8-bit or 16-bit integers (depending on T) relative to
+// the bounding box of the node itself. The quantization step along each axis is a
+// power of two such that dequantization is exact, and quantized bounding boxes are
+// rounded outward such that they always enclose the original ones.
+//
+
+template <size_t W, typename T>
+class APPLESEED_ALIGN(32) QuantizedWideNode
+{
+  public:
+    static const size_t Width = W;
+
+    // Constructor, marks all children as empty.
+    QuantizedWideNode();
+
+    // Set the bounding boxes of the first 'count' children, the others are left empty.
+    void set_child_bboxes(const AABB3d bboxes[], const size_t count);
+
+    // Get the (dequantized) bounding box of a given child.
+    AABB3f get_child_bbox(const size_t i) const;
+
+    // Make a given child reference a wide node.
+    void set_child_node_index(const size_t i, const size_t index);
+
+    // Make a given child reference a leaf node.
+    void set_child_leaf_index(const size_t i, const size_t index);
+
+    // Query the type of a given child.
+    bool is_child_empty(const size_t i) const;
+    bool is_child_leaf(const size_t i) const;
+
+    // Return the index of the wide node or of the leaf node referenced by a given child.
+    size_t get_child_index(const size_t i) const;
+
+    // Return the number of non-empty children.
+    size_t get_child_count() const;
+
+    // Dequantize the bounding boxes of all children into 'buffer', using the same layout
+    // as foundation::bvh::WideNode. Empty children get empty boxes.
+    void dequantize_child_bbox_data(float buffer[]) const;
+
+  private:
+    template <typename Tree, typename WideTree, typename Visitor, size_t StackSize>
+    friend class WideIntersector;
+
+    BOOST_STATIC_ASSERT(Width % 4 == 0);
+
+    static const uint32 EmptyChild = ~uint32(0);
+    static const uint32 LeafFlag = uint32(1) << 31;
+    static const uint32 MaxQuantizedValue = (uint32(1) << (8 * sizeof(T))) - 1;
+
+    // Bounding box of the node: min corner and quantization step along each axis.
+    float       m_origin[3];
+    float       m_scale[3];
+
+    // Quantized bounding boxes, with the same layout as in foundation::bvh::WideNode.
+    T           m_bbox_data[6 * Width];
+
+    // Child references.
+    uint32      m_children[Width];
+
+    float dequantize(const size_t d, const uint32 q) const;
+};
+
+
+//
+// QuantizedWideNode class implementation.
+//
+
+template <size_t W, typename T>
+QuantizedWideNode<W, T>::QuantizedWideNode()
+{
+    for (size_t d = 0; d < 3; ++d)
+    {
+        m_origin[d] = 0.0f;
+        m_scale[d] = 0.0f;
+    }
+
+    for (size_t i = 0; i < 6 * Width; ++i)
+        m_bbox_data[i] = 0;
+
+    for (size_t i = 0; i < Width; ++i)
+        m_children[i] = EmptyChild;
+}
+
+template <size_t W, typename T>
+inline float QuantizedWideNode<W, T>::dequantize(const size_t d, const uint32 q) const
+{
+    // The scale is a power of two, so the product is exact and only the sum is rounded.
+    return m_origin[d] + static_cast<float>(q) * m_scale[d];
+}
+
+template <size_t W, typename T>
+void QuantizedWideNode<W, T>::set_child_bboxes(const AABB3d bboxes[], const size_t count)
+{
+    assert(count <= Width);
+
+    for (size_t d = 0; d < 3; ++d)
+    {
+        // Compute the extent of the node along this axis.
+        double node_min = bboxes[0].min[d];
+        double node_max = bboxes[0].max[d];
+        for (size_t i = 1; i < count; ++i)
+        {
+            if (node_min > bboxes[i].min[d])
+                node_min = bboxes[i].min[d];
+            if (node_max < bboxes[i].max[d])
+                node_max = bboxes[i].max[d];
+        }
+
+        // The origin is the node's min corner, rounded down to single precision.
+        float origin = static_cast<float>(node_min);
+        if (static_cast<double>(origin) > node_min)
+            origin = shift(origin, -1);
+        m_origin[d] = origin;
+
+        // Find the smallest power of two quantization step covering the node's extent.
+        const double extent = node_max - static_cast<double>(origin);
+        if (extent > 0.0)
+        {
+            int exponent;
+            std::frexp(extent / MaxQuantizedValue, &exponent);
+            m_scale[d] = static_cast<float>(std::ldexp(1.0, exponent));
+            while (static_cast<double>(dequantize(d, MaxQuantizedValue)) < node_max)
+                m_scale[d] *= 2.0f;
+        }
+        else m_scale[d] = 0.0f;
+
+        // Quantize the bounding boxes of the children, rounding them outward.
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint32 qmin = 0;
+            uint32 qmax = MaxQuantizedValue;
+
+            if (m_scale[d] > 0.0f)
+            {
+                const double rcp_scale = 1.0 / m_scale[d];
+                const double fmin = std::floor((bboxes[i].min[d] - origin) * rcp_scale);
+                const double fmax = std::ceil((bboxes[i].max[d] - origin) * rcp_scale);
+                qmin = fmin <= 0.0 ? 0 : fmin >= MaxQuantizedValue ? MaxQuantizedValue : static_cast<uint32>(fmin);
+                qmax = fmax <= 0.0 ? 0 : fmax >= MaxQuantizedValue ? MaxQuantizedValue : static_cast<uint32>(fmax);
+
+                while (qmin > 0 && static_cast<double>(dequantize(d, qmin)) > bboxes[i].min[d])
+                    --qmin;
+
+                while (qmax < MaxQuantizedValue && static_cast<double>(dequantize(d, qmax)) < bboxes[i].max[d])
+                    ++qmax;
+            }
+
+            assert(static_cast<double>(dequantize(d, qmin)) <= bboxes[i].min[d]);
+            assert(static_cast<double>(dequantize(d, qmax)) >= bboxes[i].max[d]);
+
+            m_bbox_data[(d * 2 + 0) * Width + i] = static_cast<T>(qmin);
+            m_bbox_data[(d * 2 + 1) * Width + i] = static_cast<T>(qmax);
+        }
+
+        // Use inverted bounding boxes for the remaining children.
+        for (size_t i = count; i < Width; ++i)
+        {
+            m_bbox_data[(d * 2 + 0) * Width + i] = static_cast<T>(MaxQuantizedValue);
+            m_bbox_data[(d * 2 + 1) * Width + i] = 0;
+        }
+    }
+}
+
+template <size_t W, typename T>
+inline AABB3f QuantizedWideNode<W, T>::get_child_bbox(const size_t i) const
+{
+    assert(i < Width);
+
+    AABB3f bbox;
+
+    for (size_t d = 0; d < 3; ++d)
+    {
+        bbox.min[d] = dequantize(d, m_bbox_data[(d * 2 + 0) * Width + i]);
+        bbox.max[d] = dequantize(d, m_bbox_data[(d * 2 + 1) * Width + i]);
+    }
+
+    return bbox;
+}
+
+template <size_t W, typename T>
+inline void QuantizedWideNode<W, T>::set_child_node_index(const size_t i, const size_t index)
+{
+    assert(i < Width);
+    assert(index < LeafFlag);
+    m_children[i] = static_cast<uint32>(index);
+}
+
+template <size_t W, typename T>
+inline void QuantizedWideNode<W, T>::set_child_leaf_index(const size_t i, const size_t index)
+{
+    assert(i < Width);
+    assert(index < LeafFlag);
+    m_children[i] = static_cast<uint32>(index) | LeafFlag;
+}
+
+template <size_t W, typename T>
+inline bool QuantizedWideNode<W, T>::is_child_empty(const size_t i) const
+{
+    assert(i < Width);
+    return m_children[i] == EmptyChild;
+}
+
+template <size_t W, typename T>
+inline bool QuantizedWideNode<W, T>::is_child_leaf(const size_t i) const
+{
+    assert(i < Width);
+    return m_children[i] != EmptyChild && (m_children[i] & LeafFlag) != 0;
+}
+
+template <size_t W, typename T>
+inline size_t QuantizedWideNode<W, T>::get_child_index(const size_t i) const
+{
+    assert(i < Width);
+    assert(!is_child_empty(i));
+    return static_cast<size_t>(m_children[i] & ~LeafFlag);
+}
+
+template <size_t W, typename T>
+inline size_t QuantizedWideNode<W, T>::get_child_count() const
+{
+    size_t count = 0;
+
+    for (size_t i = 0; i < Width; ++i)
+    {
+        if (m_children[i] != EmptyChild)
+            ++count;
+    }
+
+    return count;
+}
+
+#ifdef APPLESEED_USE_SSE
+
+namespace impl
+{
+    // Load four quantized values and convert them to single precision.
+    inline __m128 load_quantized4(const uint8* values)
+    {
+        int32 packed;
+        std::memcpy(&packed, values, sizeof(packed));
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i x = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+        return _mm_cvtepi32_ps(x);
+    }
+
+    inline __m128 load_quantized4(const uint16* values)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i x = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(values)), zero);
+        return _mm_cvtepi32_ps(x);
+    }
+}
+
+#endif
+
+template <size_t W, typename T>
+inline void QuantizedWideNode<W, T>::dequantize_child_bbox_data(float buffer[]) const
+{
+#ifdef APPLESEED_USE_SSE
+
+    for (size_t d = 0; d < 3; ++d)
+    {
+        const __m128 morigin = _mm_set1_ps(m_origin[d]);
+        const __m128 mscale = _mm_set1_ps(m_scale[d]);
+
+        for (size_t i = d * 2 * Width, e = (d * 2 + 2) * Width; i < e; i += 4)
+        {
+            const __m128 q = impl::load_quantized4(m_bbox_data + i);
+            _mm_storeu_ps(buffer + i, _mm_add_ps(morigin, _mm_mul_ps(q, mscale)));
+        }
+    }
+
+#else
+
+    for (size_t d = 0; d < 3; ++d)
+    {
+        for (size_t i = d * 2 * Width, e = (d * 2 + 2) * Width; i < e; ++i)
+            buffer[i] = dequantize(d, m_bbox_data[i]);
+    }
+
+#endif
+
+    // Make sure empty children are never hit, even by rays parallel to a degenerate node.
+    for (size_t i = 0; i < Width; ++i)
+    {
+        if (m_children[i] == EmptyChild)
+        {
+            for (size_t d = 0; d < 3; ++d)
+            {
+                buffer[(d * 2 + 0) * Width + i] = FP<float>::pos_inf();
+                buffer[(d * 2 + 1) * Width + i] = FP<float>::neg_inf();
+            }
+        }
+    }
+}
+
+}       // namespace bvh
+}       // namespace foundation
+
+#endif  // !APPLESEED_FOUNDATION_MATH_BVH_BVH_QUANTIZEDWIDENODE_H
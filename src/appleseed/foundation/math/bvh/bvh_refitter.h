@@ -0,0 +1,250 @@
+
+//
+// This source file is part of appleseed.
+// Visit http://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2017 Francois Beaune, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#ifndef APPLESEED_FOUNDATION_MATH_BVH_BVH_REFITTER_H
+#define APPLESEED_FOUNDATION_MATH_BVH_BVH_REFITTER_H
+
+// appleseed.foundation headers.
+#include "foundation/core/concepts/noncopyable.h"
+#include "foundation/math/aabb.h"
+#include "foundation/utility/stopwatch.h"
+
+// Standard headers.
+#include <cassert>
+#include <cstddef>
+
+namespace foundation {
+namespace bvh {
+
+//
+// BVH refitter.
+//
+// Updates the bounding boxes of the nodes of a tree built by bvh::Builder after
+// its items moved, without changing the topology of the tree. Refitting is much
+// faster than rebuilding but the quality of the tree degrades as items move away
+// from their original positions; compute_sah_cost() allows to decide when the tree
+// should be rebuilt instead.
+//
+// Only the static bounding boxes of the nodes are updated: trees whose nodes
+// reference motion bounding boxes (see Node::set_left_bbox_index()), such as
+// triangle trees, cannot be refitted and must be rebuilt.
+//
+
+template <typename Tree>
+class Refitter
+  : public NonCopyable
+{
+  public:
+    typedef typename Tree::NodeType NodeType;
+    typedef typename NodeType::AABBType AABBType;
+
+    // Constructor.
+    Refitter();
+
+    // Refit a tree. 'bboxes' are the new bounding boxes of the items of the tree,
+    // in the order of the tree (item i of 'bboxes' is referenced by the leaves as
+    // item i). Return the bounding box of the tree.
+    template <typename Timer, typename AABBVector>
+    AABBType refit(
+        Tree&               tree,
+        const AABBVector&   bboxes);
+
+    // Return the refitting time.
+    double get_refit_time() const;
+
+    // Compute the surface area heuristic cost of a tree, relative to the surface
+    // area of the tree.
+    static double compute_sah_cost(
+        const Tree&         tree,
+        const double        interior_node_traversal_cost,
+        const double        item_intersection_cost);
+
+  private:
+    double m_refit_time;
+
+    template <typename AABBVector>
+    static AABBType refit_recurse(
+        Tree&               tree,
+        const size_t        node_index,
+        const AABBVector&   bboxes);
+
+    static double compute_sah_cost_recurse(
+        const Tree&         tree,
+        const size_t        node_index,
+        const AABBType&     bbox,
+        const double        interior_node_traversal_cost,
+        const double        item_intersection_cost);
+};
+
+
+//
+// Refitter class implementation.
+//
+
+template <typename Tree>
+Refitter<Tree>::Refitter()
+  : m_refit_time(0.0)
+{
+}
+
+template <typename Tree>
+template <typename Timer, typename AABBVector>
+typename Refitter<Tree>::AABBType Refitter<Tree>::refit(
+    Tree&                   tree,
+    const AABBVector&       bboxes)
+{
+    assert(!tree.m_nodes.empty());
+
+    // Start stopwatch.
+    Stopwatch<Timer> stopwatch;
+    stopwatch.start();
+
+    // Recursively refit the tree.
+    const AABBType tree_bbox = refit_recurse(tree, 0, bboxes);
+
+    // Measure and save refitting time.
+    stopwatch.measure();
+    m_refit_time = stopwatch.get_seconds();
+
+    return tree_bbox;
+}
+
+template <typename Tree>
+inline double Refitter<Tree>::get_refit_time() const
+{
+    return m_refit_time;
+}
+
+template <typename Tree>
+double Refitter<Tree>::compute_sah_cost(
+    const Tree&             tree,
+    const double            interior_node_traversal_cost,
+    const double            item_intersection_cost)
+{
+    assert(!tree.m_nodes.empty());
+
+    const NodeType& root = tree.m_nodes.front();
+
+    if (root.is_leaf())
+        return root.get_item_count() * item_intersection_cost;
+
+    AABBType root_bbox = root.get_left_bbox();
+    root_bbox.insert(root.get_right_bbox());
+
+    const double root_area = static_cast<double>(half_surface_area(root_bbox));
+
+    if (root_area <= 0.0)
+        return 0.0;
+
+    const double cost =
+        compute_sah_cost_recurse(
+            tree,
+            0,
+            root_bbox,
+            interior_node_traversal_cost,
+            item_intersection_cost);
+
+    return cost / root_area;
+}
+
+template <typename Tree>
+template <typename AABBVector>
+typename Refitter<Tree>::AABBType Refitter<Tree>::refit_recurse(
+    Tree&                   tree,
+    const size_t            node_index,
+    const AABBVector&       bboxes)
+{
+    NodeType& node = tree.m_nodes[node_index];
+
+    if (node.is_leaf())
+    {
+        AABBType bbox;
+        bbox.invalidate();
+
+        const size_t item_begin = node.get_item_index();
+        const size_t item_end = item_begin + node.get_item_count();
+
+        for (size_t i = item_begin; i < item_end; ++i)
+            bbox.insert(AABBType(bboxes[i]));
+
+        return bbox;
+    }
+    else
+    {
+        const size_t child_index = node.get_child_node_index();
+
+        const AABBType left_bbox = refit_recurse(tree, child_index, bboxes);
+        const AABBType right_bbox = refit_recurse(tree, child_index + 1, bboxes);
+
+        node.set_left_bbox(left_bbox);
+        node.set_right_bbox(right_bbox);
+
+        AABBType bbox = left_bbox;
+        bbox.insert(right_bbox);
+
+        return bbox;
+    }
+}
+
+template <typename Tree>
+double Refitter<Tree>::compute_sah_cost_recurse(
+    const Tree&             tree,
+    const size_t            node_index,
+    const AABBType&         bbox,
+    const double            interior_node_traversal_cost,
+    const double            item_intersection_cost)
+{
+    const NodeType& node = tree.m_nodes[node_index];
+    const double area =
+        bbox.is_valid() ? static_cast<double>(half_surface_area(bbox)) : 0.0;
+
+    if (node.is_leaf())
+        return area * node.get_item_count() * item_intersection_cost;
+
+    const size_t child_index = node.get_child_node_index();
+
+    return
+          area * interior_node_traversal_cost
+        + compute_sah_cost_recurse(
+              tree,
+              child_index,
+              node.get_left_bbox(),
+              interior_node_traversal_cost,
+              item_intersection_cost)
+        + compute_sah_cost_recurse(
+              tree,
+              child_index + 1,
+              node.get_right_bbox(),
+              interior_node_traversal_cost,
+              item_intersection_cost);
+}
+
+}       // namespace bvh
+}       // namespace foundation
+
+#endif  // !APPLESEED_FOUNDATION_MATH_BVH_BVH_REFITTER_H
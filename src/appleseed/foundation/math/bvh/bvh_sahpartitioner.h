@@ -32,8 +32,13 @@
 
 // appleseed.foundation headers.
 #include "foundation/math/bvh/bvh_partitionerbase.h"
+#include "foundation/platform/compiler.h"
+#include "foundation/platform/thread.h"
+#include "foundation/utility/job/ijob.h"
+#include "foundation/utility/job/jobqueue.h"
 
 // Standard headers.
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
 #include <limits>
@@ -45,6 +50,14 @@ namespace bvh {
 //
 // A BVH partitioner based on the Surface Area Heuristic (SAH).
 //
+// partition() may be called concurrently on disjoint sets of items
+// as long as none of them contains more than half of all the items.
+//
+// When parallel construction is enabled, large sets of items partitioned by the thread
+// that enabled it are split using binned SAH: the items are binned and sorted by the
+// worker threads, and only the boundaries between bins are considered as split planes.
+// Other sets of items are split using exact sweeps over all the items.
+//
 
 template <typename AABBVector>
 class SAHPartitioner
@@ -62,6 +75,15 @@ class SAHPartitioner
         const ValueType         interior_node_traversal_cost = ValueType(1.0),
         const ValueType         item_intersection_cost = ValueType(1.0));
 
+    // Enable parallel construction. Sets of at least 'min_parallel_split_size' items
+    // partitioned by the calling thread are split into 'bin_count' bins using the
+    // 'thread_count' worker threads servicing 'job_queue'.
+    void enable_parallel_build(
+        JobQueue&               job_queue,
+        const size_t            thread_count,
+        const size_t            min_parallel_split_size = 64 * 1024,
+        const size_t            bin_count = 64);
+
     // Partition a set of items into two distinct sets.
     size_t partition(
         const size_t            begin,
@@ -71,10 +93,89 @@ class SAHPartitioner
   private:
     static const size_t Dimension = AABBType::Dimension;
 
+    struct Bin
+    {
+        AABBType                m_bbox;
+        size_t                  m_count;
+    };
+
+    // Steps of a parallel split, each one run on all the chunks of a set of items.
+    enum ChunkStep
+    {
+        BinItems,
+        TagItems,
+        CountLeftItems,
+        SplitItems,
+        CopyItems
+    };
+
+    class ChunkJob;
+    friend class ChunkJob;
+
     const size_t                m_max_leaf_size;
     const ValueType             m_interior_node_traversal_cost;
     const ValueType             m_item_intersection_cost;
     std::vector<ValueType>      m_left_areas;
+
+    JobQueue*                   m_job_queue;
+    size_t                      m_job_count;
+    size_t                      m_min_parallel_split_size;
+    size_t                      m_bin_count;
+    boost::thread::id           m_thread_id;
+    std::vector<Bin>            m_bins;                 // Dimension * m_bin_count bins per chunk
+    std::vector<size_t>         m_left_counts;          // number of left items per chunk
+
+    // Find the best split of a set of items by sweeping over all the items.
+    void find_exact_split(
+        const size_t            begin,
+        const size_t            end,
+        size_t&                 best_split_dim,
+        size_t&                 best_split_pivot,
+        ValueType&              best_split_cost);
+
+    // Find the best split of a set of items by binning them in parallel.
+    void find_binned_split(
+        const size_t            begin,
+        const size_t            end,
+        size_t&                 best_split_dim,
+        size_t&                 best_split_pivot,
+        ValueType&              best_split_cost);
+
+    // Sort the item indices in parallel according to a given split.
+    void sort_indices_parallel(
+        const size_t            dimension,
+        const size_t            begin,
+        const size_t            end,
+        const size_t            pivot);
+
+    // Bin a chunk of a set of items along all dimensions.
+    void bin_items(
+        const size_t            begin,
+        const size_t            end,
+        const size_t            chunk_begin,
+        const size_t            chunk_end,
+        const size_t            chunk_index);
+
+    // Return the range of the i'th of the m_job_count chunks of a set of items.
+    void get_chunk(
+        const size_t            begin,
+        const size_t            end,
+        const size_t            chunk_index,
+        size_t&                 chunk_begin,
+        size_t&                 chunk_end) const;
+
+    // Run a step of a parallel split on all the chunks of a set of items.
+    void run_chunk_jobs(
+        const ChunkStep         step,
+        const size_t            dimension,
+        const size_t            begin,
+        const size_t            end,
+        const size_t            pivot);
+
+    // Return the key used to sort the items along a given dimension.
+    ValueType get_sort_key(
+        const size_t            item_index,
+        const size_t            dimension) const;
 };
 
 
@@ -82,6 +183,82 @@ class SAHPartitioner
 // SAHPartitioner class implementation.
 //
 
+template <typename AABBVector>
+class SAHPartitioner<AABBVector>::ChunkJob
+  : public IJob
+{
+  public:
+    ChunkJob(
+        SAHPartitioner&         partitioner,
+        const ChunkStep         step,
+        const size_t            dimension,
+        const size_t            begin,
+        const size_t            end,
+        const size_t            pivot,
+        const size_t            chunk_index)
+      : m_partitioner(partitioner)
+      , m_step(step)
+      , m_dimension(dimension)
+      , m_begin(begin)
+      , m_end(end)
+      , m_pivot(pivot)
+      , m_chunk_index(chunk_index)
+    {
+    }
+
+    virtual void execute(const size_t thread_index) APPLESEED_OVERRIDE
+    {
+        size_t chunk_begin, chunk_end;
+        m_partitioner.get_chunk(m_begin, m_end, m_chunk_index, chunk_begin, chunk_end);
+
+        switch (m_step)
+        {
+          case BinItems:
+            m_partitioner.bin_items(m_begin, m_end, chunk_begin, chunk_end, m_chunk_index);
+            break;
+
+          case TagItems:
+            m_partitioner.tag_items(m_dimension, chunk_begin, chunk_end, m_pivot);
+            break;
+
+          case CountLeftItems:
+            m_partitioner.m_left_counts[m_chunk_index] =
+                m_partitioner.count_left_items(m_dimension, chunk_begin, chunk_end);
+            break;
+
+          case SplitItems:
+            {
+                // Left items of the previous chunks come first, then left items of this chunk.
+                size_t left = m_begin;
+                size_t right = m_pivot;
+                for (size_t i = 0; i < m_chunk_index; ++i)
+                {
+                    size_t previous_chunk_begin, previous_chunk_end;
+                    m_partitioner.get_chunk(m_begin, m_end, i, previous_chunk_begin, previous_chunk_end);
+                    const size_t left_count = m_partitioner.m_left_counts[i];
+                    left += left_count;
+                    right += previous_chunk_end - previous_chunk_begin - left_count;
+                }
+                m_partitioner.split_items(m_dimension, chunk_begin, chunk_end, left, right);
+            }
+            break;
+
+          case CopyItems:
+            m_partitioner.copy_items(m_dimension, chunk_begin, chunk_end);
+            break;
+        }
+    }
+
+  private:
+    SAHPartitioner&             m_partitioner;
+    const ChunkStep             m_step;
+    const size_t                m_dimension;
+    const size_t                m_begin;
+    const size_t                m_end;
+    const size_t                m_pivot;
+    const size_t                m_chunk_index;
+};
+
 template <typename AABBVector>
 inline SAHPartitioner<AABBVector>::SAHPartitioner(
     const AABBVectorType&       bboxes,
@@ -93,9 +270,32 @@ inline SAHPartitioner<AABBVector>::SAHPartitioner(
   , m_interior_node_traversal_cost(interior_node_traversal_cost)
   , m_item_intersection_cost(item_intersection_cost)
   , m_left_areas(bboxes.size() > 1 ? bboxes.size() - 1 : 0)
+  , m_job_queue(0)
+  , m_job_count(0)
+  , m_min_parallel_split_size(0)
+  , m_bin_count(0)
 {
 }
 
+template <typename AABBVector>
+void SAHPartitioner<AABBVector>::enable_parallel_build(
+    JobQueue&                   job_queue,
+    const size_t                thread_count,
+    const size_t                min_parallel_split_size,
+    const size_t                bin_count)
+{
+    assert(thread_count > 0);
+    assert(bin_count > 1);
+
+    m_job_queue = &job_queue;
+    m_job_count = thread_count;
+    m_min_parallel_split_size = std::max<size_t>(min_parallel_split_size, 2);
+    m_bin_count = bin_count;
+    m_thread_id = boost::this_thread::get_id();
+    m_bins.resize(thread_count * Dimension * bin_count);
+    m_left_counts.resize(thread_count);
+}
+
 template <typename AABBVector>
 size_t SAHPartitioner<AABBVector>::partition(
     const size_t                begin,
@@ -113,9 +313,50 @@ size_t SAHPartitioner<AABBVector>::partition(
     if (count <= m_max_leaf_size)
         return end;
 
-    ValueType best_split_cost = std::numeric_limits<ValueType>::max();
+    // Only the thread that enabled parallel construction may use the worker threads.
+    const bool parallel =
+        m_job_queue != 0 &&
+        count >= m_min_parallel_split_size &&
+        boost::this_thread::get_id() == m_thread_id;
+
     size_t best_split_dim = 0;
     size_t best_split_pivot = 0;
+    ValueType best_split_cost = std::numeric_limits<ValueType>::max();
+
+    if (parallel)
+        find_binned_split(begin, end, best_split_dim, best_split_pivot, best_split_cost);
+
+    // Binning cannot separate items whose centroids are too close, sweep over all the items then.
+    if (best_split_pivot == 0)
+        find_exact_split(begin, end, best_split_dim, best_split_pivot, best_split_cost);
+
+    // Don't split if it's cheaper to make a leaf.
+    const ValueType split_cost =
+        m_interior_node_traversal_cost +
+        best_split_cost / half_surface_area(bbox) * m_item_intersection_cost;
+    const ValueType leaf_cost = count * m_item_intersection_cost;
+    if (leaf_cost <= split_cost)
+        return end;
+
+    const size_t pivot = begin + best_split_pivot;
+    assert(pivot < end);
+
+    if (parallel)
+        sort_indices_parallel(best_split_dim, begin, end, pivot);
+    else PartitionerBase<AABBVector>::sort_indices(best_split_dim, begin, end, pivot);
+
+    return pivot;
+}
+
+template <typename AABBVector>
+void SAHPartitioner<AABBVector>::find_exact_split(
+    const size_t                begin,
+    const size_t                end,
+    size_t&                     best_split_dim,
+    size_t&                     best_split_pivot,
+    ValueType&                  best_split_cost)
+{
+    const size_t count = end - begin;
 
     for (size_t d = 0; d < Dimension; ++d)
     {
@@ -129,7 +370,7 @@ size_t SAHPartitioner<AABBVector>::partition(
         for (size_t i = 0; i < count - 1; ++i)
         {
             bbox_accumulator.insert(bboxes[indices[begin + i]]);
-            m_left_areas[i] = half_surface_area(bbox_accumulator);
+            m_left_areas[begin + i] = half_surface_area(bbox_accumulator);
         }
 
         // Right-to-left sweep to accumulate bounding boxes, compute their surface area find the best partition.
@@ -140,7 +381,7 @@ size_t SAHPartitioner<AABBVector>::partition(
             bbox_accumulator.insert(bboxes[indices[begin + i]]);
 
             // Compute the cost of this partition.
-            const ValueType left_cost = m_left_areas[i - 1] * i;
+            const ValueType left_cost = m_left_areas[begin + i - 1] * i;
             const ValueType right_cost = half_surface_area(bbox_accumulator) * (count - i);
             const ValueType split_cost = left_cost + right_cost;
 
@@ -153,21 +394,182 @@ size_t SAHPartitioner<AABBVector>::partition(
             }
         }
     }
+}
 
-    // Don't split if it's cheaper to make a leaf.
-    const ValueType split_cost =
-        m_interior_node_traversal_cost +
-        best_split_cost / half_surface_area(bbox) * m_item_intersection_cost;
-    const ValueType leaf_cost = count * m_item_intersection_cost;
-    if (leaf_cost <= split_cost)
-        return end;
+template <typename AABBVector>
+void SAHPartitioner<AABBVector>::find_binned_split(
+    const size_t                begin,
+    const size_t                end,
+    size_t&                     best_split_dim,
+    size_t&                     best_split_pivot,
+    ValueType&                  best_split_cost)
+{
+    // Bin the items in parallel.
+    run_chunk_jobs(BinItems, 0, begin, end, 0);
 
-    const size_t pivot = begin + best_split_pivot;
-    assert(pivot < end);
+    std::vector<Bin> bins(m_bin_count);
+    std::vector<ValueType> left_areas(m_bin_count);
+    std::vector<size_t> left_counts(m_bin_count);
 
-    PartitionerBase<AABBVector>::sort_indices(best_split_dim, begin, end, pivot);
+    for (size_t d = 0; d < Dimension; ++d)
+    {
+        // Merge the bins of all the chunks, always in the same order.
+        for (size_t b = 0; b < m_bin_count; ++b)
+        {
+            bins[b].m_bbox.invalidate();
+            bins[b].m_count = 0;
 
-    return pivot;
+            for (size_t c = 0; c < m_job_count; ++c)
+            {
+                const Bin& chunk_bin = m_bins[(c * Dimension + d) * m_bin_count + b];
+                bins[b].m_bbox.insert(chunk_bin.m_bbox);
+                bins[b].m_count += chunk_bin.m_count;
+            }
+        }
+
+        AABBType bbox_accumulator;
+        size_t count_accumulator;
+
+        // Left-to-right sweep to accumulate bounding boxes and compute their surface area.
+        bbox_accumulator.invalidate();
+        count_accumulator = 0;
+        for (size_t b = 0; b < m_bin_count - 1; ++b)
+        {
+            bbox_accumulator.insert(bins[b].m_bbox);
+            count_accumulator += bins[b].m_count;
+            left_areas[b] = bbox_accumulator.is_valid() ? half_surface_area(bbox_accumulator) : ValueType(0.0);
+            left_counts[b] = count_accumulator;
+        }
+
+        // Right-to-left sweep to accumulate bounding boxes, compute their surface area find the best partition.
+        bbox_accumulator.invalidate();
+        count_accumulator = 0;
+        for (size_t b = m_bin_count - 1; b > 0; --b)
+        {
+            // Compute right bounding box.
+            bbox_accumulator.insert(bins[b].m_bbox);
+            count_accumulator += bins[b].m_count;
+
+            // Only consider boundaries with items on both sides.
+            const size_t left_count = left_counts[b - 1];
+            if (left_count == 0 || count_accumulator == 0)
+                continue;
+
+            // Compute the cost of this partition.
+            const ValueType left_cost = left_areas[b - 1] * left_count;
+            const ValueType right_cost = half_surface_area(bbox_accumulator) * count_accumulator;
+            const ValueType split_cost = left_cost + right_cost;
+
+            // Keep track of the partition with the lowest cost.
+            if (best_split_cost > split_cost)
+            {
+                best_split_cost = split_cost;
+                best_split_dim = d;
+                best_split_pivot = left_count;
+            }
+        }
+    }
+}
+
+template <typename AABBVector>
+void SAHPartitioner<AABBVector>::sort_indices_parallel(
+    const size_t                dimension,
+    const size_t                begin,
+    const size_t                end,
+    const size_t                pivot)
+{
+    run_chunk_jobs(TagItems, dimension, begin, end, pivot);
+
+    for (size_t d = 0; d < Dimension; ++d)
+    {
+        if (d != dimension)
+        {
+            run_chunk_jobs(CountLeftItems, d, begin, end, pivot);
+            run_chunk_jobs(SplitItems, d, begin, end, pivot);
+            run_chunk_jobs(CopyItems, d, begin, end, pivot);
+        }
+    }
+}
+
+template <typename AABBVector>
+void SAHPartitioner<AABBVector>::bin_items(
+    const size_t                begin,
+    const size_t                end,
+    const size_t                chunk_begin,
+    const size_t                chunk_end,
+    const size_t                chunk_index)
+{
+    const AABBVectorType& bboxes = PartitionerBase<AABBVector>::m_bboxes;
+
+    for (size_t d = 0; d < Dimension; ++d)
+    {
+        Bin* bins = &m_bins[(chunk_index * Dimension + d) * m_bin_count];
+
+        for (size_t b = 0; b < m_bin_count; ++b)
+        {
+            bins[b].m_bbox.invalidate();
+            bins[b].m_count = 0;
+        }
+
+        // The items are sorted along this dimension, so the bins are contiguous ranges of items
+        // and a split at a bin boundary is a split at the number of items to the left of it.
+        const std::vector<size_t>& indices = PartitionerBase<AABBVector>::m_indices[d];
+        const ValueType key_min = get_sort_key(indices[begin], d);
+        const ValueType key_max = get_sort_key(indices[end - 1], d);
+        if (key_min == key_max)
+            continue;
+
+        const ValueType scale = m_bin_count / (key_max - key_min);
+
+        for (size_t i = chunk_begin; i < chunk_end; ++i)
+        {
+            const size_t item_index = indices[i];
+            const size_t b =
+                std::min(
+                    static_cast<size_t>((get_sort_key(item_index, d) - key_min) * scale),
+                    m_bin_count - 1);
+
+            bins[b].m_bbox.insert(bboxes[item_index]);
+            ++bins[b].m_count;
+        }
+    }
+}
+
+template <typename AABBVector>
+inline void SAHPartitioner<AABBVector>::get_chunk(
+    const size_t                begin,
+    const size_t                end,
+    const size_t                chunk_index,
+    size_t&                     chunk_begin,
+    size_t&                     chunk_end) const
+{
+    const size_t count = end - begin;
+    chunk_begin = begin + count * chunk_index / m_job_count;
+    chunk_end = begin + count * (chunk_index + 1) / m_job_count;
+}
+
+template <typename AABBVector>
+void SAHPartitioner<AABBVector>::run_chunk_jobs(
+    const ChunkStep             step,
+    const size_t                dimension,
+    const size_t                begin,
+    const size_t                end,
+    const size_t                pivot)
+{
+    for (size_t i = 0; i < m_job_count; ++i)
+        m_job_queue->schedule(new ChunkJob(*this, step, dimension, begin, end, pivot, i));
+
+    m_job_queue->wait_until_completion();
+}
+
+template <typename AABBVector>
+inline typename SAHPartitioner<AABBVector>::ValueType SAHPartitioner<AABBVector>::get_sort_key(
+    const size_t                item_index,
+    const size_t                dimension) const
+{
+    // Same key as BboxSortPredicate.
+    const AABBType& bbox = PartitionerBase<AABBVector>::m_bboxes[item_index];
+    return bbox.min[dimension] + bbox.max[dimension];
 }
 
 }       // namespace bvh
@@ -36,7 +36,10 @@
 #include "foundation/math/bvh/bvh_bboxsortpredicate.h"
 #include "foundation/math/scalar.h"
 #include "foundation/math/split.h"
+#include "foundation/platform/compiler.h"
 #include "foundation/platform/types.h"
+#include "foundation/utility/job/ijob.h"
+#include "foundation/utility/job/jobqueue.h"
 
 // Standard headers.
 #include <algorithm>
@@ -74,6 +77,9 @@ namespace bvh {
 //              const AABBType&     bbox) const;
 //      };
 //
+// The methods of the ItemHandler class may be called concurrently from multiple
+// threads when parallel construction is enabled (see enable_parallel_build()).
+//
 
 // When defined, additional costly correctness checks are enabled (only in Debug).
 #undef FOUNDATION_SBVH_DEEPCHECK
@@ -107,6 +113,16 @@ class SBVHPartitioner
         const ValueType             interior_node_traversal_cost = ValueType(1.0),
         const ValueType             item_intersection_cost = ValueType(1.0));
 
+    // Enable parallel construction. Splits of leaves containing at least 'min_parallel_split_size'
+    // items are computed using the 'thread_count' worker threads servicing 'job_queue'. In addition,
+    // 'thread_count' workspaces are made available to builders splitting leaves concurrently
+    // (workspace indices 1 to 'thread_count'). Workspace 0 is reserved to the thread that owns
+    // the job queue.
+    void enable_parallel_build(
+        JobQueue&                   job_queue,
+        const size_t                thread_count,
+        const size_t                min_parallel_split_size = 64 * 1024);
+
     // Create the root leaf of the tree. Ownership of the leaf is passed to the caller.
     LeafType* create_root_leaf() const;
 
@@ -114,13 +130,15 @@ class SBVHPartitioner
     AABBType compute_leaf_bbox(const LeafType& leaf) const;
 
     // Split a leaf. Return true if the split should be split or false if it should be kept unsplit.
+    // Concurrent calls are allowed as long as they use distinct workspaces.
     bool split(
         LeafType&                   leaf,
         const AABBType&             leaf_bbox,
         LeafType&                   left_leaf,
         AABBType&                   left_leaf_bbox,
         LeafType&                   right_leaf,
-        AABBType&                   right_leaf_bbox);
+        AABBType&                   right_leaf_bbox,
+        const size_t                workspace_index = 0);
 
     // Store a leaf. Return the index of the first stored item.
     size_t store(const LeafType& leaf);
@@ -143,6 +161,30 @@ class SBVHPartitioner
         size_t      m_exit_counter;     // number of items that end in this bin
     };
 
+    // Scratch memory and counters private to a thread.
+    struct Workspace
+    {
+        std::vector<ValueType>      m_left_areas[Dimension];
+        std::vector<Bin>            m_bins;
+        std::vector<uint8>          m_tags;
+        size_t                      m_spatial_split_count;
+        size_t                      m_object_split_count;
+
+        Workspace()
+          : m_spatial_split_count(0)
+          , m_object_split_count(0)
+        {
+        }
+    };
+
+    class SweepJob;
+    class BinningJob;
+    class SortJob;
+
+    friend class SweepJob;
+    friend class BinningJob;
+    friend class SortJob;
+
     ItemHandler&                    m_item_handler;
     const AABBVectorType&           m_bboxes;
     const size_t                    m_max_leaf_size;
@@ -152,22 +194,29 @@ class SBVHPartitioner
     const ValueType                 m_item_intersection_cost;
 
     ValueType                       m_root_bbox_rcp_sa;
-    std::vector<AABBType>           m_left_bboxes;
-    std::vector<Bin>                m_bins;
-    std::vector<uint8>              m_tags;
+    std::vector<Workspace>          m_workspaces;
     std::vector<size_t>             m_final_indices;
 
-    size_t                          m_spatial_split_count;
-    size_t                          m_object_split_count;
+    JobQueue*                       m_job_queue;
+    size_t                          m_job_count;
+    size_t                          m_min_parallel_split_size;
 
     void compute_root_bbox_surface_area();
 
+    // Sort a set of item indices along a given dimension, possibly in parallel with other sorts.
+    void sort_indices(
+        std::vector<size_t>&        indices,
+        const size_t                dimension,
+        const bool                  parallel) const;
+
     ValueType compute_final_split_cost(
         const AABBType&             bbox,
         const double                cost) const;
 
     // Find the best object split for a given set of items.
     void find_object_split(
+        Workspace&                  workspace,
+        const bool                  parallel,
         LeafType&                   leaf,
         const AABBType&             leaf_bbox,
         AABBType&                   left_leaf_bbox,
@@ -176,8 +225,19 @@ class SBVHPartitioner
         size_t&                     best_split_pivot,
         ValueType&                  best_split_cost);
 
+    // Find the best object split along a given dimension.
+    void sweep_object_splits(
+        std::vector<ValueType>&     left_areas,
+        const LeafType&             leaf,
+        const AABBType&             leaf_bbox,
+        const size_t                dimension,
+        size_t&                     best_split_pivot,
+        ValueType&                  best_split_cost) const;
+
     // Find the best spatial split for a given set of items.
     void find_spatial_split(
+        Workspace&                  workspace,
+        const bool                  parallel,
         const LeafType&             leaf,
         const AABBType&             leaf_bbox,
         AABBType&                   left_leaf_bbox,
@@ -185,8 +245,21 @@ class SBVHPartitioner
         SplitType&                  best_split,
         ValueType&                  best_split_cost);
 
+    // Clear a set of bins.
+    void clear_bins(Bin* bins) const;
+
+    // Push a range of the items of a leaf through a set of bins.
+    void bin_items(
+        const LeafType&             leaf,
+        const AABBType&             leaf_bbox,
+        const size_t                dimension,
+        const size_t                begin,
+        const size_t                end,
+        Bin*                        bins) const;
+
     // Sort a set of items into two subsets according to a given object split.
     void object_sort(
+        Workspace&                  workspace,
         LeafType&                   leaf,
         const size_t                split_dim,
         const size_t                split_pivot,
@@ -197,6 +270,7 @@ class SBVHPartitioner
 
     // Sort a set of items into two subsets according to a given spatial split.
     void spatial_sort(
+        const bool                  parallel,
         const LeafType&             leaf,
         const SplitType&            split,
         const AABBType&             left_leaf_bbox,
@@ -210,6 +284,122 @@ class SBVHPartitioner
 // SBVHPartitioner class implementation.
 //
 
+template <typename ItemHandler, typename AABBVector>
+class SBVHPartitioner<ItemHandler, AABBVector>::SweepJob
+  : public IJob
+{
+  public:
+    SweepJob(
+        const SBVHPartitioner&      partitioner,
+        std::vector<ValueType>&     left_areas,
+        const LeafType&             leaf,
+        const AABBType&             leaf_bbox,
+        const size_t                dimension,
+        size_t&                     best_split_pivot,
+        ValueType&                  best_split_cost)
+      : m_partitioner(partitioner)
+      , m_left_areas(left_areas)
+      , m_leaf(leaf)
+      , m_leaf_bbox(leaf_bbox)
+      , m_dimension(dimension)
+      , m_best_split_pivot(best_split_pivot)
+      , m_best_split_cost(best_split_cost)
+    {
+    }
+
+    virtual void execute(const size_t thread_index) APPLESEED_OVERRIDE
+    {
+        m_partitioner.sweep_object_splits(
+            m_left_areas,
+            m_leaf,
+            m_leaf_bbox,
+            m_dimension,
+            m_best_split_pivot,
+            m_best_split_cost);
+    }
+
+  private:
+    const SBVHPartitioner&          m_partitioner;
+    std::vector<ValueType>&         m_left_areas;
+    const LeafType&                 m_leaf;
+    const AABBType                  m_leaf_bbox;
+    const size_t                    m_dimension;
+    size_t&                         m_best_split_pivot;
+    ValueType&                      m_best_split_cost;
+};
+
+template <typename ItemHandler, typename AABBVector>
+class SBVHPartitioner<ItemHandler, AABBVector>::BinningJob
+  : public IJob
+{
+  public:
+    BinningJob(
+        const SBVHPartitioner&      partitioner,
+        const LeafType&             leaf,
+        const AABBType&             leaf_bbox,
+        const size_t                dimension,
+        const size_t                begin,
+        const size_t                end,
+        Bin*                        bins)
+      : m_partitioner(partitioner)
+      , m_leaf(leaf)
+      , m_leaf_bbox(leaf_bbox)
+      , m_dimension(dimension)
+      , m_begin(begin)
+      , m_end(end)
+      , m_bins(bins)
+    {
+    }
+
+    virtual void execute(const size_t thread_index) APPLESEED_OVERRIDE
+    {
+        m_partitioner.clear_bins(m_bins);
+        m_partitioner.bin_items(
+            m_leaf,
+            m_leaf_bbox,
+            m_dimension,
+            m_begin,
+            m_end,
+            m_bins);
+    }
+
+  private:
+    const SBVHPartitioner&          m_partitioner;
+    const LeafType&                 m_leaf;
+    const AABBType                  m_leaf_bbox;
+    const size_t                    m_dimension;
+    const size_t                    m_begin;
+    const size_t                    m_end;
+    Bin*                            m_bins;
+};
+
+template <typename ItemHandler, typename AABBVector>
+class SBVHPartitioner<ItemHandler, AABBVector>::SortJob
+  : public IJob
+{
+  public:
+    SortJob(
+        const AABBVectorType&       bboxes,
+        std::vector<size_t>&        indices,
+        const size_t                dimension)
+      : m_bboxes(bboxes)
+      , m_indices(indices)
+      , m_dimension(dimension)
+    {
+    }
+
+    virtual void execute(const size_t thread_index) APPLESEED_OVERRIDE
+    {
+        StableBboxSortPredicate<AABBVectorType> predicate(m_bboxes, m_dimension);
+        std::sort(m_indices.begin(), m_indices.end(), predicate);
+    }
+
+  private:
+    const AABBVectorType&           m_bboxes;
+    std::vector<size_t>&            m_indices;
+    const size_t                    m_dimension;
+};
+
 template <typename ItemHandler, typename AABBVector>
 SBVHPartitioner<ItemHandler, AABBVector>::SBVHPartitioner(
     ItemHandler&                    item_handler,
@@ -225,15 +415,28 @@ SBVHPartitioner<ItemHandler, AABBVector>::SBVHPartitioner(
   , m_rcp_bin_count(ValueType(1.0) / bin_count)
   , m_interior_node_traversal_cost(interior_node_traversal_cost)
   , m_item_intersection_cost(item_intersection_cost)
-  , m_left_bboxes(bboxes.size() > 1 ? bboxes.size() - 1 : 0)
-  , m_bins(bin_count)
-  , m_tags(bboxes.size())
-  , m_spatial_split_count(0)
-  , m_object_split_count(0)
+  , m_workspaces(1)
+  , m_job_queue(0)
+  , m_job_count(0)
+  , m_min_parallel_split_size(0)
 {
     compute_root_bbox_surface_area();
 }
 
+template <typename ItemHandler, typename AABBVector>
+void SBVHPartitioner<ItemHandler, AABBVector>::enable_parallel_build(
+    JobQueue&                       job_queue,
+    const size_t                    thread_count,
+    const size_t                    min_parallel_split_size)
+{
+    assert(thread_count > 0);
+
+    m_job_queue = &job_queue;
+    m_job_count = thread_count;
+    m_min_parallel_split_size = min_parallel_split_size;
+    m_workspaces.resize(thread_count + 1);
+}
+
 template <typename ItemHandler, typename AABBVector>
 typename SBVHPartitioner<ItemHandler, AABBVector>::LeafType* SBVHPartitioner<ItemHandler, AABBVector>::create_root_leaf() const
 {
@@ -251,10 +454,12 @@ typename SBVHPartitioner<ItemHandler, AABBVector>::LeafType* SBVHPartitioner<Ite
             indices[i] = i;
 
         // Sort the items according to their bounding boxes.
-        StableBboxSortPredicate<AABBVectorType> predicate(m_bboxes, d);
-        std::sort(indices.begin(), indices.end(), predicate);
+        sort_indices(indices, d, m_job_queue != 0);
     }
 
+    if (m_job_queue)
+        m_job_queue->wait_until_completion();
+
     return leaf;
 }
 
@@ -280,9 +485,11 @@ bool SBVHPartitioner<ItemHandler, AABBVector>::split(
     LeafType&                       left_leaf,
     AABBType&                       left_leaf_bbox,
     LeafType&                       right_leaf,
-    AABBType&                       right_leaf_bbox)
+    AABBType&                       right_leaf_bbox,
+    const size_t                    workspace_index)
 {
     assert(!leaf_bbox.is_valid() || leaf_bbox.rank() >= Dimension - 1);
+    assert(workspace_index < m_workspaces.size());
 
 #ifdef FOUNDATION_SBVH_DEEPCHECK
     // Make sure every item intersects the leaf it belongs to.
@@ -298,6 +505,14 @@ bool SBVHPartitioner<ItemHandler, AABBVector>::split(
     if (leaf.m_indices[0].size() < 2)
         return false;
 
+    Workspace& workspace = m_workspaces[workspace_index];
+
+    // Only the thread that owns the job queue may use the worker threads.
+    const bool parallel =
+        m_job_queue != 0 &&
+        workspace_index == 0 &&
+        leaf.size() >= m_min_parallel_split_size;
+
     // Find the best object split.
     AABBType object_split_left_bbox;
     AABBType object_split_right_bbox;
@@ -305,6 +520,8 @@ bool SBVHPartitioner<ItemHandler, AABBVector>::split(
     size_t object_split_pivot;
     ValueType object_split_cost = std::numeric_limits<ValueType>::max();
     find_object_split(
+        workspace,
+        parallel,
         leaf,
         leaf_bbox,
         object_split_left_bbox,
@@ -339,6 +556,8 @@ bool SBVHPartitioner<ItemHandler, AABBVector>::split(
     if (do_find_spatial_split)
     {
         find_spatial_split(
+            workspace,
+            parallel,
             leaf,
             leaf_bbox,
             spatial_split_left_bbox,
@@ -362,6 +581,7 @@ bool SBVHPartitioner<ItemHandler, AABBVector>::split(
         left_leaf_bbox = object_split_left_bbox;
         right_leaf_bbox = object_split_right_bbox;
         object_sort(
+            workspace,
             leaf,
             object_split_dim,
             object_split_pivot,
@@ -369,7 +589,7 @@ bool SBVHPartitioner<ItemHandler, AABBVector>::split(
             right_leaf_bbox,
             left_leaf,
             right_leaf);
-        ++m_object_split_count;
+        ++workspace.m_object_split_count;
         return true;
     }
     else
@@ -378,13 +598,14 @@ bool SBVHPartitioner<ItemHandler, AABBVector>::split(
         left_leaf_bbox = spatial_split_left_bbox;
         right_leaf_bbox = spatial_split_right_bbox;
         spatial_sort(
+            parallel,
             leaf,
             spatial_split,
             left_leaf_bbox,
             right_leaf_bbox,
             left_leaf,
             right_leaf);
-        ++m_spatial_split_count;
+        ++workspace.m_spatial_split_count;
         return true;
     }
 }
@@ -425,8 +646,28 @@ inline typename AABBVector::value_type::ValueType SBVHPartitioner<ItemHandler, A
         m_item_intersection_cost * (cost / bbox_half_surface_area);
 }
 
+template <typename ItemHandler, typename AABBVector>
+void SBVHPartitioner<ItemHandler, AABBVector>::sort_indices(
+    std::vector<size_t>&            indices,
+    const size_t                    dimension,
+    const bool                      parallel) const
+{
+    if (parallel)
+    {
+        // The caller is responsible for waiting until the sort is complete.
+        m_job_queue->schedule(new SortJob(m_bboxes, indices, dimension));
+    }
+    else
+    {
+        StableBboxSortPredicate<AABBVectorType> predicate(m_bboxes, dimension);
+        std::sort(indices.begin(), indices.end(), predicate);
+    }
+}
+
 template <typename ItemHandler, typename AABBVector>
 void SBVHPartitioner<ItemHandler, AABBVector>::find_object_split(
+    Workspace&                      workspace,
+    const bool                      parallel,
     LeafType&                       leaf,
     const AABBType&                 leaf_bbox,
     AABBType&                       left_leaf_bbox,
@@ -435,58 +676,129 @@ void SBVHPartitioner<ItemHandler, AABBVector>::find_object_split(
     size_t&                         best_split_pivot,
     ValueType&                      best_split_cost)
 {
+    size_t split_pivots[Dimension];
+    ValueType split_costs[Dimension];
+
+    // Find the best split along each dimension.
     for (size_t d = 0; d < Dimension; ++d)
     {
-        const std::vector<size_t>& indices = leaf.m_indices[d];
-        const size_t item_count = indices.size();
+        if (parallel)
+        {
+            m_job_queue->schedule(
+                new SweepJob(
+                    *this,
+                    workspace.m_left_areas[d],
+                    leaf,
+                    leaf_bbox,
+                    d,
+                    split_pivots[d],
+                    split_costs[d]));
+        }
+        else
+        {
+            sweep_object_splits(
+                workspace.m_left_areas[d],
+                leaf,
+                leaf_bbox,
+                d,
+                split_pivots[d],
+                split_costs[d]);
+        }
+    }
 
-        AABBType bbox_accumulator;
+    if (parallel)
+        m_job_queue->wait_until_completion();
 
-        // Left-to-right sweep to accumulate bounding boxes and compute their surface area.
-        bbox_accumulator.invalidate();
-        for (size_t i = 0; i < item_count - 1; ++i)
+    // Keep track of the partition with the lowest cost. Ties are resolved in favor of the lowest dimension.
+    for (size_t d = 0; d < Dimension; ++d)
+    {
+        if (best_split_cost > split_costs[d])
         {
-            const size_t item_index = indices[i];
-            const AABBType& item_bbox = m_bboxes[item_index];
-            const AABBType clipped_item_bbox = AABBType::intersect(item_bbox, leaf_bbox);
-            assert(clipped_item_bbox.is_valid());
-            bbox_accumulator.insert(clipped_item_bbox);
-            m_left_bboxes[i] = bbox_accumulator;
+            best_split_cost = split_costs[d];
+            best_split_dim = d;
+            best_split_pivot = split_pivots[d];
         }
+    }
 
-        // Right-to-left sweep to accumulate bounding boxes, compute their surface area find the best partition.
-        bbox_accumulator.invalidate();
-        for (size_t i = item_count - 1; i > 0; --i)
-        {
-            // Compute right bounding box.
-            const size_t item_index = indices[i];
-            const AABBType& item_bbox = m_bboxes[item_index];
-            const AABBType clipped_item_bbox = AABBType::intersect(item_bbox, leaf_bbox);
-            assert(clipped_item_bbox.is_valid());
-            bbox_accumulator.insert(clipped_item_bbox);
-
-            // Compute the cost of this partition.
-            const ValueType left_cost = half_surface_area(m_left_bboxes[i - 1]) * i;
-            const ValueType right_cost = half_surface_area(bbox_accumulator) * (item_count - i);
-            const ValueType split_cost = left_cost + right_cost;
+    if (best_split_cost < std::numeric_limits<ValueType>::max())
+    {
+        // Compute the bounding boxes of the left and right subsets.
+        const std::vector<size_t>& indices = leaf.m_indices[best_split_dim];
+        const size_t item_count = indices.size();
 
-            // Keep track of the partition with the lowest cost.
-            if (best_split_cost > split_cost)
-            {
-                best_split_cost = split_cost;
-                best_split_dim = d;
-                best_split_pivot = i;
-                left_leaf_bbox = m_left_bboxes[i - 1];
-                right_leaf_bbox = bbox_accumulator;
-            }
-        }
+        left_leaf_bbox.invalidate();
+        for (size_t i = 0; i < best_split_pivot; ++i)
+            left_leaf_bbox.insert(AABBType::intersect(m_bboxes[indices[i]], leaf_bbox));
+
+        right_leaf_bbox.invalidate();
+        for (size_t i = best_split_pivot; i < item_count; ++i)
+            right_leaf_bbox.insert(AABBType::intersect(m_bboxes[indices[i]], leaf_bbox));
     }
 
     best_split_cost = compute_final_split_cost(leaf_bbox, best_split_cost);
 }
 
+template <typename ItemHandler, typename AABBVector>
+void SBVHPartitioner<ItemHandler, AABBVector>::sweep_object_splits(
+    std::vector<ValueType>&         left_areas,
+    const LeafType&                 leaf,
+    const AABBType&                 leaf_bbox,
+    const size_t                    dimension,
+    size_t&                         best_split_pivot,
+    ValueType&                      best_split_cost) const
+{
+    const std::vector<size_t>& indices = leaf.m_indices[dimension];
+    const size_t item_count = indices.size();
+
+    best_split_pivot = 0;
+    best_split_cost = std::numeric_limits<ValueType>::max();
+
+    if (left_areas.size() < item_count - 1)
+        left_areas.resize(item_count - 1);
+
+    AABBType bbox_accumulator;
+
+    // Left-to-right sweep to accumulate bounding boxes and compute their surface area.
+    bbox_accumulator.invalidate();
+    for (size_t i = 0; i < item_count - 1; ++i)
+    {
+        const size_t item_index = indices[i];
+        const AABBType& item_bbox = m_bboxes[item_index];
+        const AABBType clipped_item_bbox = AABBType::intersect(item_bbox, leaf_bbox);
+        assert(clipped_item_bbox.is_valid());
+        bbox_accumulator.insert(clipped_item_bbox);
+        left_areas[i] = half_surface_area(bbox_accumulator);
+    }
+
+    // Right-to-left sweep to accumulate bounding boxes, compute their surface area find the best partition.
+    bbox_accumulator.invalidate();
+    for (size_t i = item_count - 1; i > 0; --i)
+    {
+        // Compute right bounding box.
+        const size_t item_index = indices[i];
+        const AABBType& item_bbox = m_bboxes[item_index];
+        const AABBType clipped_item_bbox = AABBType::intersect(item_bbox, leaf_bbox);
+        assert(clipped_item_bbox.is_valid());
+        bbox_accumulator.insert(clipped_item_bbox);
+
+        // Compute the cost of this partition.
+        const ValueType left_cost = left_areas[i - 1] * i;
+        const ValueType right_cost = half_surface_area(bbox_accumulator) * (item_count - i);
+        const ValueType split_cost = left_cost + right_cost;
+
+        // Keep track of the partition with the lowest cost.
+        if (best_split_cost > split_cost)
+        {
+            best_split_cost = split_cost;
+            best_split_pivot = i;
+        }
+    }
+}
+
 template <typename ItemHandler, typename AABBVector>
 void SBVHPartitioner<ItemHandler, AABBVector>::find_spatial_split(
+    Workspace&                      workspace,
+    const bool                      parallel,
     const LeafType&                 leaf,
     const AABBType&                 leaf_bbox,
     AABBType&                       left_leaf_bbox,
@@ -494,83 +806,65 @@ void SBVHPartitioner<ItemHandler, AABBVector>::find_spatial_split(
     SplitType&                      best_split,
     ValueType&                      best_split_cost)
 {
+    std::vector<Bin>& bins = workspace.m_bins;
+    bins.resize(m_bin_count);
+
+    // When binning in parallel, each job fills its own set of bins.
+    const size_t chunk_count = parallel ? m_job_count : 0;
+    std::vector<Bin> chunk_bins(chunk_count * m_bin_count);
+
     for (size_t d = 0; d < Dimension; ++d)
     {
         const std::vector<size_t>& indices = leaf.m_indices[d];
         const size_t item_count = indices.size();
 
-        // Compute the extent of the leaf in the splitting dimension.
-        const ValueType bbox_min = leaf_bbox.min[d];
-        const ValueType bbox_max = leaf_bbox.max[d];
-        const ValueType bbox_extent = bbox_max - bbox_min;
-        const ValueType rcp_bin_size = m_bin_count / bbox_extent;
-
         // This node is flat in this dimension.
-        if (bbox_extent == ValueType(0.0))
+        if (leaf_bbox.max[d] - leaf_bbox.min[d] == ValueType(0.0))
             continue;
 
         // Clear the bins.
-        for (size_t i = 0; i < m_bin_count; ++i)
-        {
-            Bin& bin = m_bins[i];
-            bin.m_bin_bbox.invalidate();
-            bin.m_entry_counter = 0;
-            bin.m_exit_counter = 0;
-        }
+        clear_bins(&bins[0]);
 
         // Push the items through the bins.
-        for (size_t i = 0; i < item_count; ++i)
+        if (parallel)
         {
-            // Compute the extent of this item in the splitting dimension.
-            const size_t item_index = indices[i];
-            const AABBType& item_bbox = m_bboxes[item_index];
-            const ValueType item_bbox_min = item_bbox.min[d];
-            const ValueType item_bbox_max = item_bbox.max[d];
-            assert(item_bbox_min <= bbox_max && item_bbox_max >= bbox_min);
-
-            // Find the range of bins covered by this item.
-            const size_t begin_bin =
-                item_bbox_min > bbox_min
-                    ? std::min<size_t>(truncate<size_t>((item_bbox_min - bbox_min) * rcp_bin_size), m_bin_count - 1)
-                    : 0;
-            const size_t end_bin =
-                std::min<size_t>(truncate<size_t>((item_bbox_max - bbox_min) * rcp_bin_size), m_bin_count - 1);
-            assert(begin_bin < m_bin_count);
-            assert(end_bin < m_bin_count);
-            assert(begin_bin <= end_bin);
-
-            // Update the bins that this item overlaps.
-            for (size_t b = begin_bin; b <= end_bin; ++b)
+            for (size_t c = 0; c < chunk_count; ++c)
             {
-                // Compute the bounds of this bin.
-                const ValueType bin_min = lerp(bbox_min, bbox_max, (b + 0) * m_rcp_bin_count);
-                const ValueType bin_max = lerp(bbox_min, bbox_max, (b + 1) * m_rcp_bin_count);
-
-                // Clip the item against the bin boundaries.
-                const AABBType item_clipped_bbox =
-                    m_item_handler.clip(
-                        item_index,
+                m_job_queue->schedule(
+                    new BinningJob(
+                        *this,
+                        leaf,
+                        leaf_bbox,
                         d,
-                        bin_min,
-                        bin_max);
-                assert(item_clipped_bbox.is_valid());
-
-                // Grow the bounding box associated with this bin.
-                m_bins[b].m_bin_bbox.insert(item_clipped_bbox);
+                        (c + 0) * item_count / chunk_count,
+                        (c + 1) * item_count / chunk_count,
+                        &chunk_bins[c * m_bin_count]));
             }
 
-            // Update the enter/leave counters.
-            ++m_bins[begin_bin].m_entry_counter;
-            ++m_bins[end_bin].m_exit_counter;
+            m_job_queue->wait_until_completion();
+
+            // Merge the bins of all jobs.
+            for (size_t c = 0; c < chunk_count; ++c)
+            {
+                for (size_t i = 0; i < m_bin_count; ++i)
+                {
+                    const Bin& chunk_bin = chunk_bins[c * m_bin_count + i];
+                    Bin& bin = bins[i];
+                    bin.m_bin_bbox.insert(chunk_bin.m_bin_bbox);
+                    bin.m_entry_counter += chunk_bin.m_entry_counter;
+                    bin.m_exit_counter += chunk_bin.m_exit_counter;
+                }
+            }
         }
+        else bin_items(leaf, leaf_bbox, d, 0, item_count, &bins[0]);
 
         AABBType bbox_accumulator;
 
         // Left-to-right sweep to compute the left bounding boxes.
-        bbox_accumulator = m_bins[0].m_bin_bbox;
+        bbox_accumulator = bins[0].m_bin_bbox;
         for (size_t i = 1; i < m_bin_count; ++i)
         {
-            Bin& bin = m_bins[i];
+            Bin& bin = bins[i];
             bin.m_left_bbox = bbox_accumulator;
             bbox_accumulator.insert(bin.m_bin_bbox);
         }
@@ -581,7 +875,7 @@ void SBVHPartitioner<ItemHandler, AABBVector>::find_spatial_split(
         bbox_accumulator.invalidate();
         for (size_t i = m_bin_count - 1; i > 0; --i)
         {
-            const Bin& bin = m_bins[i];
+            const Bin& bin = bins[i];
 
             // Compute the right bounding box.
             bbox_accumulator.insert(bin.m_bin_bbox);
@@ -621,8 +915,85 @@ void SBVHPartitioner<ItemHandler, AABBVector>::find_spatial_split(
     }
 }
 
+template <typename ItemHandler, typename AABBVector>
+void SBVHPartitioner<ItemHandler, AABBVector>::clear_bins(Bin* bins) const
+{
+    for (size_t i = 0; i < m_bin_count; ++i)
+    {
+        Bin& bin = bins[i];
+        bin.m_bin_bbox.invalidate();
+        bin.m_entry_counter = 0;
+        bin.m_exit_counter = 0;
+    }
+}
+
+template <typename ItemHandler, typename AABBVector>
+void SBVHPartitioner<ItemHandler, AABBVector>::bin_items(
+    const LeafType&                 leaf,
+    const AABBType&                 leaf_bbox,
+    const size_t                    dimension,
+    const size_t                    begin,
+    const size_t                    end,
+    Bin*                            bins) const
+{
+    const size_t d = dimension;
+    const std::vector<size_t>& indices = leaf.m_indices[d];
+
+    // Compute the extent of the leaf in the splitting dimension.
+    const ValueType bbox_min = leaf_bbox.min[d];
+    const ValueType bbox_max = leaf_bbox.max[d];
+    const ValueType bbox_extent = bbox_max - bbox_min;
+    const ValueType rcp_bin_size = m_bin_count / bbox_extent;
+
+    for (size_t i = begin; i < end; ++i)
+    {
+        // Compute the extent of this item in the splitting dimension.
+        const size_t item_index = indices[i];
+        const AABBType& item_bbox = m_bboxes[item_index];
+        const ValueType item_bbox_min = item_bbox.min[d];
+        const ValueType item_bbox_max = item_bbox.max[d];
+        assert(item_bbox_min <= bbox_max && item_bbox_max >= bbox_min);
+
+        // Find the range of bins covered by this item.
+        const size_t begin_bin =
+            item_bbox_min > bbox_min
+                ? std::min<size_t>(truncate<size_t>((item_bbox_min - bbox_min) * rcp_bin_size), m_bin_count - 1)
+                : 0;
+        const size_t end_bin =
+            std::min<size_t>(truncate<size_t>((item_bbox_max - bbox_min) * rcp_bin_size), m_bin_count - 1);
+        assert(begin_bin < m_bin_count);
+        assert(end_bin < m_bin_count);
+        assert(begin_bin <= end_bin);
+
+        // Update the bins that this item overlaps.
+        for (size_t b = begin_bin; b <= end_bin; ++b)
+        {
+            // Compute the bounds of this bin.
+            const ValueType bin_min = lerp(bbox_min, bbox_max, (b + 0) * m_rcp_bin_count);
+            const ValueType bin_max = lerp(bbox_min, bbox_max, (b + 1) * m_rcp_bin_count);
+
+            // Clip the item against the bin boundaries.
+            const AABBType item_clipped_bbox =
+                m_item_handler.clip(
+                    item_index,
+                    d,
+                    bin_min,
+                    bin_max);
+            assert(item_clipped_bbox.is_valid());
+
+            // Grow the bounding box associated with this bin.
+            bins[b].m_bin_bbox.insert(item_clipped_bbox);
+        }
+
+        // Update the enter/leave counters.
+        ++bins[begin_bin].m_entry_counter;
+        ++bins[end_bin].m_exit_counter;
+    }
+}
+
 template <typename ItemHandler, typename AABBVector>
 void SBVHPartitioner<ItemHandler, AABBVector>::object_sort(
+    Workspace&                      workspace,
     LeafType&                       leaf,
     const size_t                    split_dim,
     const size_t                    split_pivot,
@@ -636,11 +1007,14 @@ void SBVHPartitioner<ItemHandler, AABBVector>::object_sort(
 
     enum { Left = 0, Right = 1 };
 
+    std::vector<uint8>& tags = workspace.m_tags;
+    tags.resize(m_bboxes.size());
+
     for (size_t i = 0; i < split_pivot; ++i)
-        m_tags[split_indices[i]] = Left;
+        tags[split_indices[i]] = Left;
 
     for (size_t i = split_pivot; i < size; ++i)
-        m_tags[split_indices[i]] = Right;
+        tags[split_indices[i]] = Right;
 
     for (size_t d = 0; d < Dimension; ++d)
     {
@@ -680,7 +1054,7 @@ void SBVHPartitioner<ItemHandler, AABBVector>::object_sort(
             {
                 const size_t item_index = leaf.m_indices[d][i];
 
-                if (m_tags[item_index] == Left)
+                if (tags[item_index] == Left)
                 {
                     assert(left < split_pivot);
                     left_leaf.m_indices[d][left++] = item_index;
@@ -700,6 +1074,7 @@ void SBVHPartitioner<ItemHandler, AABBVector>::object_sort(
 
 template <typename ItemHandler, typename AABBVector>
 void SBVHPartitioner<ItemHandler, AABBVector>::spatial_sort(
+    const bool                      parallel,
     const LeafType&                 leaf,
     const SplitType&                split,
     const AABBType&                 left_leaf_bbox,
@@ -766,11 +1141,13 @@ void SBVHPartitioner<ItemHandler, AABBVector>::spatial_sort(
             right_leaf.m_indices[d] = right_leaf.m_indices[split.m_dimension];
 
             // Sort the items according to their bounding boxes.
-            StableBboxSortPredicate<AABBVectorType> predicate(m_bboxes, d);
-            std::sort(left_leaf.m_indices[d].begin(), left_leaf.m_indices[d].end(), predicate);
-            std::sort(right_leaf.m_indices[d].begin(), right_leaf.m_indices[d].end(), predicate);
+            sort_indices(left_leaf.m_indices[d], d, parallel);
+            sort_indices(right_leaf.m_indices[d], d, parallel);
         }
     }
+
+    if (parallel)
+        m_job_queue->wait_until_completion();
 }
 
 template <typename ItemHandler, typename AABBVector>
@@ -794,15 +1171,25 @@ inline const std::vector<size_t>& SBVHPartitioner<ItemHandler, AABBVector>::get_
 }
 
 template <typename ItemHandler, typename AABBVector>
-inline size_t SBVHPartitioner<ItemHandler, AABBVector>::get_spatial_split_count() const
+size_t SBVHPartitioner<ItemHandler, AABBVector>::get_spatial_split_count() const
 {
-    return m_spatial_split_count;
+    size_t count = 0;
+
+    for (size_t i = 0; i < m_workspaces.size(); ++i)
+        count += m_workspaces[i].m_spatial_split_count;
+
+    return count;
 }
 
 template <typename ItemHandler, typename AABBVector>
-inline size_t SBVHPartitioner<ItemHandler, AABBVector>::get_object_split_count() const
+size_t SBVHPartitioner<ItemHandler, AABBVector>::get_object_split_count() const
 {
-    return m_object_split_count;
+    size_t count = 0;
+
+    for (size_t i = 0; i < m_workspaces.size(); ++i)
+        count += m_workspaces[i].m_object_split_count;
+
+    return count;
 }
 
 }       // namespace bvh
@@ -32,9 +32,13 @@
 
 // appleseed.foundation headers.
 #include "foundation/core/concepts/noncopyable.h"
+#include "foundation/platform/compiler.h"
+#include "foundation/utility/job/ijob.h"
+#include "foundation/utility/job/jobqueue.h"
 #include "foundation/utility/stopwatch.h"
 
 // Standard headers.
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
 #include <vector>
@@ -58,13 +62,16 @@ namespace bvh {
 //          };
 //
 //          // Split a leaf. Return true if the split should be split or false if it should be kept unsplit.
+//          // Parallel builds call this method concurrently with distinct workspace indices:
+//          // 0 for the calling thread, and 1 + the worker thread index for subtree jobs.
 //          bool split(
 //              const LeafType&     leaf,
 //              const AABBType&     leaf_bbox,
 //              LeafType&           left_leaf,
 //              AABBType&           left_left_bbox,
 //              LeafType&           right_leaf,
-//              AABBType&           right_leaf_bbox);
+//              AABBType&           right_leaf_bbox,
+//              const size_t        workspace_index);
 //
 //          // Store a leaf. Return the index of the first stored item.
 //          size_t store(const LeafType& leaf);
@@ -91,23 +98,80 @@ class SpatialBuilder
         LeafType*           root_leaf,
         const AABBType&     root_leaf_bbox);
 
+    // Build a tree using the worker threads servicing a given job queue. The top of the
+    // tree is built by the calling thread, the subtrees below it are built concurrently.
+    // The partitioner must provide at least thread_count + 1 workspaces. The resulting
+    // tree is identical to the one built by the single-threaded method above.
+    template <typename Timer>
+    void build(
+        Tree&               tree,
+        Partitioner&        partitioner,
+        LeafType*           root_leaf,
+        const AABBType&     root_leaf_bbox,
+        JobQueue&           job_queue,
+        const size_t        thread_count);
+
     // Return the construction time.
     double get_build_time() const;
 
   private:
+    typedef typename Tree::NodeVectorType NodeVector;
     typedef std::vector<const LeafType*> LeafVector;
 
+    struct Subtree
+    {
+        size_t              m_node_index;       // index of the root of the subtree in the top of the tree
+        LeafType*           m_root_leaf;
+        AABBType            m_root_leaf_bbox;
+        NodeVector          m_nodes;
+        LeafVector          m_leaves;
+
+        explicit Subtree(const NodeVector& nodes)
+          : m_nodes(nodes.get_allocator())
+        {
+        }
+    };
+
+    typedef std::vector<Subtree*> SubtreeVector;
+
+    class SubtreeJob;
+    friend class SubtreeJob;
+
+    // Leaves are turned into subtrees when they contain no more than 1 / (SubtreesPerThread *
+    // thread_count) of the items of the root leaf.
+    static const size_t SubtreesPerThread = 4;
+
     double m_build_time;
 
-    // Recursively subdivide the tree.
+    // Recursively subdivide the tree. Leaves with no more than subtree_size items
+    // are not subdivided but appended to 'subtrees', unless 'subtrees' is null.
     void subdivide_recurse(
-        Tree&               tree,
+        NodeVector&         nodes,
         Partitioner&        partitioner,
         LeafVector&         leaves,
         LeafType*           leaf,
         const AABBType&     leaf_bbox,
         const size_t        leaf_node_index,
-        const size_t        depth);
+        const size_t        depth,
+        const size_t        workspace_index,
+        SubtreeVector*      subtrees,
+        const size_t        subtree_size);
+
+    // Recursively copy a tree, laying out nodes and leaves in the order of a single-threaded build.
+    void relayout_recurse(
+        const NodeVector&   src_nodes,
+        const LeafVector&   src_leaves,
+        const SubtreeVector* src_subtrees,
+        const size_t        src_node_index,
+        NodeVector&         dst_nodes,
+        LeafVector&         dst_leaves,
+        const size_t        dst_node_index);
+
+    // Store the leaves of a tree.
+    void store_leaves(
+        Tree&               tree,
+        Partitioner&        partitioner,
+        const LeafVector&   leaves);
 };
 
 
@@ -115,6 +179,44 @@ class SpatialBuilder
 // SpatialBuilder class implementation.
 //
 
+template <typename Tree, typename Partitioner>
+class SpatialBuilder<Tree, Partitioner>::SubtreeJob
+  : public IJob
+{
+  public:
+    SubtreeJob(
+        SpatialBuilder&     builder,
+        Partitioner&        partitioner,
+        Subtree&            subtree)
+      : m_builder(builder)
+      , m_partitioner(partitioner)
+      , m_subtree(subtree)
+    {
+    }
+
+    virtual void execute(const size_t thread_index) APPLESEED_OVERRIDE
+    {
+        m_subtree.m_nodes.push_back(NodeType());
+
+        m_builder.subdivide_recurse(
+            m_subtree.m_nodes,
+            m_partitioner,
+            m_subtree.m_leaves,
+            m_subtree.m_root_leaf,
+            m_subtree.m_root_leaf_bbox,
+            0,
+            0,
+            thread_index + 1,
+            0,
+            0);
+    }
+
+  private:
+    SpatialBuilder&         m_builder;
+    Partitioner&            m_partitioner;
+    Subtree&                m_subtree;
+};
+
 template <typename Tree, typename Partitioner>
 SpatialBuilder<Tree, Partitioner>::SpatialBuilder()
   : m_build_time(0.0)
@@ -144,26 +246,86 @@ void SpatialBuilder<Tree, Partitioner>::build(
     // Recursively subdivide the tree.
     LeafVector leaves;
     subdivide_recurse(
-        tree,
+        tree.m_nodes,
         partitioner,
         leaves,
         root_leaf,
         root_leaf_bbox,
         0,
+        0,
+        0,
+        0,
         0);
 
     // Store the leaves.
-    const size_t node_count = tree.m_nodes.size();
-    for (size_t i = 0; i < node_count; ++i)
-    {
-        NodeType& node = tree.m_nodes[i];
-        if (node.is_leaf())
-        {
-            const LeafType* leaf = leaves[node.get_item_index()];
-            node.set_item_index(partitioner.store(*leaf));
-            delete leaf;
-        }
-    }
+    store_leaves(tree, partitioner, leaves);
+
+    // Measure and save construction time.
+    stopwatch.measure();
+    m_build_time = stopwatch.get_seconds();
+}
+
+template <typename Tree, typename Partitioner>
+template <typename Timer>
+void SpatialBuilder<Tree, Partitioner>::build(
+    Tree&                   tree,
+    Partitioner&            partitioner,
+    LeafType*               root_leaf,
+    const AABBType&         root_leaf_bbox,
+    JobQueue&               job_queue,
+    const size_t            thread_count)
+{
+    assert(thread_count > 0);
+
+    // Start stopwatch.
+    Stopwatch<Timer> stopwatch;
+    stopwatch.start();
+
+    // Clear the tree.
+    tree.m_nodes.clear();
+
+    // Build the top of the tree, collecting the roots of the subtrees.
+    NodeVector top_nodes(tree.m_nodes.get_allocator());
+    top_nodes.push_back(NodeType());
+    LeafVector top_leaves;
+    SubtreeVector subtrees;
+    subdivide_recurse(
+        top_nodes,
+        partitioner,
+        top_leaves,
+        root_leaf,
+        root_leaf_bbox,
+        0,
+        0,
+        0,
+        &subtrees,
+        std::max<size_t>(root_leaf->size() / (SubtreesPerThread * thread_count), 1));
+
+    // Build the subtrees concurrently.
+    for (size_t i = 0; i < subtrees.size(); ++i)
+        job_queue.schedule(new SubtreeJob(*this, partitioner, *subtrees[i]));
+    job_queue.wait_until_completion();
+
+    // Assemble the final tree.
+    SubtreeVector subtrees_by_node(top_nodes.size(), 0);
+    for (size_t i = 0; i < subtrees.size(); ++i)
+        subtrees_by_node[subtrees[i]->m_node_index] = subtrees[i];
+    LeafVector leaves;
+    tree.m_nodes.push_back(NodeType());
+    relayout_recurse(
+        top_nodes,
+        top_leaves,
+        &subtrees_by_node,
+        0,
+        tree.m_nodes,
+        leaves,
+        0);
+
+    for (size_t i = 0; i < subtrees.size(); ++i)
+        delete subtrees[i];
+
+    // Store the leaves.
+    store_leaves(tree, partitioner, leaves);
 
     // Measure and save construction time.
     stopwatch.measure();
@@ -178,15 +340,29 @@ inline double SpatialBuilder<Tree, Partitioner>::get_build_time() const
 
 template <typename Tree, typename Partitioner>
 void SpatialBuilder<Tree, Partitioner>::subdivide_recurse(
-    Tree&                   tree,
+    NodeVector&             nodes,
     Partitioner&            partitioner,
     LeafVector&             leaves,
     LeafType*               leaf,
     const AABBType&         leaf_bbox,
     const size_t            leaf_node_index,
-    const size_t            depth)
+    const size_t            depth,
+    const size_t            workspace_index,
+    SubtreeVector*          subtrees,
+    const size_t            subtree_size)
 {
-    assert(leaf_node_index < tree.m_nodes.size());
+    assert(leaf_node_index < nodes.size());
+
+    // Defer the construction of small enough subtrees.
+    if (subtrees && leaf->size() <= subtree_size)
+    {
+        Subtree* subtree = new Subtree(nodes);
+        subtree->m_node_index = leaf_node_index;
+        subtree->m_root_leaf = leaf;
+        subtree->m_root_leaf_bbox = leaf_bbox;
+        subtrees->push_back(subtree);
+        return;
+    }
 
     // Try to split the leaf.
     LeafType* left_leaf = new LeafType();
@@ -199,7 +375,8 @@ void SpatialBuilder<Tree, Partitioner>::subdivide_recurse(
             *left_leaf,
             left_leaf_bbox,
             *right_leaf,
-            right_leaf_bbox);
+            right_leaf_bbox,
+            workspace_index);
 
     if (split)
     {
@@ -207,39 +384,45 @@ void SpatialBuilder<Tree, Partitioner>::subdivide_recurse(
         delete leaf;
 
         // Compute the indices of the child nodes.
-        const size_t left_node_index = tree.m_nodes.size();
+        const size_t left_node_index = nodes.size();
         const size_t right_node_index = left_node_index + 1;
 
         // Turn the current node into an interior node.
-        NodeType& node = tree.m_nodes[leaf_node_index];
+        NodeType& node = nodes[leaf_node_index];
         node.make_interior();
         node.set_left_bbox(left_leaf_bbox);
         node.set_right_bbox(right_leaf_bbox);
         node.set_child_node_index(left_node_index);
 
         // Create the child nodes.
-        tree.m_nodes.push_back(NodeType());
-        tree.m_nodes.push_back(NodeType());
+        nodes.push_back(NodeType());
+        nodes.push_back(NodeType());
 
         // Recurse into the left subtree.
         subdivide_recurse(
-            tree,
+            nodes,
             partitioner,
             leaves,
             left_leaf,
             left_leaf_bbox,
             left_node_index,
-            depth + 1);
+            depth + 1,
+            workspace_index,
+            subtrees,
+            subtree_size);
 
         // Recurse into the right subtree.
         subdivide_recurse(
-            tree,
+            nodes,
             partitioner,
             leaves,
             right_leaf,
             right_leaf_bbox,
             right_node_index,
-            depth + 1);
+            depth + 1,
+            workspace_index,
+            subtrees,
+            subtree_size);
     }
     else
     {
@@ -248,7 +431,7 @@ void SpatialBuilder<Tree, Partitioner>::subdivide_recurse(
         delete right_leaf;
 
         // Turn the current node into a leaf node.
-        NodeType& node = tree.m_nodes[leaf_node_index];
+        NodeType& node = nodes[leaf_node_index];
         node.make_leaf();
         node.set_item_index(leaves.size());
         node.set_item_count(leaf->size());
@@ -256,6 +439,86 @@ void SpatialBuilder<Tree, Partitioner>::subdivide_recurse(
     }
 }
 
+template <typename Tree, typename Partitioner>
+void SpatialBuilder<Tree, Partitioner>::relayout_recurse(
+    const NodeVector&       src_nodes,
+    const LeafVector&       src_leaves,
+    const SubtreeVector*    src_subtrees,
+    const size_t            src_node_index,
+    NodeVector&             dst_nodes,
+    LeafVector&             dst_leaves,
+    const size_t            dst_node_index)
+{
+    // Continue with the root of the subtree if this node is the root of a subtree.
+    if (src_subtrees && (*src_subtrees)[src_node_index])
+    {
+        const Subtree& subtree = *(*src_subtrees)[src_node_index];
+
+        relayout_recurse(
+            subtree.m_nodes,
+            subtree.m_leaves,
+            0,
+            0,
+            dst_nodes,
+            dst_leaves,
+            dst_node_index);
+
+        return;
+    }
+
+    NodeType node = src_nodes[src_node_index];
+
+    if (node.is_leaf())
+    {
+        const LeafType* leaf = src_leaves[node.get_item_index()];
+        node.set_item_index(dst_leaves.size());
+        dst_leaves.push_back(leaf);
+        dst_nodes[dst_node_index] = node;
+    }
+    else
+    {
+        // Create the child nodes.
+        const size_t src_child_node_index = node.get_child_node_index();
+        const size_t dst_child_node_index = dst_nodes.size();
+        node.set_child_node_index(dst_child_node_index);
+        dst_nodes[dst_node_index] = node;
+        dst_nodes.push_back(NodeType());
+        dst_nodes.push_back(NodeType());
+
+        // Recurse into the left and right subtrees.
+        for (size_t i = 0; i < 2; ++i)
+        {
+            relayout_recurse(
+                src_nodes,
+                src_leaves,
+                src_subtrees,
+                src_child_node_index + i,
+                dst_nodes,
+                dst_leaves,
+                dst_child_node_index + i);
+        }
+    }
+}
+
+template <typename Tree, typename Partitioner>
+void SpatialBuilder<Tree, Partitioner>::store_leaves(
+    Tree&                   tree,
+    Partitioner&            partitioner,
+    const LeafVector&       leaves)
+{
+    const size_t node_count = tree.m_nodes.size();
+    for (size_t i = 0; i < node_count; ++i)
+    {
+        NodeType& node = tree.m_nodes[i];
+        if (node.is_leaf())
+        {
+            const LeafType* leaf = leaves[node.get_item_index()];
+            node.set_item_index(partitioner.store(*leaf));
+            delete leaf;
+        }
+    }
+}
+
 }       // namespace bvh
 }       // namespace foundation
 
@@ -78,6 +78,23 @@ class TreeStatistics
 };
 
 
+//
+// Wide BVH tree statistics.
+//
+
+template <typename Tree, typename WideTree>
+class WideTreeStatistics
+  : public Statistics
+{
+  public:
+    // Constructor, collects statistics for a given wide tree.
+    // 'tree' is the binary tree that was collapsed into 'wide_tree'.
+    WideTreeStatistics(
+        const Tree&         tree,
+        const WideTree&     wide_tree);
+};
+
+
 //
 // BVH traversal statistics.
 //
@@ -168,6 +185,45 @@ void TreeStatistics<Tree>::collect_stats_recurse(
     }
 }
 
+
+//
+// WideTreeStatistics class implementation.
+//
+
+template <typename Tree, typename WideTree>
+WideTreeStatistics<Tree, WideTree>::WideTreeStatistics(
+    const Tree&             tree,
+    const WideTree&         wide_tree)
+{
+    typedef typename Tree::NodeType NodeType;
+    typedef typename WideTree::NodeType WideNodeType;
+
+    assert(!tree.m_nodes.empty());
+    assert(!wide_tree.m_nodes.empty());
+
+    Population<size_t> node_occupancy;
+    for (size_t i = 0; i < wide_tree.m_nodes.size(); ++i)
+        node_occupancy.insert(wide_tree.m_nodes[i].get_child_count());
+
+    // Size of the interior nodes of the binary tree replaced by the wide tree.
+    // The binary tree only retains its leaves once collapsed.
+    const size_t binary_size = (tree.m_nodes.size() - 1) * sizeof(NodeType);
+    const size_t wide_size = wide_tree.m_nodes.size() * sizeof(WideNodeType);
+
+    insert_size("wide tree size", wide_tree.get_memory_size());
+    insert("wide nodes", pretty_uint(wide_tree.m_nodes.size()));
+    insert_size("wide node size", sizeof(WideNodeType));
+    insert("wide node occupancy", node_occupancy);
+    insert_size("binary interior nodes size", binary_size);
+    if (binary_size > 0)
+    {
+        insert_percent(
+            "memory savings",
+            static_cast<double>(binary_size) - static_cast<double>(wide_size),
+            static_cast<double>(binary_size));
+    }
+}
+
 }       // namespace bvh
 }       // namespace foundation
 
@@ -70,12 +70,24 @@ class Tree
     template <typename Tree, typename Partitioner>
     friend class SpatialBuilder;
 
+    template <typename Tree, typename WideTree>
+    friend class Collapser;
+
+    template <typename Tree>
+    friend class Refitter;
+
     template <typename Tree>
     friend class TreeStatistics;
 
+    template <typename Tree, typename WideTree>
+    friend class WideTreeStatistics;
+
     template <typename Tree, typename Visitor, typename Ray, size_t StackSize, size_t N>
     friend class Intersector;
 
+    template <typename Tree, typename WideTree, typename Visitor, size_t StackSize>
+    friend class WideIntersector;
+
     typedef typename NodeType::AABBType AABBType;
     typedef std::vector<AABBType> AABBVector;
 
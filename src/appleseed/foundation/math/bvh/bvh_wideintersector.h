@@ -0,0 +1,537 @@
+
+//
+// This source file is part of appleseed.
+// Visit http://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2017 Francois Beaune, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#ifndef APPLESEED_FOUNDATION_MATH_BVH_BVH_WIDEINTERSECTOR_H
+#define APPLESEED_FOUNDATION_MATH_BVH_BVH_WIDEINTERSECTOR_H
+
+// appleseed.foundation headers.
+#include "foundation/core/concepts/noncopyable.h"
+#include "foundation/math/bvh/bvh_intersector.h"
+#include "foundation/math/bvh/bvh_quantizedwidenode.h"
+#include "foundation/math/bvh/bvh_statistics.h"
+#include "foundation/math/bvh/bvh_widenode.h"
+#include "foundation/math/fp.h"
+#include "foundation/math/minmax.h"
+#include "foundation/math/ray.h"
+#include "foundation/platform/compiler.h"
+#include "foundation/platform/types.h"
+#ifdef APPLESEED_USE_SSE
+#include "foundation/platform/sse.h"
+#endif
+
+// Standard headers.
+#include <cassert>
+#include <cstddef>
+#include <limits>
+
+namespace foundation {
+namespace bvh {
+
+//
+// Wide BVH intersector.
+//
+// Traverses a wide tree (foundation::bvh::WideTree) built by foundation::bvh::Collapser,
+// testing the ray against all the children of a node at once, and visits the leaves of
+// the binary tree the wide tree was collapsed from. Only trees without motion are supported.
+// Nodes can be either foundation::bvh::WideNode or foundation::bvh::QuantizedWideNode.
+//
+// Child bounding boxes are tested in single precision. The ray origin is rounded outward
+// and the slab distances are scaled conservatively so that no child is ever missed
+// compared to a double precision test.
+//
+// The Visitor class must conform to the same prototype as for foundation::bvh::Intersector.
+//
+
+template <
+    typename Tree,
+    typename WideTree,
+    typename Visitor,
+    size_t StackSize = 64
+>
+class WideIntersector
+  : public NonCopyable
+{
+  public:
+    typedef typename Tree::NodeType LeafNodeType;
+    typedef typename WideTree::NodeType NodeType;
+    typedef double ValueType;
+    typedef Ray3d RayType;
+    typedef RayInfo3d RayInfoType;
+
+    // Intersect a ray with a given wide BVH without motion.
+    // 'tree' is the binary tree holding the leaves referenced by 'wide_tree'.
+    void intersect_no_motion(
+        const Tree&             tree,
+        const WideTree&         wide_tree,
+        const RayType&          ray,
+        const RayInfoType&      ray_info,
+        Visitor&                visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+        , TraversalStatistics&  stats
+#endif
+        ) const;
+
+  private:
+    static const size_t Width = NodeType::Width;
+
+    struct StackEntry
+    {
+        uint32  m_child;
+        float   m_tmin;
+    };
+
+    // Ray in single precision, prepared for conservative ray-box tests.
+    class NodeTester
+    {
+      public:
+        NodeTester(
+            const RayType&      ray,
+            const RayInfoType&  ray_info);
+
+        // Intersect the ray with the bounding boxes of all children of a node.
+        // Return a bit mask of the children that were hit and their entry distances.
+        size_t intersect(
+            const float*        bbox_data,
+            const float         ray_tmax,
+            float               tmin[]) const;
+
+      private:
+        size_t  m_near_offset[3];
+        size_t  m_far_offset[3];
+
+#if defined APPLESEED_USE_AVX
+        __m256  m_org_near[3];
+        __m256  m_org_far[3];
+        __m256  m_rcp_dir_near[3];
+        __m256  m_rcp_dir_far[3];
+        __m256  m_ray_tmin;
+#elif defined APPLESEED_USE_SSE
+        __m128  m_org_near[3];
+        __m128  m_org_far[3];
+        __m128  m_rcp_dir_near[3];
+        __m128  m_rcp_dir_far[3];
+        __m128  m_ray_tmin;
+#else
+        float   m_org_near[3];
+        float   m_org_far[3];
+        float   m_rcp_dir_near[3];
+        float   m_rcp_dir_far[3];
+        float   m_ray_tmin;
+#endif
+    };
+
+    // Return the bounding boxes of the children of a node, in the layout of foundation::bvh::WideNode.
+    // Quantized bounding boxes are dequantized into 'buffer'.
+    template <size_t W>
+    static const float* fetch_child_bbox_data(
+        const WideNode<W>&      node,
+        float                   buffer[]);
+    template <size_t W, typename T>
+    static const float* fetch_child_bbox_data(
+        const QuantizedWideNode<W, T>& node,
+        float                   buffer[]);
+
+    // Convert a double to the closest float smaller than or equal to it.
+    static float round_down(const double x);
+
+    // Convert a double to the closest float greater than or equal to it.
+    static float round_up(const double x);
+};
+
+
+//
+// WideIntersector class implementation.
+//
+
+template <typename Tree, typename WideTree, typename Visitor, size_t StackSize>
+inline float WideIntersector<Tree, WideTree, Visitor, StackSize>::round_down(const double x)
+{
+    const float result = static_cast<float>(x);
+    return static_cast<double>(result) > x ? shift(result, -1) : result;
+}
+
+template <typename Tree, typename WideTree, typename Visitor, size_t StackSize>
+inline float WideIntersector<Tree, WideTree, Visitor, StackSize>::round_up(const double x)
+{
+    const float result = static_cast<float>(x);
+    return static_cast<double>(result) < x ? shift(result, +1) : result;
+}
+
+template <typename Tree, typename WideTree, typename Visitor, size_t StackSize>
+template <size_t W>
+inline const float* WideIntersector<Tree, WideTree, Visitor, StackSize>::fetch_child_bbox_data(
+    const WideNode<W>&          node,
+    float                       buffer[])
+{
+    return node.get_child_bbox_data();
+}
+
+template <typename Tree, typename WideTree, typename Visitor, size_t StackSize>
+template <size_t W, typename T>
+inline const float* WideIntersector<Tree, WideTree, Visitor, StackSize>::fetch_child_bbox_data(
+    const QuantizedWideNode<W, T>& node,
+    float                       buffer[])
+{
+    node.dequantize_child_bbox_data(buffer);
+    return buffer;
+}
+
+template <typename Tree, typename WideTree, typename Visitor, size_t StackSize>
+WideIntersector<Tree, WideTree, Visitor, StackSize>::NodeTester::NodeTester(
+    const RayType&              ray,
+    const RayInfoType&          ray_info)
+{
+    // Margin accounting for the rounding errors of single precision slab tests.
+    const float Margin = 4.0f * std::numeric_limits<float>::epsilon();
+
+    for (size_t d = 0; d < 3; ++d)
+    {
+        // Positive directions enter through the min plane, negative directions through the max plane.
+        const bool positive = ray_info.m_sgn_dir[d] != 0;
+        m_near_offset[d] = (d * 2 + (positive ? 0 : 1)) * Width;
+        m_far_offset[d] = (d * 2 + (positive ? 1 : 0)) * Width;
+
+        // Round the origin such that entry distances are underestimated and exit distances overestimated.
+        const float org_near = positive ? round_up(ray.m_org[d]) : round_down(ray.m_org[d]);
+        const float org_far = positive ? round_down(ray.m_org[d]) : round_up(ray.m_org[d]);
+        const float rcp_dir = static_cast<float>(ray_info.m_rcp_dir[d]);
+        const float rcp_dir_near = rcp_dir * (1.0f - Margin);
+        const float rcp_dir_far = rcp_dir * (1.0f + Margin);
+
+#if defined APPLESEED_USE_AVX
+        m_org_near[d] = _mm256_set1_ps(org_near);
+        m_org_far[d] = _mm256_set1_ps(org_far);
+        m_rcp_dir_near[d] = _mm256_set1_ps(rcp_dir_near);
+        m_rcp_dir_far[d] = _mm256_set1_ps(rcp_dir_far);
+#elif defined APPLESEED_USE_SSE
+        m_org_near[d] = _mm_set1_ps(org_near);
+        m_org_far[d] = _mm_set1_ps(org_far);
+        m_rcp_dir_near[d] = _mm_set1_ps(rcp_dir_near);
+        m_rcp_dir_far[d] = _mm_set1_ps(rcp_dir_far);
+#else
+        m_org_near[d] = org_near;
+        m_org_far[d] = org_far;
+        m_rcp_dir_near[d] = rcp_dir_near;
+        m_rcp_dir_far[d] = rcp_dir_far;
+#endif
+    }
+
+#if defined APPLESEED_USE_AVX
+    m_ray_tmin = _mm256_set1_ps(round_down(ray.m_tmin));
+#elif defined APPLESEED_USE_SSE
+    m_ray_tmin = _mm_set1_ps(round_down(ray.m_tmin));
+#else
+    m_ray_tmin = round_down(ray.m_tmin);
+#endif
+}
+
+template <typename Tree, typename WideTree, typename Visitor, size_t StackSize>
+inline size_t WideIntersector<Tree, WideTree, Visitor, StackSize>::NodeTester::intersect(
+    const float*                node_bbox_data,
+    const float                 ray_tmax,
+    float                       tmin[]) const
+{
+    size_t hits = 0;
+
+#if defined APPLESEED_USE_AVX
+
+    if (Width % 8 == 0)
+    {
+        const __m256 mray_tmax = _mm256_set1_ps(ray_tmax);
+
+        for (size_t g = 0; g < Width; g += 8)
+        {
+            const float* bbox_data = node_bbox_data + g;
+
+            const __m256 xl1 = _mm256_mul_ps(m_rcp_dir_near[0], _mm256_sub_ps(_mm256_load_ps(bbox_data + m_near_offset[0]), m_org_near[0]));
+            const __m256 xl2 = _mm256_mul_ps(m_rcp_dir_far[0], _mm256_sub_ps(_mm256_load_ps(bbox_data + m_far_offset[0]), m_org_far[0]));
+            const __m256 yl1 = _mm256_mul_ps(m_rcp_dir_near[1], _mm256_sub_ps(_mm256_load_ps(bbox_data + m_near_offset[1]), m_org_near[1]));
+            const __m256 yl2 = _mm256_mul_ps(m_rcp_dir_far[1], _mm256_sub_ps(_mm256_load_ps(bbox_data + m_far_offset[1]), m_org_far[1]));
+            const __m256 zl1 = _mm256_mul_ps(m_rcp_dir_near[2], _mm256_sub_ps(_mm256_load_ps(bbox_data + m_near_offset[2]), m_org_near[2]));
+            const __m256 zl2 = _mm256_mul_ps(m_rcp_dir_far[2], _mm256_sub_ps(_mm256_load_ps(bbox_data + m_far_offset[2]), m_org_far[2]));
+
+            const __m256 mtmin = _mm256_max_ps(zl1, _mm256_max_ps(yl1, _mm256_max_ps(xl1, m_ray_tmin)));
+            const __m256 mtmax = _mm256_min_ps(zl2, _mm256_min_ps(yl2, _mm256_min_ps(xl2, mray_tmax)));
+
+            const int group_hits =
+                _mm256_movemask_ps(
+                    _mm256_or_ps(
+                        _mm256_cmp_ps(mtmin, mtmax, _CMP_GT_OS),
+                        _mm256_or_ps(
+                            _mm256_cmp_ps(mtmax, m_ray_tmin, _CMP_LT_OS),
+                            _mm256_cmp_ps(mtmin, mray_tmax, _CMP_GE_OS)))) ^ 0xFF;
+
+            _mm256_store_ps(tmin + g, mtmin);
+            hits |= static_cast<size_t>(group_hits) << g;
+        }
+
+        return hits;
+    }
+
+    // Use the lower half of the AVX registers for nodes of width 4.
+    const __m128 org_near[3] =
+    {
+        _mm256_castps256_ps128(m_org_near[0]),
+        _mm256_castps256_ps128(m_org_near[1]),
+        _mm256_castps256_ps128(m_org_near[2])
+    };
+    const __m128 org_far[3] =
+    {
+        _mm256_castps256_ps128(m_org_far[0]),
+        _mm256_castps256_ps128(m_org_far[1]),
+        _mm256_castps256_ps128(m_org_far[2])
+    };
+    const __m128 rcp_dir_near[3] =
+    {
+        _mm256_castps256_ps128(m_rcp_dir_near[0]),
+        _mm256_castps256_ps128(m_rcp_dir_near[1]),
+        _mm256_castps256_ps128(m_rcp_dir_near[2])
+    };
+    const __m128 rcp_dir_far[3] =
+    {
+        _mm256_castps256_ps128(m_rcp_dir_far[0]),
+        _mm256_castps256_ps128(m_rcp_dir_far[1]),
+        _mm256_castps256_ps128(m_rcp_dir_far[2])
+    };
+    const __m128 ray_tmin = _mm256_castps256_ps128(m_ray_tmin);
+
+#elif defined APPLESEED_USE_SSE
+
+    const __m128* org_near = m_org_near;
+    const __m128* org_far = m_org_far;
+    const __m128* rcp_dir_near = m_rcp_dir_near;
+    const __m128* rcp_dir_far = m_rcp_dir_far;
+    const __m128 ray_tmin = m_ray_tmin;
+
+#endif
+
+#ifdef APPLESEED_USE_SSE
+
+    const __m128 mray_tmax = _mm_set1_ps(ray_tmax);
+
+    for (size_t g = 0; g < Width; g += 4)
+    {
+        const float* bbox_data = node_bbox_data + g;
+
+        const __m128 xl1 = _mm_mul_ps(rcp_dir_near[0], _mm_sub_ps(_mm_load_ps(bbox_data + m_near_offset[0]), org_near[0]));
+        const __m128 xl2 = _mm_mul_ps(rcp_dir_far[0], _mm_sub_ps(_mm_load_ps(bbox_data + m_far_offset[0]), org_far[0]));
+        const __m128 yl1 = _mm_mul_ps(rcp_dir_near[1], _mm_sub_ps(_mm_load_ps(bbox_data + m_near_offset[1]), org_near[1]));
+        const __m128 yl2 = _mm_mul_ps(rcp_dir_far[1], _mm_sub_ps(_mm_load_ps(bbox_data + m_far_offset[1]), org_far[1]));
+        const __m128 zl1 = _mm_mul_ps(rcp_dir_near[2], _mm_sub_ps(_mm_load_ps(bbox_data + m_near_offset[2]), org_near[2]));
+        const __m128 zl2 = _mm_mul_ps(rcp_dir_far[2], _mm_sub_ps(_mm_load_ps(bbox_data + m_far_offset[2]), org_far[2]));
+
+        const __m128 mtmin = _mm_max_ps(zl1, _mm_max_ps(yl1, _mm_max_ps(xl1, ray_tmin)));
+        const __m128 mtmax = _mm_min_ps(zl2, _mm_min_ps(yl2, _mm_min_ps(xl2, mray_tmax)));
+
+        const int group_hits =
+            _mm_movemask_ps(
+                _mm_or_ps(
+                    _mm_cmpgt_ps(mtmin, mtmax),
+                    _mm_or_ps(
+                        _mm_cmplt_ps(mtmax, ray_tmin),
+                        _mm_cmpge_ps(mtmin, mray_tmax)))) ^ 0xF;
+
+        _mm_store_ps(tmin + g, mtmin);
+        hits |= static_cast<size_t>(group_hits) << g;
+    }
+
+#else
+
+    for (size_t i = 0; i < Width; ++i)
+    {
+        const float* bbox_data = node_bbox_data + i;
+
+        const float xl1 = m_rcp_dir_near[0] * (bbox_data[m_near_offset[0]] - m_org_near[0]);
+        const float xl2 = m_rcp_dir_far[0] * (bbox_data[m_far_offset[0]] - m_org_far[0]);
+        const float yl1 = m_rcp_dir_near[1] * (bbox_data[m_near_offset[1]] - m_org_near[1]);
+        const float yl2 = m_rcp_dir_far[1] * (bbox_data[m_far_offset[1]] - m_org_far[1]);
+        const float zl1 = m_rcp_dir_near[2] * (bbox_data[m_near_offset[2]] - m_org_near[2]);
+        const float zl2 = m_rcp_dir_far[2] * (bbox_data[m_far_offset[2]] - m_org_far[2]);
+
+        tmin[i] = ssemax(zl1, ssemax(yl1, ssemax(xl1, m_ray_tmin)));
+        const float tmax = ssemin(zl2, ssemin(yl2, ssemin(xl2, ray_tmax)));
+
+        if (!(tmin[i] > tmax || tmax < m_ray_tmin || tmin[i] >= ray_tmax))
+            hits |= size_t(1) << i;
+    }
+
+#endif
+
+    return hits;
+}
+
+template <typename Tree, typename WideTree, typename Visitor, size_t StackSize>
+void WideIntersector<Tree, WideTree, Visitor, StackSize>::intersect_no_motion(
+    const Tree&                 tree,
+    const WideTree&             wide_tree,
+    const RayType&              ray,
+    const RayInfoType&          ray_info,
+    Visitor&                    visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+    , TraversalStatistics&      stats
+#endif
+    ) const
+{
+    // Make sure the tree was built.
+    assert(!wide_tree.m_nodes.empty());
+
+    // Prepare the ray for single precision ray-box tests.
+    const NodeTester node_tester(ray, ray_info);
+
+    // Node stack.
+    StackEntry stack[StackSize];
+    StackEntry* stack_ptr = stack;
+
+    // Current node (start with the root of the wide tree).
+    uint32 child = 0;
+
+    // Initialize traversal statistics.
+    FOUNDATION_BVH_TRAVERSAL_STATS(++stats.m_traversal_count);
+    FOUNDATION_BVH_TRAVERSAL_STATS(size_t visited_nodes = 0);
+    FOUNDATION_BVH_TRAVERSAL_STATS(size_t visited_leaves = 0);
+    FOUNDATION_BVH_TRAVERSAL_STATS(size_t intersected_bboxes = 0);
+    FOUNDATION_BVH_TRAVERSAL_STATS(size_t discarded_nodes = 0);
+
+    // Traverse the tree and intersect leaf nodes.
+    ValueType rtmax = ray.m_tmax;
+    float rtmax_float = round_up(rtmax);
+    while (true)
+    {
+        // Fetch the node.
+        FOUNDATION_BVH_TRAVERSAL_STATS(++visited_nodes);
+
+        if ((child & NodeType::LeafFlag) == 0)
+        {
+            const NodeType& node = wide_tree.m_nodes[child];
+
+            FOUNDATION_BVH_TRAVERSAL_STATS(intersected_bboxes += node.get_child_count());
+
+            // Intersect the bounding boxes of all children at once.
+            APPLESEED_SIMD8_ALIGN float bbox_data[6 * Width];
+            APPLESEED_SIMD8_ALIGN float tmin[Width];
+            size_t hits =
+                node_tester.intersect(
+                    fetch_child_bbox_data(node, bbox_data),
+                    rtmax_float,
+                    tmin);
+
+            if (hits)
+            {
+                // Collect the children that were hit, sorted by decreasing entry distance.
+                size_t hit_children[Width];
+                size_t hit_count = 0;
+                for (size_t i = 0; hits; ++i, hits >>= 1)
+                {
+                    if (hits & 1)
+                    {
+                        assert(!node.is_child_empty(i));
+
+                        size_t j = hit_count++;
+                        while (j > 0 && tmin[hit_children[j - 1]] < tmin[i])
+                        {
+                            hit_children[j] = hit_children[j - 1];
+                            --j;
+                        }
+                        hit_children[j] = i;
+                    }
+                }
+
+                FOUNDATION_BVH_TRAVERSAL_STATS(discarded_nodes += node.get_child_count() - hit_count);
+
+                // Push the far children to the stack, continue with the nearest child.
+                assert(stack_ptr + hit_count - 1 <= stack + StackSize);
+                for (size_t i = 0; i < hit_count - 1; ++i)
+                {
+                    stack_ptr->m_child = node.m_children[hit_children[i]];
+                    stack_ptr->m_tmin = tmin[hit_children[i]];
+                    ++stack_ptr;
+                }
+                child = node.m_children[hit_children[hit_count - 1]];
+                continue;
+            }
+
+            FOUNDATION_BVH_TRAVERSAL_STATS(discarded_nodes += node.get_child_count());
+        }
+        else
+        {
+            // Visit the leaf.
+            FOUNDATION_BVH_TRAVERSAL_STATS(++visited_leaves);
+            ValueType distance;
+#ifndef NDEBUG
+            distance = ValueType(-1.0);
+#endif
+            const bool proceed =
+                visitor.visit(
+                    tree.m_nodes[child & ~NodeType::LeafFlag],
+                    ray,
+                    ray_info,
+                    distance
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+                    , stats
+#endif
+                    );
+            assert(!proceed || distance >= ValueType(0.0));
+
+            // Terminate traversal if the visitor decided so.
+            if (!proceed)
+                break;
+
+            // Keep track of the distance to the closest intersection.
+            if (rtmax > distance)
+            {
+                rtmax = distance;
+                rtmax_float = round_up(rtmax);
+            }
+        }
+
+        // Skip nodes that lie beyond the closest intersection.
+        while (stack_ptr > stack && stack_ptr[-1].m_tmin >= rtmax_float)
+        {
+            FOUNDATION_BVH_TRAVERSAL_STATS(++discarded_nodes);
+            --stack_ptr;
+        }
+
+        // Terminate traversal if the node stack is empty.
+        if (stack_ptr == stack)
+            break;
+
+        // Pop the top node from the stack.
+        child = (--stack_ptr)->m_child;
+    }
+
+    // Store traversal statistics.
+    FOUNDATION_BVH_TRAVERSAL_STATS(stats.m_visited_nodes.insert(visited_nodes));
+    FOUNDATION_BVH_TRAVERSAL_STATS(stats.m_visited_leaves.insert(visited_leaves));
+    FOUNDATION_BVH_TRAVERSAL_STATS(stats.m_intersected_bboxes.insert(intersected_bboxes));
+    FOUNDATION_BVH_TRAVERSAL_STATS(stats.m_discarded_nodes.insert(discarded_nodes));
+}
+
+}       // namespace bvh
+}       // namespace foundation
+
+#endif  // !APPLESEED_FOUNDATION_MATH_BVH_BVH_WIDEINTERSECTOR_H
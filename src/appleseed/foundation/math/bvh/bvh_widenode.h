@@ -0,0 +1,239 @@
+
+//
+// This source file is part of appleseed.
+// Visit http://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2017 Francois Beaune, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#ifndef APPLESEED_FOUNDATION_MATH_BVH_BVH_WIDENODE_H
+#define APPLESEED_FOUNDATION_MATH_BVH_BVH_WIDENODE_H
+
+// appleseed.foundation headers.
+#include "foundation/math/aabb.h"
+#include "foundation/math/fp.h"
+#include "foundation/platform/compiler.h"
+#include "foundation/platform/types.h"
+
+// Boost headers.
+#include "boost/static_assert.hpp"
+
+// Standard headers.
+#include <cassert>
+#include <cstddef>
+
+namespace foundation {
+namespace bvh {
+
+//
+// Interior node of a wide (multi-branching) BVH.
+//
+// A wide node stores the bounding boxes of up to Width children in single precision
+// and in a structure-of-arrays layout, such that a ray can be tested against all of
+// them at once using SIMD instructions. Bounding boxes are rounded outward when they
+// are converted to single precision.
+//
+// Each child is either another wide node, or a leaf of the binary tree the wide
+// tree was collapsed from, or empty.
+//
+
+template <size_t W>
+class APPLESEED_ALIGN(64) WideNode
+{
+  public:
+    static const size_t Width = W;
+
+    // Constructor, marks all children as empty.
+    WideNode();
+
+    // Set/get the bounding box of a given child.
+    void set_child_bbox(const size_t i, const AABB3d& bbox);
+    AABB3f get_child_bbox(const size_t i) const;
+
+    // Set the bounding boxes of the first 'count' children, the others are left empty.
+    void set_child_bboxes(const AABB3d bboxes[], const size_t count);
+
+    // Make a given child reference a wide node.
+    void set_child_node_index(const size_t i, const size_t index);
+
+    // Make a given child reference a leaf node.
+    void set_child_leaf_index(const size_t i, const size_t index);
+
+    // Query the type of a given child.
+    bool is_child_empty(const size_t i) const;
+    bool is_child_leaf(const size_t i) const;
+
+    // Return the index of the wide node or of the leaf node referenced by a given child.
+    size_t get_child_index(const size_t i) const;
+
+    // Return the number of non-empty children.
+    size_t get_child_count() const;
+
+    // Return the bounding boxes of all children.
+    const float* get_child_bbox_data() const;
+
+  private:
+    template <typename Tree, typename WideTree, typename Visitor, size_t StackSize>
+    friend class WideIntersector;
+
+    BOOST_STATIC_ASSERT(Width % 4 == 0);
+
+    static const uint32 EmptyChild = ~uint32(0);
+    static const uint32 LeafFlag = uint32(1) << 31;
+
+    // Bounding boxes, as min.x[Width] max.x[Width] min.y[Width] max.y[Width] min.z[Width] max.z[Width].
+    APPLESEED_SIMD4_ALIGN float     m_bbox_data[6 * Width];
+
+    // Child references.
+    uint32                          m_children[Width];
+};
+
+
+//
+// WideNode class implementation.
+//
+
+template <size_t W>
+WideNode<W>::WideNode()
+{
+    for (size_t i = 0; i < Width; ++i)
+    {
+        // Empty bounding boxes are never hit by any ray.
+        for (size_t d = 0; d < 3; ++d)
+        {
+            m_bbox_data[(d * 2 + 0) * Width + i] = FP<float>::pos_inf();
+            m_bbox_data[(d * 2 + 1) * Width + i] = FP<float>::neg_inf();
+        }
+
+        m_children[i] = EmptyChild;
+    }
+}
+
+template <size_t W>
+inline void WideNode<W>::set_child_bbox(const size_t i, const AABB3d& bbox)
+{
+    assert(i < Width);
+
+    for (size_t d = 0; d < 3; ++d)
+    {
+        float min_value = static_cast<float>(bbox.min[d]);
+        float max_value = static_cast<float>(bbox.max[d]);
+
+        if (static_cast<double>(min_value) > bbox.min[d])
+            min_value = shift(min_value, -1);
+
+        if (static_cast<double>(max_value) < bbox.max[d])
+            max_value = shift(max_value, +1);
+
+        m_bbox_data[(d * 2 + 0) * Width + i] = min_value;
+        m_bbox_data[(d * 2 + 1) * Width + i] = max_value;
+    }
+}
+
+template <size_t W>
+inline AABB3f WideNode<W>::get_child_bbox(const size_t i) const
+{
+    assert(i < Width);
+
+    AABB3f bbox;
+
+    for (size_t d = 0; d < 3; ++d)
+    {
+        bbox.min[d] = m_bbox_data[(d * 2 + 0) * Width + i];
+        bbox.max[d] = m_bbox_data[(d * 2 + 1) * Width + i];
+    }
+
+    return bbox;
+}
+
+template <size_t W>
+inline void WideNode<W>::set_child_bboxes(const AABB3d bboxes[], const size_t count)
+{
+    assert(count <= Width);
+
+    for (size_t i = 0; i < count; ++i)
+        set_child_bbox(i, bboxes[i]);
+}
+
+template <size_t W>
+inline void WideNode<W>::set_child_node_index(const size_t i, const size_t index)
+{
+    assert(i < Width);
+    assert(index < LeafFlag);
+    m_children[i] = static_cast<uint32>(index);
+}
+
+template <size_t W>
+inline void WideNode<W>::set_child_leaf_index(const size_t i, const size_t index)
+{
+    assert(i < Width);
+    assert(index < LeafFlag);
+    m_children[i] = static_cast<uint32>(index) | LeafFlag;
+}
+
+template <size_t W>
+inline bool WideNode<W>::is_child_empty(const size_t i) const
+{
+    assert(i < Width);
+    return m_children[i] == EmptyChild;
+}
+
+template <size_t W>
+inline bool WideNode<W>::is_child_leaf(const size_t i) const
+{
+    assert(i < Width);
+    return m_children[i] != EmptyChild && (m_children[i] & LeafFlag) != 0;
+}
+
+template <size_t W>
+inline size_t WideNode<W>::get_child_index(const size_t i) const
+{
+    assert(i < Width);
+    assert(!is_child_empty(i));
+    return static_cast<size_t>(m_children[i] & ~LeafFlag);
+}
+
+template <size_t W>
+inline size_t WideNode<W>::get_child_count() const
+{
+    size_t count = 0;
+
+    for (size_t i = 0; i < Width; ++i)
+    {
+        if (m_children[i] != EmptyChild)
+            ++count;
+    }
+
+    return count;
+}
+
+template <size_t W>
+inline const float* WideNode<W>::get_child_bbox_data() const
+{
+    return m_bbox_data;
+}
+
+}       // namespace bvh
+}       // namespace foundation
+
+#endif  // !APPLESEED_FOUNDATION_MATH_BVH_BVH_WIDENODE_H
@@ -0,0 +1,131 @@
+
+//
+// This source file is part of appleseed.
+// Visit http://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2017 Francois Beaune, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#ifndef APPLESEED_FOUNDATION_MATH_BVH_BVH_WIDETREE_H
+#define APPLESEED_FOUNDATION_MATH_BVH_BVH_WIDETREE_H
+
+// appleseed.foundation headers.
+#include "foundation/core/concepts/noncopyable.h"
+
+// Boost headers.
+#include "boost/type_traits/alignment_of.hpp"
+
+// Standard headers.
+#include <cstddef>
+
+namespace foundation {
+namespace bvh {
+
+//
+// Wide (multi-branching) Bounding Volume Hierarchy.
+//
+// A wide tree only stores interior nodes. Its leaves are the leaves of the binary
+// tree (foundation::bvh::Tree) it was collapsed from by foundation::bvh::Collapser.
+//
+
+template <typename NodeVector>
+class WideTree
+  : public NonCopyable
+{
+  public:
+    typedef NodeVector NodeVectorType;
+    typedef WideTree<NodeVectorType> WideTreeType;
+    typedef typename NodeVectorType::value_type NodeType;
+    typedef typename NodeVectorType::allocator_type AllocatorType;
+
+    // Constructor. By default, nodes are aligned to their natural alignment
+    // such that their bounding boxes can be loaded with aligned SIMD loads.
+    explicit WideTree(
+        const AllocatorType& allocator = AllocatorType(boost::alignment_of<NodeType>::value));
+
+    // Clear the tree.
+    void clear();
+
+    // Return true if the tree is empty.
+    bool empty() const;
+
+    // Return the number of interior nodes in the tree.
+    size_t get_node_count() const;
+
+    // Return the size (in bytes) of this object in memory.
+    size_t get_memory_size() const;
+
+  protected:
+    template <typename Tree, typename WideTree>
+    friend class Collapser;
+
+    template <typename Tree, typename WideTree>
+    friend class WideTreeStatistics;
+
+    template <typename Tree, typename WideTree, typename Visitor, size_t StackSize>
+    friend class WideIntersector;
+
+    NodeVector  m_nodes;
+};
+
+
+//
+// WideTree class implementation.
+//
+
+template <typename NodeVector>
+WideTree<NodeVector>::WideTree(const AllocatorType& allocator)
+  : m_nodes(allocator)
+{
+}
+
+template <typename NodeVector>
+void WideTree<NodeVector>::clear()
+{
+    m_nodes.clear();
+}
+
+template <typename NodeVector>
+inline bool WideTree<NodeVector>::empty() const
+{
+    return m_nodes.empty();
+}
+
+template <typename NodeVector>
+inline size_t WideTree<NodeVector>::get_node_count() const
+{
+    return m_nodes.size();
+}
+
+template <typename NodeVector>
+size_t WideTree<NodeVector>::get_memory_size() const
+{
+    return
+          sizeof(*this)
+        + m_nodes.capacity() * sizeof(NodeType);
+}
+
+}       // namespace bvh
+}       // namespace foundation
+
+#endif  // !APPLESEED_FOUNDATION_MATH_BVH_BVH_WIDETREE_H
@@ -38,6 +38,9 @@
 #include "foundation/math/permutation.h"
 #include "foundation/math/split.h"
 #include "foundation/math/vector.h"
+#include "foundation/platform/compiler.h"
+#include "foundation/utility/job/ijob.h"
+#include "foundation/utility/job/jobqueue.h"
 #include "foundation/utility/stopwatch.h"
 
 // Standard headers.
@@ -75,14 +78,46 @@ class Builder
     void build_move_points(
         std::vector<VectorType>&    points);
 
+    // Like build_move_points() but using the worker threads servicing a given job
+    // queue. Large sets of points are bounded and partitioned by chunks, and the
+    // subtrees below the top of the tree are built concurrently. The resulting
+    // tree answers queries exactly like the one built by build_move_points().
+    template <typename Timer>
+    void build_move_points(
+        std::vector<VectorType>&    points,
+        JobQueue&                   job_queue,
+        const size_t                thread_count);
+
     // Return the construction time.
     double get_build_time() const;
 
   private:
     typedef typename TreeType::NodeType NodeType;
+    typedef std::vector<NodeType> NodeVector;
     typedef AABB<T, N> BboxType;
     typedef Split<T> SplitType;
 
+    struct Subtree
+    {
+        size_t                      m_node_index;   // index of the root of the subtree in the top of the tree
+        size_t                      m_begin;
+        size_t                      m_end;
+        NodeVector                  m_nodes;
+    };
+
+    typedef std::vector<Subtree*> SubtreeVector;
+
+    class SubtreeJob;
+    class BboxJob;
+    class PartitionJob;
+
+    // Sets of points are turned into subtrees when they contain no more than
+    // 1 / (SubtreesPerThread * thread_count) of all the points.
+    static const size_t SubtreesPerThread = 4;
+
+    // Sets of points smaller than this are bounded and partitioned by a single thread.
+    static const size_t MinParallelPartitionSize = 64 * 1024;
+
     struct PartitionPredicate
     {
         typedef std::vector<VectorType> PointVector;
@@ -100,15 +135,47 @@ class Builder
 
     TreeType&   m_tree;
     double      m_build_time;
+    JobQueue*   m_job_queue;
+    size_t      m_thread_count;
+
+    void move_points(std::vector<VectorType>& points);
+    void reorder_points();
 
+    // Recursively partition a set of points. Sets of no more than subtree_size
+    // points are not partitioned but appended to 'subtrees', unless 'subtrees' is null.
     void partition(
+        NodeVector&                 nodes,
         const size_t                parent_node_index,
         const size_t                begin,
-        const size_t                end) const;
+        const size_t                end,
+        SubtreeVector*              subtrees = 0,
+        const size_t                subtree_size = 0) const;
+
+    // Recursively copy a tree, laying out nodes in the order of a single-threaded build.
+    void relayout(
+        const NodeVector&           src_nodes,
+        const SubtreeVector*        src_subtrees,
+        const size_t                src_node_index,
+        NodeVector&                 dst_nodes,
+        const size_t                dst_node_index) const;
 
     BboxType compute_bbox(
         const size_t                begin,
         const size_t                end) const;
+
+    BboxType compute_bbox_parallel(
+        const size_t                begin,
+        const size_t                end) const;
+
+    size_t partition_indices(
+        const size_t                begin,
+        const size_t                end,
+        const SplitType&            split) const;
+
+    size_t partition_indices_parallel(
+        const size_t                begin,
+        const size_t                end,
+        const SplitType&            split) const;
 };
 
 typedef Builder<float, 2>  Builder2f;
@@ -121,10 +188,98 @@ typedef Builder<double, 3> Builder3d;
 // Implementation.
 //
 
+template <typename T, size_t N>
+class Builder<T, N>::SubtreeJob
+  : public IJob
+{
+  public:
+    SubtreeJob(
+        const Builder&      builder,
+        Subtree&            subtree)
+      : m_builder(builder)
+      , m_subtree(subtree)
+    {
+    }
+
+    virtual void execute(const size_t thread_index) APPLESEED_OVERRIDE
+    {
+        m_subtree.m_nodes.reserve((m_subtree.m_end - m_subtree.m_begin) * 2 + 1);
+        m_subtree.m_nodes.push_back(NodeType());
+        m_builder.partition(m_subtree.m_nodes, 0, m_subtree.m_begin, m_subtree.m_end);
+    }
+
+  private:
+    const Builder&          m_builder;
+    Subtree&                m_subtree;
+};
+
+template <typename T, size_t N>
+class Builder<T, N>::BboxJob
+  : public IJob
+{
+  public:
+    BboxJob(
+        const Builder&      builder,
+        const size_t        begin,
+        const size_t        end,
+        BboxType&           bbox)
+      : m_builder(builder)
+      , m_begin(begin)
+      , m_end(end)
+      , m_bbox(bbox)
+    {
+    }
+
+    virtual void execute(const size_t thread_index) APPLESEED_OVERRIDE
+    {
+        m_bbox = m_builder.compute_bbox(m_begin, m_end);
+    }
+
+  private:
+    const Builder&          m_builder;
+    const size_t            m_begin;
+    const size_t            m_end;
+    BboxType&               m_bbox;
+};
+
+template <typename T, size_t N>
+class Builder<T, N>::PartitionJob
+  : public IJob
+{
+  public:
+    PartitionJob(
+        const Builder&      builder,
+        const size_t        begin,
+        const size_t        end,
+        const SplitType&    split,
+        size_t&             pivot)
+      : m_builder(builder)
+      , m_begin(begin)
+      , m_end(end)
+      , m_split(split)
+      , m_pivot(pivot)
+    {
+    }
+
+    virtual void execute(const size_t thread_index) APPLESEED_OVERRIDE
+    {
+        m_pivot = m_builder.partition_indices(m_begin, m_end, m_split);
+    }
+
+  private:
+    const Builder&          m_builder;
+    const size_t            m_begin;
+    const size_t            m_end;
+    const SplitType         m_split;
+    size_t&                 m_pivot;
+};
+
 template <typename T, size_t N>
 inline Builder<T, N>::Builder(TreeType& tree)
   : m_tree(tree)
   , m_build_time(0.0)
+  , m_job_queue(0)
+  , m_thread_count(1)
 {
 }
 
@@ -153,33 +308,72 @@ void Builder<T, N>::build_move_points(
     Stopwatch<Timer> stopwatch;
     stopwatch.start();
 
-    const size_t count = points.size();
+    move_points(points);
 
-    if (count > 0)
-    {
-        m_tree.m_points.swap(points);
+    const size_t count = m_tree.m_points.size();
 
-        m_tree.m_indices.resize(count);
+    m_tree.m_nodes.reserve(count * 2 + 1);
+    m_tree.m_nodes.push_back(NodeType());
 
-        for (size_t i = 0; i < count; ++i)
-            m_tree.m_indices[i] = i;
-    }
+    partition(m_tree.m_nodes, 0, 0, count);
+
+    reorder_points();
 
+    stopwatch.measure();
+    m_build_time = stopwatch.get_seconds();
+}
+
+template <typename T, size_t N>
+template <typename Timer>
+void Builder<T, N>::build_move_points(
+    std::vector<VectorType>&    points,
+    JobQueue&                   job_queue,
+    const size_t                thread_count)
+{
+    assert(thread_count > 0);
+
+    Stopwatch<Timer> stopwatch;
+    stopwatch.start();
+
+    move_points(points);
+
+    const size_t count = m_tree.m_points.size();
+
+    m_job_queue = &job_queue;
+    m_thread_count = thread_count;
+
+    // Build the top of the tree, collecting the roots of the subtrees.
+    NodeVector top_nodes;
+    top_nodes.push_back(NodeType());
+    SubtreeVector subtrees;
+    partition(
+        top_nodes,
+        0,
+        0,
+        count,
+        &subtrees,
+        std::min(count / (SubtreesPerThread * thread_count), count / 2));
+
+    m_job_queue = 0;
+    m_thread_count = 1;
+
+    // Build the subtrees concurrently.
+    for (size_t i = 0; i < subtrees.size(); ++i)
+        job_queue.schedule(new SubtreeJob(*this, *subtrees[i]));
+    job_queue.wait_until_completion();
+
+    // Assemble the final tree.
+    SubtreeVector subtrees_by_node(top_nodes.size(), 0);
+    for (size_t i = 0; i < subtrees.size(); ++i)
+        subtrees_by_node[subtrees[i]->m_node_index] = subtrees[i];
     m_tree.m_nodes.reserve(count * 2 + 1);
     m_tree.m_nodes.push_back(NodeType());
+    relayout(top_nodes, &subtrees_by_node, 0, m_tree.m_nodes, 0);
 
-    partition(0, 0, count);
-
-    if (count > 0)
-    {
-        std::vector<VectorType> temp(count);
+    for (size_t i = 0; i < subtrees.size(); ++i)
+        delete subtrees[i];
 
-        small_item_reorder(
-            &m_tree.m_points[0],
-            &temp[0],
-            &m_tree.m_indices[0],
-            count);
-    }
+    reorder_points();
 
     stopwatch.measure();
     m_build_time = stopwatch.get_seconds();
@@ -207,33 +401,82 @@ inline bool Builder<T, N>::PartitionPredicate::operator()(
     return m_points[index][m_split.m_dimension] < m_split.m_abscissa;
 }
 
+template <typename T, size_t N>
+void Builder<T, N>::move_points(std::vector<VectorType>& points)
+{
+    const size_t count = points.size();
+
+    if (count > 0)
+    {
+        m_tree.m_points.swap(points);
+
+        m_tree.m_indices.resize(count);
+
+        for (size_t i = 0; i < count; ++i)
+            m_tree.m_indices[i] = i;
+    }
+}
+
+template <typename T, size_t N>
+void Builder<T, N>::reorder_points()
+{
+    const size_t count = m_tree.m_points.size();
+
+    if (count > 0)
+    {
+        std::vector<VectorType> temp(count);
+
+        small_item_reorder(
+            &m_tree.m_points[0],
+            &temp[0],
+            &m_tree.m_indices[0],
+            count);
+    }
+}
+
 template <typename T, size_t N>
 void Builder<T, N>::partition(
+    NodeVector&                 nodes,
     const size_t                parent_node_index,
     const size_t                begin,
-    const size_t                end) const
+    const size_t                end,
+    SubtreeVector*              subtrees,
+    const size_t                subtree_size) const
 {
     const size_t count = end - begin;
 
+    // Defer the construction of small enough subtrees.
+    if (subtrees && count <= subtree_size)
+    {
+        Subtree* subtree = new Subtree();
+        subtree->m_node_index = parent_node_index;
+        subtree->m_begin = begin;
+        subtree->m_end = end;
+        subtrees->push_back(subtree);
+        return;
+    }
+
     if (count <= 1)
     {
-        NodeType& parent_node = m_tree.m_nodes[parent_node_index];
+        NodeType& parent_node = nodes[parent_node_index];
         parent_node.make_leaf();
         parent_node.set_point_index(begin);
         parent_node.set_point_count(count);
     }
     else
     {
-        const BboxType bbox = compute_bbox(begin, end);
-        SplitType split = SplitType::middle(bbox);
+        const bool parallel = m_job_queue && count >= MinParallelPartitionSize;
 
-        const size_t* bound =
-            std::partition(
-                &m_tree.m_indices[0] + begin,
-                &m_tree.m_indices[0] + end,
-                PartitionPredicate(m_tree.m_points, split));
+        const BboxType bbox =
+            parallel
+                ? compute_bbox_parallel(begin, end)
+                : compute_bbox(begin, end);
+        SplitType split = SplitType::middle(bbox);
 
-        size_t pivot = bound - &m_tree.m_indices[0];
+        size_t pivot =
+            parallel
+                ? partition_indices_parallel(begin, end, split)
+                : partition_indices(begin, end, split);
         assert(pivot >= begin);
         assert(pivot <= end);
 
@@ -244,13 +487,13 @@ void Builder<T, N>::partition(
         if (pivot == begin || pivot == end)
             pivot = (begin + end) / 2;
 
-        const size_t left_node_index = m_tree.m_nodes.size();
+        const size_t left_node_index = nodes.size();
         const size_t right_node_index = left_node_index + 1;
 
-        m_tree.m_nodes.push_back(NodeType());
-        m_tree.m_nodes.push_back(NodeType());
+        nodes.push_back(NodeType());
+        nodes.push_back(NodeType());
 
-        NodeType& parent_node = m_tree.m_nodes[parent_node_index];
+        NodeType& parent_node = nodes[parent_node_index];
         parent_node.make_interior();
         parent_node.set_split_dim(split.m_dimension);
         parent_node.set_split_abs(split.m_abscissa);
@@ -258,8 +501,43 @@ void Builder<T, N>::partition(
         parent_node.set_point_index(begin);
         parent_node.set_point_count(count);
 
-        partition(left_node_index, begin, pivot);
-        partition(right_node_index, pivot, end);
+        partition(nodes, left_node_index, begin, pivot, subtrees, subtree_size);
+        partition(nodes, right_node_index, pivot, end, subtrees, subtree_size);
+    }
+}
+
+template <typename T, size_t N>
+void Builder<T, N>::relayout(
+    const NodeVector&           src_nodes,
+    const SubtreeVector*        src_subtrees,
+    const size_t                src_node_index,
+    NodeVector&                 dst_nodes,
+    const size_t                dst_node_index) const
+{
+    // Continue with the root of the subtree if this node is the root of a subtree.
+    if (src_subtrees && (*src_subtrees)[src_node_index])
+    {
+        relayout((*src_subtrees)[src_node_index]->m_nodes, 0, 0, dst_nodes, dst_node_index);
+        return;
+    }
+
+    NodeType node = src_nodes[src_node_index];
+
+    if (node.is_leaf())
+        dst_nodes[dst_node_index] = node;
+    else
+    {
+        // Create the child nodes.
+        const size_t src_child_node_index = node.get_child_node_index();
+        const size_t dst_child_node_index = dst_nodes.size();
+        node.set_child_node_index(dst_child_node_index);
+        dst_nodes[dst_node_index] = node;
+        dst_nodes.push_back(NodeType());
+        dst_nodes.push_back(NodeType());
+
+        // Recurse into the left and right subtrees.
+        relayout(src_nodes, src_subtrees, src_child_node_index, dst_nodes, dst_child_node_index);
+        relayout(src_nodes, src_subtrees, src_child_node_index + 1, dst_nodes, dst_child_node_index + 1);
     }
 }
 
@@ -280,6 +558,122 @@ inline typename Builder<T, N>::BboxType Builder<T, N>::compute_bbox(
     return bbox;
 }
 
+template <typename T, size_t N>
+typename Builder<T, N>::BboxType Builder<T, N>::compute_bbox_parallel(
+    const size_t                begin,
+    const size_t                end) const
+{
+    assert(m_job_queue);
+
+    const size_t chunk_count = m_thread_count;
+    std::vector<BboxType> chunk_bboxes(chunk_count);
+
+    for (size_t i = 0; i < chunk_count; ++i)
+    {
+        m_job_queue->schedule(
+            new BboxJob(
+                *this,
+                begin + (end - begin) * i / chunk_count,
+                begin + (end - begin) * (i + 1) / chunk_count,
+                chunk_bboxes[i]));
+    }
+
+    m_job_queue->wait_until_completion();
+
+    BboxType bbox;
+    bbox.invalidate();
+
+    for (size_t i = 0; i < chunk_count; ++i)
+        bbox.insert(chunk_bboxes[i]);
+
+    return bbox;
+}
+
+template <typename T, size_t N>
+inline size_t Builder<T, N>::partition_indices(
+    const size_t                begin,
+    const size_t                end,
+    const SplitType&            split) const
+{
+    const size_t* bound =
+        std::partition(
+            &m_tree.m_indices[0] + begin,
+            &m_tree.m_indices[0] + end,
+            PartitionPredicate(m_tree.m_points, split));
+
+    return bound - &m_tree.m_indices[0];
+}
+
+template <typename T, size_t N>
+size_t Builder<T, N>::partition_indices_parallel(
+    const size_t                begin,
+    const size_t                end,
+    const SplitType&            split) const
+{
+    assert(m_job_queue);
+
+    // Partition chunks of the set of points concurrently.
+    const size_t chunk_count = m_thread_count;
+    std::vector<size_t> chunk_bounds(chunk_count + 1);
+    std::vector<size_t> chunk_pivots(chunk_count);
+
+    for (size_t i = 0; i <= chunk_count; ++i)
+        chunk_bounds[i] = begin + (end - begin) * i / chunk_count;
+
+    for (size_t i = 0; i < chunk_count; ++i)
+    {
+        m_job_queue->schedule(
+            new PartitionJob(
+                *this,
+                chunk_bounds[i],
+                chunk_bounds[i + 1],
+                split,
+                chunk_pivots[i]));
+    }
+
+    m_job_queue->wait_until_completion();
+
+    // Compute the final pivot.
+    size_t pivot = begin;
+    for (size_t i = 0; i < chunk_count; ++i)
+        pivot += chunk_pivots[i] - chunk_bounds[i];
+
+    // Collect the ranges of points on the wrong side of the final pivot: right
+    // points of the chunks before the pivot, and left points of the chunks after it.
+    typedef std::pair<size_t, size_t> Range;
+    std::vector<Range> misplaced_right, misplaced_left;
+
+    for (size_t i = 0; i < chunk_count; ++i)
+    {
+        const size_t right_begin = std::max(chunk_pivots[i], begin);
+        const size_t right_end = std::min(chunk_bounds[i + 1], pivot);
+        if (right_begin < right_end)
+            misplaced_right.push_back(Range(right_begin, right_end));
+
+        const size_t left_begin = std::max(chunk_bounds[i], pivot);
+        const size_t left_end = std::min(chunk_pivots[i], end);
+        if (left_begin < left_end)
+            misplaced_left.push_back(Range(left_begin, left_end));
+    }
+
+    // Swap misplaced points. There are as many misplaced left points as misplaced right points.
+    size_t* indices = &m_tree.m_indices[0];
+    size_t left_range = 0, left_index = misplaced_left.empty() ? 0 : misplaced_left[0].first;
+
+    for (size_t i = 0; i < misplaced_right.size(); ++i)
+    {
+        for (size_t right_index = misplaced_right[i].first; right_index < misplaced_right[i].second; ++right_index)
+        {
+            if (left_index == misplaced_left[left_range].second)
+                left_index = misplaced_left[++left_range].first;
+
+            std::swap(indices[right_index], indices[left_index++]);
+        }
+    }
+
+    return pivot;
+}
+
 }       // namespace knn
 }       // namespace foundation
 
@@ -0,0 +1,657 @@
+
+//
+// This source file is part of appleseed.
+// Visit http://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2017 Francois Beaune, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#ifndef APPLESEED_FOUNDATION_MATH_KNN_KNN_HASHGRID_H
+#define APPLESEED_FOUNDATION_MATH_KNN_KNN_HASHGRID_H
+
+// appleseed.foundation headers.
+#include "foundation/core/concepts/noncopyable.h"
+#include "foundation/math/distance.h"
+#include "foundation/math/knn/knn_answer.h"
+#include "foundation/math/scalar.h"
+#include "foundation/math/vector.h"
+#include "foundation/platform/compiler.h"
+#include "foundation/platform/types.h"
+#include "foundation/utility/job/ijob.h"
+#include "foundation/utility/job/jobqueue.h"
+#include "foundation/utility/stopwatch.h"
+
+// Standard headers.
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+namespace foundation {
+namespace knn {
+
+//
+// A uniform grid of cubic cells whose cells are hashed into a fixed number of buckets.
+//
+// Building the grid is a linear-time counting sort of the points by bucket. It answers
+// the same queries as knn::Tree but is only efficient when the query radius is known
+// in advance and is close to half the cell size, such that a query visits 2^N cells.
+//
+// Reference:
+//
+//   Teschner et al., Optimized Spatial Hashing for Collision Detection of Deformable Objects,
+//   Proceedings of Vision, Modeling, Visualization 2003.
+//
+
+template <typename T, size_t N>
+class HashGrid
+  : public NonCopyable
+{
+  public:
+    typedef T ValueType;
+    static const size_t Dimension = N;
+
+    typedef Vector<T, N> VectorType;
+
+    // Constructor.
+    HashGrid();
+
+    // Return true if the grid does not contain any point.
+    bool empty() const;
+
+    // Transform an internal index to a user-data index.
+    size_t remap(const size_t i) const;
+
+    // Return the i'th point, where i is an internal index.
+    const VectorType& get_point(const size_t i) const;
+
+    // Return the edge length of the cells.
+    ValueType get_cell_size() const;
+
+    // Return the number of buckets.
+    size_t get_bucket_count() const;
+
+    // Return the number of points in a given bucket.
+    size_t get_bucket_size(const size_t bucket) const;
+
+    // Return the size (in bytes) of this object in memory.
+    size_t get_memory_size() const;
+
+    // Return the integer coordinate of the cell containing a given abscissa.
+    int32 get_cell_coordinate(const ValueType x) const;
+
+    // Return the bucket a given cell is hashed to.
+    size_t get_bucket(const int32 cell[N]) const;
+
+  private:
+    template <typename, size_t> friend class HashGridBuilder;
+    template <typename, size_t> friend class HashGridQuery;
+
+    ValueType               m_cell_size;
+    ValueType               m_rcp_cell_size;
+    size_t                  m_bucket_mask;
+    std::vector<VectorType> m_points;           // points sorted by bucket
+    std::vector<size_t>     m_indices;          // user-data index of each point
+    std::vector<size_t>     m_bucket_offsets;   // index of the first point of each bucket, plus a sentinel
+};
+
+typedef HashGrid<float, 2>  HashGrid2f;
+typedef HashGrid<double, 2> HashGrid2d;
+typedef HashGrid<float, 3>  HashGrid3f;
+typedef HashGrid<double, 3> HashGrid3d;
+
+
+//
+// Hash grid builder.
+//
+
+template <typename T, size_t N>
+class HashGridBuilder
+  : public NonCopyable
+{
+  public:
+    typedef T ValueType;
+    static const size_t Dimension = N;
+
+    typedef Vector<T, N> VectorType;
+    typedef HashGrid<T, N> GridType;
+
+    // Constructor.
+    explicit HashGridBuilder(GridType& grid);
+
+    // Build a grid with a given cell size for a given set of points.
+    template <typename Timer>
+    void build(
+        const VectorType            points[],
+        const size_t                count,
+        const ValueType             cell_size);
+
+    // Like build() but the points will be moved into the grid rather than copied.
+    template <typename Timer>
+    void build_move_points(
+        std::vector<VectorType>&    points,
+        const ValueType             cell_size);
+
+    // Like build_move_points() but the points are hashed using the worker threads
+    // servicing a given job queue. The resulting grid is identical.
+    template <typename Timer>
+    void build_move_points(
+        std::vector<VectorType>&    points,
+        const ValueType             cell_size,
+        JobQueue&                   job_queue,
+        const size_t                thread_count);
+
+    // Return the construction time.
+    double get_build_time() const;
+
+  private:
+    class HashJob;
+
+    GridType&   m_grid;
+    double      m_build_time;
+
+    void init(
+        std::vector<VectorType>&    points,
+        const ValueType             cell_size);
+
+    void hash_points(
+        std::vector<size_t>&        buckets,
+        const size_t                begin,
+        const size_t                end) const;
+
+    void sort_points(
+        const std::vector<size_t>&  buckets);
+};
+
+typedef HashGridBuilder<float, 2>  HashGridBuilder2f;
+typedef HashGridBuilder<double, 2> HashGridBuilder2d;
+typedef HashGridBuilder<float, 3>  HashGridBuilder3f;
+typedef HashGridBuilder<double, 3> HashGridBuilder3d;
+
+
+//
+// Hash grid query.
+//
+// Find the answer's size nearest points within a given distance of a query point.
+// Answers contain the same points as those of knn::Query, in a different order.
+//
+
+template <typename T, size_t N>
+class HashGridQuery
+  : public NonCopyable
+{
+  public:
+    typedef T ValueType;
+    static const size_t Dimension = N;
+
+    typedef Vector<T, N> VectorType;
+    typedef HashGrid<T, N> GridType;
+    typedef Answer<T> AnswerType;
+
+    HashGridQuery(
+        const GridType&     grid,
+        AnswerType&         answer);
+
+    void run(
+        const VectorType&   query_point,
+        const ValueType     query_max_square_distance) const;
+
+  private:
+    // Queries spanning at most that many cells don't allocate memory.
+    static const size_t MaxLocalBucketCount = 64;
+
+    const GridType&         m_grid;
+    AnswerType&             m_answer;
+
+    // Collect the distinct buckets of the cells of a given range.
+    size_t collect_buckets(
+        const int32         cell_begin[N],
+        const int32         cell_end[N],
+        size_t              buckets[]) const;
+
+    // Insert the points of a given bucket into the answer.
+    void visit_bucket(
+        const size_t        bucket,
+        const VectorType&   query_point,
+        const ValueType     query_max_square_distance,
+        ValueType&          max_square_dist) const;
+};
+
+typedef HashGridQuery<float, 2>  HashGridQuery2f;
+typedef HashGridQuery<double, 2> HashGridQuery2d;
+typedef HashGridQuery<float, 3>  HashGridQuery3f;
+typedef HashGridQuery<double, 3> HashGridQuery3d;
+
+
+//
+// HashGrid class implementation.
+//
+
+template <typename T, size_t N>
+inline HashGrid<T, N>::HashGrid()
+  : m_cell_size(T(1.0))
+  , m_rcp_cell_size(T(1.0))
+  , m_bucket_mask(0)
+{
+}
+
+template <typename T, size_t N>
+inline bool HashGrid<T, N>::empty() const
+{
+    return m_points.empty();
+}
+
+template <typename T, size_t N>
+inline size_t HashGrid<T, N>::remap(const size_t i) const
+{
+    assert(i < m_indices.size());
+    return m_indices[i];
+}
+
+template <typename T, size_t N>
+inline const Vector<T, N>& HashGrid<T, N>::get_point(const size_t i) const
+{
+    assert(i < m_points.size());
+    return m_points[i];
+}
+
+template <typename T, size_t N>
+inline T HashGrid<T, N>::get_cell_size() const
+{
+    return m_cell_size;
+}
+
+template <typename T, size_t N>
+inline size_t HashGrid<T, N>::get_bucket_count() const
+{
+    return m_bucket_offsets.empty() ? 0 : m_bucket_offsets.size() - 1;
+}
+
+template <typename T, size_t N>
+inline size_t HashGrid<T, N>::get_bucket_size(const size_t bucket) const
+{
+    assert(bucket + 1 < m_bucket_offsets.size());
+    return m_bucket_offsets[bucket + 1] - m_bucket_offsets[bucket];
+}
+
+template <typename T, size_t N>
+inline size_t HashGrid<T, N>::get_memory_size() const
+{
+    size_t mem_size = sizeof(*this);
+    mem_size += m_points.capacity() * sizeof(VectorType);
+    mem_size += m_indices.capacity() * sizeof(size_t);
+    mem_size += m_bucket_offsets.capacity() * sizeof(size_t);
+    return mem_size;
+}
+
+template <typename T, size_t N>
+inline int32 HashGrid<T, N>::get_cell_coordinate(const ValueType x) const
+{
+    return static_cast<int32>(std::floor(x * m_rcp_cell_size));
+}
+
+template <typename T, size_t N>
+inline size_t HashGrid<T, N>::get_bucket(const int32 cell[N]) const
+{
+    static const uint32 Primes[] = { 73856093, 19349663, 83492791, 50331653 };
+
+    uint32 h = 0;
+
+    for (size_t i = 0; i < N; ++i)
+        h ^= static_cast<uint32>(cell[i]) * Primes[i % 4];
+
+    return static_cast<size_t>(h) & m_bucket_mask;
+}
+
+
+//
+// HashGridBuilder class implementation.
+//
+
+template <typename T, size_t N>
+class HashGridBuilder<T, N>::HashJob
+  : public IJob
+{
+  public:
+    HashJob(
+        const HashGridBuilder&  builder,
+        std::vector<size_t>&    buckets,
+        const size_t            begin,
+        const size_t            end)
+      : m_builder(builder)
+      , m_buckets(buckets)
+      , m_begin(begin)
+      , m_end(end)
+    {
+    }
+
+    virtual void execute(const size_t thread_index) APPLESEED_OVERRIDE
+    {
+        m_builder.hash_points(m_buckets, m_begin, m_end);
+    }
+
+  private:
+    const HashGridBuilder&      m_builder;
+    std::vector<size_t>&        m_buckets;
+    const size_t                m_begin;
+    const size_t                m_end;
+};
+
+template <typename T, size_t N>
+inline HashGridBuilder<T, N>::HashGridBuilder(GridType& grid)
+  : m_grid(grid)
+  , m_build_time(0.0)
+{
+}
+
+template <typename T, size_t N>
+template <typename Timer>
+void HashGridBuilder<T, N>::build(
+    const VectorType            points[],
+    const size_t                count,
+    const ValueType             cell_size)
+{
+    std::vector<VectorType> vec(count);
+
+    if (count > 0)
+    {
+        assert(points);
+        std::memcpy(&vec[0], points, count * sizeof(VectorType));
+    }
+
+    build_move_points<Timer>(vec, cell_size);
+}
+
+template <typename T, size_t N>
+template <typename Timer>
+void HashGridBuilder<T, N>::build_move_points(
+    std::vector<VectorType>&    points,
+    const ValueType             cell_size)
+{
+    Stopwatch<Timer> stopwatch;
+    stopwatch.start();
+
+    init(points, cell_size);
+
+    const size_t count = m_grid.m_points.size();
+
+    std::vector<size_t> buckets(count);
+    hash_points(buckets, 0, count);
+    sort_points(buckets);
+
+    stopwatch.measure();
+    m_build_time = stopwatch.get_seconds();
+}
+
+template <typename T, size_t N>
+template <typename Timer>
+void HashGridBuilder<T, N>::build_move_points(
+    std::vector<VectorType>&    points,
+    const ValueType             cell_size,
+    JobQueue&                   job_queue,
+    const size_t                thread_count)
+{
+    assert(thread_count > 0);
+
+    Stopwatch<Timer> stopwatch;
+    stopwatch.start();
+
+    init(points, cell_size);
+
+    const size_t count = m_grid.m_points.size();
+
+    // Hash the points concurrently.
+    std::vector<size_t> buckets(count);
+    for (size_t i = 0; i < thread_count; ++i)
+    {
+        const size_t begin = count * i / thread_count;
+        const size_t end = count * (i + 1) / thread_count;
+
+        if (begin < end)
+            job_queue.schedule(new HashJob(*this, buckets, begin, end));
+    }
+    job_queue.wait_until_completion();
+
+    sort_points(buckets);
+
+    stopwatch.measure();
+    m_build_time = stopwatch.get_seconds();
+}
+
+template <typename T, size_t N>
+inline double HashGridBuilder<T, N>::get_build_time() const
+{
+    return m_build_time;
+}
+
+template <typename T, size_t N>
+void HashGridBuilder<T, N>::init(
+    std::vector<VectorType>&    points,
+    const ValueType             cell_size)
+{
+    assert(cell_size > ValueType(0.0));
+
+    const size_t count = points.size();
+
+    m_grid.m_cell_size = cell_size;
+    m_grid.m_rcp_cell_size = ValueType(1.0) / cell_size;
+    m_grid.m_points.clear();
+    m_grid.m_points.swap(points);
+    m_grid.m_indices.resize(count);
+
+    // Use about one bucket per point.
+    const size_t bucket_count =
+        static_cast<size_t>(next_pow2<uint64>(std::max<uint64>(count, 1)));
+    m_grid.m_bucket_mask = bucket_count - 1;
+    m_grid.m_bucket_offsets.assign(bucket_count + 1, 0);
+}
+
+template <typename T, size_t N>
+void HashGridBuilder<T, N>::hash_points(
+    std::vector<size_t>&        buckets,
+    const size_t                begin,
+    const size_t                end) const
+{
+    for (size_t i = begin; i < end; ++i)
+    {
+        const VectorType& point = m_grid.m_points[i];
+
+        int32 cell[N];
+        for (size_t d = 0; d < N; ++d)
+            cell[d] = m_grid.get_cell_coordinate(point[d]);
+
+        buckets[i] = m_grid.get_bucket(cell);
+    }
+}
+
+template <typename T, size_t N>
+void HashGridBuilder<T, N>::sort_points(
+    const std::vector<size_t>&  buckets)
+{
+    const size_t count = buckets.size();
+    std::vector<size_t>& offsets = m_grid.m_bucket_offsets;
+
+    // Count the points of each bucket.
+    for (size_t i = 0; i < count; ++i)
+        ++offsets[buckets[i] + 1];
+
+    // Turn the counts into offsets.
+    for (size_t i = 1; i < offsets.size(); ++i)
+        offsets[i] += offsets[i - 1];
+
+    // Scatter the points, preserving their relative order within each bucket.
+    std::vector<size_t> cursors(offsets.begin(), offsets.end() - 1);
+    std::vector<VectorType> sorted_points(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const size_t dest = cursors[buckets[i]]++;
+        sorted_points[dest] = m_grid.m_points[i];
+        m_grid.m_indices[dest] = i;
+    }
+
+    m_grid.m_points.swap(sorted_points);
+}
+
+
+//
+// HashGridQuery class implementation.
+//
+
+template <typename T, size_t N>
+inline HashGridQuery<T, N>::HashGridQuery(
+    const GridType&         grid,
+    AnswerType&             answer)
+  : m_grid(grid)
+  , m_answer(answer)
+{
+}
+
+template <typename T, size_t N>
+inline void HashGridQuery<T, N>::run(
+    const VectorType&       query_point,
+    const ValueType         query_max_square_distance) const
+{
+    assert(!m_grid.empty());
+
+    m_answer.clear();
+
+    // Compute the range of cells overlapped by the bounding box of the query sphere.
+    const ValueType query_max_distance = std::sqrt(query_max_square_distance);
+    int32 cell_begin[N];
+    int32 cell_end[N];
+    size_t cell_count = 1;
+
+    for (size_t d = 0; d < N; ++d)
+    {
+        cell_begin[d] = m_grid.get_cell_coordinate(query_point[d] - query_max_distance);
+        cell_end[d] = m_grid.get_cell_coordinate(query_point[d] + query_max_distance);
+        cell_count *= static_cast<size_t>(cell_end[d] - cell_begin[d]) + 1;
+    }
+
+    ValueType max_square_dist = query_max_square_distance;
+    const size_t bucket_count = m_grid.get_bucket_count();
+
+    if (cell_count >= bucket_count)
+    {
+        // The query covers more cells than there are buckets: visit every bucket.
+        for (size_t i = 0; i < bucket_count; ++i)
+            visit_bucket(i, query_point, query_max_square_distance, max_square_dist);
+    }
+    else if (cell_count <= MaxLocalBucketCount)
+    {
+        size_t buckets[MaxLocalBucketCount];
+        const size_t count = collect_buckets(cell_begin, cell_end, buckets);
+
+        for (size_t i = 0; i < count; ++i)
+            visit_bucket(buckets[i], query_point, query_max_square_distance, max_square_dist);
+    }
+    else
+    {
+        std::vector<size_t> buckets(cell_count);
+        const size_t count = collect_buckets(cell_begin, cell_end, &buckets[0]);
+
+        for (size_t i = 0; i < count; ++i)
+            visit_bucket(buckets[i], query_point, query_max_square_distance, max_square_dist);
+    }
+}
+
+template <typename T, size_t N>
+inline size_t HashGridQuery<T, N>::collect_buckets(
+    const int32             cell_begin[N],
+    const int32             cell_end[N],
+    size_t                  buckets[]) const
+{
+    size_t count = 0;
+
+    int32 cell[N];
+    for (size_t d = 0; d < N; ++d)
+        cell[d] = cell_begin[d];
+
+    while (true)
+    {
+        buckets[count++] = m_grid.get_bucket(cell);
+
+        // Move to the next cell.
+        size_t d = 0;
+        while (d < N && cell[d] == cell_end[d])
+        {
+            cell[d] = cell_begin[d];
+            ++d;
+        }
+
+        if (d == N)
+            break;
+
+        ++cell[d];
+    }
+
+    // Distinct cells may be hashed to the same bucket, visit each bucket once.
+    std::sort(buckets, buckets + count);
+    return static_cast<size_t>(std::unique(buckets, buckets + count) - buckets);
+}
+
+template <typename T, size_t N>
+inline void HashGridQuery<T, N>::visit_bucket(
+    const size_t            bucket,
+    const VectorType&       query_point,
+    const ValueType         query_max_square_distance,
+    ValueType&              max_square_dist) const
+{
+    const VectorType* APPLESEED_RESTRICT points = &m_grid.m_points.front();
+    const size_t begin = m_grid.m_bucket_offsets[bucket];
+    const size_t end = m_grid.m_bucket_offsets[bucket + 1];
+    const size_t max_answer_size = m_answer.m_max_size;
+
+    for (size_t i = begin; i < end; ++i)
+    {
+        const ValueType square_dist = square_distance(points[i], query_point);
+
+        if (m_answer.m_size < max_answer_size)
+        {
+            // Fill up the answer like an array.
+            if (square_dist <= query_max_square_distance)
+            {
+                m_answer.array_insert(i, square_dist);
+
+                // The answer is full, so we transform it into a heap.
+                if (m_answer.m_size == max_answer_size)
+                {
+                    m_answer.make_heap();
+                    max_square_dist = m_answer.top().m_square_dist;
+                }
+            }
+        }
+        else if (square_dist < max_square_dist)
+        {
+            m_answer.heap_insert(i, square_dist);
+            max_square_dist = m_answer.top().m_square_dist;
+        }
+    }
+}
+
+}       // namespace knn
+}       // namespace foundation
+
+#endif  // !APPLESEED_FOUNDATION_MATH_KNN_KNN_HASHGRID_H
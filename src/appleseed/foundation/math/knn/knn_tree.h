@@ -44,6 +44,7 @@
 DECLARE_TEST_CASE(Foundation_Math_Knn_Builder, Build_GivenZeroPoint_BuildsEmptyTree);
 DECLARE_TEST_CASE(Foundation_Math_Knn_Builder, Build_GivenTwoPoints_BuildsCorrectTree);
 DECLARE_TEST_CASE(Foundation_Math_Knn_Builder, Build_GivenEightPoints_GeneratesFifteenNodes);
+DECLARE_TEST_CASE(Foundation_Math_Knn_Builder, BuildMovePoints_GivenJobQueue_BuildsSameTreeAsSingleThreadedBuild);
 
 namespace foundation {
 namespace knn {
@@ -79,6 +80,7 @@ class Tree
     GRANT_ACCESS_TO_TEST_CASE(Foundation_Math_Knn_Builder, Build_GivenZeroPoint_BuildsEmptyTree);
     GRANT_ACCESS_TO_TEST_CASE(Foundation_Math_Knn_Builder, Build_GivenTwoPoints_BuildsCorrectTree);
     GRANT_ACCESS_TO_TEST_CASE(Foundation_Math_Knn_Builder, Build_GivenEightPoints_GeneratesFifteenNodes);
+    GRANT_ACCESS_TO_TEST_CASE(Foundation_Math_Knn_Builder, BuildMovePoints_GivenJobQueue_BuildsSameTreeAsSingleThreadedBuild);
 
     std::vector<VectorType> m_points;
     std::vector<size_t>     m_indices;
@@ -35,6 +35,8 @@
 #include "foundation/core/exceptions/exceptionioerror.h"
 #include "foundation/math/vector.h"
 #include "foundation/mesh/imeshbuilder.h"
+#include "foundation/mesh/irenderreadymeshbuilder.h"
+#include "foundation/platform/compiler.h"
 #include "foundation/platform/types.h"
 #include "foundation/utility/bufferedfile.h"
 #include "foundation/utility/memory.h"
@@ -42,6 +44,7 @@
 // Standard headers.
 #include <cstring>
 #include <memory>
+#include <vector>
 
 using namespace std;
 
@@ -76,6 +79,110 @@ namespace
     {
         checked_read(file, &object, sizeof(T));
     }
+
+    template <typename File>
+    string checked_read_string(File& file)
+    {
+        uint16 length;
+        checked_read(file, length);
+
+        string s;
+        s.resize(length);
+        checked_read(file, &s[0], length);
+
+        return s;
+    }
+
+    // Alignment in bytes of the arrays of format version 4.
+    const size_t RenderReadyAlignment = 16;
+
+    template <typename T>
+    inline T* array_data(vector<T>& v)
+    {
+        return v.empty() ? 0 : &v[0];
+    }
+
+    // Feeds the meshes of a render-ready file to a generic mesh builder.
+    class MeshBuilderAdapter
+      : public IRenderReadyMeshBuilder
+    {
+      public:
+        explicit MeshBuilderAdapter(IMeshBuilder& builder)
+          : m_builder(builder)
+        {
+        }
+
+        virtual void begin_mesh(const char* name) APPLESEED_OVERRIDE
+        {
+            m_builder.begin_mesh(name);
+        }
+
+        virtual void push_material_slot(const char* name) APPLESEED_OVERRIDE
+        {
+            m_builder.push_material_slot(name);
+        }
+
+        virtual float* allocate_vertices(const size_t count) APPLESEED_OVERRIDE
+        {
+            m_vertices.resize(count * 3);
+            return array_data(m_vertices);
+        }
+
+        virtual float* allocate_vertex_normals(const size_t count) APPLESEED_OVERRIDE
+        {
+            m_vertex_normals.resize(count * 3);
+            return array_data(m_vertex_normals);
+        }
+
+        virtual float* allocate_tex_coords(const size_t count) APPLESEED_OVERRIDE
+        {
+            m_tex_coords.resize(count * 2);
+            return array_data(m_tex_coords);
+        }
+
+        virtual uint32* allocate_triangles(const size_t count) APPLESEED_OVERRIDE
+        {
+            m_triangles.resize(count * 10);
+            return array_data(m_triangles);
+        }
+
+        virtual void end_mesh() APPLESEED_OVERRIDE
+        {
+            for (size_t i = 0; i < m_vertices.size(); i += 3)
+                m_builder.push_vertex(Vector3d(m_vertices[i + 0], m_vertices[i + 1], m_vertices[i + 2]));
+
+            for (size_t i = 0; i < m_vertex_normals.size(); i += 3)
+                m_builder.push_vertex_normal(Vector3d(m_vertex_normals[i + 0], m_vertex_normals[i + 1], m_vertex_normals[i + 2]));
+
+            for (size_t i = 0; i < m_tex_coords.size(); i += 2)
+                m_builder.push_tex_coords(Vector2d(m_tex_coords[i + 0], m_tex_coords[i + 1]));
+
+            for (size_t i = 0; i < m_triangles.size(); i += 10)
+            {
+                const uint32* t = &m_triangles[i];
+
+                const size_t vertices[3] = { t[0], t[1], t[2] };
+                const size_t vertex_normals[3] = { t[3], t[4], t[5] };
+                const size_t tex_coords[3] = { t[6], t[7], t[8] };
+
+                m_builder.begin_face(3);
+                m_builder.set_face_vertices(vertices);
+                m_builder.set_face_vertex_normals(vertex_normals);
+                m_builder.set_face_vertex_tex_coords(tex_coords);
+                m_builder.set_face_material(t[9]);
+                m_builder.end_face();
+            }
+
+            m_builder.end_mesh();
+        }
+
+      private:
+        IMeshBuilder&   m_builder;
+        vector<float>   m_vertices;
+        vector<float>   m_vertex_normals;
+        vector<float>   m_tex_coords;
+        vector<uint32>  m_triangles;
+    };
 }
 
 BinaryMeshFileReader::BinaryMeshFileReader(const string& filename)
@@ -90,13 +197,7 @@ void BinaryMeshFileReader::read(IMeshBuilder& builder)
         BufferedFile::BinaryType,
         BufferedFile::ReadMode);
 
-    if (!file.is_open())
-        throw ExceptionIOError();
-
-    read_and_check_signature(file);
-
-    uint16 version;
-    checked_read(file, version);
+    const uint16 version = open_and_read_version(file);
 
     auto_ptr<ReaderAdapter> reader;
 
@@ -118,6 +219,14 @@ void BinaryMeshFileReader::read(IMeshBuilder& builder)
         reader.reset(new LZ4CompressedReaderAdapter(file));
         break;
 
+      // Uncompressed, triangulated and aligned.
+      case 4:
+        {
+            MeshBuilderAdapter adapter(builder);
+            read_render_ready_meshes(file, adapter);
+        }
+        return;
+
       // Unknown format.
       default:
         throw ExceptionIOError("unknown binarymesh format version");
@@ -126,6 +235,34 @@ void BinaryMeshFileReader::read(IMeshBuilder& builder)
     read_meshes(*reader.get(), builder);
 }
 
+bool BinaryMeshFileReader::read_render_ready(IRenderReadyMeshBuilder& builder)
+{
+    BufferedFile file(
+        m_filename.c_str(),
+        BufferedFile::BinaryType,
+        BufferedFile::ReadMode);
+
+    if (open_and_read_version(file) != 4)
+        return false;
+
+    read_render_ready_meshes(file, builder);
+
+    return true;
+}
+
+uint16 BinaryMeshFileReader::open_and_read_version(BufferedFile& file)
+{
+    if (!file.is_open())
+        throw ExceptionIOError();
+
+    read_and_check_signature(file);
+
+    uint16 version;
+    checked_read(file, version);
+
+    return version;
+}
+
 void BinaryMeshFileReader::read_and_check_signature(BufferedFile& file)
 {
     static const char ExpectedSig[10] = { 'B', 'I', 'N', 'A', 'R', 'Y', 'M', 'E', 'S', 'H' };
@@ -139,14 +276,7 @@ void BinaryMeshFileReader::read_and_check_signature(BufferedFile& file)
 
 string BinaryMeshFileReader::read_string(ReaderAdapter& reader)
 {
-    uint16 length;
-    checked_read(reader, length);
-
-    string s;
-    s.resize(length);
-    checked_read(reader, &s[0], length);
-
-    return s;
+    return checked_read_string(reader);
 }
 
 void BinaryMeshFileReader::read_meshes(ReaderAdapter& reader, IMeshBuilder& builder)
@@ -280,4 +410,94 @@ void BinaryMeshFileReader::read_face(ReaderAdapter& reader, IMeshBuilder& builde
     builder.end_face();
 }
 
+void BinaryMeshFileReader::skip_padding(BufferedFile& file)
+{
+    const size_t misalignment = static_cast<size_t>(file.tell() % RenderReadyAlignment);
+
+    if (misalignment > 0)
+    {
+        uint8 padding[RenderReadyAlignment];
+        checked_read(file, padding, RenderReadyAlignment - misalignment);
+    }
+}
+
+void BinaryMeshFileReader::read_render_ready_meshes(BufferedFile& file, IRenderReadyMeshBuilder& builder)
+{
+    try
+    {
+        while (true)
+        {
+            // Read the name of the next mesh.
+            string mesh_name;
+            try
+            {
+                mesh_name = checked_read_string(file);
+            }
+            catch (const ExceptionEOF&)
+            {
+                // Expected EOF.
+                break;
+            }
+
+            builder.begin_mesh(mesh_name.c_str());
+            read_render_ready_mesh(file, builder);
+            builder.end_mesh();
+        }
+    }
+    catch (const ExceptionEOF&)
+    {
+        // Unexpected EOF.
+        throw ExceptionIOError();
+    }
+}
+
+void BinaryMeshFileReader::read_render_ready_mesh(BufferedFile& file, IRenderReadyMeshBuilder& builder)
+{
+    uint32 vertex_count, vertex_normal_count, tex_coords_count, triangle_count;
+    checked_read(file, vertex_count);
+    checked_read(file, vertex_normal_count);
+    checked_read(file, tex_coords_count);
+    checked_read(file, triangle_count);
+
+    uint16 material_slot_count;
+    checked_read(file, material_slot_count);
+
+    for (uint16 i = 0; i < material_slot_count; ++i)
+    {
+        const string material_slot = checked_read_string(file);
+        builder.push_material_slot(material_slot.c_str());
+    }
+
+    skip_padding(file);
+
+    // Each array is stored exactly as it is used in memory and is read with a single call
+    // straight into the storage provided by the builder.
+
+    read_array(
+        file,
+        builder.allocate_vertices(vertex_count),
+        static_cast<size_t>(vertex_count) * 3 * sizeof(float));
+
+    read_array(
+        file,
+        builder.allocate_vertex_normals(vertex_normal_count),
+        static_cast<size_t>(vertex_normal_count) * 3 * sizeof(float));
+
+    read_array(
+        file,
+        builder.allocate_tex_coords(tex_coords_count),
+        static_cast<size_t>(tex_coords_count) * 2 * sizeof(float));
+
+    read_array(
+        file,
+        builder.allocate_triangles(triangle_count),
+        static_cast<size_t>(triangle_count) * 10 * sizeof(uint32));
+}
+
+void BinaryMeshFileReader::read_array(BufferedFile& file, void* array, const size_t size)
+{
+    checked_read(file, array, size);
+    skip_padding(file);
+}
+
 }   // namespace foundation
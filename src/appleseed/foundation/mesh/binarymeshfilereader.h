@@ -33,6 +33,7 @@
 // appleseed.foundation headers.
 #include "foundation/mesh/imeshfilereader.h"
 #include "foundation/platform/compiler.h"
+#include "foundation/platform/types.h"
 
 // Standard headers.
 #include <cstddef>
@@ -42,6 +43,7 @@
 // Forward declarations.
 namespace foundation    { class BufferedFile; }
 namespace foundation    { class IMeshBuilder; }
+namespace foundation    { class IRenderReadyMeshBuilder; }
 namespace foundation    { class ReaderAdapter; }
 
 namespace foundation
@@ -61,12 +63,17 @@ class BinaryMeshFileReader
     // Read a mesh.
     virtual void read(IMeshBuilder& builder) APPLESEED_OVERRIDE;
 
+    // Read a render-ready mesh (format version 4) directly into the storage provided by
+    // the builder. Return false, without calling the builder, if the file is in another format.
+    bool read_render_ready(IRenderReadyMeshBuilder& builder);
+
   private:
     const std::string       m_filename;
     std::vector<size_t>     m_vertices;
     std::vector<size_t>     m_vertex_normals;
     std::vector<size_t>     m_tex_coords;
 
+    static uint16 open_and_read_version(BufferedFile& file);
     static void read_and_check_signature(BufferedFile& file);
 
     static std::string read_string(ReaderAdapter& reader);
@@ -77,6 +84,12 @@ class BinaryMeshFileReader
     void read_material_slots(ReaderAdapter& reader, IMeshBuilder& builder);
     void read_faces(ReaderAdapter& reader, IMeshBuilder& builder);
     void read_face(ReaderAdapter& reader, IMeshBuilder& builder);
+
+    // Format version 4.
+    static void skip_padding(BufferedFile& file);
+    static void read_array(BufferedFile& file, void* array, const size_t size);
+    void read_render_ready_meshes(BufferedFile& file, IRenderReadyMeshBuilder& builder);
+    void read_render_ready_mesh(BufferedFile& file, IRenderReadyMeshBuilder& builder);
 };
 
 }       // namespace foundation
@@ -32,12 +32,16 @@
 
 // appleseed.foundation headers.
 #include "foundation/core/exceptions/exceptionioerror.h"
+#include "foundation/math/triangulator.h"
 #include "foundation/math/vector.h"
 #include "foundation/mesh/imeshwalker.h"
 #include "foundation/platform/types.h"
+#include "foundation/utility/memory.h"
 
 // Standard headers.
+#include <cassert>
 #include <cstring>
+#include <vector>
 
 using namespace std;
 
@@ -64,14 +68,64 @@ namespace
     {
         checked_write(file, &object, sizeof(T));
     }
+
+    template <typename File>
+    void checked_write_string(File& file, const char* s)
+    {
+        const uint16 length = static_cast<uint16>(strlen(s));
+
+        checked_write(file, length);
+        checked_write(file, s, length);
+    }
+
+    // Alignment in bytes of the arrays of format version 4.
+    const size_t RenderReadyAlignment = 16;
+
+    void push_triangle(
+        const IMeshWalker&  walker,
+        const size_t        face_index,
+        const size_t        v0,
+        const size_t        v1,
+        const size_t        v2,
+        vector<uint32>&     triangles)
+    {
+        triangles.push_back(static_cast<uint32>(walker.get_face_vertex(face_index, v0)));
+        triangles.push_back(static_cast<uint32>(walker.get_face_vertex(face_index, v1)));
+        triangles.push_back(static_cast<uint32>(walker.get_face_vertex(face_index, v2)));
+
+        triangles.push_back(static_cast<uint32>(walker.get_face_vertex_normal(face_index, v0)));
+        triangles.push_back(static_cast<uint32>(walker.get_face_vertex_normal(face_index, v1)));
+        triangles.push_back(static_cast<uint32>(walker.get_face_vertex_normal(face_index, v2)));
+
+        triangles.push_back(static_cast<uint32>(walker.get_face_tex_coords(face_index, v0)));
+        triangles.push_back(static_cast<uint32>(walker.get_face_tex_coords(face_index, v1)));
+        triangles.push_back(static_cast<uint32>(walker.get_face_tex_coords(face_index, v2)));
+
+        triangles.push_back(static_cast<uint32>(walker.get_face_material(face_index)));
+    }
 }
 
-BinaryMeshFileWriter::BinaryMeshFileWriter(const string& filename)
+BinaryMeshFileWriter::BinaryMeshFileWriter(
+    const string&   filename,
+    const int       options)
   : m_filename(filename)
+  , m_options(options)
   , m_writer(m_file, 256 * 1024)
 {
 }
 
+int BinaryMeshFileWriter::get_options() const
+{
+    return m_options;
+}
+
+void BinaryMeshFileWriter::set_options(const int options)
+{
+    assert(!m_file.is_open());
+
+    m_options = options;
+}
+
 void BinaryMeshFileWriter::write(const IMeshWalker& walker)
 {
     if (!m_file.is_open())
@@ -88,7 +142,9 @@ void BinaryMeshFileWriter::write(const IMeshWalker& walker)
         write_version();
     }
 
-    write_mesh(walker);
+    if (m_options & RenderReady)
+        write_render_ready_mesh(walker);
+    else write_mesh(walker);
 }
 
 void BinaryMeshFileWriter::write_signature()
@@ -100,17 +156,14 @@ void BinaryMeshFileWriter::write_signature()
 
 void BinaryMeshFileWriter::write_version()
 {
-    const uint16 Version = 3;
+    const uint16 Version = (m_options & RenderReady) ? 4 : 3;
 
     checked_write(m_file, Version);
 }
 
 void BinaryMeshFileWriter::write_string(const char* s)
 {
-    const uint16 length = static_cast<uint16>(strlen(s));
-
-    checked_write(m_writer, length);
-    checked_write(m_writer, s, length);
+    checked_write_string(m_writer, s);
 }
 
 void BinaryMeshFileWriter::write_mesh(const IMeshWalker& walker)
@@ -183,4 +236,104 @@ void BinaryMeshFileWriter::write_face(const IMeshWalker& walker, const size_t fa
     checked_write(m_writer, static_cast<uint16>(walker.get_face_material(face_index)));
 }
 
+void BinaryMeshFileWriter::write_padding()
+{
+    static const uint8 Zeros[RenderReadyAlignment] = { 0 };
+
+    const size_t misalignment = static_cast<size_t>(m_file.tell() % RenderReadyAlignment);
+
+    if (misalignment > 0)
+        checked_write(m_file, Zeros, RenderReadyAlignment - misalignment);
+}
+
+void BinaryMeshFileWriter::write_render_ready_mesh(const IMeshWalker& walker)
+{
+    triangulate_faces(walker);
+
+    const uint32 vertex_count = static_cast<uint32>(walker.get_vertex_count());
+    const uint32 vertex_normal_count = static_cast<uint32>(walker.get_vertex_normal_count());
+    const uint32 tex_coords_count = static_cast<uint32>(walker.get_tex_coords_count());
+    const uint32 triangle_count = static_cast<uint32>(m_triangles.size() / 10);
+    const uint16 material_slot_count = static_cast<uint16>(walker.get_material_slot_count());
+
+    // Mesh header.
+    checked_write_string(m_file, walker.get_name());
+    checked_write(m_file, vertex_count);
+    checked_write(m_file, vertex_normal_count);
+    checked_write(m_file, tex_coords_count);
+    checked_write(m_file, triangle_count);
+    checked_write(m_file, material_slot_count);
+    for (uint16 i = 0; i < material_slot_count; ++i)
+        checked_write_string(m_file, walker.get_material_slot(i));
+    write_padding();
+
+    // Vertices.
+    for (uint32 i = 0; i < vertex_count; ++i)
+        checked_write(m_file, Vector3f(walker.get_vertex(i)));
+    write_padding();
+
+    // Vertex normals.
+    for (uint32 i = 0; i < vertex_normal_count; ++i)
+        checked_write(m_file, Vector3f(walker.get_vertex_normal(i)));
+    write_padding();
+
+    // Texture coordinates.
+    for (uint32 i = 0; i < tex_coords_count; ++i)
+        checked_write(m_file, Vector2f(walker.get_tex_coords(i)));
+    write_padding();
+
+    // Triangles.
+    if (triangle_count > 0)
+        checked_write(m_file, &m_triangles[0], m_triangles.size() * sizeof(uint32));
+    write_padding();
+}
+
+void BinaryMeshFileWriter::triangulate_faces(const IMeshWalker& walker)
+{
+    clear_keep_memory(m_triangles);
+
+    Triangulator<double> triangulator(Triangulator<double>::KeepDegenerateTriangles);
+    vector<Vector3d> polygon;
+    vector<size_t> triangles;
+
+    const size_t face_count = walker.get_face_count();
+
+    for (size_t face_index = 0; face_index < face_count; ++face_index)
+    {
+        const size_t vertex_count = walker.get_face_vertex_count(face_index);
+
+        if (vertex_count > 3)
+        {
+            // Create the polygon to triangulate.
+            polygon.clear();
+            for (size_t i = 0; i < vertex_count; ++i)
+                polygon.push_back(walker.get_vertex(walker.get_face_vertex(face_index, i)));
+
+            // Triangulate the polygon.
+            triangles.clear();
+            if (triangulator.triangulate(polygon, triangles))
+            {
+                for (size_t i = 0; i < triangles.size(); i += 3)
+                {
+                    push_triangle(
+                        walker,
+                        face_index,
+                        triangles[i + 0],
+                        triangles[i + 1],
+                        triangles[i + 2],
+                        m_triangles);
+                }
+            }
+            else
+            {
+                // The polygon could not be triangulated: insert 0-area triangles instead.
+                for (size_t i = 0; i < vertex_count - 2; ++i)
+                    push_triangle(walker, face_index, 0, 0, 0, m_triangles);
+            }
+        }
+        else if (vertex_count == 3)
+            push_triangle(walker, face_index, 0, 1, 2, m_triangles);
+    }
+}
+
 }   // namespace foundation
@@ -33,11 +33,13 @@
 // appleseed.foundation headers.
 #include "foundation/mesh/imeshfilewriter.h"
 #include "foundation/platform/compiler.h"
+#include "foundation/platform/types.h"
 #include "foundation/utility/bufferedfile.h"
 
 // Standard headers.
 #include <cstddef>
 #include <string>
+#include <vector>
 
 // Forward declarations.
 namespace foundation    { class IMeshWalker; }
@@ -53,16 +55,30 @@ class BinaryMeshFileWriter
   : public IMeshFileWriter
 {
   public:
+    enum Options
+    {
+        Defaults    = 0,            // none of the flags below
+        RenderReady = 1 << 0        // write triangulated, uncompressed and aligned data (format version 4)
+    };
+
     // Constructor.
-    explicit BinaryMeshFileWriter(const std::string& filename);
+    explicit BinaryMeshFileWriter(
+        const std::string&  filename,
+        const int           options = Defaults);
+
+    // Get/set options. Options must be set before the first mesh is written.
+    int get_options() const;
+    void set_options(const int options);
 
     // Write a mesh.
     virtual void write(const IMeshWalker& walker) APPLESEED_OVERRIDE;
 
   private:
     const std::string           m_filename;
+    int                         m_options;
     BufferedFile                m_file;
     LZ4CompressedWriterAdapter  m_writer;
+    std::vector<uint32>         m_triangles;
 
     void write_signature();
     void write_version();
@@ -75,6 +91,11 @@ class BinaryMeshFileWriter
     void write_material_slots(const IMeshWalker& walker);
     void write_faces(const IMeshWalker& walker);
     void write_face(const IMeshWalker& walker, const size_t face_index);
+
+    // Format version 4.
+    void write_padding();
+    void write_render_ready_mesh(const IMeshWalker& walker);
+    void triangulate_faces(const IMeshWalker& walker);
 };
 
 }       // namespace foundation
@@ -49,6 +49,7 @@ namespace foundation
 {
 
 GenericMeshFileWriter::GenericMeshFileWriter(const char* filename)
+  : m_binarymesh_writer(0)
 {
     const bf::path filepath(filename);
     const string extension = lower_case(filepath.extension().string());
@@ -56,7 +57,7 @@ GenericMeshFileWriter::GenericMeshFileWriter(const char* filename)
     if (extension == ".obj")
         m_writer = new OBJMeshFileWriter(filename);
     else if (extension == ".binarymesh")
-        m_writer = new BinaryMeshFileWriter(filename);
+        m_writer = m_binarymesh_writer = new BinaryMeshFileWriter(filename);
     else throw ExceptionUnsupportedFileFormat(filename);
 }
 
@@ -65,6 +66,20 @@ GenericMeshFileWriter::~GenericMeshFileWriter()
     delete m_writer;
 }
 
+int GenericMeshFileWriter::get_binarymesh_options() const
+{
+    return
+        m_binarymesh_writer
+            ? m_binarymesh_writer->get_options()
+            : BinaryMeshFileWriter::Defaults;
+}
+
+void GenericMeshFileWriter::set_binarymesh_options(const int binarymesh_options)
+{
+    if (m_binarymesh_writer)
+        m_binarymesh_writer->set_options(binarymesh_options);
+}
+
 void GenericMeshFileWriter::write(const IMeshWalker& walker)
 {
     m_writer->write(walker);
@@ -38,6 +38,7 @@
 #include "main/dllsymbol.h"
 
 // Forward declarations.
+namespace foundation    { class BinaryMeshFileWriter; }
 namespace foundation    { class IMeshWalker; }
 
 namespace foundation
@@ -57,11 +58,17 @@ class APPLESEED_DLLSYMBOL GenericMeshFileWriter
     // Destructor.
     virtual ~GenericMeshFileWriter();
 
+    // Get/set options for the BinaryMesh file writer (see foundation::BinaryMeshFileWriter::Options).
+    // They are ignored if the mesh file is not a BinaryMesh file.
+    int get_binarymesh_options() const;
+    void set_binarymesh_options(const int binarymesh_options);
+
     // Write a mesh.
     virtual void write(const IMeshWalker& walker) APPLESEED_OVERRIDE;
 
   private:
-    IMeshFileWriter* m_writer;
+    IMeshFileWriter*        m_writer;
+    BinaryMeshFileWriter*   m_binarymesh_writer;
 };
 
 }       // namespace foundation
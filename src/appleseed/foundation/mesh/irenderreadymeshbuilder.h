@@ -0,0 +1,88 @@
+
+//
+// This source file is part of appleseed.
+// Visit http://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2010-2013 Francois Beaune, Jupiter Jazz Limited
+// Copyright (c) 2014-2017 Francois Beaune, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#ifndef APPLESEED_FOUNDATION_MESH_IRENDERREADYMESHBUILDER_H
+#define APPLESEED_FOUNDATION_MESH_IRENDERREADYMESHBUILDER_H
+
+// appleseed.foundation headers.
+#include "foundation/core/concepts/noncopyable.h"
+#include "foundation/platform/types.h"
+
+// appleseed.main headers.
+#include "main/dllsymbol.h"
+
+// Standard headers.
+#include <cstddef>
+
+namespace foundation
+{
+
+//
+// Builder interface for meshes stored in render-ready form (binarymesh format version 4).
+//
+// Instead of receiving vertices and faces one by one, the builder provides the storage
+// for each array of a mesh and the reader reads the array there in a single operation.
+//
+
+class APPLESEED_DLLSYMBOL IRenderReadyMeshBuilder
+  : public NonCopyable
+{
+  public:
+    // Destructor.
+    virtual ~IRenderReadyMeshBuilder() {}
+
+    // Begin the definition of a mesh.
+    virtual void begin_mesh(const char* name) = 0;
+
+    // Append a material slot to the mesh.
+    virtual void push_material_slot(const char* name) = 0;
+
+    // Return storage for the vertices of the mesh (three floats per vertex).
+    virtual float* allocate_vertices(const size_t count) = 0;
+
+    // Return storage for the vertex normals of the mesh (three floats per normal).
+    // The normals are NOT necessarily unit-length.
+    virtual float* allocate_vertex_normals(const size_t count) = 0;
+
+    // Return storage for the texture coordinates of the mesh (two floats per vector).
+    virtual float* allocate_tex_coords(const size_t count) = 0;
+
+    // Return storage for the triangles of the mesh (ten indices per triangle: three
+    // vertex indices, three vertex normal indices, three texture coordinate indices
+    // and a material index, absent features being ~0).
+    virtual uint32* allocate_triangles(const size_t count) = 0;
+
+    // End the definition of the mesh.
+    virtual void end_mesh() = 0;
+};
+
+}       // namespace foundation
+
+#endif  // !APPLESEED_FOUNDATION_MESH_IRENDERREADYMESHBUILDER_H
@@ -63,6 +63,8 @@ class OBJMeshFileLexer
     // Constructor.
     explicit OBJMeshFileLexer(const ParsingMode parsing_mode = Precise)
       : m_parsing_mode(parsing_mode)
+      , m_text(0)
+      , m_text_end(0)
       , m_eof(false)
       , m_line_number(0)
       , m_line(4096)
@@ -78,6 +80,8 @@ class OBJMeshFileLexer
     // Return true on success, false on error.
     bool open(const std::string& filename)
     {
+        m_text = 0;
+        m_text_end = 0;
         m_eof = false;
         m_line_number = 0;
         m_line_size = 0;
@@ -96,16 +100,35 @@ class OBJMeshFileLexer
         return true;
     }
 
+    // Read the input from a range of characters in memory instead of a file.
+    // Lines are split exactly as they would be if the characters were read from a file.
+    // The characters must remain valid until the lexer is closed.
+    void open(const char* begin, const char* end)
+    {
+        assert(begin != 0 && begin <= end);
+
+        m_text = begin;
+        m_text_end = end;
+        m_eof = false;
+        m_line_number = 0;
+        m_line_size = 0;
+        m_line_index = 0;
+
+        read_next_line();
+    }
+
     // Close the input file.
     void close()
     {
+        m_text = 0;
+        m_text_end = 0;
         m_file.close();
     }
 
     // Return the position of the current line in the file.
     size_t get_line_number() const
     {
-        assert(m_file.is_open());
+        assert(is_open());
 
         return m_line_number;
     }
@@ -113,7 +136,7 @@ class OBJMeshFileLexer
     // Return the current character in the line.
     APPLESEED_FORCE_INLINE unsigned char get_char() const
     {
-        assert(m_file.is_open());
+        assert(is_open());
 
         return m_line_index == m_line_size ? '\n' : m_line[m_line_index];
     }
@@ -121,7 +144,7 @@ class OBJMeshFileLexer
     // Advance to the next character in the line.
     APPLESEED_FORCE_INLINE void next_char()
     {
-        assert(m_file.is_open());
+        assert(is_open());
 
         if (m_line_index < m_line_size)
             ++m_line_index;
@@ -141,7 +164,7 @@ class OBJMeshFileLexer
     // Return true if the end of the line has been reached.
     APPLESEED_FORCE_INLINE bool is_eol() const
     {
-        assert(m_file.is_open());
+        assert(is_open());
 
         return m_line_index == m_line_size;
     }
@@ -149,7 +172,7 @@ class OBJMeshFileLexer
     // Return true if the end of the file has been reached.
     APPLESEED_FORCE_INLINE bool is_eof() const
     {
-        assert(m_file.is_open());
+        assert(is_open());
 
         return m_eof && is_eol();
     }
@@ -157,7 +180,7 @@ class OBJMeshFileLexer
     // Eat blank characters and comments.
     void eat_blanks()
     {
-        assert(m_file.is_open());
+        assert(is_open());
 
         while (true)
         {
@@ -192,7 +215,7 @@ class OBJMeshFileLexer
     // Accept a end-of-line character, or generate a parse error.
     void accept_newline()
     {
-        assert(m_file.is_open());
+        assert(is_open());
 
         if (!is_eol())
             parse_error();
@@ -203,7 +226,7 @@ class OBJMeshFileLexer
     // Accept a string of non-blank characters, or generate a parse error.
     void accept_string(const char** begin, size_t* length)
     {
-        assert(m_file.is_open());
+        assert(is_open());
 
         if (is_eof())
             parse_error();
@@ -236,7 +259,7 @@ class OBJMeshFileLexer
     // Accept a long integer, or generate a parse error.
     APPLESEED_FORCE_INLINE long accept_long()
     {
-        assert(m_file.is_open());
+        assert(is_open());
 
         // Read an integer value at the current position in the line.
         const char* base_ptr = &m_line[0];
@@ -255,7 +278,7 @@ class OBJMeshFileLexer
     // Accept a double-precision floating point number, or generate a parse error.
     APPLESEED_FORCE_INLINE double accept_double()
     {
-        assert(m_file.is_open());
+        assert(is_open());
 
         // Read a floating-point value at the current position in the line.
         char* base_ptr = &m_line[0];
@@ -279,23 +302,30 @@ class OBJMeshFileLexer
     const ParsingMode   m_parsing_mode;     // parsing mode for floating-point values
     bool                m_is_space[256];    // precomputed values of std::isspace(c) for all c
     BufferedFile        m_file;
+    const char*         m_text;             // current position in the input when reading from memory
+    const char*         m_text_end;         // end of the input when reading from memory
     bool                m_eof;              // has the end of the file been reached?
     size_t              m_line_number;      // position of the current line in the file
     std::vector<char>   m_line;             // current line
     size_t              m_line_size;        // size of the current line (not counting the zero terminator)
     size_t              m_line_index;       // position of the cursor in the current line
 
+    bool is_open() const
+    {
+        return m_text != 0 || m_file.is_open();
+    }
+
     // Close the input file and throw an ExceptionParseError exception.
     void parse_error()
     {
-        m_file.close();
+        close();
         throw OBJMeshFileReader::ExceptionParseError(m_line_number);
     }
 
     // Read the next line from the input file.
     void read_next_line()
     {
-        assert(m_file.is_open());
+        assert(is_open());
 
         m_line_size = 0;
 
@@ -303,29 +333,59 @@ class OBJMeshFileLexer
         {
             ++m_line_number;
 
-            while (m_line_size < m_line.size() - 1)
-            {
-                // Read one character from the file.
-                char c;
-                if (m_file.read(&c) < 1)
-                {
-                    // Reached the end of the file.
-                    m_eof = true;
-                    break;
-                }
-
-                // Stop as soon as the end of the line is reached.
-                if (c == '\n')
-                    break;
-
-                // Append the character to the line.
-                m_line[m_line_size++] = c;
-            }
+            if (m_text)
+                read_next_line_from_memory();
+            else read_next_line_from_file();
         }
 
         // Append a null terminator.
         m_line[m_line_size] = 0;
     }
+
+    void read_next_line_from_memory()
+    {
+        while (m_line_size < m_line.size() - 1)
+        {
+            if (m_text == m_text_end)
+            {
+                // Reached the end of the input.
+                m_eof = true;
+                break;
+            }
+
+            // Read one character.
+            const char c = *m_text++;
+
+            // Stop as soon as the end of the line is reached.
+            if (c == '\n')
+                break;
+
+            // Append the character to the line.
+            m_line[m_line_size++] = c;
+        }
+    }
+
+    void read_next_line_from_file()
+    {
+        while (m_line_size < m_line.size() - 1)
+        {
+            // Read one character from the file.
+            char c;
+            if (m_file.read(&c) < 1)
+            {
+                // Reached the end of the file.
+                m_eof = true;
+                break;
+            }
+
+            // Stop as soon as the end of the line is reached.
+            if (c == '\n')
+                break;
+
+            // Append the character to the line.
+            m_line[m_line_size++] = c;
+        }
+    }
 };
 
 }       // namespace foundation
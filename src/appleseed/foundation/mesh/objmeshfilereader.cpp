@@ -35,11 +35,18 @@
 #include "foundation/math/vector.h"
 #include "foundation/mesh/imeshbuilder.h"
 #include "foundation/mesh/objmeshfilelexer.h"
+#include "foundation/platform/system.h"
+#include "foundation/utility/bufferedfile.h"
+#include "foundation/utility/job.h"
+#include "foundation/utility/log.h"
 #include "foundation/utility/memory.h"
+#include "foundation/utility/otherwise.h"
 
 // Standard headers.
+#include <cassert>
 #include <cstring>
 #include <map>
+#include <memory>
 #include <utility>
 #include <vector>
 
@@ -51,17 +58,500 @@ namespace foundation
 //
 // OBJMeshFileReader class implementation.
 //
+// Parsing is split in two stages: a StatementParser turns the characters of the
+// file into statements, and OBJMeshFileReader::Impl turns statements into calls
+// to the mesh builder. When parsing concurrently, the first stage runs on chunks
+// of the file in parallel, and the statements of each chunk are then handed over
+// to the second stage in file order, with indices and line numbers rebased.
+//
 
 namespace
 {
     const size_t Undefined = ~0;
+
+    template <typename T>
+    const T* first_or_null(const vector<T>& v)
+    {
+        return v.empty() ? 0 : &v[0];
+    }
+
+    //
+    // Turns the characters of an OBJ file into statements and forwards them to a handler.
+    // Face indices are forwarded as they appear in the file; they are validated by the handler.
+    //
+
+    template <typename Handler>
+    class StatementParser
+    {
+      public:
+        StatementParser(
+            OBJMeshFileLexer&   lexer,
+            Handler&            handler)
+          : m_lexer(lexer)
+          , m_handler(handler)
+        {
+        }
+
+        void parse()
+        {
+            while (true)
+            {
+                m_lexer.eat_blanks();
+
+                // Handle end of file.
+                if (m_lexer.is_eof())
+                    break;
+
+                // Handle empty lines.
+                if (m_lexer.is_eol())
+                {
+                    m_lexer.accept_newline();
+                    continue;
+                }
+
+                const char* keyword;
+                size_t keyword_length;
+
+                m_lexer.accept_string(&keyword, &keyword_length);
+
+                if (keyword_length == 1)
+                {
+                    switch (keyword[0])
+                    {
+                      case 'f':
+                        parse_f_statement();
+                        break;
+
+                      case 'g':
+                      case 'o':
+                        m_handler.on_o_g_statement(parse_compound_identifier());
+                        break;
+
+                      case 'v':
+                        parse_v_statement();
+                        break;
+
+                      default:
+                        // Ignore unknown or unhandled statements.
+                        m_lexer.eat_line();
+                        continue;
+                    }
+                }
+                else if (keyword_length == 2)
+                {
+                    switch (keyword[0] * 256 + keyword[1])
+                    {
+                      case 'v' * 256 + 'n':
+                        parse_vn_statement();
+                        break;
+
+                      case 'v' * 256 + 't':
+                        parse_vt_statement();
+                        break;
+
+                      default:
+                        // Ignore unknown or unhandled statements.
+                        m_lexer.eat_line();
+                        continue;
+                    }
+                }
+                else if (strncmp(keyword, "usemtl", keyword_length) == 0)
+                {
+                    m_handler.on_usemtl_statement(parse_compound_identifier());
+                }
+                else
+                {
+                    // Ignore unknown or unhandled statements.
+                    m_lexer.eat_line();
+                    continue;
+                }
+
+                m_lexer.eat_blanks();
+                m_lexer.accept_newline();
+            }
+        }
+
+      private:
+        OBJMeshFileLexer&       m_lexer;
+        Handler&                m_handler;
+
+        // Temporary vectors for collecting indices while parsing face statements.
+        vector<long>            m_face_vertex_indices;
+        vector<long>            m_face_tex_coord_indices;
+        vector<long>            m_face_normal_indices;
+
+        // Close the input file and throw an ExceptionParseError exception.
+        void parse_error()
+        {
+            const size_t line_number = m_lexer.get_line_number();
+
+            m_lexer.close();
+
+            throw OBJMeshFileReader::ExceptionParseError(line_number);
+        }
+
+        void parse_f_statement()
+        {
+            clear_keep_memory(m_face_vertex_indices);
+            clear_keep_memory(m_face_tex_coord_indices);
+            clear_keep_memory(m_face_normal_indices);
+
+            while (true)
+            {
+                m_lexer.eat_blanks();
+
+                if (m_lexer.is_eol())
+                    break;
+
+                //
+                // Recognized (epsilon)
+                // Accept n
+                //
+
+                m_face_vertex_indices.push_back(m_lexer.accept_long());
+
+                //
+                // Recognized n
+                // Accept (epsilon), /
+                //
+
+                {
+                    const unsigned char c = m_lexer.get_char();
+                    if (m_lexer.is_space(c))
+                        continue;
+                    else if (c == '/')
+                        m_lexer.next_char();
+                    else parse_error();
+                }
+
+                //
+                // Recognized n/
+                // Accept /, n
+                //
+
+                {
+                    const unsigned char c = m_lexer.get_char();
+                    if (c == '/')
+                    {
+                        m_lexer.next_char();
+                        goto skip;
+                    }
+                    else m_face_tex_coord_indices.push_back(m_lexer.accept_long());
+                }
+
+                //
+                // Recognized n/n
+                // Accept (epsilon), /
+                //
+
+                {
+                    const unsigned char c = m_lexer.get_char();
+                    if (m_lexer.is_space(c))
+                        continue;
+                    else if (c == '/')
+                        m_lexer.next_char();
+                    else parse_error();
+                }
+
+              skip:
+
+                //
+                // Recognized n//, n/n/
+                // Accept (epsilon), n
+                //
+
+                {
+                    const unsigned char c = m_lexer.get_char();
+                    if (m_lexer.is_space(c))
+                        continue;
+                    else m_face_normal_indices.push_back(m_lexer.accept_long());
+                }
+            }
+
+            m_handler.on_f_statement(
+                m_face_vertex_indices,
+                m_face_tex_coord_indices,
+                m_face_normal_indices,
+                m_lexer.get_line_number());
+        }
+
+        string parse_compound_identifier()
+        {
+            string identifier;
+
+            m_lexer.eat_blanks();
+
+            while (!m_lexer.is_eol())
+            {
+                const char* token;
+                size_t token_length;
+
+                m_lexer.accept_string(&token, &token_length);
+                m_lexer.eat_blanks();
+
+                if (!identifier.empty())
+                    identifier += ' ';
+
+                identifier.append(token, token_length);
+            }
+
+            return identifier;
+        }
+
+        void parse_v_statement()
+        {
+            Vector3d v;
+
+            m_lexer.eat_blanks();
+            v.x = m_lexer.accept_double();
+
+            m_lexer.eat_blanks();
+            v.y = m_lexer.accept_double();
+
+            m_lexer.eat_blanks();
+            v.z = m_lexer.accept_double();
+
+            m_lexer.eat_blanks();
+
+            if (!m_lexer.is_eol())
+                m_lexer.accept_double();
+
+            m_handler.on_v_statement(v);
+        }
+
+        void parse_vt_statement()
+        {
+            Vector2d v;
+
+            m_lexer.eat_blanks();
+            v.x = m_lexer.accept_double();
+
+            m_lexer.eat_blanks();
+            v.y = m_lexer.accept_double();
+
+            m_lexer.eat_blanks();
+
+            if (!m_lexer.is_eol())
+                m_lexer.accept_double();
+
+            m_handler.on_vt_statement(v);
+        }
+
+        void parse_vn_statement()
+        {
+            Vector3d n;
+
+            m_lexer.eat_blanks();
+            n.x = m_lexer.accept_double();
+
+            m_lexer.eat_blanks();
+            n.y = m_lexer.accept_double();
+
+            m_lexer.eat_blanks();
+            n.z = m_lexer.accept_double();
+
+            m_handler.on_vn_statement(n);
+        }
+    };
+
+    //
+    // A chunk of an OBJ file made of whole lines, and the statements parsed from it.
+    //
+
+    struct Chunk
+    {
+        struct Statement
+        {
+            enum Type { Face, ObjectOrGroup, UseMaterial };
+
+            Type                m_type;
+            size_t              m_line;                     // line number, relative to the beginning of the chunk
+            size_t              m_index;                    // index of the first face index in m_indices, or of the name in m_names
+
+            // Face statements only.
+            size_t              m_vertex_index_count;       // number of vertex indices of the face
+            size_t              m_tex_coord_index_count;    // number of texture coordinate indices of the face
+            size_t              m_normal_index_count;       // number of normal indices of the face
+            size_t              m_vertex_count;             // number of vertices defined in the chunk before the face
+            size_t              m_tex_coord_count;          // number of texture coordinates defined in the chunk before the face
+            size_t              m_normal_count;             // number of normals defined in the chunk before the face
+        };
+
+        vector<char>            m_text;
+        bool                    m_parsed;
+        size_t                  m_line_count;
+        bool                    m_parse_error;
+        size_t                  m_parse_error_line;         // relative to the beginning of the chunk
+
+        vector<Vector3d>        m_vertices;
+        vector<Vector2d>        m_tex_coords;
+        vector<Vector3d>        m_normals;
+        vector<Statement>       m_statements;
+        vector<long>            m_indices;
+        vector<string>          m_names;
+
+        void parse(const OBJMeshFileLexer::ParsingMode parsing_mode)
+        {
+            assert(!m_text.empty());
+
+            m_parsed = false;
+            m_line_count = 0;
+            m_parse_error = false;
+            m_parse_error_line = 0;
+
+            clear_keep_memory(m_vertices);
+            clear_keep_memory(m_tex_coords);
+            clear_keep_memory(m_normals);
+            clear_keep_memory(m_statements);
+            clear_keep_memory(m_indices);
+            m_names.clear();
+
+            OBJMeshFileLexer lexer(parsing_mode);
+            lexer.open(&m_text[0], &m_text[0] + m_text.size());
+
+            try
+            {
+                StatementParser<Chunk> parser(lexer, *this);
+                parser.parse();
+
+                // The last line number is the one of the empty line at the end of the chunk.
+                m_line_count = lexer.get_line_number() - 1;
+                lexer.close();
+            }
+            catch (const OBJMeshFileReader::ExceptionParseError& e)
+            {
+                // Parse errors are reported once the statements that precede them are replayed.
+                m_parse_error = true;
+                m_parse_error_line = e.m_line;
+            }
+
+            m_parsed = true;
+        }
+
+        void on_v_statement(const Vector3d& v)
+        {
+            m_vertices.push_back(v);
+        }
+
+        void on_vt_statement(const Vector2d& v)
+        {
+            m_tex_coords.push_back(v);
+        }
+
+        void on_vn_statement(const Vector3d& n)
+        {
+            m_normals.push_back(n);
+        }
+
+        void on_f_statement(
+            const vector<long>& vertex_indices,
+            const vector<long>& tex_coord_indices,
+            const vector<long>& normal_indices,
+            const size_t        line)
+        {
+            Statement statement;
+            statement.m_type = Statement::Face;
+            statement.m_line = line;
+            statement.m_index = m_indices.size();
+            statement.m_vertex_index_count = vertex_indices.size();
+            statement.m_tex_coord_index_count = tex_coord_indices.size();
+            statement.m_normal_index_count = normal_indices.size();
+            statement.m_vertex_count = m_vertices.size();
+            statement.m_tex_coord_count = m_tex_coords.size();
+            statement.m_normal_count = m_normals.size();
+            m_statements.push_back(statement);
+
+            m_indices.insert(m_indices.end(), vertex_indices.begin(), vertex_indices.end());
+            m_indices.insert(m_indices.end(), tex_coord_indices.begin(), tex_coord_indices.end());
+            m_indices.insert(m_indices.end(), normal_indices.begin(), normal_indices.end());
+        }
+
+        void on_o_g_statement(const string& name)
+        {
+            push_named_statement(Statement::ObjectOrGroup, name);
+        }
+
+        void on_usemtl_statement(const string& name)
+        {
+            push_named_statement(Statement::UseMaterial, name);
+        }
+
+        void push_named_statement(const Statement::Type type, const string& name)
+        {
+            Statement statement;
+            statement.m_type = type;
+            statement.m_line = 0;
+            statement.m_index = m_names.size();
+            m_statements.push_back(statement);
+
+            m_names.push_back(name);
+        }
+    };
+
+    class ChunkParsingJob
+      : public IJob
+    {
+      public:
+        ChunkParsingJob(
+            Chunk&                                  chunk,
+            const OBJMeshFileLexer::ParsingMode     parsing_mode)
+          : m_chunk(chunk)
+          , m_parsing_mode(parsing_mode)
+        {
+        }
+
+        virtual void execute(const size_t thread_index) APPLESEED_OVERRIDE
+        {
+            m_chunk.parse(m_parsing_mode);
+        }
+
+      private:
+        Chunk&                                      m_chunk;
+        const OBJMeshFileLexer::ParsingMode         m_parsing_mode;
+    };
+
+    // Read about chunk_size bytes from a file into a chunk, stopping at the end of a line.
+    // The characters read past the end of the last line are kept in leftover for the next chunk.
+    // Return true if the end of the file was reached.
+    bool read_chunk(
+        BufferedFile&   file,
+        const size_t    chunk_size,
+        vector<char>&   leftover,
+        vector<char>&   chunk)
+    {
+        chunk.swap(leftover);
+        leftover.clear();
+
+        while (true)
+        {
+            const size_t size = chunk.size();
+            chunk.resize(size + chunk_size);
+
+            const size_t bytes_read = file.read(&chunk[size], chunk_size);
+            chunk.resize(size + bytes_read);
+
+            if (bytes_read < chunk_size)
+                return true;
+
+            for (size_t i = chunk.size(); i > size; --i)
+            {
+                if (chunk[i - 1] == '\n')
+                {
+                    leftover.assign(chunk.begin() + i, chunk.end());
+                    chunk.resize(i);
+                    return false;
+                }
+            }
+
+            // No end of line found: the chunk must grow.
+        }
+    }
 }
 
 struct OBJMeshFileReader::Impl
 {
     const int               m_options;
     IMeshBuilder&           m_builder;
-    OBJMeshFileLexer        m_lexer;
 
     // Current state.
     bool                    m_inside_mesh_def;              // currently inside a mesh definition?
@@ -79,7 +569,7 @@ struct OBJMeshFileReader::Impl
     vector<size_t>          m_tex_coord_index_mapping;
     vector<size_t>          m_normal_index_mapping;
 
-    // Temporary vectors for collecting indices while parsing face statements.
+    // Temporary vectors for collecting indices of the current face.
     vector<size_t>          m_face_vertex_indices;
     vector<size_t>          m_face_tex_coord_indices;
     vector<size_t>          m_face_normal_indices;
@@ -90,199 +580,225 @@ struct OBJMeshFileReader::Impl
         IMeshBuilder&       builder)
       : m_options(options)
       , m_builder(builder)
-      , m_lexer(
-            (options & FavorSpeedOverPrecision)
-                ? OBJMeshFileLexer::Fast
-                : OBJMeshFileLexer::Precise)
       , m_inside_mesh_def(false)
       , m_current_material_slot_index(0)
     {
     }
 
-    // Close the input file and throw an ExceptionParseError exception.
-    void parse_error()
+    OBJMeshFileLexer::ParsingMode get_parsing_mode() const
     {
-        const size_t line_number = m_lexer.get_line_number();
+        return
+            (m_options & FavorSpeedOverPrecision)
+                ? OBJMeshFileLexer::Fast
+                : OBJMeshFileLexer::Precise;
+    }
 
-        m_lexer.close();
+    void parse_file(const string& filename)
+    {
+        OBJMeshFileLexer lexer(get_parsing_mode());
 
-        throw ExceptionParseError(line_number);
+        // Open the input file.
+        if (!lexer.open(filename))
+            throw ExceptionIOError();
+
+        // Parse the file.
+        StatementParser<Impl> parser(lexer, *this);
+        parser.parse();
+        end_file();
+
+        // Close the input file.
+        lexer.close();
     }
 
-    void parse_file()
+    void parse_file_concurrently(
+        const string&       filename,
+        const size_t        thread_count,
+        const size_t        chunk_size)
     {
-        while (true)
-        {
-            m_lexer.eat_blanks();
+        assert(thread_count > 0);
+        assert(chunk_size > 0);
 
-            // Handle end of file.
-            if (m_lexer.is_eof())
-                break;
+        BufferedFile file(
+            filename.c_str(),
+            BufferedFile::TextType,
+            BufferedFile::ReadMode);
 
-            // Handle empty lines.
-            if (m_lexer.is_eol())
-            {
-                m_lexer.accept_newline();
-                continue;
-            }
+        if (!file.is_open())
+            throw ExceptionIOError();
 
-            const char* keyword;
-            size_t keyword_length;
+        // Worker threads are only started if the file spans more than one chunk.
+        Logger logger;
+        JobQueue job_queue;
+        auto_ptr<JobManager> job_manager;
 
-            m_lexer.accept_string(&keyword, &keyword_length);
+        const OBJMeshFileLexer::ParsingMode parsing_mode = get_parsing_mode();
+        vector<Chunk> chunks(thread_count);
+        vector<char> leftover;
+        size_t line_offset = 0;
+        bool eof = false;
 
-            if (keyword_length == 1)
+        while (!eof)
+        {
+            // Read one chunk per thread.
+            size_t chunk_count = 0;
+            while (chunk_count < thread_count && !eof)
             {
-                switch (keyword[0])
-                {
-                  case 'f':
-                    parse_f_statement();
-                    break;
-
-                  case 'g':
-                  case 'o':
-                    parse_o_g_statement();
-                    break;
-
-                  case 'v':
-                    parse_v_statement();
-                    break;
+                eof = read_chunk(file, chunk_size, leftover, chunks[chunk_count].m_text);
 
-                  default:
-                    // Ignore unknown or unhandled statements.
-                    m_lexer.eat_line();
-                    continue;
-                }
+                if (!chunks[chunk_count].m_text.empty())
+                    ++chunk_count;
             }
-            else if (keyword_length == 2)
+
+            // Parse the chunks.
+            if (chunk_count > 1)
             {
-                switch (keyword[0] * 256 + keyword[1])
+                if (job_manager.get() == 0)
                 {
-                  case 'v' * 256 + 'n':
-                    parse_vn_statement();
-                    break;
+                    job_manager.reset(
+                        new JobManager(
+                            logger,
+                            job_queue,
+                            thread_count,
+                            JobManager::KeepRunningOnEmptyQueue));
+                    job_manager->start();
+                }
 
-                  case 'v' * 256 + 't':
-                    parse_vt_statement();
-                    break;
+                for (size_t i = 0; i < chunk_count; ++i)
+                    job_queue.schedule(new ChunkParsingJob(chunks[i], parsing_mode));
 
-                  default:
-                    // Ignore unknown or unhandled statements.
-                    m_lexer.eat_line();
-                    continue;
-                }
-            }
-            else if (strncmp(keyword, "usemtl", keyword_length) == 0)
-            {
-                parse_usemtl_statement();
+                job_queue.wait_until_completion();
             }
-            else
+            else if (chunk_count == 1)
+                chunks[0].parse(parsing_mode);
+
+            // Process their statements in file order.
+            for (size_t i = 0; i < chunk_count; ++i)
             {
-                // Ignore unknown or unhandled statements.
-                m_lexer.eat_line();
-                continue;
+                replay_chunk(chunks[i], line_offset);
+                line_offset += chunks[i].m_line_count;
             }
-
-            m_lexer.eat_blanks();
-            m_lexer.accept_newline();
         }
 
-        // End the definition of the last object.
-        if (m_inside_mesh_def)
-            m_builder.end_mesh();
+        end_file();
     }
 
-    void parse_f_statement()
+    void replay_chunk(const Chunk& chunk, const size_t line_offset)
     {
-        clear_keep_memory(m_face_vertex_indices);
-        clear_keep_memory(m_face_tex_coord_indices);
-        clear_keep_memory(m_face_normal_indices);
+        // The parsing job was terminated by an exception other than a parse error.
+        if (!chunk.m_parsed)
+            throw ExceptionIOError();
 
-        while (true)
-        {
-            m_lexer.eat_blanks();
+        const size_t vertex_base = m_vertices.size();
+        const size_t tex_coord_base = m_tex_coords.size();
+        const size_t normal_base = m_normals.size();
 
-            if (m_lexer.is_eol())
-                break;
+        m_vertices.insert(m_vertices.end(), chunk.m_vertices.begin(), chunk.m_vertices.end());
+        m_tex_coords.insert(m_tex_coords.end(), chunk.m_tex_coords.begin(), chunk.m_tex_coords.end());
+        m_normals.insert(m_normals.end(), chunk.m_normals.begin(), chunk.m_normals.end());
 
-            //
-            // Recognized (epsilon)
-            // Accept n
-            //
+        const size_t statement_count = chunk.m_statements.size();
 
+        for (size_t i = 0; i < statement_count; ++i)
+        {
+            const Chunk::Statement& statement = chunk.m_statements[i];
+
+            switch (statement.m_type)
             {
-                const long n = m_lexer.accept_long();
-                const size_t v = fix_index(n, m_vertices.size());
-                m_face_vertex_indices.push_back(v);
-            }
+              case Chunk::Statement::Face:
+                {
+                    const long* indices = first_or_null(chunk.m_indices);
+                    const long* vertex_indices = indices ? indices + statement.m_index : 0;
+                    const long* tex_coord_indices = indices ? vertex_indices + statement.m_vertex_index_count : 0;
+                    const long* normal_indices = indices ? tex_coord_indices + statement.m_tex_coord_index_count : 0;
+
+                    insert_face(
+                        vertex_indices,
+                        statement.m_vertex_index_count,
+                        tex_coord_indices,
+                        statement.m_tex_coord_index_count,
+                        normal_indices,
+                        statement.m_normal_index_count,
+                        line_offset + statement.m_line,
+                        vertex_base + statement.m_vertex_count,
+                        tex_coord_base + statement.m_tex_coord_count,
+                        normal_base + statement.m_normal_count);
+                }
+                break;
 
-            //
-            // Recognized n
-            // Accept (epsilon), /
-            //
+              case Chunk::Statement::ObjectOrGroup:
+                on_o_g_statement(chunk.m_names[statement.m_index]);
+                break;
 
-            {
-                const unsigned char c = m_lexer.get_char();
-                if (m_lexer.is_space(c))
-                    continue;
-                else if (c == '/')
-                    m_lexer.next_char();
-                else parse_error();
+              case Chunk::Statement::UseMaterial:
+                on_usemtl_statement(chunk.m_names[statement.m_index]);
+                break;
+
+              assert_otherwise;
             }
+        }
 
-            //
-            // Recognized n/
-            // Accept /, n
-            //
+        if (chunk.m_parse_error)
+            throw ExceptionParseError(line_offset + chunk.m_parse_error_line);
+    }
 
-            {
-                const unsigned char c = m_lexer.get_char();
-                if (c == '/')
-                {
-                    m_lexer.next_char();
-                    goto skip;
-                }
-                else
-                {
-                    const long n = m_lexer.accept_long();
-                    const size_t vt = fix_index(n, m_tex_coords.size());
-                    m_face_tex_coord_indices.push_back(vt);
-                }
-            }
+    void end_file()
+    {
+        // End the definition of the last object.
+        if (m_inside_mesh_def)
+            m_builder.end_mesh();
+    }
 
-            //
-            // Recognized n/n
-            // Accept (epsilon), /
-            //
+    void on_v_statement(const Vector3d& v)
+    {
+        m_vertices.push_back(v);
+    }
 
-            {
-                const unsigned char c = m_lexer.get_char();
-                if (m_lexer.is_space(c))
-                    continue;
-                else if (c == '/')
-                    m_lexer.next_char();
-                else parse_error();
-            }
+    void on_vt_statement(const Vector2d& v)
+    {
+        m_tex_coords.push_back(v);
+    }
 
-          skip:
+    void on_vn_statement(const Vector3d& n)
+    {
+        m_normals.push_back(n);
+    }
 
-            //
-            // Recognized n//, n/n/
-            // Accept (epsilon), n
-            //
+    void on_f_statement(
+        const vector<long>& vertex_indices,
+        const vector<long>& tex_coord_indices,
+        const vector<long>& normal_indices,
+        const size_t        line)
+    {
+        insert_face(
+            first_or_null(vertex_indices),
+            vertex_indices.size(),
+            first_or_null(tex_coord_indices),
+            tex_coord_indices.size(),
+            first_or_null(normal_indices),
+            normal_indices.size(),
+            line,
+            m_vertices.size(),
+            m_tex_coords.size(),
+            m_normals.size());
+    }
 
-            {
-                const unsigned char c = m_lexer.get_char();
-                if (m_lexer.is_space(c))
-                    continue;
-                else
-                {
-                    const long n = m_lexer.accept_long();
-                    const size_t vn = fix_index(n, m_normals.size());
-                    m_face_normal_indices.push_back(vn);
-                }
-            }
-        }
+    // Insert a face given by indices as they appear in the file. The vertex, texture
+    // coordinate and normal counts are those at the point where the face is defined.
+    void insert_face(
+        const long*         vertex_indices,
+        const size_t        vertex_index_count,
+        const long*         tex_coord_indices,
+        const size_t        tex_coord_index_count,
+        const long*         normal_indices,
+        const size_t        normal_index_count,
+        const size_t        line,
+        const size_t        vertex_count,
+        const size_t        tex_coord_count,
+        const size_t        normal_count)
+    {
+        fix_indices(vertex_indices, vertex_index_count, vertex_count, line, m_face_vertex_indices);
+        fix_indices(tex_coord_indices, tex_coord_index_count, tex_coord_count, line, m_face_tex_coord_indices);
+        fix_indices(normal_indices, normal_index_count, normal_count, line, m_face_normal_indices);
 
         // Check whether the face is well-formed.
         const size_t vc = m_face_vertex_indices.size();
@@ -302,31 +818,43 @@ struct OBJMeshFileReader::Impl
         {
             // The face is ill-formed, ignore it or abort parsing.
             if (m_options & StopOnInvalidFaceDef)
-                throw ExceptionInvalidFaceDef(m_lexer.get_line_number());
+                throw ExceptionInvalidFaceDef(line);
         }
     }
 
+    static void fix_indices(
+        const long*         indices,
+        const size_t        index_count,
+        const size_t        count,
+        const size_t        line,
+        vector<size_t>&     fixed_indices)
+    {
+        clear_keep_memory(fixed_indices);
+
+        for (size_t i = 0; i < index_count; ++i)
+            fixed_indices.push_back(fix_index(indices[i], count, line));
+    }
+
     // Convert 1-based indices (including negative indices) to 0-based indices.
-    size_t fix_index(const long index, const size_t count)
+    static size_t fix_index(const long index, const size_t count, const size_t line)
     {
         if (index > 0)
         {
             const size_t i = static_cast<size_t>(index);
             if (i > count)
-                parse_error();
+                throw ExceptionParseError(line);
             return i - 1;
         }
         else if (index < 0)
         {
             const size_t i = static_cast<size_t>(-index);
             if (i > count)
-                parse_error();
+                throw ExceptionParseError(line);
             return count - i;
         }
         else
         {
-            parse_error();
-            return 0;       // keep the compiler happy
+            throw ExceptionParseError(line);
         }
     }
 
@@ -417,11 +945,8 @@ struct OBJMeshFileReader::Impl
             indices[i] = mapping[indices[i]];
     }
 
-    void parse_o_g_statement()
+    void on_o_g_statement(const string& upcoming_mesh_name)
     {
-        // Retrieve the name of the upcoming mesh.
-        const string upcoming_mesh_name = parse_compound_identifier();
-
         // Start a new mesh only if the name of the object or group actually changes.
         if (upcoming_mesh_name != m_current_mesh_name)
         {
@@ -440,92 +965,11 @@ struct OBJMeshFileReader::Impl
         }
     }
 
-    string parse_compound_identifier()
-    {
-        string identifier;
-
-        m_lexer.eat_blanks();
-
-        while (!m_lexer.is_eol())
-        {
-            const char* token;
-            size_t token_length;
-
-            m_lexer.accept_string(&token, &token_length);
-            m_lexer.eat_blanks();
-
-            if (!identifier.empty())
-                identifier += ' ';
-
-            identifier.append(token, token_length);
-        }
-
-        return identifier;
-    }
-
-    void parse_v_statement()
-    {
-        Vector3d v;
-
-        m_lexer.eat_blanks();
-        v.x = m_lexer.accept_double();
-
-        m_lexer.eat_blanks();
-        v.y = m_lexer.accept_double();
-
-        m_lexer.eat_blanks();
-        v.z = m_lexer.accept_double();
-
-        m_lexer.eat_blanks();
-
-        if (!m_lexer.is_eol())
-            m_lexer.accept_double();
-
-        m_vertices.push_back(v);
-    }
-
-    void parse_vt_statement()
-    {
-        Vector2d v;
-
-        m_lexer.eat_blanks();
-        v.x = m_lexer.accept_double();
-
-        m_lexer.eat_blanks();
-        v.y = m_lexer.accept_double();
-
-        m_lexer.eat_blanks();
-
-        if (!m_lexer.is_eol())
-            m_lexer.accept_double();
-
-        m_tex_coords.push_back(v);
-    }
-
-    void parse_vn_statement()
-    {
-        Vector3d n;
-
-        m_lexer.eat_blanks();
-        n.x = m_lexer.accept_double();
-
-        m_lexer.eat_blanks();
-        n.y = m_lexer.accept_double();
-
-        m_lexer.eat_blanks();
-        n.z = m_lexer.accept_double();
-
-        m_normals.push_back(n);
-    }
-
-    void parse_usemtl_statement()
+    void on_usemtl_statement(const string& material_slot_name)
     {
         // Begin a mesh definition if we're not already inside one.
         ensure_mesh_def();
 
-        // Retrieve the name of the material slot.
-        const string material_slot_name = parse_compound_identifier();
-
         // Check whether this material slot has already been defined for this mesh.
         const map<string, size_t>::const_iterator& it =
             m_material_slots.find(material_slot_name);
@@ -563,22 +1007,30 @@ OBJMeshFileReader::OBJMeshFileReader(
     const int       options)
   : m_filename(filename)
   , m_options(options)
+  , m_thread_count(System::get_logical_cpu_core_count())
+  , m_chunk_size(4 * 1024 * 1024)
 {
 }
 
-void OBJMeshFileReader::read(IMeshBuilder& builder)
+void OBJMeshFileReader::set_thread_count(const size_t thread_count)
 {
-    Impl impl(m_options, builder);
+    assert(thread_count > 0);
+    m_thread_count = thread_count;
+}
 
-    // Open the input file.
-    if (!impl.m_lexer.open(m_filename))
-        throw ExceptionIOError();
+void OBJMeshFileReader::set_chunk_size(const size_t chunk_size)
+{
+    assert(chunk_size > 0);
+    m_chunk_size = chunk_size;
+}
 
-    // Parse the file.
-    impl.parse_file();
+void OBJMeshFileReader::read(IMeshBuilder& builder)
+{
+    Impl impl(m_options, builder);
 
-    // Close the input file.
-    impl.m_lexer.close();
+    if (m_options & ParseConcurrently)
+        impl.parse_file_concurrently(m_filename, m_thread_count, m_chunk_size);
+    else impl.parse_file(m_filename);
 }
 
 }   // namespace foundation
@@ -83,7 +83,8 @@ class OBJMeshFileReader
     {
         Default                 = 0,            // none of the flags below
         FavorSpeedOverPrecision = 1 << 0,       // use approximate algorithm for parsing floating-point values
-        StopOnInvalidFaceDef    = 1 << 1        // stop parsing on invalid face definitions
+        StopOnInvalidFaceDef    = 1 << 1,       // stop parsing on invalid face definitions
+        ParseConcurrently       = 1 << 2        // parse chunks of the file on multiple threads (same result as serial parsing)
     };
 
     // Constructor.
@@ -91,6 +92,11 @@ class OBJMeshFileReader
         const std::string&  filename,
         const int           options = Default);
 
+    // Set the number of threads and the size in bytes of the chunks used when parsing concurrently.
+    // By default, one thread per logical CPU core is used.
+    void set_thread_count(const size_t thread_count);
+    void set_chunk_size(const size_t chunk_size);
+
     // Read a mesh.
     virtual void read(IMeshBuilder& builder) APPLESEED_OVERRIDE;
 
@@ -99,6 +105,8 @@ class OBJMeshFileReader
 
     const std::string       m_filename;
     const int               m_options;
+    size_t                  m_thread_count;
+    size_t                  m_chunk_size;
 };
 
 }       // namespace foundation
@@ -40,15 +40,24 @@ using namespace std;
 
 BENCHMARK_SUITE(Foundation_Utility_Job)
 {
-    struct EmptyJob
+    template <size_t WorkSize>
+    struct BusyJob
       : public IJob
     {
+        volatile double m_result;
+
         virtual void execute(const size_t thread_index)
         {
+            double x = 1.0;
+
+            for (size_t i = 0; i < WorkSize; ++i)
+                x = x * 1.000001 + 0.000001;
+
+            m_result = x;
         }
     };
 
-    template <size_t ThreadCount>
+    template <size_t ThreadCount, int Flags, size_t WorkSize>
     struct Fixture
     {
         Logger      m_logger;
@@ -56,7 +65,7 @@ BENCHMARK_SUITE(Foundation_Utility_Job)
         JobManager  m_job_manager;
 
         Fixture()
-          : m_job_manager(m_logger, m_job_queue, ThreadCount, JobManager::KeepRunningOnEmptyQueue)
+          : m_job_manager(m_logger, m_job_queue, ThreadCount, JobManager::KeepRunningOnEmptyQueue | Flags)
         {
             m_job_manager.start();
         }
@@ -64,7 +73,7 @@ BENCHMARK_SUITE(Foundation_Utility_Job)
         void payload()
         {
             const size_t JobCount = 256;
-            EmptyJob jobs[JobCount];
+            BusyJob<WorkSize> jobs[JobCount];
 
             for (size_t i = 0; i < JobCount; ++i)
                 m_job_queue.schedule(&jobs[i], false);
@@ -73,12 +82,74 @@ BENCHMARK_SUITE(Foundation_Utility_Job)
         }
     };
 
-    BENCHMARK_CASE_F(SingleThreadedJobExecution, Fixture<1>)
+    const int SharedQueue = 0;
+    const int WorkStealing = JobManager::WorkStealing;
+
+    typedef Fixture<1, SharedQueue, 0> FixtureEmptyJobs1ThreadsSharedQueue;
+    typedef Fixture<2, SharedQueue, 0> FixtureEmptyJobs2ThreadsSharedQueue;
+    typedef Fixture<8, SharedQueue, 0> FixtureEmptyJobs8ThreadsSharedQueue;
+    typedef Fixture<8, WorkStealing, 0> FixtureEmptyJobs8ThreadsWorkStealing;
+    typedef Fixture<8, SharedQueue, 1000> FixtureSmallJobs8ThreadsSharedQueue;
+    typedef Fixture<8, WorkStealing, 1000> FixtureSmallJobs8ThreadsWorkStealing;
+    typedef Fixture<8, SharedQueue, 100000> FixtureLargeJobs8ThreadsSharedQueue;
+    typedef Fixture<8, WorkStealing, 100000> FixtureLargeJobs8ThreadsWorkStealing;
+    typedef Fixture<32, SharedQueue, 1000> FixtureSmallJobs32ThreadsSharedQueue;
+    typedef Fixture<32, WorkStealing, 1000> FixtureSmallJobs32ThreadsWorkStealing;
+
+    BENCHMARK_CASE_F(SingleThreadedJobExecution, FixtureEmptyJobs1ThreadsSharedQueue)
+    {
+        payload();
+    }
+
+    BENCHMARK_CASE_F(DoubleThreadedJobExecution, FixtureEmptyJobs2ThreadsSharedQueue)
+    {
+        payload();
+    }
+
+    // Empty jobs: measures the scheduling overhead only.
+
+    BENCHMARK_CASE_F(SharedQueue_8Threads_EmptyJobs, FixtureEmptyJobs8ThreadsSharedQueue)
+    {
+        payload();
+    }
+
+    BENCHMARK_CASE_F(WorkStealing_8Threads_EmptyJobs, FixtureEmptyJobs8ThreadsWorkStealing)
+    {
+        payload();
+    }
+
+    // Fine-grained jobs.
+
+    BENCHMARK_CASE_F(SharedQueue_8Threads_SmallJobs, FixtureSmallJobs8ThreadsSharedQueue)
+    {
+        payload();
+    }
+
+    BENCHMARK_CASE_F(WorkStealing_8Threads_SmallJobs, FixtureSmallJobs8ThreadsWorkStealing)
+    {
+        payload();
+    }
+
+    // Coarse-grained jobs.
+
+    BENCHMARK_CASE_F(SharedQueue_8Threads_LargeJobs, FixtureLargeJobs8ThreadsSharedQueue)
+    {
+        payload();
+    }
+
+    BENCHMARK_CASE_F(WorkStealing_8Threads_LargeJobs, FixtureLargeJobs8ThreadsWorkStealing)
+    {
+        payload();
+    }
+
+    // Fine-grained jobs on many threads.
+
+    BENCHMARK_CASE_F(SharedQueue_32Threads_SmallJobs, FixtureSmallJobs32ThreadsSharedQueue)
     {
         payload();
     }
 
-    BENCHMARK_CASE_F(DoubleThreadedJobExecution, Fixture<2>)
+    BENCHMARK_CASE_F(WorkStealing_32Threads_SmallJobs, FixtureSmallJobs32ThreadsWorkStealing)
     {
         payload();
     }
@@ -32,6 +32,7 @@
 #include "foundation/math/rng/distribution.h"
 #include "foundation/math/rng/mersennetwister.h"
 #include "foundation/math/rng/xorshift.h"
+#include "foundation/math/scalar.h"
 #include "foundation/math/vector.h"
 #include "foundation/platform/timers.h"
 #include "foundation/platform/types.h"
@@ -44,6 +45,7 @@
 
 // Standard headers.
 #include <cassert>
+#include <cmath>
 #include <cstddef>
 #include <memory>
 #include <string>
@@ -282,3 +284,115 @@ BENCHMARK_SUITE(Foundation_Math_Knn_Query)
     BENCHMARK_CASE_F(PhotonMap_K100, PhotonMapFixture<100>)  { run_queries(); }
     BENCHMARK_CASE_F(PhotonMap_K500, PhotonMapFixture<500>)  { run_queries(); }
 }
+
+BENCHMARK_SUITE(Foundation_Math_Knn_HashGrid)
+{
+    // Number of points expected within the lookup radius, as in a photon map lookup.
+    const size_t PointsPerLookup = 100;
+
+    const size_t QueryCount = 1000;
+
+    template <size_t PointCount>
+    struct BuildFixture
+    {
+        vector<Vector3f>    m_points;
+        float               m_lookup_radius;
+
+        BuildFixture()
+        {
+            MersenneTwister rng;
+
+            m_points.resize(PointCount);
+            for (size_t i = 0; i < PointCount; ++i)
+                m_points[i] = rand_vector1<Vector3f>(rng);
+
+            // Points are uniformly distributed in the unit cube.
+            m_lookup_radius =
+                pow(
+                    3.0f * PointsPerLookup / (4.0f * Pi<float>() * PointCount),
+                    1.0f / 3.0f);
+        }
+
+        void build_tree()
+        {
+            knn::Tree3f tree;
+            knn::Builder3f builder(tree);
+            builder.build<DefaultWallclockTimer>(&m_points[0], PointCount);
+        }
+
+        void build_grid()
+        {
+            knn::HashGrid3f grid;
+            knn::HashGridBuilder3f builder(grid);
+            builder.build<DefaultWallclockTimer>(&m_points[0], PointCount, 2.0f * m_lookup_radius);
+        }
+    };
+
+    template <size_t PointCount>
+    struct QueryFixture
+    {
+        vector<Vector3f>    m_query_points;
+        float               m_lookup_radius;
+        knn::Tree3f         m_tree;
+        knn::HashGrid3f     m_grid;
+        knn::Answer<float>  m_answer;
+        size_t              m_accumulator;
+
+        QueryFixture()
+          : m_answer(PointsPerLookup)
+          , m_accumulator(0)
+        {
+            BuildFixture<PointCount> build_fixture;
+            m_lookup_radius = build_fixture.m_lookup_radius;
+
+            MersenneTwister rng(42);
+            m_query_points.resize(QueryCount);
+            for (size_t i = 0; i < QueryCount; ++i)
+                m_query_points[i] = rand_vector1<Vector3f>(rng);
+
+            knn::Builder3f tree_builder(m_tree);
+            tree_builder.build<DefaultWallclockTimer>(&build_fixture.m_points[0], PointCount);
+
+            knn::HashGridBuilder3f grid_builder(m_grid);
+            grid_builder.build_move_points<DefaultWallclockTimer>(build_fixture.m_points, 2.0f * m_lookup_radius);
+        }
+
+        void query_tree()
+        {
+            const knn::Query3f query(m_tree, m_answer);
+            const float max_square_distance = square(m_lookup_radius);
+
+            for (size_t i = 0; i < QueryCount; ++i)
+            {
+                query.run(m_query_points[i], max_square_distance);
+                m_accumulator += m_answer.size();
+            }
+        }
+
+        void query_grid()
+        {
+            const knn::HashGridQuery3f query(m_grid, m_answer);
+            const float max_square_distance = square(m_lookup_radius);
+
+            for (size_t i = 0; i < QueryCount; ++i)
+            {
+                query.run(m_query_points[i], max_square_distance);
+                m_accumulator += m_answer.size();
+            }
+        }
+    };
+
+    BENCHMARK_CASE_F(BuildTree_1M, BuildFixture<1000000>)       { build_tree(); }
+    BENCHMARK_CASE_F(BuildGrid_1M, BuildFixture<1000000>)       { build_grid(); }
+    BENCHMARK_CASE_F(BuildTree_10M, BuildFixture<10000000>)     { build_tree(); }
+    BENCHMARK_CASE_F(BuildGrid_10M, BuildFixture<10000000>)     { build_grid(); }
+    BENCHMARK_CASE_F(BuildTree_50M, BuildFixture<50000000>)     { build_tree(); }
+    BENCHMARK_CASE_F(BuildGrid_50M, BuildFixture<50000000>)     { build_grid(); }
+
+    BENCHMARK_CASE_F(QueryTree_1M, QueryFixture<1000000>)       { query_tree(); }
+    BENCHMARK_CASE_F(QueryGrid_1M, QueryFixture<1000000>)       { query_grid(); }
+    BENCHMARK_CASE_F(QueryTree_10M, QueryFixture<10000000>)     { query_tree(); }
+    BENCHMARK_CASE_F(QueryGrid_10M, QueryFixture<10000000>)     { query_grid(); }
+    BENCHMARK_CASE_F(QueryTree_50M, QueryFixture<50000000>)     { query_tree(); }
+    BENCHMARK_CASE_F(QueryGrid_50M, QueryFixture<50000000>)     { query_grid(); }
+}
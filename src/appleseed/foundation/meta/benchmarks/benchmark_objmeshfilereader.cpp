@@ -0,0 +1,122 @@
+
+//
+// This source file is part of appleseed.
+// Visit http://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2010-2013 Francois Beaune, Jupiter Jazz Limited
+// Copyright (c) 2014-2017 Francois Beaune, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// appleseed.foundation headers.
+#include "foundation/mesh/meshbuilderbase.h"
+#include "foundation/mesh/objmeshfilereader.h"
+#include "foundation/utility/benchmark.h"
+
+// Boost headers.
+#include "boost/filesystem/operations.hpp"
+
+// Standard headers.
+#include <cstddef>
+#include <cstdio>
+#include <string>
+
+using namespace foundation;
+using namespace std;
+namespace bf = boost::filesystem;
+
+BENCHMARK_SUITE(Foundation_Mesh_OBJMeshFileReader)
+{
+    // Write a square grid of quads with texture coordinates and normals.
+    void write_grid_file(const char* filename, const size_t size)
+    {
+        FILE* file = fopen(filename, "wt");
+
+        if (file == 0)
+            return;
+
+        fprintf(file, "o grid\n");
+
+        for (size_t y = 0; y <= size; ++y)
+        {
+            for (size_t x = 0; x <= size; ++x)
+            {
+                const double u = static_cast<double>(x) / size;
+                const double v = static_cast<double>(y) / size;
+                fprintf(file, "v %f %f %f\n", u, 0.0, v);
+                fprintf(file, "vt %f %f\n", u, v);
+            }
+        }
+
+        fprintf(file, "vn 0.0 1.0 0.0\n");
+
+        for (size_t y = 0; y < size; ++y)
+        {
+            for (size_t x = 0; x < size; ++x)
+            {
+                const size_t v0 = y * (size + 1) + x + 1;
+                const size_t v1 = v0 + 1;
+                const size_t v2 = v1 + size + 1;
+                const size_t v3 = v0 + size + 1;
+                fprintf(
+                    file,
+                    "f %lu/%lu/1 %lu/%lu/1 %lu/%lu/1 %lu/%lu/1\n",
+                    static_cast<unsigned long>(v0), static_cast<unsigned long>(v0),
+                    static_cast<unsigned long>(v1), static_cast<unsigned long>(v1),
+                    static_cast<unsigned long>(v2), static_cast<unsigned long>(v2),
+                    static_cast<unsigned long>(v3), static_cast<unsigned long>(v3));
+            }
+        }
+
+        fclose(file);
+    }
+
+    struct Fixture
+    {
+        const string        m_filename;
+        MeshBuilderBase     m_builder;
+
+        Fixture()
+          : m_filename("unit benchmarks/outputs/benchmark_objmeshfilereader_grid.obj")
+        {
+            bf::create_directories("unit benchmarks/outputs");
+
+            // About 30 MB of text.
+            write_grid_file(m_filename.c_str(), 512);
+        }
+
+        void payload(const int options)
+        {
+            OBJMeshFileReader reader(m_filename, OBJMeshFileReader::FavorSpeedOverPrecision | options);
+            reader.read(m_builder);
+        }
+    };
+
+    BENCHMARK_CASE_F(ParseSerially, Fixture)
+    {
+        payload(OBJMeshFileReader::Default);
+    }
+
+    BENCHMARK_CASE_F(ParseConcurrently, Fixture)
+    {
+        payload(OBJMeshFileReader::ParseConcurrently);
+    }
+}
@@ -0,0 +1,153 @@
+
+//
+// This source file is part of appleseed.
+// Visit http://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2017 Francois Beaune, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// appleseed.foundation headers.
+#include "foundation/platform/types.h"
+#include "foundation/utility/arena.h"
+#include "foundation/utility/memory.h"
+#include "foundation/utility/test.h"
+
+// Standard headers.
+#include <cstddef>
+#include <cstring>
+
+using namespace foundation;
+
+TEST_SUITE(Foundation_Utility_Arena)
+{
+    TEST_CASE(Allocate_ReturnsAlignedMemory)
+    {
+        Arena arena;
+
+        void* ptr1 = arena.allocate(3);
+        void* ptr2 = arena.allocate(5);
+
+        EXPECT_TRUE(is_aligned(ptr1, 16));
+        EXPECT_TRUE(is_aligned(ptr2, 16));
+        EXPECT_NEQ(ptr1, ptr2);
+    }
+
+    TEST_CASE(Allocate_GivenMoreThanOneChunkOfAllocations_GrowsArena)
+    {
+        Arena arena;
+
+        for (size_t i = 0; i < 1024; ++i)
+        {
+            uint8* ptr = static_cast<uint8*>(arena.allocate(1024));
+            std::memset(ptr, 0xFF, 1024);
+        }
+
+        EXPECT_GT(1, arena.get_chunk_count());
+        EXPECT_EQ(1024 * 1024, arena.get_high_water_mark());
+    }
+
+    TEST_CASE(Allocate_GivenAllocationLargerThanChunk_ReturnsAlignedMemory)
+    {
+        Arena arena;
+
+        uint8* ptr = static_cast<uint8*>(arena.allocate(1024 * 1024));
+        std::memset(ptr, 0xFF, 1024 * 1024);
+
+        EXPECT_TRUE(is_aligned(ptr, 16));
+        EXPECT_EQ(2, arena.get_chunk_count());
+    }
+
+    TEST_CASE(Clear_ReusesChunks)
+    {
+        Arena arena;
+
+        for (size_t i = 0; i < 1024; ++i)
+            arena.allocate(1024);
+
+        const size_t chunk_count = arena.get_chunk_count();
+
+        arena.clear();
+
+        for (size_t i = 0; i < 1024; ++i)
+            arena.allocate(1024);
+
+        EXPECT_EQ(chunk_count, arena.get_chunk_count());
+    }
+
+    TEST_CASE(Rewind_ReturnsSameMemoryForNextAllocation)
+    {
+        Arena arena;
+        arena.allocate(16);
+
+        const Arena::Marker marker = arena.get_marker();
+        void* ptr1 = arena.allocate(16);
+        arena.rewind(marker);
+        void* ptr2 = arena.allocate(16);
+
+        EXPECT_EQ(ptr1, ptr2);
+    }
+
+    TEST_CASE(Rewind_GivenMarkerInPreviousChunk_ReturnsSameMemoryForNextAllocation)
+    {
+        Arena arena;
+        arena.allocate(16);
+
+        const Arena::Marker marker = arena.get_marker();
+        void* ptr1 = arena.allocate(16);
+        for (size_t i = 0; i < 1024; ++i)
+            arena.allocate(1024);
+        arena.rewind(marker);
+        void* ptr2 = arena.allocate(16);
+
+        EXPECT_EQ(ptr1, ptr2);
+    }
+
+    TEST_CASE(ArenaScope_RewindsArenaOnDestruction)
+    {
+        Arena arena;
+        arena.allocate(16);
+
+        void* ptr1;
+
+        {
+            ArenaScope scope(arena);
+            ptr1 = arena.allocate(16);
+        }
+
+        void* ptr2 = arena.allocate(16);
+
+        EXPECT_EQ(ptr1, ptr2);
+    }
+
+    TEST_CASE(GetHighWaterMark_AfterClear_ReturnsLargestAllocatedSize)
+    {
+        Arena arena;
+
+        arena.allocate(64);
+        arena.allocate(64);
+        arena.clear();
+        arena.allocate(32);
+
+        EXPECT_EQ(128, arena.get_high_water_mark());
+    }
+}
@@ -0,0 +1,414 @@
+
+//
+// This source file is part of appleseed.
+// Visit http://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2010-2013 Francois Beaune, Jupiter Jazz Limited
+// Copyright (c) 2014-2017 Francois Beaune, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// appleseed.foundation headers.
+#include "foundation/math/vector.h"
+#include "foundation/mesh/binarymeshfilereader.h"
+#include "foundation/mesh/binarymeshfilewriter.h"
+#include "foundation/mesh/imeshwalker.h"
+#include "foundation/mesh/irenderreadymeshbuilder.h"
+#include "foundation/mesh/meshbuilderbase.h"
+#include "foundation/platform/compiler.h"
+#include "foundation/platform/types.h"
+#include "foundation/utility/iostreamop.h"
+#include "foundation/utility/test.h"
+
+// Standard headers.
+#include <cstddef>
+#include <string>
+#include <vector>
+
+using namespace foundation;
+using namespace std;
+
+TEST_SUITE(Foundation_Mesh_BinaryMeshFileWriter)
+{
+    struct Face
+    {
+        vector<size_t>      m_vertices;
+        vector<size_t>      m_tex_coords;
+        size_t              m_material;
+    };
+
+    struct Mesh
+    {
+        string              m_name;
+        vector<Vector3d>    m_vertices;
+        vector<Vector2d>    m_tex_coords;
+        vector<string>      m_material_slots;
+        vector<Face>        m_faces;
+    };
+
+    struct MeshBuilder
+      : public MeshBuilderBase
+    {
+        vector<Mesh> m_meshes;
+
+        virtual void begin_mesh(const char* name) APPLESEED_OVERRIDE
+        {
+            m_meshes.push_back(Mesh());
+            m_meshes.back().m_name = name;
+        }
+
+        virtual size_t push_vertex(const Vector3d& v) APPLESEED_OVERRIDE
+        {
+            m_meshes.back().m_vertices.push_back(v);
+            return m_meshes.back().m_vertices.size() - 1;
+        }
+
+        virtual size_t push_tex_coords(const Vector2d& v) APPLESEED_OVERRIDE
+        {
+            m_meshes.back().m_tex_coords.push_back(v);
+            return m_meshes.back().m_tex_coords.size() - 1;
+        }
+
+        virtual size_t push_material_slot(const char* name) APPLESEED_OVERRIDE
+        {
+            m_meshes.back().m_material_slots.push_back(name);
+            return m_meshes.back().m_material_slots.size() - 1;
+        }
+
+        virtual void begin_face(const size_t vertex_count) APPLESEED_OVERRIDE
+        {
+            m_meshes.back().m_faces.push_back(Face());
+            m_meshes.back().m_faces.back().m_vertices.resize(vertex_count);
+            m_meshes.back().m_faces.back().m_tex_coords.resize(vertex_count);
+        }
+
+        virtual void set_face_vertices(const size_t vertices[]) APPLESEED_OVERRIDE
+        {
+            Face& face = m_meshes.back().m_faces.back();
+            for (size_t i = 0; i < face.m_vertices.size(); ++i)
+                face.m_vertices[i] = vertices[i];
+        }
+
+        virtual void set_face_vertex_tex_coords(const size_t tex_coords[]) APPLESEED_OVERRIDE
+        {
+            Face& face = m_meshes.back().m_faces.back();
+            for (size_t i = 0; i < face.m_tex_coords.size(); ++i)
+                face.m_tex_coords[i] = tex_coords[i];
+        }
+
+        virtual void set_face_material(const size_t material) APPLESEED_OVERRIDE
+        {
+            m_meshes.back().m_faces.back().m_material = material;
+        }
+    };
+
+    struct MeshWalker
+      : public IMeshWalker
+    {
+        const Mesh& m_mesh;
+
+        explicit MeshWalker(const Mesh& mesh)
+          : m_mesh(mesh)
+        {
+        }
+
+        virtual const char* get_name() const APPLESEED_OVERRIDE
+        {
+            return m_mesh.m_name.c_str();
+        }
+
+        virtual size_t get_vertex_count() const APPLESEED_OVERRIDE
+        {
+            return m_mesh.m_vertices.size();
+        }
+
+        virtual Vector3d get_vertex(const size_t i) const APPLESEED_OVERRIDE
+        {
+            return m_mesh.m_vertices[i];
+        }
+
+        virtual size_t get_vertex_normal_count() const APPLESEED_OVERRIDE
+        {
+            return 0;
+        }
+
+        virtual Vector3d get_vertex_normal(const size_t i) const APPLESEED_OVERRIDE
+        {
+            return Vector3d();
+        }
+
+        virtual size_t get_tex_coords_count() const APPLESEED_OVERRIDE
+        {
+            return m_mesh.m_tex_coords.size();
+        }
+
+        virtual Vector2d get_tex_coords(const size_t i) const APPLESEED_OVERRIDE
+        {
+            return m_mesh.m_tex_coords[i];
+        }
+
+        virtual size_t get_material_slot_count() const APPLESEED_OVERRIDE
+        {
+            return m_mesh.m_material_slots.size();
+        }
+
+        virtual const char* get_material_slot(const size_t i) const APPLESEED_OVERRIDE
+        {
+            return m_mesh.m_material_slots[i].c_str();
+        }
+
+        virtual size_t get_face_count() const APPLESEED_OVERRIDE
+        {
+            return m_mesh.m_faces.size();
+        }
+
+        virtual size_t get_face_vertex_count(const size_t face_index) const APPLESEED_OVERRIDE
+        {
+            return m_mesh.m_faces[face_index].m_vertices.size();
+        }
+
+        virtual size_t get_face_vertex(const size_t face_index, const size_t vertex_index) const APPLESEED_OVERRIDE
+        {
+            return m_mesh.m_faces[face_index].m_vertices[vertex_index];
+        }
+
+        virtual size_t get_face_vertex_normal(const size_t face_index, const size_t vertex_index) const APPLESEED_OVERRIDE
+        {
+            return None;
+        }
+
+        virtual size_t get_face_tex_coords(const size_t face_index, const size_t vertex_index) const APPLESEED_OVERRIDE
+        {
+            return m_mesh.m_faces[face_index].m_tex_coords[vertex_index];
+        }
+
+        virtual size_t get_face_material(const size_t face_index) const APPLESEED_OVERRIDE
+        {
+            return m_mesh.m_faces[face_index].m_material;
+        }
+    };
+
+    // Create a mesh made of a single quad.
+    Mesh create_mesh(const string& name)
+    {
+        Mesh mesh;
+        mesh.m_name = name;
+
+        mesh.m_vertices.push_back(Vector3d(0.0, 0.0, 0.0));
+        mesh.m_vertices.push_back(Vector3d(1.0, 0.0, 0.0));
+        mesh.m_vertices.push_back(Vector3d(1.0, 1.0, 0.0));
+        mesh.m_vertices.push_back(Vector3d(0.0, 1.0, 0.0));
+
+        mesh.m_tex_coords.push_back(Vector2d(0.0, 0.0));
+        mesh.m_tex_coords.push_back(Vector2d(1.0, 0.0));
+        mesh.m_tex_coords.push_back(Vector2d(1.0, 1.0));
+        mesh.m_tex_coords.push_back(Vector2d(0.0, 1.0));
+
+        mesh.m_material_slots.push_back("material");
+
+        Face face;
+        for (size_t i = 0; i < 4; ++i)
+        {
+            face.m_vertices.push_back(i);
+            face.m_tex_coords.push_back(i);
+        }
+        face.m_material = 0;
+        mesh.m_faces.push_back(face);
+
+        return mesh;
+    }
+
+    TEST_CASE(WriteTwoObjectsToFile)
+    {
+        const Mesh mesh1 = create_mesh("mesh1");
+        const Mesh mesh2 = create_mesh("mesh2");
+
+        {
+            BinaryMeshFileWriter writer("unit tests/outputs/test_binarymeshfilewriter_twoobjects.binarymesh");
+            MeshWalker walker1(mesh1);
+            writer.write(walker1);
+            MeshWalker walker2(mesh2);
+            writer.write(walker2);
+        }
+
+        BinaryMeshFileReader reader("unit tests/outputs/test_binarymeshfilewriter_twoobjects.binarymesh");
+        MeshBuilder builder;
+        reader.read(builder);
+
+        ASSERT_EQ(2, builder.m_meshes.size());
+
+        const Mesh& output_mesh2 = builder.m_meshes[1];
+        EXPECT_EQ(mesh2.m_name, output_mesh2.m_name);
+        ASSERT_EQ(mesh2.m_vertices.size(), output_mesh2.m_vertices.size());
+        EXPECT_SEQUENCE_EQ(mesh2.m_vertices.size(), &mesh2.m_vertices[0], &output_mesh2.m_vertices[0]);
+        ASSERT_EQ(1, output_mesh2.m_faces.size());
+        EXPECT_EQ(4, output_mesh2.m_faces[0].m_vertices.size());
+    }
+
+    TEST_CASE(WriteTwoRenderReadyObjectsToFile)
+    {
+        const Mesh mesh1 = create_mesh("mesh1");
+        const Mesh mesh2 = create_mesh("mesh2");
+
+        {
+            BinaryMeshFileWriter writer(
+                "unit tests/outputs/test_binarymeshfilewriter_tworenderreadyobjects.binarymesh",
+                BinaryMeshFileWriter::RenderReady);
+            MeshWalker walker1(mesh1);
+            writer.write(walker1);
+            MeshWalker walker2(mesh2);
+            writer.write(walker2);
+        }
+
+        BinaryMeshFileReader reader("unit tests/outputs/test_binarymeshfilewriter_tworenderreadyobjects.binarymesh");
+        MeshBuilder builder;
+        reader.read(builder);
+
+        ASSERT_EQ(2, builder.m_meshes.size());
+
+        for (size_t i = 0; i < 2; ++i)
+        {
+            const Mesh& mesh = i == 0 ? mesh1 : mesh2;
+            const Mesh& output_mesh = builder.m_meshes[i];
+
+            EXPECT_EQ(mesh.m_name, output_mesh.m_name);
+            ASSERT_EQ(mesh.m_vertices.size(), output_mesh.m_vertices.size());
+            EXPECT_SEQUENCE_EQ(mesh.m_vertices.size(), &mesh.m_vertices[0], &output_mesh.m_vertices[0]);
+            ASSERT_EQ(mesh.m_tex_coords.size(), output_mesh.m_tex_coords.size());
+            EXPECT_SEQUENCE_EQ(mesh.m_tex_coords.size(), &mesh.m_tex_coords[0], &output_mesh.m_tex_coords[0]);
+            ASSERT_EQ(1, output_mesh.m_material_slots.size());
+            EXPECT_EQ(mesh.m_material_slots[0], output_mesh.m_material_slots[0]);
+
+            // The quad must have been split into two triangles.
+            ASSERT_EQ(2, output_mesh.m_faces.size());
+
+            for (size_t j = 0; j < 2; ++j)
+            {
+                const Face& face = output_mesh.m_faces[j];
+                ASSERT_EQ(3, face.m_vertices.size());
+                EXPECT_SEQUENCE_EQ(3, &face.m_vertices[0], &face.m_tex_coords[0]);
+                EXPECT_EQ(0, face.m_material);
+            }
+        }
+    }
+
+    struct RenderReadyMesh
+    {
+        string              m_name;
+        vector<float>       m_vertices;
+        vector<float>       m_tex_coords;
+        vector<uint32>      m_triangles;
+    };
+
+    class RenderReadyMeshBuilder
+      : public IRenderReadyMeshBuilder
+    {
+      public:
+        vector<RenderReadyMesh> m_meshes;
+
+        virtual void begin_mesh(const char* name) APPLESEED_OVERRIDE
+        {
+            m_meshes.push_back(RenderReadyMesh());
+            m_meshes.back().m_name = name;
+        }
+
+        virtual void push_material_slot(const char*) APPLESEED_OVERRIDE
+        {
+        }
+
+        virtual float* allocate_vertices(const size_t count) APPLESEED_OVERRIDE
+        {
+            return allocate(m_meshes.back().m_vertices, count * 3);
+        }
+
+        virtual float* allocate_vertex_normals(const size_t count) APPLESEED_OVERRIDE
+        {
+            return allocate(m_vertex_normals, count * 3);
+        }
+
+        virtual float* allocate_tex_coords(const size_t count) APPLESEED_OVERRIDE
+        {
+            return allocate(m_meshes.back().m_tex_coords, count * 2);
+        }
+
+        virtual uint32* allocate_triangles(const size_t count) APPLESEED_OVERRIDE
+        {
+            return allocate(m_meshes.back().m_triangles, count * 10);
+        }
+
+        virtual void end_mesh() APPLESEED_OVERRIDE
+        {
+        }
+
+      private:
+        vector<float>       m_vertex_normals;
+
+        template <typename T>
+        static T* allocate(vector<T>& v, const size_t size)
+        {
+            v.resize(size);
+            return size > 0 ? &v[0] : 0;
+        }
+    };
+
+    TEST_CASE(ReadRenderReadyObjectsDirectly)
+    {
+        const Mesh mesh = create_mesh("mesh");
+
+        {
+            BinaryMeshFileWriter writer(
+                "unit tests/outputs/test_binarymeshfilewriter_renderreadyobject.binarymesh",
+                BinaryMeshFileWriter::RenderReady);
+            MeshWalker walker(mesh);
+            writer.write(walker);
+        }
+
+        BinaryMeshFileReader reader("unit tests/outputs/test_binarymeshfilewriter_renderreadyobject.binarymesh");
+        RenderReadyMeshBuilder builder;
+        ASSERT_TRUE(reader.read_render_ready(builder));
+
+        ASSERT_EQ(1, builder.m_meshes.size());
+
+        const RenderReadyMesh& output_mesh = builder.m_meshes[0];
+        EXPECT_EQ(mesh.m_name, output_mesh.m_name);
+        ASSERT_EQ(mesh.m_vertices.size() * 3, output_mesh.m_vertices.size());
+        EXPECT_EQ(static_cast<float>(mesh.m_vertices[2].y), output_mesh.m_vertices[2 * 3 + 1]);
+        ASSERT_EQ(mesh.m_tex_coords.size() * 2, output_mesh.m_tex_coords.size());
+        ASSERT_EQ(2 * 10, output_mesh.m_triangles.size());
+        EXPECT_EQ(0, output_mesh.m_triangles[9]);
+    }
+
+    TEST_CASE(ReadRenderReadyObjects_GivenNonRenderReadyFile_ReturnsFalse)
+    {
+        {
+            const Mesh mesh = create_mesh("mesh");
+            BinaryMeshFileWriter writer("unit tests/outputs/test_binarymeshfilewriter_nonrenderreadyobject.binarymesh");
+            MeshWalker walker(mesh);
+            writer.write(walker);
+        }
+
+        BinaryMeshFileReader reader("unit tests/outputs/test_binarymeshfilewriter_nonrenderreadyobject.binarymesh");
+        RenderReadyMeshBuilder builder;
+
+        EXPECT_FALSE(reader.read_render_ready(builder));
+        EXPECT_TRUE(builder.m_meshes.empty());
+    }
+}
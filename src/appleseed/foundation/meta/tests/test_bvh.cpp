@@ -30,14 +30,24 @@
 // appleseed.foundation headers.
 #include "foundation/math/aabb.h"
 #include "foundation/math/bvh.h"
+#include "foundation/math/intersection/rayaabb.h"
 #include "foundation/math/ray.h"
+#include "foundation/math/rng/distribution.h"
+#include "foundation/math/rng/mersennetwister.h"
 #include "foundation/math/vector.h"
+#include "foundation/platform/timers.h"
+#include "foundation/platform/types.h"
 #include "foundation/utility/alignedvector.h"
 #include "foundation/utility/iostreamop.h"
+#include "foundation/utility/job/jobmanager.h"
+#include "foundation/utility/job/jobqueue.h"
+#include "foundation/utility/log.h"
 #include "foundation/utility/test.h"
 
 // Standard headers.
+#include <algorithm>
 #include <cstddef>
+#include <limits>
 #include <vector>
 
 using namespace foundation;
@@ -119,6 +129,404 @@ TEST_SUITE(Foundation_Math_BVH_SpatialBuilder)
     }
 }
 
+TEST_SUITE(Foundation_Math_BVH_ParallelBuild)
+{
+    typedef AlignedVector<bvh::Node<AABB3d> > NodeVector;
+    typedef vector<AABB3d> AABBVector;
+
+    const size_t ThreadCount = 4;
+
+    struct Tree
+      : public bvh::Tree<NodeVector>
+    {
+        const NodeVector& get_nodes() const
+        {
+            return m_nodes;
+        }
+    };
+
+    class ItemHandler
+    {
+      public:
+        explicit ItemHandler(const AABBVector& bboxes)
+          : m_bboxes(bboxes)
+        {
+        }
+
+        double get_bbox_grow_eps() const
+        {
+            return 1.0e-9;
+        }
+
+        AABB3d clip(
+            const size_t    item_index,
+            const size_t    dimension,
+            const double    slab_min,
+            const double    slab_max) const
+        {
+            AABB3d bbox = m_bboxes[item_index];
+
+            if (bbox.min[dimension] < slab_min)
+                bbox.min[dimension] = slab_min;
+
+            if (bbox.max[dimension] > slab_max)
+                bbox.max[dimension] = slab_max;
+
+            return bbox;
+        }
+
+        bool intersect(
+            const size_t    item_index,
+            const AABB3d&   bbox) const
+        {
+            return AABB3d::overlap(m_bboxes[item_index], bbox);
+        }
+
+      private:
+        const AABBVector& m_bboxes;
+    };
+
+    struct Fixture
+    {
+        AABBVector  m_bboxes;
+        Logger      m_logger;
+        JobQueue    m_job_queue;
+        JobManager  m_job_manager;
+
+        Fixture()
+          : m_job_manager(m_logger, m_job_queue, ThreadCount, JobManager::KeepRunningOnEmptyQueue)
+        {
+            // Generate a set of random, long and overlapping boxes that call for spatial splits.
+            MersenneTwister rng;
+            for (size_t i = 0; i < 2000; ++i)
+            {
+                Vector3d center;
+                center.x = rand_double1(rng, -10.0, 10.0);
+                center.y = rand_double1(rng, -10.0, 10.0);
+                center.z = rand_double1(rng, -10.0, 10.0);
+                Vector3d extent;
+                extent.x = rand_double1(rng, 0.01, 0.2);
+                extent.y = rand_double1(rng, 0.01, 0.2);
+                extent.z = rand_double1(rng, 1.0, 8.0);
+                m_bboxes.push_back(AABB3d(center - extent, center + extent));
+            }
+
+            m_job_manager.start();
+        }
+    };
+
+    bool are_equal(const NodeVector& lhs, const NodeVector& rhs)
+    {
+        if (lhs.size() != rhs.size())
+            return false;
+
+        for (size_t i = 0; i < lhs.size(); ++i)
+        {
+            if (lhs[i].is_leaf() != rhs[i].is_leaf())
+                return false;
+
+            if (lhs[i].is_leaf())
+            {
+                if (lhs[i].get_item_index() != rhs[i].get_item_index() ||
+                    lhs[i].get_item_count() != rhs[i].get_item_count())
+                    return false;
+            }
+            else
+            {
+                if (lhs[i].get_child_node_index() != rhs[i].get_child_node_index() ||
+                    lhs[i].get_left_bbox() != rhs[i].get_left_bbox() ||
+                    lhs[i].get_right_bbox() != rhs[i].get_right_bbox())
+                    return false;
+            }
+        }
+
+        return true;
+    }
+
+    TEST_CASE_F(Builder_ParallelBuildMatchesSingleThreadedBuild, Fixture)
+    {
+        typedef bvh::SAHPartitioner<AABBVector> Partitioner;
+        typedef bvh::Builder<Tree, Partitioner> Builder;
+
+        Partitioner partitioner(m_bboxes, 2);
+        Tree tree;
+        Builder builder;
+        builder.build<DefaultWallclockTimer>(tree, partitioner, m_bboxes.size(), 2);
+
+        Partitioner parallel_partitioner(m_bboxes, 2);
+        Tree parallel_tree;
+        Builder parallel_builder;
+        parallel_builder.build<DefaultWallclockTimer>(
+            parallel_tree,
+            parallel_partitioner,
+            m_bboxes.size(),
+            2,
+            m_job_queue,
+            ThreadCount);
+
+        EXPECT_TRUE(are_equal(tree.get_nodes(), parallel_tree.get_nodes()));
+        EXPECT_EQ(partitioner.get_item_ordering(), parallel_partitioner.get_item_ordering());
+    }
+
+    bool encloses(const AABB3d& outer, const AABB3d& inner)
+    {
+        return outer.contains(inner.min) && outer.contains(inner.max);
+    }
+
+    // Return true if the items of the subtree of a given node are enclosed in a given bounding box.
+    bool are_items_enclosed(
+        const NodeVector&           nodes,
+        const vector<size_t>&       ordering,
+        const AABBVector&           bboxes,
+        const size_t                node_index,
+        const AABB3d&               bbox)
+    {
+        const bvh::Node<AABB3d>& node = nodes[node_index];
+
+        if (node.is_leaf())
+        {
+            const size_t begin = node.get_item_index();
+            const size_t end = begin + node.get_item_count();
+
+            for (size_t i = begin; i < end; ++i)
+            {
+                if (!encloses(bbox, bboxes[ordering[i]]))
+                    return false;
+            }
+
+            return true;
+        }
+
+        const size_t child_node_index = node.get_child_node_index();
+
+        return
+            encloses(bbox, node.get_left_bbox()) &&
+            encloses(bbox, node.get_right_bbox()) &&
+            are_items_enclosed(nodes, ordering, bboxes, child_node_index, node.get_left_bbox()) &&
+            are_items_enclosed(nodes, ordering, bboxes, child_node_index + 1, node.get_right_bbox());
+    }
+
+    TEST_CASE_F(Builder_ParallelBinnedSplits_ProduceDeterministicAndValidTree, Fixture)
+    {
+        typedef bvh::SAHPartitioner<AABBVector> Partitioner;
+        typedef bvh::Builder<Tree, Partitioner> Builder;
+
+        // Use a low threshold to split the top of the tree using binned SAH.
+        Partitioner partitioner(m_bboxes, 2);
+        partitioner.enable_parallel_build(m_job_queue, ThreadCount, 500, 16);
+        Tree tree;
+        Builder builder;
+        builder.build<DefaultWallclockTimer>(
+            tree,
+            partitioner,
+            m_bboxes.size(),
+            2,
+            m_job_queue,
+            ThreadCount);
+
+        Partitioner other_partitioner(m_bboxes, 2);
+        other_partitioner.enable_parallel_build(m_job_queue, ThreadCount, 500, 16);
+        Tree other_tree;
+        Builder other_builder;
+        other_builder.build<DefaultWallclockTimer>(
+            other_tree,
+            other_partitioner,
+            m_bboxes.size(),
+            2,
+            m_job_queue,
+            ThreadCount);
+
+        EXPECT_TRUE(are_equal(tree.get_nodes(), other_tree.get_nodes()));
+        EXPECT_EQ(partitioner.get_item_ordering(), other_partitioner.get_item_ordering());
+
+        vector<size_t> ordering = partitioner.get_item_ordering();
+        sort(ordering.begin(), ordering.end());
+        for (size_t i = 0; i < ordering.size(); ++i)
+            EXPECT_EQ(i, ordering[i]);
+
+        AABB3d root_bbox;
+        root_bbox.invalidate();
+        for (size_t i = 0; i < m_bboxes.size(); ++i)
+            root_bbox.insert(m_bboxes[i]);
+        EXPECT_TRUE(
+            are_items_enclosed(
+                tree.get_nodes(),
+                partitioner.get_item_ordering(),
+                m_bboxes,
+                0,
+                root_bbox));
+    }
+
+    TEST_CASE_F(SpatialBuilder_ParallelBuildMatchesSingleThreadedBuild, Fixture)
+    {
+        typedef bvh::SBVHPartitioner<ItemHandler, AABBVector> Partitioner;
+        typedef bvh::SpatialBuilder<Tree, Partitioner> Builder;
+
+        ItemHandler item_handler(m_bboxes);
+
+        Partitioner partitioner(item_handler, m_bboxes, 2, 16);
+        Partitioner::LeafType* root_leaf = partitioner.create_root_leaf();
+        Tree tree;
+        Builder builder;
+        builder.build<DefaultWallclockTimer>(
+            tree,
+            partitioner,
+            root_leaf,
+            partitioner.compute_leaf_bbox(*root_leaf));
+
+        // Use a low threshold to also split the top leaves using the worker threads.
+        Partitioner parallel_partitioner(item_handler, m_bboxes, 2, 16);
+        parallel_partitioner.enable_parallel_build(m_job_queue, ThreadCount, 500);
+        Partitioner::LeafType* parallel_root_leaf = parallel_partitioner.create_root_leaf();
+        Tree parallel_tree;
+        Builder parallel_builder;
+        parallel_builder.build<DefaultWallclockTimer>(
+            parallel_tree,
+            parallel_partitioner,
+            parallel_root_leaf,
+            parallel_partitioner.compute_leaf_bbox(*parallel_root_leaf),
+            m_job_queue,
+            ThreadCount);
+
+        EXPECT_TRUE(are_equal(tree.get_nodes(), parallel_tree.get_nodes()));
+        EXPECT_EQ(partitioner.get_item_ordering(), parallel_partitioner.get_item_ordering());
+        EXPECT_EQ(partitioner.get_spatial_split_count(), parallel_partitioner.get_spatial_split_count());
+        EXPECT_EQ(partitioner.get_object_split_count(), parallel_partitioner.get_object_split_count());
+        EXPECT_GT(0, parallel_partitioner.get_spatial_split_count());
+    }
+}
+
+
+TEST_SUITE(Foundation_Math_BVH_Refitter)
+{
+    typedef AlignedVector<bvh::Node<AABB3d> > NodeVector;
+    typedef vector<AABB3d> AABBVector;
+    typedef bvh::SAHPartitioner<AABBVector> Partitioner;
+
+    struct Tree
+      : public bvh::Tree<NodeVector>
+    {
+        const NodeVector& get_nodes() const
+        {
+            return m_nodes;
+        }
+    };
+
+    typedef bvh::Refitter<Tree> Refitter;
+
+    struct Fixture
+    {
+        AABBVector  m_bboxes;           // in the order of the tree
+        Tree        m_tree;
+
+        Fixture()
+        {
+            MersenneTwister rng;
+            AABBVector bboxes;
+            for (size_t i = 0; i < 1000; ++i)
+            {
+                Vector3d center;
+                center.x = rand_double1(rng, -10.0, 10.0);
+                center.y = rand_double1(rng, -10.0, 10.0);
+                center.z = rand_double1(rng, -10.0, 10.0);
+                bboxes.push_back(AABB3d(center - Vector3d(0.1), center + Vector3d(0.1)));
+            }
+
+            Partitioner partitioner(bboxes, 2);
+            bvh::Builder<Tree, Partitioner> builder;
+            builder.build<DefaultWallclockTimer>(m_tree, partitioner, bboxes.size(), 2);
+
+            const vector<size_t>& ordering = partitioner.get_item_ordering();
+            for (size_t i = 0; i < ordering.size(); ++i)
+                m_bboxes.push_back(bboxes[ordering[i]]);
+        }
+    };
+
+    bool child_bboxes_enclose_items(
+        const NodeVector&   nodes,
+        const size_t        node_index,
+        const AABB3d&       bbox,
+        const AABBVector&   bboxes)
+    {
+        const bvh::Node<AABB3d>& node = nodes[node_index];
+
+        if (node.is_leaf())
+        {
+            for (size_t i = node.get_item_index(); i < node.get_item_index() + node.get_item_count(); ++i)
+            {
+                if (!bbox.contains(bboxes[i].min) || !bbox.contains(bboxes[i].max))
+                    return false;
+            }
+
+            return true;
+        }
+
+        const size_t child_index = node.get_child_node_index();
+
+        return
+            child_bboxes_enclose_items(nodes, child_index, node.get_left_bbox(), bboxes) &&
+            child_bboxes_enclose_items(nodes, child_index + 1, node.get_right_bbox(), bboxes);
+    }
+
+    TEST_CASE_F(Refit_GivenUnchangedItems_LeavesTreeUnchanged, Fixture)
+    {
+        const NodeVector original_nodes = m_tree.get_nodes();
+
+        Refitter refitter;
+        refitter.refit<DefaultWallclockTimer>(m_tree, m_bboxes);
+
+        ASSERT_EQ(original_nodes.size(), m_tree.get_nodes().size());
+
+        for (size_t i = 0; i < original_nodes.size(); ++i)
+        {
+            if (original_nodes[i].is_interior())
+            {
+                EXPECT_EQ(original_nodes[i].get_left_bbox(), m_tree.get_nodes()[i].get_left_bbox());
+                EXPECT_EQ(original_nodes[i].get_right_bbox(), m_tree.get_nodes()[i].get_right_bbox());
+            }
+        }
+    }
+
+    TEST_CASE_F(Refit_GivenMovedItems_ChildBBoxesEncloseMovedItems, Fixture)
+    {
+        MersenneTwister rng;
+        for (size_t i = 0; i < m_bboxes.size(); ++i)
+        {
+            Vector3d offset;
+            offset.x = rand_double1(rng, -5.0, 5.0);
+            offset.y = rand_double1(rng, -5.0, 5.0);
+            offset.z = rand_double1(rng, -5.0, 5.0);
+            m_bboxes[i].min += offset;
+            m_bboxes[i].max += offset;
+        }
+
+        Refitter refitter;
+        const AABB3d tree_bbox = refitter.refit<DefaultWallclockTimer>(m_tree, m_bboxes);
+
+        AABB3d expected_bbox;
+        expected_bbox.invalidate();
+        for (size_t i = 0; i < m_bboxes.size(); ++i)
+            expected_bbox.insert(m_bboxes[i]);
+
+        EXPECT_EQ(expected_bbox, tree_bbox);
+        EXPECT_TRUE(child_bboxes_enclose_items(m_tree.get_nodes(), 0, tree_bbox, m_bboxes));
+    }
+
+    TEST_CASE_F(ComputeSAHCost_GivenScrambledItems_ReturnsHigherCost, Fixture)
+    {
+        const double original_cost = Refitter::compute_sah_cost(m_tree, 1.0, 1.0);
+
+        // Swap items across the whole scene so that leaves no longer group nearby items.
+        for (size_t i = 0; i < m_bboxes.size() / 2; i += 2)
+            swap(m_bboxes[i], m_bboxes[m_bboxes.size() - 1 - i]);
+
+        Refitter refitter;
+        refitter.refit<DefaultWallclockTimer>(m_tree, m_bboxes);
+
+        EXPECT_GT(original_cost, Refitter::compute_sah_cost(m_tree, 1.0, 1.0));
+    }
+}
+
 TEST_SUITE(Foundation_Math_BVH_Intersector_2D)
 {
     typedef bvh::Node<AABB2d> NodeType;
@@ -148,3 +556,235 @@ TEST_SUITE(Foundation_Math_BVH_Intersector_2D)
         > intersector;
     }
 }
+
+TEST_SUITE(Foundation_Math_BVH_WideIntersector)
+{
+    typedef bvh::Node<AABB3d> NodeType;
+    typedef bvh::Tree<AlignedVector<NodeType> > Tree;
+    typedef vector<AABB3d> AABBVector;
+
+    struct Visitor
+    {
+        const AABBVector&       m_bboxes;
+        const vector<size_t>&   m_ordering;
+        double                  m_closest;
+        size_t                  m_closest_index;
+
+        Visitor(
+            const AABBVector&       bboxes,
+            const vector<size_t>&   ordering)
+          : m_bboxes(bboxes)
+          , m_ordering(ordering)
+          , m_closest(numeric_limits<double>::max())
+          , m_closest_index(~size_t(0))
+        {
+        }
+
+        bool visit(
+            const NodeType&             node,
+            const Ray3d&                ray,
+            const RayInfo3d&            ray_info,
+            double&                     distance
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+            , bvh::TraversalStatistics& stats
+#endif
+            )
+        {
+            const size_t begin = node.get_item_index();
+            const size_t end = begin + node.get_item_count();
+
+            for (size_t i = begin; i < end; ++i)
+            {
+                const size_t item_index = m_ordering[i];
+
+                double tmin;
+                if (intersect(ray, ray_info, m_bboxes[item_index], tmin) && tmin < m_closest)
+                {
+                    m_closest = tmin;
+                    m_closest_index = item_index;
+                }
+            }
+
+            distance = m_closest;
+            return true;
+        }
+    };
+
+    // Return the number of rays for which the wide and binary intersectors disagree.
+    template <typename WideNodeType>
+    size_t count_mismatching_closest_hits()
+    {
+        typedef bvh::WideTree<AlignedVector<WideNodeType> > WideTree;
+
+        // Generate a set of random boxes.
+        MersenneTwister rng;
+        AABBVector bboxes;
+        AABB3d root_bbox;
+        root_bbox.invalidate();
+        for (size_t i = 0; i < 500; ++i)
+        {
+            Vector3d center;
+            center.x = rand_double1(rng, -10.0, 10.0);
+            center.y = rand_double1(rng, -10.0, 10.0);
+            center.z = rand_double1(rng, -10.0, 10.0);
+            const Vector3d extent(rand_double1(rng, 0.01, 0.5));
+            bboxes.push_back(AABB3d(center - extent, center + extent));
+            root_bbox.insert(bboxes.back());
+        }
+
+        // Build the same binary tree twice.
+        typedef bvh::SAHPartitioner<AABBVector> Partitioner;
+        typedef bvh::Builder<Tree, Partitioner> Builder;
+        Partitioner partitioner(bboxes, 2);
+        Tree tree;
+        Builder builder;
+        builder.template build<DefaultWallclockTimer>(tree, partitioner, bboxes.size(), 2);
+        Partitioner collapsed_partitioner(bboxes, 2);
+        Tree collapsed_tree;
+        Builder collapsed_builder;
+        collapsed_builder.template build<DefaultWallclockTimer>(collapsed_tree, collapsed_partitioner, bboxes.size(), 2);
+
+        // Collapse the second binary tree into a wide tree.
+        WideTree wide_tree;
+        bvh::Collapser<Tree, WideTree> collapser;
+        collapser.template collapse<DefaultWallclockTimer>(collapsed_tree, wide_tree, root_bbox);
+
+        const bvh::Intersector<Tree, Visitor, Ray3d> intersector;
+        const bvh::WideIntersector<Tree, WideTree, Visitor> wide_intersector;
+
+        size_t mismatches = 0;
+
+        for (size_t i = 0; i < 1000; ++i)
+        {
+            Vector3d origin;
+            origin.x = rand_double1(rng, -15.0, 15.0);
+            origin.y = rand_double1(rng, -15.0, 15.0);
+            origin.z = rand_double1(rng, -15.0, 15.0);
+            Vector3d target;
+            target.x = rand_double1(rng, -5.0, 5.0);
+            target.y = rand_double1(rng, -5.0, 5.0);
+            target.z = rand_double1(rng, -5.0, 5.0);
+
+            const Ray3d ray(origin, normalize(target - origin));
+            const RayInfo3d ray_info(ray);
+
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+            bvh::TraversalStatistics stats;
+#endif
+
+            Visitor visitor(bboxes, partitioner.get_item_ordering());
+            intersector.intersect_no_motion(
+                tree,
+                ray,
+                ray_info,
+                visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+                , stats
+#endif
+                );
+
+            Visitor wide_visitor(bboxes, partitioner.get_item_ordering());
+            wide_intersector.intersect_no_motion(
+                collapsed_tree,
+                wide_tree,
+                ray,
+                ray_info,
+                wide_visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+                , stats
+#endif
+                );
+
+            if (visitor.m_closest_index != wide_visitor.m_closest_index)
+                ++mismatches;
+        }
+
+        return mismatches;
+    }
+
+    TEST_CASE(IntersectNoMotion_Width4_ReturnsSameClosestHitAsBinaryIntersector)
+    {
+        EXPECT_EQ(0, count_mismatching_closest_hits<bvh::WideNode<4> >());
+    }
+
+    TEST_CASE(IntersectNoMotion_Width8_ReturnsSameClosestHitAsBinaryIntersector)
+    {
+        EXPECT_EQ(0, count_mismatching_closest_hits<bvh::WideNode<8> >());
+    }
+
+    TEST_CASE(IntersectNoMotion_Width4Quantized8_ReturnsSameClosestHitAsBinaryIntersector)
+    {
+        typedef bvh::QuantizedWideNode<4, uint8> WideNodeType;
+        EXPECT_EQ(0, count_mismatching_closest_hits<WideNodeType>());
+    }
+
+    TEST_CASE(IntersectNoMotion_Width8Quantized16_ReturnsSameClosestHitAsBinaryIntersector)
+    {
+        typedef bvh::QuantizedWideNode<8, uint16> WideNodeType;
+        EXPECT_EQ(0, count_mismatching_closest_hits<WideNodeType>());
+    }
+}
+
+TEST_SUITE(Foundation_Math_BVH_QuantizedWideNode)
+{
+    bool encloses(const AABB3d& outer, const AABB3d& inner)
+    {
+        return outer.contains(inner.min) && outer.contains(inner.max);
+    }
+
+    template <typename T>
+    bool quantized_bboxes_enclose_original_bboxes()
+    {
+        MersenneTwister rng;
+
+        for (size_t i = 0; i < 100; ++i)
+        {
+            AABB3d bboxes[4];
+            for (size_t j = 0; j < 4; ++j)
+            {
+                Vector3d center;
+                center.x = rand_double1(rng, -1000.0, 1000.0);
+                center.y = rand_double1(rng, -1.0, 1.0);
+                center.z = rand_double1(rng, 1.0e6, 1.0e6 + 1.0);
+                const Vector3d extent(rand_double1(rng, 0.0, 0.1));
+                bboxes[j] = AABB3d(center - extent, center + extent);
+            }
+
+            bvh::QuantizedWideNode<4, T> node;
+            node.set_child_bboxes(bboxes, 4);
+
+            for (size_t j = 0; j < 4; ++j)
+            {
+                const AABB3d quantized_bbox(node.get_child_bbox(j));
+
+                if (!encloses(quantized_bbox, bboxes[j]))
+                    return false;
+            }
+        }
+
+        return true;
+    }
+
+    TEST_CASE(SetChildBBoxes_8Bits_QuantizedBBoxesEncloseOriginalBBoxes)
+    {
+        EXPECT_TRUE(quantized_bboxes_enclose_original_bboxes<uint8>());
+    }
+
+    TEST_CASE(SetChildBBoxes_16Bits_QuantizedBBoxesEncloseOriginalBBoxes)
+    {
+        EXPECT_TRUE(quantized_bboxes_enclose_original_bboxes<uint16>());
+    }
+
+    TEST_CASE(SetChildBBoxes_GivenSingleChild_OtherChildrenAreEmpty)
+    {
+        const AABB3d bbox(Vector3d(1.0, 2.0, 3.0), Vector3d(4.0, 5.0, 6.0));
+
+        bvh::QuantizedWideNode<4, uint8> node;
+        node.set_child_bboxes(&bbox, 1);
+        node.set_child_leaf_index(0, 0);
+
+        EXPECT_EQ(1, node.get_child_count());
+        EXPECT_TRUE(node.is_child_empty(1));
+        EXPECT_TRUE(encloses(AABB3d(node.get_child_bbox(0)), bbox));
+    }
+}
@@ -189,6 +189,20 @@ TEST_SUITE(Foundation_Utility_Cache_LRUCache)
         cache.get(9);   // flushes 6, cache contains 9
         ASSERT_EQ(9000, element_swapper.m_memory_size);
     }
+
+    TEST_CASE(Contains_DoesNotAffectStatistics)
+    {
+        KeyHasher key_hasher;
+        ElementSwapperCountingUnloads element_swapper;
+        LRUCache<Key, KeyHasher, Element, ElementSwapperCountingUnloads> cache(key_hasher, element_swapper);
+
+        cache.get(1);
+
+        EXPECT_TRUE(cache.contains(1));
+        EXPECT_FALSE(cache.contains(2));
+        EXPECT_EQ(0, cache.get_hit_count());
+        EXPECT_EQ(1, cache.get_miss_count());
+    }
 }
 
 TEST_SUITE(Foundation_Utility_Cache_DualStageCache)
@@ -374,6 +374,63 @@ TEST_SUITE(Foundation_Utility_Job_JobManager)
 
         EXPECT_EQ(1, execution_count);
     }
+
+    struct FixtureWorkStealingJobManager
+    {
+        Logger      logger;
+        JobQueue    job_queue;
+        JobManager  job_manager;
+
+        FixtureWorkStealingJobManager()
+          : job_manager(logger, job_queue, 4, JobManager::WorkStealing)
+        {
+        }
+    };
+
+    TEST_CASE(WorkStealingJobManager_JobsScheduledBeforeConstructionAreKept)
+    {
+        JobQueue job_queue;
+        job_queue.schedule(new EmptyJob());
+        job_queue.schedule(new EmptyJob());
+        job_queue.schedule(new EmptyJob());
+
+        Logger logger;
+        JobManager job_manager(logger, job_queue, 2, JobManager::WorkStealing);
+
+        EXPECT_EQ(3, job_queue.get_scheduled_job_count());
+
+        job_queue.clear_scheduled_jobs();
+
+        EXPECT_FALSE(job_queue.has_scheduled_or_running_jobs());
+    }
+
+    TEST_CASE_F(WorkStealingJobManager_ExecutesAllJobs, FixtureWorkStealingJobManager)
+    {
+        volatile uint32 execution_count = 0;
+
+        const size_t JobCount = 1000;
+        for (size_t i = 0; i < JobCount; ++i)
+            job_queue.schedule(new JobNotifyingAboutExecution(&execution_count));
+
+        job_manager.start();
+        job_queue.wait_until_completion();
+
+        EXPECT_EQ(JobCount, execution_count);
+        EXPECT_FALSE(job_queue.has_scheduled_or_running_jobs());
+    }
+
+    TEST_CASE_F(WorkStealingJobManager_ExecutesSubJobs, FixtureWorkStealingJobManager)
+    {
+        volatile uint32 execution_count = 0;
+
+        job_queue.schedule(
+            new JobCreatingAnotherJob(job_queue, &execution_count));
+
+        job_manager.start();
+        job_queue.wait_until_completion();
+
+        EXPECT_EQ(1, execution_count);
+    }
 }
 
 TEST_SUITE(Foundation_Utility_Job_WorkerThread)
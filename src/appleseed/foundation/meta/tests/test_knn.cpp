@@ -37,6 +37,8 @@
 #include "foundation/math/vector.h"
 #include "foundation/platform/timers.h"
 #include "foundation/utility/iostreamop.h"
+#include "foundation/utility/job.h"
+#include "foundation/utility/log.h"
 #include "foundation/utility/test.h"
 
 // Standard headers.
@@ -141,6 +143,59 @@ TEST_SUITE(Foundation_Math_Knn_Builder)
         knn::Builder3d builder(tree);
         builder.build<DefaultWallclockTimer>(points, PointCount);
     }
+
+    TEST_CASE(BuildMovePoints_GivenJobQueue_BuildsSameTreeAsSingleThreadedBuild)
+    {
+        const size_t PointCount = 200000;
+
+        MersenneTwister rng;
+        vector<Vector3f> points(PointCount);
+        for (size_t i = 0; i < PointCount; ++i)
+        {
+            points[i][0] = rand_float2(rng);
+            points[i][1] = rand_float2(rng);
+            points[i][2] = rand_float2(rng);
+        }
+
+        vector<Vector3f> points_copy(points);
+
+        knn::Tree3f tree;
+        knn::Builder3f builder(tree);
+        builder.build_move_points<DefaultWallclockTimer>(points);
+
+        knn::Tree3f parallel_tree;
+        {
+            Logger logger;
+            JobQueue job_queue;
+            JobManager job_manager(logger, job_queue, 4, JobManager::KeepRunningOnEmptyQueue);
+            job_manager.start();
+
+            knn::Builder3f parallel_builder(parallel_tree);
+            parallel_builder.build_move_points<DefaultWallclockTimer>(points_copy, job_queue, 4);
+        }
+
+        EXPECT_TRUE(tree.m_points == parallel_tree.m_points);
+        EXPECT_TRUE(tree.m_indices == parallel_tree.m_indices);
+
+        ASSERT_EQ(tree.m_nodes.size(), parallel_tree.m_nodes.size());
+
+        for (size_t i = 0; i < tree.m_nodes.size(); ++i)
+        {
+            const knn::Tree3f::NodeType& node = tree.m_nodes[i];
+            const knn::Tree3f::NodeType& parallel_node = parallel_tree.m_nodes[i];
+
+            ASSERT_EQ(node.is_leaf(), parallel_node.is_leaf());
+            ASSERT_EQ(node.get_point_index(), parallel_node.get_point_index());
+            ASSERT_EQ(node.get_point_count(), parallel_node.get_point_count());
+
+            if (node.is_interior())
+            {
+                ASSERT_EQ(node.get_child_node_index(), parallel_node.get_child_node_index());
+                ASSERT_EQ(node.get_split_dim(), parallel_node.get_split_dim());
+                ASSERT_EQ(node.get_split_abs(), parallel_node.get_split_abs());
+            }
+        }
+    }
 }
 
 TEST_SUITE(Foundation_Math_Knn_Answer)
@@ -444,3 +499,149 @@ TEST_SUITE(Foundation_Math_Knn_Query)
         EXPECT_TRUE(do_results_match_naive_algorithm(points, AnswerSize, QueryCount, rng));
     }
 }
+
+TEST_SUITE(Foundation_Math_Knn_HashGrid)
+{
+    void generate_random_points(
+        MersenneTwister&            rng,
+        vector<Vector3f>&           points,
+        const size_t                count)
+    {
+        points.resize(count);
+
+        for (size_t i = 0; i < count; ++i)
+            points[i] = rand_vector1<Vector3f>(rng);
+    }
+
+    TEST_CASE(Empty_GivenDefaultConstructedGrid_ReturnsTrue)
+    {
+        knn::HashGrid3f grid;
+
+        EXPECT_TRUE(grid.empty());
+    }
+
+    TEST_CASE(Build_GivenPoints_StoresEveryPointOnce)
+    {
+        const size_t PointCount = 1000;
+
+        MersenneTwister rng;
+        vector<Vector3f> points;
+        generate_random_points(rng, points, PointCount);
+
+        knn::HashGrid3f grid;
+        knn::HashGridBuilder3f builder(grid);
+        builder.build<DefaultWallclockTimer>(&points[0], PointCount, 0.1f);
+
+        vector<size_t> indices;
+        for (size_t i = 0; i < PointCount; ++i)
+        {
+            EXPECT_EQ(points[grid.remap(i)], grid.get_point(i));
+            indices.push_back(grid.remap(i));
+        }
+
+        sort(indices.begin(), indices.end());
+
+        for (size_t i = 0; i < PointCount; ++i)
+            EXPECT_EQ(i, indices[i]);
+    }
+
+    TEST_CASE(BuildMovePoints_GivenJobQueue_BuildsSameGridAsSingleThreadedBuild)
+    {
+        const size_t PointCount = 100000;
+
+        MersenneTwister rng;
+        vector<Vector3f> points;
+        generate_random_points(rng, points, PointCount);
+
+        vector<Vector3f> points_copy(points);
+
+        knn::HashGrid3f grid;
+        knn::HashGridBuilder3f builder(grid);
+        builder.build_move_points<DefaultWallclockTimer>(points, 0.02f);
+
+        knn::HashGrid3f parallel_grid;
+        {
+            Logger logger;
+            JobQueue job_queue;
+            JobManager job_manager(logger, job_queue, 4, JobManager::KeepRunningOnEmptyQueue);
+            job_manager.start();
+
+            knn::HashGridBuilder3f parallel_builder(parallel_grid);
+            parallel_builder.build_move_points<DefaultWallclockTimer>(points_copy, 0.02f, job_queue, 4);
+        }
+
+        ASSERT_EQ(grid.get_bucket_count(), parallel_grid.get_bucket_count());
+
+        for (size_t i = 0; i < grid.get_bucket_count(); ++i)
+            ASSERT_EQ(grid.get_bucket_size(i), parallel_grid.get_bucket_size(i));
+
+        for (size_t i = 0; i < PointCount; ++i)
+        {
+            ASSERT_EQ(grid.remap(i), parallel_grid.remap(i));
+            ASSERT_EQ(grid.get_point(i), parallel_grid.get_point(i));
+        }
+    }
+
+    bool do_results_match_tree(
+        const vector<Vector3f>&     points,
+        const float                 cell_size,
+        const float                 query_max_square_distance,
+        const size_t                answer_size,
+        const size_t                query_count,
+        MersenneTwister&            rng)
+    {
+        knn::Tree3f tree;
+        knn::Builder3f tree_builder(tree);
+        tree_builder.build<DefaultWallclockTimer>(&points[0], points.size());
+
+        knn::HashGrid3f grid;
+        knn::HashGridBuilder3f grid_builder(grid);
+        grid_builder.build<DefaultWallclockTimer>(&points[0], points.size(), cell_size);
+
+        knn::Answer<float> tree_answer(answer_size);
+        knn::Query3f tree_query(tree, tree_answer);
+
+        knn::Answer<float> grid_answer(answer_size);
+        knn::HashGridQuery3f grid_query(grid, grid_answer);
+
+        for (size_t i = 0; i < query_count; ++i)
+        {
+            const Vector3f q = rand_vector1<Vector3f>(rng);
+
+            tree_query.run(q, query_max_square_distance);
+            tree_answer.sort();
+
+            grid_query.run(q, query_max_square_distance);
+            grid_answer.sort();
+
+            if (grid_answer.size() != tree_answer.size())
+                return false;
+
+            for (size_t j = 0; j < grid_answer.size(); ++j)
+            {
+                if (grid.remap(grid_answer.get(j).m_index) != tree.remap(tree_answer.get(j).m_index))
+                    return false;
+            }
+        }
+
+        return true;
+    }
+
+    TEST_CASE(Run_GivenRadiusOfHalfCellSize_ReturnsSameResultsAsTree)
+    {
+        MersenneTwister rng;
+        vector<Vector3f> points;
+        generate_random_points(rng, points, 10000);
+
+        EXPECT_TRUE(do_results_match_tree(points, 0.1f, square(0.05f), 20, 1000, rng));
+    }
+
+    TEST_CASE(Run_GivenRadiusLargerThanCellSize_ReturnsSameResultsAsTree)
+    {
+        MersenneTwister rng;
+        vector<Vector3f> points;
+        generate_random_points(rng, points, 10000);
+
+        EXPECT_TRUE(do_results_match_tree(points, 0.01f, square(0.1f), 100, 200, rng));
+    }
+}
@@ -29,9 +29,13 @@
 
 // appleseed.foundation headers.
 #include "foundation/math/vector.h"
+#include "foundation/mesh/imeshbuilder.h"
 #include "foundation/mesh/meshbuilderbase.h"
 #include "foundation/mesh/objmeshfilereader.h"
 #include "foundation/platform/compiler.h"
+#include "foundation/utility/countof.h"
+#include "foundation/utility/iostreamop.h"
+#include "foundation/utility/string.h"
 #include "foundation/utility/test.h"
 
 // Standard headers.
@@ -121,4 +125,140 @@ TEST_SUITE(Foundation_Mesh_OBJMeshFileReader)
         EXPECT_EQ(4, mesh.m_tex_coords.size());
         EXPECT_EQ(1, mesh.m_faces.size());
     }
+
+    // Records all calls made to the builder, in order.
+    struct RecordingMeshBuilder
+      : public IMeshBuilder
+    {
+        vector<string>      m_calls;
+        size_t              m_vertex_count;
+        size_t              m_vertex_normal_count;
+        size_t              m_tex_coords_count;
+        size_t              m_material_slot_count;
+        size_t              m_face_vertex_count;
+
+        virtual void begin_mesh(const char* name) APPLESEED_OVERRIDE
+        {
+            m_calls.push_back("begin_mesh " + string(name));
+            m_vertex_count = 0;
+            m_vertex_normal_count = 0;
+            m_tex_coords_count = 0;
+            m_material_slot_count = 0;
+        }
+
+        virtual size_t push_vertex(const Vector3d& v) APPLESEED_OVERRIDE
+        {
+            m_calls.push_back("push_vertex " + to_string(v));
+            return m_vertex_count++;
+        }
+
+        virtual size_t push_vertex_normal(const Vector3d& v) APPLESEED_OVERRIDE
+        {
+            m_calls.push_back("push_vertex_normal " + to_string(v));
+            return m_vertex_normal_count++;
+        }
+
+        virtual size_t push_tex_coords(const Vector2d& v) APPLESEED_OVERRIDE
+        {
+            m_calls.push_back("push_tex_coords " + to_string(v));
+            return m_tex_coords_count++;
+        }
+
+        virtual size_t push_material_slot(const char* name) APPLESEED_OVERRIDE
+        {
+            m_calls.push_back("push_material_slot " + string(name));
+            return m_material_slot_count++;
+        }
+
+        virtual void begin_face(const size_t vertex_count) APPLESEED_OVERRIDE
+        {
+            m_calls.push_back("begin_face " + to_string(vertex_count));
+            m_face_vertex_count = vertex_count;
+        }
+
+        virtual void set_face_vertices(const size_t vertices[]) APPLESEED_OVERRIDE
+        {
+            m_calls.push_back("set_face_vertices " + to_string(vertices, m_face_vertex_count));
+        }
+
+        virtual void set_face_vertex_normals(const size_t vertex_normals[]) APPLESEED_OVERRIDE
+        {
+            m_calls.push_back("set_face_vertex_normals " + to_string(vertex_normals, m_face_vertex_count));
+        }
+
+        virtual void set_face_vertex_tex_coords(const size_t tex_coords[]) APPLESEED_OVERRIDE
+        {
+            m_calls.push_back("set_face_vertex_tex_coords " + to_string(tex_coords, m_face_vertex_count));
+        }
+
+        virtual void set_face_material(const size_t material) APPLESEED_OVERRIDE
+        {
+            m_calls.push_back("set_face_material " + to_string(material));
+        }
+
+        virtual void end_face() APPLESEED_OVERRIDE
+        {
+            m_calls.push_back("end_face");
+        }
+
+        virtual void end_mesh() APPLESEED_OVERRIDE
+        {
+            m_calls.push_back("end_mesh");
+        }
+    };
+
+    TEST_CASE(ReadMultipleObjectsMeshFile_ParseConcurrently_MatchesSerialParsing)
+    {
+        const char* Filename = "unit tests/inputs/test_objmeshfilereader_multipleobjects.obj";
+
+        OBJMeshFileReader serial_reader(Filename);
+        RecordingMeshBuilder serial_builder;
+        serial_reader.read(serial_builder);
+
+        ASSERT_FALSE(serial_builder.m_calls.empty());
+
+        const size_t ChunkSizes[] = { 1, 7, 64, 1024 * 1024 };
+
+        for (size_t i = 0; i < countof(ChunkSizes); ++i)
+        {
+            OBJMeshFileReader concurrent_reader(Filename, OBJMeshFileReader::ParseConcurrently);
+            concurrent_reader.set_thread_count(3);
+            concurrent_reader.set_chunk_size(ChunkSizes[i]);
+            RecordingMeshBuilder concurrent_builder;
+            concurrent_reader.read(concurrent_builder);
+
+            ASSERT_EQ(serial_builder.m_calls.size(), concurrent_builder.m_calls.size());
+
+            for (size_t j = 0; j < serial_builder.m_calls.size(); ++j)
+                EXPECT_EQ(serial_builder.m_calls[j], concurrent_builder.m_calls[j]);
+        }
+    }
+
+    size_t read_and_return_parse_error_line(OBJMeshFileReader& reader)
+    {
+        try
+        {
+            RecordingMeshBuilder builder;
+            reader.read(builder);
+        }
+        catch (const OBJMeshFileReader::ExceptionParseError& e)
+        {
+            return e.m_line;
+        }
+
+        return 0;
+    }
+
+    TEST_CASE(ReadInvalidIndexMeshFile_ParseConcurrently_ReportsSameLineAsSerialParsing)
+    {
+        const char* Filename = "unit tests/inputs/test_objmeshfilereader_invalidindex.obj";
+
+        OBJMeshFileReader serial_reader(Filename);
+        EXPECT_EQ(8, read_and_return_parse_error_line(serial_reader));
+
+        OBJMeshFileReader concurrent_reader(Filename, OBJMeshFileReader::ParseConcurrently);
+        concurrent_reader.set_thread_count(2);
+        concurrent_reader.set_chunk_size(8);
+        EXPECT_EQ(8, read_and_return_parse_error_line(concurrent_reader));
+    }
 }
@@ -31,14 +31,17 @@
 #define APPLESEED_FOUNDATION_UTILITY_ARENA_H
 
 // appleseed.foundation headers.
-#include "foundation/core/exceptions/exception.h"
+#include "foundation/core/concepts/noncopyable.h"
 #include "foundation/platform/compiler.h"
 #include "foundation/platform/types.h"
 #include "foundation/utility/memory.h"
 
 // Standard headers.
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
+#include <new>
+#include <vector>
 
 namespace foundation
 {
@@ -46,25 +49,83 @@ namespace foundation
 //
 // An arena is a temporary heap providing extremely cheap memory allocation.
 //
+// Memory is carved out of a list of chunks. The first chunk is stored inside
+// the arena itself; additional chunks are allocated on demand when it runs out
+// and are kept around for reuse after the arena is cleared or rewound, so that
+// an arena owned by a rendering thread acts as that thread's chunk pool.
+//
 
 class Arena
+  : public NonCopyable
 {
   public:
+    // A position in the arena that it can later be rewound to.
+    struct Marker
+    {
+        size_t  m_chunk_index;
+        size_t  m_chunk_base;
+        uint8*  m_current;
+    };
+
     Arena();
+    ~Arena();
 
+    // Release all allocations.
     void clear();
 
+    // Release all allocations made after a given marker.
+    Marker get_marker() const;
+    void rewind(const Marker& marker);
+
     void* allocate(const size_t size);
 
     template <typename T> T* allocate();
     template <typename T> T* allocate_noinit();
 
+    // Return the number of chunks owned by the arena, including the inline one.
+    size_t get_chunk_count() const;
+
+    // Return the largest number of bytes simultaneously allocated so far.
+    size_t get_high_water_mark() const;
+
   private:
-    enum { ArenaSize = 256 * 1024 };    // bytes
+    enum { ChunkSize = 256 * 1024 };    // bytes
+
+    struct Chunk
+    {
+        uint8*  m_begin;
+        uint8*  m_end;
+    };
 
-    APPLESEED_SIMD4_ALIGN uint8 m_storage[ArenaSize];
+    APPLESEED_SIMD4_ALIGN uint8 m_storage[ChunkSize];
+    std::vector<Chunk>          m_chunks;
+    size_t                      m_chunk_index;
+    size_t                      m_chunk_base;       // bytes allocated in chunks before the current one
+    uint8*                      m_begin;
     const uint8*                m_end;
     uint8*                      m_current;
+    size_t                      m_high_water_mark;
+
+    void* allocate_slow(const size_t size);
+
+    size_t get_allocated_size() const;
+};
+
+
+//
+// Rewinds an arena to its state at construction time when going out of scope.
+//
+
+class ArenaScope
+  : public NonCopyable
+{
+  public:
+    explicit ArenaScope(Arena& arena);
+    ~ArenaScope();
+
+  private:
+    Arena&              m_arena;
+    const Arena::Marker m_marker;
 };
 
 
@@ -73,20 +134,62 @@ class Arena
 //
 
 inline Arena::Arena()
-  : m_end(m_storage + ArenaSize)
+  : m_chunk_index(0)
+  , m_chunk_base(0)
+  , m_begin(m_storage)
+  , m_end(m_storage + ChunkSize)
   , m_current(m_storage)
+  , m_high_water_mark(0)
+{
+    Chunk chunk;
+    chunk.m_begin = m_storage;
+    chunk.m_end = m_storage + ChunkSize;
+    m_chunks.push_back(chunk);
+}
+
+inline Arena::~Arena()
 {
+    for (size_t i = 1, e = m_chunks.size(); i < e; ++i)
+        aligned_free(m_chunks[i].m_begin);
 }
 
 inline void Arena::clear()
 {
+    m_high_water_mark = std::max(m_high_water_mark, get_allocated_size());
+
+    m_chunk_index = 0;
+    m_chunk_base = 0;
+    m_begin = m_storage;
+    m_end = m_storage + ChunkSize;
     m_current = m_storage;
 }
 
+inline Arena::Marker Arena::get_marker() const
+{
+    Marker marker;
+    marker.m_chunk_index = m_chunk_index;
+    marker.m_chunk_base = m_chunk_base;
+    marker.m_current = m_current;
+    return marker;
+}
+
+inline void Arena::rewind(const Marker& marker)
+{
+    assert(marker.m_chunk_index <= m_chunk_index);
+
+    m_high_water_mark = std::max(m_high_water_mark, get_allocated_size());
+
+    m_chunk_index = marker.m_chunk_index;
+    m_chunk_base = marker.m_chunk_base;
+    m_begin = m_chunks[m_chunk_index].m_begin;
+    m_end = m_chunks[m_chunk_index].m_end;
+    m_current = marker.m_current;
+}
+
 inline void* Arena::allocate(const size_t size)
 {
     if (m_current + size > m_end)
-        throw Exception("out of arena memory");
+        return allocate_slow(size);
 
     void* ptr = m_current;
     m_current += align(size, 16);
@@ -112,6 +215,70 @@ inline T* Arena::allocate_noinit()
     return static_cast<T*>(allocate(sizeof(T)));
 }
 
+inline size_t Arena::get_chunk_count() const
+{
+    return m_chunks.size();
+}
+
+inline size_t Arena::get_high_water_mark() const
+{
+    return std::max(m_high_water_mark, get_allocated_size());
+}
+
+inline void* Arena::allocate_slow(const size_t size)
+{
+    const size_t aligned_size = align(size, 16);
+
+    m_chunk_base += m_current - m_begin;
+
+    // Move to the next chunk large enough to hold the allocation.
+    ++m_chunk_index;
+    while (
+        m_chunk_index < m_chunks.size() &&
+        static_cast<size_t>(m_chunks[m_chunk_index].m_end - m_chunks[m_chunk_index].m_begin) < aligned_size)
+        ++m_chunk_index;
+
+    // Grow the arena if there is no such chunk.
+    if (m_chunk_index == m_chunks.size())
+    {
+        const size_t chunk_size = std::max<size_t>(ChunkSize, aligned_size);
+
+        Chunk chunk;
+        chunk.m_begin = static_cast<uint8*>(aligned_malloc(chunk_size, 16));
+        chunk.m_end = chunk.m_begin + chunk_size;
+        m_chunks.push_back(chunk);
+    }
+
+    m_begin = m_chunks[m_chunk_index].m_begin;
+    m_end = m_chunks[m_chunk_index].m_end;
+    m_current = m_begin + aligned_size;
+
+    assert(is_aligned(m_begin, 16));
+
+    return m_begin;
+}
+
+inline size_t Arena::get_allocated_size() const
+{
+    return m_chunk_base + (m_current - m_begin);
+}
+
+
+//
+// ArenaScope class implementation.
+//
+
+inline ArenaScope::ArenaScope(Arena& arena)
+  : m_arena(arena)
+  , m_marker(arena.get_marker())
+{
+}
+
+inline ArenaScope::~ArenaScope()
+{
+    m_arena.rewind(m_marker);
+}
+
 }       // namespace foundation
 
 #endif  // !APPLESEED_FOUNDATION_UTILITY_ARENA_H
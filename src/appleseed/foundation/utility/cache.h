@@ -473,6 +473,10 @@ class LRUCache
     // Get an element from the cache.
     ElementType& get(const KeyType& key);
 
+    // Return true if a given key is in the cache. Neither the order of the
+    // elements nor the cache performance statistics are affected.
+    bool contains(const KeyType& key) const;
+
     // Return the size (in bytes) of this object in memory.
     size_t get_memory_size() const;
 
@@ -968,6 +972,12 @@ get(const KeyType& key)
     }
 }
 
+FOUNDATION_LRUCACHE_TEMPLATE_DEF(inline bool)
+contains(const KeyType& key) const
+{
+    return m_index.find(key) != m_index.end();
+}
+
 FOUNDATION_LRUCACHE_TEMPLATE_DEF(inline size_t)
 get_memory_size() const
 {
@@ -72,6 +72,9 @@ class HashTable
     // Retrieve an existing element from the hash table.
     const ValueType& get(const KeyType& key) const;
 
+    // Retrieve an element from the hash table, or return 0 if it does not exist.
+    const ValueType* find(const KeyType& key) const;
+
   private:
     typedef std::pair<KeyType, ValueType> Entry;
     typedef std::vector<Entry> EntryVector;
@@ -143,6 +146,24 @@ const ValueType& HashTable<KeyType, KeyHasherType, ValueType>::get(const KeyType
     return vec.back().second;
 }
 
+template <typename KeyType, typename KeyHasherType, typename ValueType>
+const ValueType* HashTable<KeyType, KeyHasherType, ValueType>::find(const KeyType& key) const
+{
+    if (m_vectors == 0)
+        return 0;
+
+    const size_t index = m_key_hasher(key) & m_mask;
+    const EntryVector& vec = m_vectors[index];
+
+    for (size_t i = 0, e = vec.size(); i < e; ++i)
+    {
+        if (vec[i].first == key)
+            return &vec[i].second;
+    }
+
+    return 0;
+}
+
 }       // namespace foundation
 
 #endif  // !APPLESEED_FOUNDATION_UTILITY_CONTAINERS_HASHTABLE_H
@@ -81,6 +81,8 @@ JobManager::JobManager(
     const int           flags)
   : impl(new Impl(logger, job_queue, thread_count, flags))
 {
+    if (flags & WorkStealing)
+        job_queue.enable_work_stealing(thread_count);
 }
 
 JobManager::~JobManager()
@@ -59,10 +59,12 @@ class APPLESEED_DLLSYMBOL JobManager
     enum Flags
     {
         KeepRunningOnEmptyQueue = 1 << 0,   // the worker thread keeps running even if the job queue is empty
-        KeepRunningOnJobFailure = 1 << 1    // the worker thread keeps executing jobs from the work queue even if one or more jobs failed
+        KeepRunningOnJobFailure = 1 << 1,   // the worker thread keeps executing jobs from the work queue even if one or more jobs failed
+        WorkStealing            = 1 << 2    // each worker thread has its own queue of jobs and steals jobs from other worker threads when it runs out of jobs
     };
 
-    // Constructor.
+    // Constructor. In work stealing mode, the job queue switches to per-worker
+    // queues and should not be shared with other job managers.
     JobManager(
         Logger&         logger,
         JobQueue&       job_queue,
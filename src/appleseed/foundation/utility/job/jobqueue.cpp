@@ -38,10 +38,13 @@
 #include "foundation/utility/job/ijob.h"
 
 // Boost headers.
+#include "boost/atomic/atomic.hpp"
 #include "boost/thread/condition_variable.hpp"
 
 // Standard headers.
 #include <cassert>
+#include <deque>
+#include <vector>
 
 using namespace std;
 
@@ -54,21 +57,88 @@ namespace foundation
 
 struct JobQueue::Impl
 {
+    // The queue of scheduled jobs of a worker thread, in work stealing mode.
+    struct WorkerQueue
+    {
+        boost::mutex                m_mutex;
+        std::deque<JobInfo>         m_jobs;
+        boost::atomic<size_t>       m_job_count;    // allows to skip empty queues without locking them
+
+        WorkerQueue()
+          : m_job_count(0)
+        {
+        }
+    };
+
+    typedef std::vector<WorkerQueue*> WorkerQueueVector;
+
     mutable boost::mutex            m_mutex;
     boost::condition_variable_any   m_event;
     JobList                         m_scheduled_jobs;
     JobList                         m_running_jobs;
 
+    // Work stealing mode.
+    WorkerQueueVector               m_worker_queues;
+    boost::atomic<size_t>           m_scheduled_job_count;
+    boost::atomic<size_t>           m_running_job_count;
+    boost::atomic<size_t>           m_sleeping_worker_count;
+    boost::atomic<size_t>           m_next_worker_queue;
+
+    Impl()
+      : m_scheduled_job_count(0)
+      , m_running_job_count(0)
+      , m_sleeping_worker_count(0)
+      , m_next_worker_queue(0)
+    {
+    }
+
+    bool is_work_stealing() const
+    {
+        return !m_worker_queues.empty();
+    }
+
+    size_t get_scheduled_job_count_unlocked() const
+    {
+        return is_work_stealing() ? m_scheduled_job_count.load() : m_scheduled_jobs.size();
+    }
+
+    size_t get_running_job_count_unlocked() const
+    {
+        return is_work_stealing() ? m_running_job_count.load() : m_running_jobs.size();
+    }
+
+    static void delete_job(const JobInfo& job_info)
+    {
+        if (job_info.m_owned)
+            delete job_info.m_job;
+    }
+
     static void delete_jobs(JobList& list)
     {
         for (each<JobList> i = list; i; ++i)
-        {
-            if (i->m_owned)
-                delete i->m_job;
-        }
+            delete_job(*i);
 
         list.clear();
     }
+
+    // Delete the jobs of all per-worker queues.
+    void delete_worker_jobs()
+    {
+        for (size_t i = 0; i < m_worker_queues.size(); ++i)
+        {
+            WorkerQueue& worker_queue = *m_worker_queues[i];
+            boost::mutex::scoped_lock lock(worker_queue.m_mutex);
+
+            for (size_t j = 0; j < worker_queue.m_jobs.size(); ++j)
+                delete_job(worker_queue.m_jobs[j]);
+
+            // The scheduled job count is only updated under the lock of the queue holding
+            // the jobs, so that it never drops below the number of jobs left in the queues.
+            m_scheduled_job_count -= worker_queue.m_jobs.size();
+            worker_queue.m_jobs.clear();
+            worker_queue.m_job_count = 0;
+        }
+    }
 };
 
 JobQueue::JobQueue()
@@ -82,15 +152,23 @@ JobQueue::~JobQueue()
 
     // At this point, no job must be running.
     assert(impl->m_running_jobs.empty());
+    assert(impl->m_running_job_count == 0);
 
     // Delete all scheduled jobs that the queue owns.
     Impl::delete_jobs(impl->m_scheduled_jobs);
+    impl->delete_worker_jobs();
+
+    for (size_t i = 0; i < impl->m_worker_queues.size(); ++i)
+        delete impl->m_worker_queues[i];
 
     delete impl;
 }
 
 void JobQueue::clear_scheduled_jobs()
 {
+    if (impl->is_work_stealing())
+        impl->delete_worker_jobs();
+
     boost::mutex::scoped_lock lock(impl->m_mutex);
 
     impl->delete_jobs(impl->m_scheduled_jobs);
@@ -103,48 +181,74 @@ bool JobQueue::has_scheduled_jobs() const
 {
     boost::mutex::scoped_lock lock(impl->m_mutex);
 
-    return !impl->m_scheduled_jobs.empty();
+    return impl->get_scheduled_job_count_unlocked() > 0;
 }
 
 bool JobQueue::has_running_jobs() const
 {
     boost::mutex::scoped_lock lock(impl->m_mutex);
 
-    return !impl->m_running_jobs.empty();
+    return impl->get_running_job_count_unlocked() > 0;
 }
 
 bool JobQueue::has_scheduled_or_running_jobs() const
 {
     boost::mutex::scoped_lock lock(impl->m_mutex);
 
-    return !impl->m_scheduled_jobs.empty() || !impl->m_running_jobs.empty();
+    return impl->get_scheduled_job_count_unlocked() + impl->get_running_job_count_unlocked() > 0;
 }
 
 size_t JobQueue::get_scheduled_job_count() const
 {
     boost::mutex::scoped_lock lock(impl->m_mutex);
 
-    return impl->m_scheduled_jobs.size();
+    return impl->get_scheduled_job_count_unlocked();
 }
 
 size_t JobQueue::get_running_job_count() const
 {
     boost::mutex::scoped_lock lock(impl->m_mutex);
 
-    return impl->m_running_jobs.size();
+    return impl->get_running_job_count_unlocked();
 }
 
 size_t JobQueue::get_total_job_count() const
 {
     boost::mutex::scoped_lock lock(impl->m_mutex);
 
-    return impl->m_scheduled_jobs.size() + impl->m_running_jobs.size();
+    return impl->get_scheduled_job_count_unlocked() + impl->get_running_job_count_unlocked();
 }
 
 void JobQueue::schedule(IJob* job, const bool transfer_ownership)
 {
     assert(job);
 
+    if (impl->is_work_stealing())
+    {
+        // Distribute jobs over the per-worker queues in a round-robin fashion.
+        const size_t queue_index = impl->m_next_worker_queue++ % impl->m_worker_queues.size();
+        Impl::WorkerQueue& worker_queue = *impl->m_worker_queues[queue_index];
+
+        {
+            // Count the job before it can be acquired.
+            boost::mutex::scoped_lock lock(worker_queue.m_mutex);
+            ++impl->m_scheduled_job_count;
+            worker_queue.m_jobs.push_back(JobInfo(job, transfer_ownership));
+            ++worker_queue.m_job_count;
+        }
+
+        // Only wake up worker threads if some are waiting for jobs. A worker thread
+        // registers itself as sleeping before checking the scheduled job count,
+        // hence it cannot miss this job.
+        if (impl->m_sleeping_worker_count > 0)
+        {
+            boost::mutex::scoped_lock lock(impl->m_mutex);
+            impl->m_event.notify_all();
+        }
+
+        return;
+    }
+
     boost::mutex::scoped_lock lock(impl->m_mutex);
 
     impl->m_scheduled_jobs.push_back(JobInfo(job, transfer_ownership));
@@ -158,19 +262,42 @@ void JobQueue::wait_until_completion()
     boost::mutex::scoped_lock lock(impl->m_mutex);
 
     // Wait until there is no more scheduled or running jobs.
-    while (!impl->m_scheduled_jobs.empty() || !impl->m_running_jobs.empty())
+    while (impl->get_scheduled_job_count_unlocked() + impl->get_running_job_count_unlocked() > 0)
         impl->m_event.wait(lock);
 }
 
 JobQueue::RunningJobInfo JobQueue::acquire_scheduled_job()
 {
+    if (impl->is_work_stealing())
+        return acquire_worker_job(0);
+
     boost::mutex::scoped_lock lock(impl->m_mutex);
 
     return acquire_scheduled_job_unlocked();
 }
 
-JobQueue::RunningJobInfo JobQueue::wait_for_scheduled_job(AbortSwitch& abort_switch)
+JobQueue::RunningJobInfo JobQueue::wait_for_scheduled_job(
+    AbortSwitch&    abort_switch,
+    const size_t    worker_index)
 {
+    if (impl->is_work_stealing())
+    {
+        while (true)
+        {
+            const RunningJobInfo running_job_info = acquire_worker_job(worker_index);
+
+            if (running_job_info.first.m_job || abort_switch.is_aborted())
+                return running_job_info;
+
+            // Wait for a scheduled job to be available.
+            boost::mutex::scoped_lock lock(impl->m_mutex);
+            ++impl->m_sleeping_worker_count;
+            while (!abort_switch.is_aborted() && impl->m_scheduled_job_count == 0)    // order matters
+                impl->m_event.wait(lock);
+            --impl->m_sleeping_worker_count;
+        }
+    }
+
     boost::mutex::scoped_lock lock(impl->m_mutex);
 
     // Wait for a scheduled job to be available.
@@ -197,8 +324,93 @@ JobQueue::RunningJobInfo JobQueue::acquire_scheduled_job_unlocked()
     return RunningJobInfo(job_info, pred(impl->m_running_jobs.end()));
 }
 
+void JobQueue::enable_work_stealing(const size_t worker_count)
+{
+    assert(worker_count > 0);
+
+    boost::mutex::scoped_lock lock(impl->m_mutex);
+
+    if (impl->is_work_stealing())
+        return;
+
+    assert(impl->m_running_jobs.empty());
+
+    for (size_t i = 0; i < worker_count; ++i)
+        impl->m_worker_queues.push_back(new Impl::WorkerQueue());
+
+    // Move jobs already scheduled to the per-worker queues.
+    impl->m_scheduled_job_count = impl->m_scheduled_jobs.size();
+    for (const_each<JobList> i = impl->m_scheduled_jobs; i; ++i)
+    {
+        const size_t queue_index = impl->m_next_worker_queue++ % worker_count;
+        Impl::WorkerQueue& worker_queue = *impl->m_worker_queues[queue_index];
+        worker_queue.m_jobs.push_back(*i);
+        ++worker_queue.m_job_count;
+    }
+
+    impl->m_scheduled_jobs.clear();
+}
+
+JobQueue::RunningJobInfo JobQueue::acquire_worker_job(const size_t worker_index)
+{
+    assert(impl->is_work_stealing());
+
+    const size_t queue_count = impl->m_worker_queues.size();
+
+    if (impl->m_scheduled_job_count > 0)
+    {
+        for (size_t i = 0; i < queue_count; ++i)
+        {
+            // Start with the queue of this worker, then try to steal from the others.
+            Impl::WorkerQueue& worker_queue = *impl->m_worker_queues[(worker_index + i) % queue_count];
+
+            if (worker_queue.m_job_count == 0)
+                continue;
+
+            boost::mutex::scoped_lock lock(worker_queue.m_mutex);
+
+            if (worker_queue.m_jobs.empty())
+                continue;
+
+            // Workers execute their own jobs in scheduling order, and steal
+            // the most recently scheduled jobs from other workers.
+            const bool stealing = i > 0;
+            const JobInfo job_info = stealing ? worker_queue.m_jobs.back() : worker_queue.m_jobs.front();
+            if (stealing)
+                worker_queue.m_jobs.pop_back();
+            else worker_queue.m_jobs.pop_front();
+            --worker_queue.m_job_count;
+
+            // Increment the running job count first so that the total job count never drops to zero.
+            ++impl->m_running_job_count;
+            --impl->m_scheduled_job_count;
+
+            lock.unlock();
+
+            return RunningJobInfo(job_info, impl->m_running_jobs.end());
+        }
+    }
+
+    return RunningJobInfo(JobInfo(0, false), impl->m_running_jobs.end());
+}
+
 void JobQueue::retire_running_job(const RunningJobInfo& running_job_info)
 {
+    if (impl->is_work_stealing())
+    {
+        // Delete the job.
+        Impl::delete_job(running_job_info.first);
+
+        // Notify threads waiting for completion if this was the last job.
+        if (--impl->m_running_job_count == 0 && impl->m_scheduled_job_count == 0)
+        {
+            boost::mutex::scoped_lock lock(impl->m_mutex);
+            impl->m_event.notify_all();
+        }
+
+        return;
+    }
+
     boost::mutex::scoped_lock lock(impl->m_mutex);
 
     // Remove the job from the running list.
@@ -67,6 +67,12 @@ namespace foundation
 //   - scheduled: the job was inserted into the job queue, but hasn't yet been executed
 //   - running: the job is currently being executed
 //
+// By default, scheduled jobs are kept in a single list shared by all worker threads.
+// When the job queue is used by a job manager in work stealing mode (see
+// foundation::JobManager::WorkStealing), scheduled jobs are instead distributed over
+// per-worker queues: each worker thread takes jobs from its own queue, and steals
+// jobs from the queues of other worker threads when its own queue is empty.
+//
 
 class APPLESEED_DLLSYMBOL JobQueue
   : public NonCopyable
@@ -107,6 +113,7 @@ class APPLESEED_DLLSYMBOL JobQueue
     void wait_until_completion();
 
   private:
+    friend class JobManager;
     friend class WorkerThread;
 
     struct Impl;
@@ -137,12 +144,23 @@ class APPLESEED_DLLSYMBOL JobQueue
     // Acquire a scheduled job and change its state from 'scheduled' to 'running'.
     RunningJobInfo acquire_scheduled_job();
 
-    // Wait for a scheduled job to be available.
-    RunningJobInfo wait_for_scheduled_job(AbortSwitch& abort_switch);
+    // Wait for a scheduled job to be available. In work stealing mode, the job is
+    // preferably taken from the queue of the worker thread of index worker_index.
+    RunningJobInfo wait_for_scheduled_job(
+        AbortSwitch&    abort_switch,
+        const size_t    worker_index = 0);
 
     // Acquire a scheduled job without any locking.
     RunningJobInfo acquire_scheduled_job_unlocked();
 
+    // Switch to work stealing mode with a given number of per-worker queues.
+    // Jobs already scheduled are distributed over the per-worker queues.
+    void enable_work_stealing(const size_t worker_count);
+
+    // Acquire a scheduled job from the per-worker queues, stealing it from another
+    // worker if the queue of the worker of index worker_index is empty.
+    RunningJobInfo acquire_worker_job(const size_t worker_index);
+
     // Retire a running job. The job is deleted if it is owned by the queue.
     void retire_running_job(const RunningJobInfo& running_job_info);
 
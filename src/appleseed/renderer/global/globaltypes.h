@@ -60,7 +60,11 @@ typedef foundation::Ray<GScalar, 3> GRay3;
 typedef foundation::RayInfo<GScalar, 3> GRayInfo3;
 
 // Spectrum representation.
+#ifdef APPLESEED_USE_RGB_SPECTRUM
+typedef DynamicSpectrum3f Spectrum;
+#else
 typedef DynamicSpectrum31f Spectrum;
+#endif
 
 // Alpha channel representation.
 typedef foundation::Color<float, 1> Alpha;
@@ -34,6 +34,7 @@
 #include "renderer/global/globallogger.h"
 #include "renderer/global/globaltypes.h"
 #include "renderer/kernel/intersection/intersectionsettings.h"
+#include "renderer/kernel/intersection/objectinstancetree.h"
 #include "renderer/kernel/intersection/regioninfo.h"
 #include "renderer/kernel/shading/shadingpoint.h"
 #include "renderer/modeling/entity/entityvector.h"
@@ -42,6 +43,7 @@
 #include "renderer/modeling/object/meshobject.h"
 #include "renderer/modeling/object/object.h"
 #include "renderer/modeling/object/regionkit.h"
+#include "renderer/modeling/scene/archiveassembly.h"
 #include "renderer/modeling/scene/assemblyinstance.h"
 #include "renderer/modeling/scene/objectinstance.h"
 #include "renderer/modeling/scene/scene.h"
@@ -49,24 +51,31 @@
 
 // appleseed.foundation headers.
 #include "foundation/math/beziercurve.h"
+#include "foundation/math/intersection/rayaabb.h"
 #include "foundation/math/permutation.h"
 #include "foundation/math/ray.h"
 #include "foundation/math/transform.h"
 #include "foundation/math/vector.h"
+#include "foundation/platform/compiler.h"
 #include "foundation/platform/system.h"
 #include "foundation/platform/timers.h"
 #include "foundation/platform/types.h"
 #include "foundation/utility/alignedallocator.h"
 #include "foundation/utility/foreach.h"
+#include "foundation/utility/job/ijob.h"
+#include "foundation/utility/job/jobmanager.h"
+#include "foundation/utility/job/jobqueue.h"
 #include "foundation/utility/lazy.h"
 #include "foundation/utility/siphash.h"
 #include "foundation/utility/statistics.h"
+#include "foundation/utility/stopwatch.h"
 #include "foundation/utility/string.h"
 
 // Standard headers.
 #include <algorithm>
 #include <cassert>
 #include <cstring>
+#include <map>
 #include <set>
 #include <utility>
 
@@ -76,6 +85,59 @@ using namespace std;
 namespace renderer
 {
 
+namespace
+{
+    uint64 compute_transform_sequence_signature(const TransformSequence& transform_sequence)
+    {
+        uint64 signature = transform_sequence.size();
+
+        for (size_t i = 0, e = transform_sequence.size(); i < e; ++i)
+        {
+            float time;
+            Transformd transform;
+            transform_sequence.get_transform(i, time, transform);
+
+            signature = Entity::combine_signatures(signature, siphash24(time));
+            signature = Entity::combine_signatures(signature, siphash24(transform.get_local_to_parent()));
+        }
+
+        return signature;
+    }
+
+    // Compute a signature that changes whenever an assembly instance of the hierarchy
+    // is added, removed, transformed or refers to an assembly that changed.
+    uint64 compute_assembly_instances_signature(const AssemblyInstanceContainer& assembly_instances)
+    {
+        uint64 signature = 0;
+
+        for (const_each<AssemblyInstanceContainer> i = assembly_instances; i; ++i)
+        {
+            const AssemblyInstance& assembly_instance = *i;
+            const Assembly& assembly = assembly_instance.get_assembly();
+
+            signature = Entity::combine_signatures(signature, assembly_instance.compute_signature());
+            signature = Entity::combine_signatures(signature, assembly.compute_signature());
+            signature =
+                Entity::combine_signatures(
+                    signature,
+                    compute_transform_sequence_signature(assembly_instance.transform_sequence()));
+
+            // The contents of archives loaded on demand belong to nested trees.
+            const ArchiveAssembly* archive = dynamic_cast<const ArchiveAssembly*>(&assembly);
+            if (archive && archive->is_loaded_on_demand())
+                continue;
+
+            signature =
+                Entity::combine_signatures(
+                    signature,
+                    compute_assembly_instances_signature(assembly.assembly_instances()));
+        }
+
+        return signature;
+    }
+}
+
+
 //
 // AssemblyTree class implementation.
 //
@@ -83,6 +145,31 @@ namespace renderer
 AssemblyTree::AssemblyTree(const Scene& scene)
   : TreeType(AlignedAllocator<void>(System::get_l1_data_cache_line_size()))
   , m_scene(scene)
+  , m_assembly_instances(scene.assembly_instances())
+  , m_built_sah_cost(0.0)
+  , m_signature(0)
+  , m_rebuild_count(0)
+  , m_refit_count(0)
+  , m_rebuild_time(0.0)
+  , m_refit_time(0.0)
+{
+    update();
+}
+
+AssemblyTree::AssemblyTree(
+    const Scene&                        scene,
+    const AssemblyInstanceContainer&    assembly_instances,
+    const TransformSequence&            transform_sequence)
+  : TreeType(AlignedAllocator<void>(System::get_l1_data_cache_line_size()))
+  , m_scene(scene)
+  , m_assembly_instances(assembly_instances)
+  , m_transform_sequence(transform_sequence)
+  , m_built_sah_cost(0.0)
+  , m_signature(0)
+  , m_rebuild_count(0)
+  , m_refit_count(0)
+  , m_rebuild_time(0.0)
+  , m_refit_time(0.0)
 {
     update();
 }
@@ -90,14 +177,56 @@ AssemblyTree::AssemblyTree(const Scene& scene)
 AssemblyTree::~AssemblyTree()
 {
     RENDERER_LOG_INFO("deleting assembly tree...");
+
+    clear_deferred_items(m_deferred_items);
 }
 
 void AssemblyTree::update()
 {
-    rebuild_assembly_tree();
+    // Leave the assembly tree untouched if no assembly instance changed,
+    // e.g. when only the camera moved.
+    const uint64 signature =
+        Entity::combine_signatures(
+            compute_transform_sequence_signature(m_transform_sequence),
+            compute_assembly_instances_signature(m_assembly_instances));
+
+    if (m_rebuild_count == 0 || signature != m_signature)
+    {
+        m_signature = signature;
+
+        Stopwatch<DefaultWallclockTimer> stopwatch;
+        stopwatch.start();
+
+        if (refit_assembly_tree())
+        {
+            stopwatch.measure();
+            ++m_refit_count;
+            m_refit_time += stopwatch.get_seconds();
+        }
+        else
+        {
+            rebuild_assembly_tree();
+            stopwatch.measure();
+            ++m_rebuild_count;
+            m_rebuild_time += stopwatch.get_seconds();
+        }
+    }
+
+    // Child trees, intersection filters and other per-assembly data may need an update
+    // even if the assembly tree itself doesn't.
     update_tree_hierarchy();
 }
 
+Statistics AssemblyTree::get_statistics() const
+{
+    Statistics statistics;
+    statistics.insert("rebuilds", m_rebuild_count);
+    statistics.insert_time("rebuild time", m_rebuild_time);
+    statistics.insert("refits", m_refit_count);
+    statistics.insert_time("refit time", m_refit_time);
+    return statistics;
+}
+
 size_t AssemblyTree::get_memory_size() const
 {
     return
@@ -105,6 +234,9 @@ size_t AssemblyTree::get_memory_size() const
         - sizeof(*static_cast<const TreeType*>(this))
         + sizeof(*this)
         + m_items.capacity() * sizeof(AssemblyInstance*)
+        + m_item_ordering.capacity() * sizeof(size_t)
+        + m_assembly_instance_uids.capacity() * sizeof(UniqueID)
+        + m_deferred_items.capacity() * sizeof(DeferredItem*)
         + m_assembly_versions.size() * sizeof(pair<UniqueID, VersionID>);
 }
 
@@ -126,6 +258,30 @@ void AssemblyTree::collect_assembly_instances(
             assembly_instance.transform_sequence() * parent_transform_seq;
         cumulated_transform_seq.prepare();
 
+        // Archives loaded on demand are represented by their bounding box and
+        // intersected through a nested tree built the first time a ray enters it.
+        ArchiveAssembly* archive = dynamic_cast<ArchiveAssembly*>(&assembly_instance.get_assembly());
+        if (archive && archive->is_loaded_on_demand())
+        {
+            m_items.push_back(
+                Item(
+                    &assembly,
+                    &assembly_instance,
+                    cumulated_transform_seq,
+                    m_deferred_items.size()));
+            const GAABB3 archive_local_bbox = archive->compute_local_bbox();
+
+            AABB3d deferred_item_bbox(archive_local_bbox);
+            deferred_item_bbox.robust_grow(1.0e-15);
+            m_deferred_items.push_back(
+                new DeferredItem(archive, cumulated_transform_seq, deferred_item_bbox));
+
+            AABB3d archive_bbox(cumulated_transform_seq.to_parent(archive_local_bbox));
+            archive_bbox.robust_grow(1.0e-15);
+            assembly_instance_bboxes.push_back(archive_bbox);
+            continue;
+        }
+
         // Recurse into child assembly instances.
         collect_assembly_instances(
             assembly.assembly_instances(),
@@ -157,6 +313,9 @@ void AssemblyTree::rebuild_assembly_tree()
     // Clear the current tree.
     clear();
     m_items.clear();
+    m_item_ordering.clear();
+    m_assembly_instance_uids.clear();
+    clear_deferred_items(m_deferred_items);
 
     Statistics statistics;
 
@@ -164,8 +323,8 @@ void AssemblyTree::rebuild_assembly_tree()
     RENDERER_LOG_INFO("collecting assembly instances...");
     AABBVector assembly_instance_bboxes;
     collect_assembly_instances(
-        m_scene.assembly_instances(),
-        TransformSequence(),
+        m_assembly_instances,
+        m_transform_sequence,
         assembly_instance_bboxes);
 
     RENDERER_LOG_INFO(
@@ -203,6 +362,17 @@ void AssemblyTree::rebuild_assembly_tree()
 
         // Store the items in the tree leaves whenever possible.
         store_items_in_leaves(statistics);
+
+        // Keep what is needed to refit the tree later on.
+        m_item_ordering = ordering;
+        m_assembly_instance_uids.reserve(m_items.size());
+        for (const_each<ItemVector> i = m_items; i; ++i)
+            m_assembly_instance_uids.push_back(i->m_assembly_instance->get_uid());
+        m_built_sah_cost =
+            bvh::Refitter<AssemblyTree>::compute_sah_cost(
+                *this,
+                AssemblyTreeInteriorNodeTraversalCost,
+                AssemblyTreeTriangleIntersectionCost);
     }
 
     // Print assembly tree statistics.
@@ -212,6 +382,177 @@ void AssemblyTree::rebuild_assembly_tree()
             statistics).to_string().c_str());
 }
 
+bool AssemblyTree::refit_assembly_tree()
+{
+    if (m_items.empty())
+        return false;
+
+    // Collect assembly instances and their bounding boxes. Keep the previous
+    // deferred items around since their nested trees may still be valid.
+    ItemVector previous_items;
+    previous_items.swap(m_items);
+    DeferredItemVector previous_deferred_items;
+    previous_deferred_items.swap(m_deferred_items);
+    AABBVector assembly_instance_bboxes;
+    collect_assembly_instances(
+        m_assembly_instances,
+        m_transform_sequence,
+        assembly_instance_bboxes);
+
+    const bool refitted = refit_items(previous_items, assembly_instance_bboxes);
+
+    if (refitted)
+    {
+        // The same archives are collected in the same order: reuse the nested trees
+        // of the archives that didn't move.
+        assert(m_deferred_items.size() == previous_deferred_items.size());
+
+        for (size_t i = 0, e = m_deferred_items.size(); i < e; ++i)
+        {
+            DeferredItem& item = *m_deferred_items[i];
+            DeferredItem& previous_item = *previous_deferred_items[i];
+            assert(item.m_archive == previous_item.m_archive);
+
+            if (compute_transform_sequence_signature(item.m_transform_sequence) ==
+                compute_transform_sequence_signature(previous_item.m_transform_sequence))
+            {
+                item.m_tree.store(previous_item.m_tree.load());
+                previous_item.m_tree.store(0);
+            }
+        }
+    }
+
+    clear_deferred_items(previous_deferred_items);
+
+    return refitted;
+}
+
+bool AssemblyTree::refit_items(
+    const ItemVector&                   previous_items,
+    AABBVector&                         assembly_instance_bboxes)
+{
+    // The tree can only be refitted if the same assembly instances of the same
+    // assemblies are collected in the same order as when the tree was built.
+    if (m_items.size() != previous_items.size())
+        return false;
+
+    for (size_t i = 0, e = m_items.size(); i < e; ++i)
+    {
+        const Item& item = m_items[m_item_ordering[i]];
+
+        if (item.m_assembly_uid != previous_items[i].m_assembly_uid ||
+            item.m_assembly_instance->get_uid() != m_assembly_instance_uids[i])
+            return false;
+    }
+
+    // Reorder the items and their bounding boxes according to the tree ordering.
+    ItemVector temp_items(m_items.size());
+    small_item_reorder(
+        &m_items[0],
+        &temp_items[0],
+        &m_item_ordering[0],
+        m_item_ordering.size());
+    AABBVector temp_bboxes(assembly_instance_bboxes.size());
+    small_item_reorder(
+        &assembly_instance_bboxes[0],
+        &temp_bboxes[0],
+        &m_item_ordering[0],
+        m_item_ordering.size());
+
+    // Refit the tree.
+    typedef bvh::Refitter<AssemblyTree> Refitter;
+    Refitter refitter;
+    refitter.refit<DefaultWallclockTimer>(*this, assembly_instance_bboxes);
+
+    // Rebuild the tree if its quality degraded too much.
+    const double sah_cost =
+        Refitter::compute_sah_cost(
+            *this,
+            AssemblyTreeInteriorNodeTraversalCost,
+            AssemblyTreeTriangleIntersectionCost);
+    if (sah_cost > m_built_sah_cost * AssemblyTreeMaxRefitCostRatio)
+    {
+        RENDERER_LOG_DEBUG(
+            "assembly tree cost went from %f to %f after refitting, rebuilding it.",
+            m_built_sah_cost,
+            sah_cost);
+        return false;
+    }
+
+    // Store the updated items in the tree leaves.
+    Statistics statistics;
+    store_items_in_leaves(statistics);
+
+    RENDERER_LOG_INFO(
+        "refitted assembly tree (%s %s) in %s.",
+        pretty_int(m_items.size()).c_str(),
+        plural(m_items.size(), "assembly instance").c_str(),
+        pretty_time(refitter.get_refit_time()).c_str());
+
+    return true;
+}
+
+void AssemblyTree::clear_deferred_items(DeferredItemVector& deferred_items)
+{
+    for (each<DeferredItemVector> i = deferred_items; i; ++i)
+    {
+        delete (*i)->m_tree.load();
+        delete *i;
+    }
+
+    deferred_items.clear();
+}
+
+const AssemblyTree& AssemblyTree::get_deferred_tree(const size_t deferred_index) const
+{
+    DeferredItem& item = *m_deferred_items[deferred_index];
+
+    AssemblyTree* tree = item.m_tree.load(boost::memory_order_acquire);
+
+    if (tree == 0)
+    {
+        // Load the archive first: the archive is loaded without holding any lock.
+        item.m_archive->load_on_demand();
+
+        boost::mutex::scoped_lock lock(item.m_mutex);
+
+        tree = item.m_tree.load(boost::memory_order_relaxed);
+
+        if (tree == 0)
+        {
+            // Build a tree for the assembly instances of the archive
+            // directly in the space of this tree.
+            tree =
+                new AssemblyTree(
+                    m_scene,
+                    item.m_archive->assembly_instances(),
+                    item.m_transform_sequence);
+
+            item.m_tree.store(tree, boost::memory_order_release);
+        }
+    }
+
+    return *tree;
+}
+
+bool AssemblyTree::DeferredItem::is_entered_by(const ShadingRay& ray) const
+{
+    // Static archives are entirely described by their bounding box in the tree.
+    if (m_transform_sequence.size() < 2)
+        return true;
+
+    // Transform the ray to archive space at the time of the ray.
+    Transformd scratch;
+    const Transformd& transform = m_transform_sequence.evaluate(ray.m_time.m_absolute, scratch);
+    const Ray3d local_ray(
+        transform.point_to_local(ray.m_org),
+        transform.vector_to_local(ray.m_dir),
+        ray.m_tmin,
+        ray.m_tmax);
+
+    return intersect(local_ray, RayInfo3d(local_ray), m_local_bbox);
+}
+
 void AssemblyTree::store_items_in_leaves(Statistics& statistics)
 {
     size_t leaf_count = 0;
@@ -362,16 +703,69 @@ namespace
         return hash;
     }
 
-    void collect_regions(const Assembly& assembly, RegionInfoVector& regions)
+    void collect_object_instance_groups(const Assembly& assembly, ObjectInstanceGroupVector& groups)
+    {
+        assert(groups.empty());
+
+        const size_t threshold =
+            assembly.get_parameters().child("acceleration_structure").get_optional<size_t>(
+                "object_instancing_threshold",
+                ObjectInstancingDefaultThreshold);
+
+        // A threshold of 0 disables object instancing.
+        if (threshold == 0)
+            return;
+
+        // Group the object instances of each mesh object.
+        typedef map<UniqueID, ObjectInstanceIndexVector> ObjectInstanceGroupMap;
+        ObjectInstanceGroupMap object_instance_groups;
+
+        const ObjectInstanceContainer& object_instances = assembly.object_instances();
+        const size_t object_instance_count = object_instances.size();
+
+        for (size_t obj_inst_index = 0; obj_inst_index < object_instance_count; ++obj_inst_index)
+        {
+            const ObjectInstance* object_instance = object_instances.get_by_index(obj_inst_index);
+            assert(object_instance);
+
+            const Object& object = object_instance->get_object();
+
+            if (strcmp(object.get_model(), MeshObjectFactory::get_model()) == 0)
+                object_instance_groups[object.get_uid()].push_back(obj_inst_index);
+        }
+
+        // Only keep objects that are instanced often enough.
+        for (const_each<ObjectInstanceGroupMap> i = object_instance_groups; i; ++i)
+        {
+            if (i->second.size() >= threshold)
+                groups.push_back(i->second);
+        }
+    }
+
+    void collect_regions(
+        const Assembly&                     assembly,
+        const ObjectInstanceGroupVector&    object_instance_groups,
+        RegionInfoVector&                   regions)
     {
         assert(regions.empty());
 
         const ObjectInstanceContainer& object_instances = assembly.object_instances();
         const size_t object_instance_count = object_instances.size();
 
-        // Collect all regions of all object instances of this assembly.
+        // Object instances sharing the geometry of their object are intersected separately.
+        vector<bool> shared(object_instance_count, false);
+        for (const_each<ObjectInstanceGroupVector> i = object_instance_groups; i; ++i)
+        {
+            for (const_each<ObjectInstanceIndexVector> j = *i; j; ++j)
+                shared[*j] = true;
+        }
+
+        // Collect all regions of all other object instances of this assembly.
         for (size_t obj_inst_index = 0; obj_inst_index < object_instance_count; ++obj_inst_index)
         {
+            if (shared[obj_inst_index])
+                continue;
+
             // Retrieve the object instance and its transformation.
             const ObjectInstance* object_instance = object_instances.get_by_index(obj_inst_index);
             assert(object_instance);
@@ -452,8 +846,13 @@ void AssemblyTree::create_triangle_tree(const Assembly& assembly)
                 assembly.object_instances().begin(),
                 assembly.object_instances().end());
 
+        // Objects instanced many times in the assembly are intersected through a triangle tree
+        // shared by their instances rather than through copies of their triangles.
+        ObjectInstanceGroupVector object_instance_groups;
+        collect_object_instance_groups(assembly, object_instance_groups);
+
         RegionInfoVector regions;
-        collect_regions(assembly, regions);
+        collect_regions(assembly, object_instance_groups, regions);
 
         auto_ptr<ILazyFactory<TriangleTree> > triangle_tree_factory(
             new TriangleTreeFactory(
@@ -462,7 +861,9 @@ void AssemblyTree::create_triangle_tree(const Assembly& assembly)
                     assembly.get_uid(),
                     assembly_bbox,
                     assembly,
-                    regions)));
+                    regions,
+                    ObjectInstanceIndexVector(),
+                    object_instance_groups)));
 
         tree = new Lazy<TriangleTree>(triangle_tree_factory);
         m_triangle_tree_repository.insert(hash, tree);
@@ -549,6 +950,41 @@ namespace
             update->update_non_geometry(enable_intersection_filters);
         }
     };
+
+    template <typename TreeType>
+    class UpdateTreeJob
+      : public IJob
+    {
+      public:
+        UpdateTreeJob(
+            Lazy<TreeType>&     tree,
+            const size_t        ref_count)
+          : m_tree(tree)
+          , m_ref_count(ref_count)
+        {
+        }
+
+        virtual void execute(const size_t thread_index) APPLESEED_OVERRIDE
+        {
+            UpdateTrees<TreeType> update_trees;
+            update_trees(m_tree, m_ref_count);
+        }
+
+      private:
+        Lazy<TreeType>&         m_tree;
+        const size_t            m_ref_count;
+    };
+
+    template <typename TreeType>
+    struct CollectTrees
+    {
+        vector<pair<Lazy<TreeType>*, size_t> > m_trees;
+
+        void operator()(Lazy<TreeType>& tree, const size_t ref_count)
+        {
+            m_trees.push_back(make_pair(&tree, ref_count));
+        }
+    };
 }
 
 void AssemblyTree::update_region_trees()
@@ -559,10 +995,55 @@ void AssemblyTree::update_region_trees()
 
 void AssemblyTree::update_triangle_trees()
 {
-    UpdateTrees<TriangleTree> update_trees;
-    m_triangle_tree_repository.for_each(update_trees);
-}
+    CollectTrees<TriangleTree> collect_trees;
+    m_triangle_tree_repository.for_each(collect_trees);
+
+    if (collect_trees.m_trees.empty())
+        return;
+
+    // Start a single pool of worker threads used at both levels of parallelism.
+    const size_t thread_count = System::get_logical_cpu_core_count();
+    JobQueue job_queue;
+    JobManager job_manager(
+        global_logger(),
+        job_queue,
+        thread_count,
+        JobManager::KeepRunningOnEmptyQueue | JobManager::KeepRunningOnJobFailure);
+
+    // Triangle trees of different assemblies are independent: small trees are built
+    // concurrently, each one on a single worker thread. Trees that are large enough to
+    // be built in parallel are built afterward, one after the other, each one using all
+    // the worker threads. Tree builders wait for the whole job queue to drain, so they
+    // cannot share it with other jobs.
+    vector<size_t> large_trees;
+
+    for (size_t i = 0, e = collect_trees.m_trees.size(); i < e; ++i)
+    {
+        Lazy<TriangleTree>& tree = *collect_trees.m_trees[i].first;
+
+        // Trees that are not built yet are created by the factory set in create_triangle_tree().
+        TriangleTreeFactory* factory = static_cast<TriangleTreeFactory*>(tree.get_factory());
+        if (factory && factory->estimate_triangle_count() >= TriangleTreeMinParallelBuildSize)
+        {
+            factory->set_build_job_queue(&job_queue, thread_count);
+            large_trees.push_back(i);
+        }
+        else
+        {
+            job_queue.schedule(
+                new UpdateTreeJob<TriangleTree>(tree, collect_trees.m_trees[i].second));
+        }
+    }
 
+    job_manager.start();
+    job_queue.wait_until_completion();
+
+    for (const_each<vector<size_t> > i = large_trees; i; ++i)
+    {
+        UpdateTrees<TriangleTree> update_trees;
+        update_trees(*collect_trees.m_trees[*i].first, collect_trees.m_trees[*i].second);
+    }
+}
 
 //
 // Utility function to transform a ray to the space of an assembly instance.
@@ -648,6 +1129,42 @@ bool AssemblyLeafVisitor::visit(
 
         FOUNDATION_BVH_TRAVERSAL_STATS(stats.m_intersected_items.insert(1));
 
+        // Archives loaded on demand are intersected through their nested tree.
+        if (item.m_deferred_index != ~size_t(0))
+        {
+            // Assembly trees bound moving items over the whole shutter interval: the nested
+            // tree is traversed without motion, items being positioned at the time of the ray.
+            if (!m_tree.m_deferred_items[item.m_deferred_index]->is_entered_by(ray))
+                continue;
+
+            const AssemblyTree& deferred_tree = m_tree.get_deferred_tree(item.m_deferred_index);
+
+            AssemblyLeafVisitor visitor(
+                m_shading_point,
+                deferred_tree,
+                m_region_tree_cache,
+                m_triangle_tree_cache,
+                m_curve_tree_cache,
+                m_parent_shading_point
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+                , m_triangle_tree_stats
+                , m_curve_tree_stats
+#endif
+                );
+            AssemblyTreeIntersector intersector;
+            intersector.intersect_no_motion(
+                deferred_tree,
+                ray,
+                ray_info,
+                visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+                , stats
+#endif
+                );
+
+            continue;
+        }
+
         // Evaluate the transformation of the assembly instance.
         const TransformSequence* assembly_instance_transform_seq =
             &item.m_transform_sequence;
@@ -727,6 +1244,29 @@ bool AssemblyLeafVisitor::visit(
                         );
                 }
                 visitor.read_hit_triangle_data();
+
+                // Check the intersection between the ray and the object instances sharing the geometry of their object.
+                const ObjectInstanceTree* object_instance_tree = triangle_tree->get_object_instance_tree();
+                if (object_instance_tree)
+                {
+                    ObjectInstanceLeafVisitor visitor(
+                        *object_instance_tree,
+                        local_shading_point
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+                        , m_triangle_tree_stats
+#endif
+                        );
+                    ObjectInstanceTreeIntersector intersector;
+                    intersector.intersect_no_motion(
+                        *object_instance_tree,
+                        local_shading_point.m_ray,
+                        local_ray_info,
+                        visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+                        , m_triangle_tree_stats
+#endif
+                        );
+                }
             }
         }
 
@@ -811,6 +1351,48 @@ bool AssemblyLeafProbeVisitor::visit(
 
         FOUNDATION_BVH_TRAVERSAL_STATS(stats.m_intersected_items.insert(1));
 
+        // Archives loaded on demand are intersected through their nested tree.
+        if (item.m_deferred_index != ~size_t(0))
+        {
+            // Assembly trees bound moving items over the whole shutter interval: the nested
+            // tree is traversed without motion, items being positioned at the time of the ray.
+            if (!m_tree.m_deferred_items[item.m_deferred_index]->is_entered_by(ray))
+                continue;
+
+            const AssemblyTree& deferred_tree = m_tree.get_deferred_tree(item.m_deferred_index);
+
+            AssemblyLeafProbeVisitor visitor(
+                deferred_tree,
+                m_region_tree_cache,
+                m_triangle_tree_cache,
+                m_curve_tree_cache,
+                m_parent_shading_point
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+                , m_triangle_tree_stats
+                , m_curve_tree_stats
+#endif
+                );
+            AssemblyTreeProbeIntersector intersector;
+            intersector.intersect_no_motion(
+                deferred_tree,
+                ray,
+                ray_info,
+                visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+                , stats
+#endif
+                );
+
+            // Terminate traversal if there was a hit.
+            if (visitor.hit())
+            {
+                m_hit = true;
+                return false;
+            }
+
+            continue;
+        }
+
         // Evaluate the transformation of the assembly instance.
         Transformd scratch;
         const Transformd& assembly_instance_transform =
@@ -900,6 +1482,37 @@ bool AssemblyLeafProbeVisitor::visit(
                     m_hit = true;
                     return false;
                 }
+
+                // Check the intersection between the ray and the object instances sharing the geometry of their object.
+                const ObjectInstanceTree* object_instance_tree = triangle_tree->get_object_instance_tree();
+                if (object_instance_tree)
+                {
+                    ObjectInstanceLeafProbeVisitor visitor(
+                        *object_instance_tree,
+                        local_ray.m_time.m_normalized,
+                        local_ray.m_flags
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+                        , m_triangle_tree_stats
+#endif
+                        );
+                    ObjectInstanceTreeProbeIntersector intersector;
+                    intersector.intersect_no_motion(
+                        *object_instance_tree,
+                        local_ray,
+                        local_ray_info,
+                        visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+                        , m_triangle_tree_stats
+#endif
+                        );
+
+                    // Terminate traversal if there was a hit.
+                    if (visitor.hit())
+                    {
+                        m_hit = true;
+                        return false;
+                    }
+                }
             }
         }
 
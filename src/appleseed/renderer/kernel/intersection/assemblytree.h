@@ -45,10 +45,15 @@
 #include "foundation/core/concepts/noncopyable.h"
 #include "foundation/math/aabb.h"
 #include "foundation/math/bvh.h"
+#include "foundation/platform/thread.h"
+#include "foundation/platform/types.h"
 #include "foundation/utility/alignedvector.h"
 #include "foundation/utility/uid.h"
 #include "foundation/utility/version.h"
 
+// Boost headers.
+#include "boost/atomic/atomic.hpp"
+
 // Standard headers.
 #include <cstddef>
 #include <map>
@@ -56,6 +61,7 @@
 
 // Forward declarations.
 namespace foundation    { class Statistics; }
+namespace renderer      { class ArchiveAssembly; }
 namespace renderer      { class AssemblyInstance; }
 namespace renderer      { class Scene; }
 namespace renderer      { class ShadingPoint; }
@@ -81,9 +87,14 @@ class AssemblyTree
     // Destructor.
     ~AssemblyTree();
 
-    // Update the assembly tree and all the child trees.
+    // Update the assembly tree and all the child trees. The assembly tree is left untouched
+    // if no assembly instance changed, and refitted rather than rebuilt when only the
+    // transforms of assembly instances changed. Child trees are always updated.
     void update();
 
+    // Return statistics about the updates of the assembly tree.
+    foundation::Statistics get_statistics() const;
+
     // Return the size (in bytes) of this object in memory.
     size_t get_memory_size() const;
 
@@ -98,38 +109,92 @@ class AssemblyTree
         foundation::UniqueID                    m_assembly_uid;
         const renderer::AssemblyInstance*       m_assembly_instance;
         renderer::TransformSequence             m_transform_sequence;
+        size_t                                  m_deferred_index;   // index of the deferred item, or ~0
 
         Item() {}
 
         Item(
             const renderer::Assembly*           assembly,
             const renderer::AssemblyInstance*   assembly_instance,
-            renderer::TransformSequence         transform_sequence)
+            renderer::TransformSequence         transform_sequence,
+            const size_t                        deferred_index = ~size_t(0))
           : m_assembly(assembly)
           , m_assembly_uid(assembly->get_uid())
           , m_assembly_instance(assembly_instance)
           , m_transform_sequence(transform_sequence)
+          , m_deferred_index(deferred_index)
         {
         }
     };
 
+    // An instance of an archive loaded on demand. Its contents are intersected
+    // through a nested assembly tree built the first time a ray enters it.
+    struct DeferredItem
+    {
+        ArchiveAssembly*                        m_archive;
+        renderer::TransformSequence             m_transform_sequence;
+        foundation::AABB3d                      m_local_bbox;       // bounding box of the archive contents in archive space
+        boost::mutex                            m_mutex;
+        boost::atomic<AssemblyTree*>            m_tree;
+
+        DeferredItem(
+            ArchiveAssembly*                    archive,
+            const renderer::TransformSequence&  transform_sequence,
+            const foundation::AABB3d&           local_bbox)
+          : m_archive(archive)
+          , m_transform_sequence(transform_sequence)
+          , m_local_bbox(local_bbox)
+          , m_tree(0)
+        {
+        }
+
+        // Return true if a ray enters the archive at the time of the ray. The bounding box
+        // of the item in the tree covers the whole motion of moving archives, this test
+        // keeps rays that miss a moving archive at their time from loading or visiting it.
+        bool is_entered_by(const ShadingRay& ray) const;
+    };
+
     typedef std::vector<Item> ItemVector;
+    typedef std::vector<DeferredItem*> DeferredItemVector;
     typedef std::vector<foundation::AABB3d> AABBVector;
     typedef std::vector<const Assembly*> AssemblyVector;
     typedef std::map<foundation::UniqueID, foundation::VersionID> AssemblyVersionMap;
 
-    const Scene&                    m_scene;
-    ItemVector                      m_items;
-    AssemblyVersionMap              m_assembly_versions;
-
-    TreeRepository<TriangleTree>    m_triangle_tree_repository;
-    TriangleTreeContainer           m_triangle_trees;
+    const Scene&                         m_scene;
+    const AssemblyInstanceContainer&     m_assembly_instances;
+    const TransformSequence              m_transform_sequence;
+    ItemVector                           m_items;
+    std::vector<size_t>                  m_item_ordering;
+    std::vector<foundation::UniqueID>    m_assembly_instance_uids;
+    double                               m_built_sah_cost;
+    foundation::uint64                   m_signature;
+    DeferredItemVector                   m_deferred_items;
+    AssemblyVersionMap                   m_assembly_versions;
+
+    TreeRepository<TriangleTree>         m_triangle_tree_repository;
+    TriangleTreeContainer                m_triangle_trees;
+
+    TreeRepository<RegionTree>           m_region_tree_repository;
+    RegionTreeContainer                  m_region_trees;
+
+    TreeRepository<CurveTree>            m_curve_tree_repository;
+    CurveTreeContainer                   m_curve_trees;
+
+    foundation::uint64                   m_rebuild_count;
+    foundation::uint64                   m_refit_count;
+    double                               m_rebuild_time;
+    double                               m_refit_time;
+
+    // Constructor, builds a tree for assembly instances of an archive loaded on demand.
+    AssemblyTree(
+        const Scene&                            scene,
+        const AssemblyInstanceContainer&        assembly_instances,
+        const TransformSequence&                transform_sequence);
 
-    TreeRepository<RegionTree>      m_region_tree_repository;
-    RegionTreeContainer             m_region_trees;
+    // Return the nested tree of a deferred item, loading the archive if needed. Thread-safe.
+    const AssemblyTree& get_deferred_tree(const size_t deferred_index) const;
 
-    TreeRepository<CurveTree>       m_curve_tree_repository;
-    CurveTreeContainer              m_curve_trees;
+    static void clear_deferred_items(DeferredItemVector& deferred_items);
 
     void collect_assembly_instances(
         const AssemblyInstanceContainer&        assembly_instances,
@@ -137,6 +202,10 @@ class AssemblyTree
         AABBVector&                             assembly_instance_bboxes);
 
     void rebuild_assembly_tree();
+    bool refit_assembly_tree();
+    bool refit_items(
+        const ItemVector&                       previous_items,
+        AABBVector&                             assembly_instance_bboxes);
     void store_items_in_leaves(foundation::Statistics& statistics);
 
     void update_tree_hierarchy();
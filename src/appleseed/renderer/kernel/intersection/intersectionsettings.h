@@ -57,6 +57,10 @@ const double AssemblyTreeInteriorNodeTraversalCost = 1.0;
 // Relative cost of intersecting an assembly.
 const double AssemblyTreeTriangleIntersectionCost = 10.0;
 
+// The assembly tree is rebuilt instead of refitted when refitting would increase its cost
+// (according to the surface area heuristic) by more than this factor since it was built.
+const double AssemblyTreeMaxRefitCostRatio = 1.5;
+
 
 //
 // Region tree settings.
@@ -76,6 +80,25 @@ const size_t RegionTreeAccessCacheLines = 16;
 const size_t RegionTreeAccessCacheWays = 1;
 
 
+//
+// Object instance tree settings.
+//
+
+// Default minimum number of instances of an object in an assembly for the object
+// to be intersected through a shared triangle tree rather than through copies of
+// its triangles, 0 to always copy triangles. Can be overridden per assembly.
+const size_t ObjectInstancingDefaultThreshold = 0;
+
+// Maximum number of object instances per leaf.
+const size_t ObjectInstanceTreeMaxLeafSize = 1;
+
+// Relative cost of traversing an interior node.
+const double ObjectInstanceTreeInteriorNodeTraversalCost = 1.0;
+
+// Relative cost of intersecting an object instance.
+const double ObjectInstanceTreeInstanceIntersectionCost = 10.0;
+
+
 //
 // Triangle tree settings.
 //
@@ -99,6 +122,12 @@ const GScalar TriangleTreeDefaultTriangleIntersectionCost(1.0);
 // Number of bins used during SBVH construction.
 const size_t TriangleTreeDefaultBinCount = 256;
 
+// Minimum number of triangles for a triangle tree to be built using multiple threads.
+const size_t TriangleTreeMinParallelBuildSize = 16 * 1024;
+
+// Minimum number of triangles in a BVH node or SBVH leaf for it to be split using multiple threads.
+const size_t TriangleTreeMinParallelSplitSize = 64 * 1024;
+
 // Define this symbol to enable reordering the nodes of triangle trees for better
 // locality of reference. Requires a lot of temporary memory for minimal results.
 #undef RENDERER_TRIANGLE_TREE_REORDER_NODES
@@ -113,6 +142,10 @@ const size_t TriangleTreeAccessCacheWays = 2;
 // Size of the stack (in number of nodes) used during traversal.
 const size_t TriangleTreeStackSize = 64;
 
+// Size of the stack (in number of nodes) used during traversal of wide trees.
+// Up to 7 nodes are pushed per level when traversing 8-wide trees.
+const size_t TriangleTreeWideStackSize = 7 * TriangleTreeStackSize;
+
 
 //
 // Curve tree settings.
@@ -0,0 +1,400 @@
+
+//
+// This source file is part of appleseed.
+// Visit http://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2010-2013 Francois Beaune, Jupiter Jazz Limited
+// Copyright (c) 2014-2017 Francois Beaune, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// Interface header.
+#include "objectinstancetree.h"
+
+// appleseed.renderer headers.
+#include "renderer/global/globallogger.h"
+#include "renderer/global/globaltypes.h"
+#include "renderer/kernel/intersection/intersectionsettings.h"
+#include "renderer/kernel/intersection/regioninfo.h"
+#include "renderer/kernel/shading/shadingpoint.h"
+#include "renderer/kernel/shading/shadingray.h"
+#include "renderer/modeling/object/iregion.h"
+#include "renderer/modeling/object/object.h"
+#include "renderer/modeling/object/regionkit.h"
+#include "renderer/modeling/scene/assembly.h"
+#include "renderer/modeling/scene/containers.h"
+#include "renderer/modeling/scene/objectinstance.h"
+
+// appleseed.foundation headers.
+#include "foundation/math/permutation.h"
+#include "foundation/platform/system.h"
+#include "foundation/platform/timers.h"
+#include "foundation/utility/alignedallocator.h"
+#include "foundation/utility/api/apistring.h"
+#include "foundation/utility/foreach.h"
+#include "foundation/utility/lazy.h"
+#include "foundation/utility/statistics.h"
+#include "foundation/utility/string.h"
+#include "foundation/utility/uid.h"
+
+// Standard headers.
+#include <cassert>
+
+using namespace foundation;
+using namespace std;
+
+namespace renderer
+{
+
+//
+// ObjectInstanceTree class implementation.
+//
+
+ObjectInstanceTree::ObjectInstanceTree(
+    const Scene&                        scene,
+    const Assembly&                     assembly,
+    const ObjectInstanceGroupVector&    object_instance_groups,
+    JobQueue*                           build_job_queue,
+    const size_t                        build_thread_count)
+  : TreeType(AlignedAllocator<void>(System::get_l1_data_cache_line_size()))
+{
+    const ObjectInstanceContainer& object_instances = assembly.object_instances();
+
+    vector<AABB3d> object_instance_bboxes;
+
+    for (const_each<ObjectInstanceGroupVector> i = object_instance_groups; i; ++i)
+    {
+        const ObjectInstanceIndexVector& group = *i;
+        assert(!group.empty());
+
+        // Retrieve the object shared by the object instances of this group.
+        const ObjectInstance* first_object_instance = object_instances.get_by_index(group[0]);
+        assert(first_object_instance);
+        Object& object = first_object_instance->get_object();
+
+        // Collect the regions of the object, in object space.
+        RegionInfoVector regions;
+        {
+            Access<RegionKit> region_kit(&object.get_region_kit());
+
+            for (size_t region_index = 0; region_index < region_kit->size(); ++region_index)
+            {
+                regions.push_back(
+                    RegionInfo(
+                        group[0],
+                        region_index,
+                        (*region_kit)[region_index]->compute_local_bbox()));
+            }
+        }
+
+        // Build the triangle tree shared by the object instances of this group.
+        TriangleTree::Arguments arguments(
+            scene,
+            new_guid(),
+            object.compute_local_bbox(),
+            assembly,
+            regions,
+            group);
+        arguments.m_build_job_queue = build_job_queue;
+        arguments.m_build_thread_count = build_thread_count;
+        TriangleTree* triangle_tree = new TriangleTree(arguments);
+        m_triangle_trees.push_back(triangle_tree);
+
+        // Create one item per object instance.
+        for (const_each<ObjectInstanceIndexVector> j = group; j; ++j)
+        {
+            const ObjectInstance* object_instance = object_instances.get_by_index(*j);
+            assert(object_instance);
+            assert(&object_instance->get_object() == &object);
+
+            Item item;
+            item.m_triangle_tree = triangle_tree;
+            item.m_object_instance_index = *j;
+            item.m_vis_flags = object_instance->get_vis_flags();
+            item.m_transform = object_instance->get_transform();
+            m_items.push_back(item);
+
+            AABB3d object_instance_bbox(object_instance->compute_parent_bbox());
+            object_instance_bbox.robust_grow(1.0e-15);
+            object_instance_bboxes.push_back(object_instance_bbox);
+        }
+    }
+
+    // Create the partitioner.
+    typedef bvh::SAHPartitioner<vector<AABB3d> > Partitioner;
+    Partitioner partitioner(
+        object_instance_bboxes,
+        ObjectInstanceTreeMaxLeafSize,
+        ObjectInstanceTreeInteriorNodeTraversalCost,
+        ObjectInstanceTreeInstanceIntersectionCost);
+
+    // Build the tree.
+    typedef bvh::Builder<ObjectInstanceTree, Partitioner> Builder;
+    Builder builder;
+    builder.build<DefaultWallclockTimer>(*this, partitioner, m_items.size(), ObjectInstanceTreeMaxLeafSize);
+
+    // Reorder the items according to the tree ordering.
+    if (!m_items.empty())
+    {
+        const vector<size_t>& ordering = partitioner.get_item_ordering();
+        assert(m_items.size() == ordering.size());
+
+        vector<Item> temp_items(ordering.size());
+        small_item_reorder(
+            &m_items[0],
+            &temp_items[0],
+            &ordering[0],
+            ordering.size());
+    }
+
+    RENDERER_LOG_INFO(
+        "built object instance tree for assembly \"%s\" (%s %s sharing %s %s) in %s.",
+        assembly.get_path().c_str(),
+        pretty_uint(m_items.size()).c_str(),
+        plural(m_items.size(), "object instance").c_str(),
+        pretty_uint(m_triangle_trees.size()).c_str(),
+        plural(m_triangle_trees.size(), "triangle tree").c_str(),
+        pretty_time(builder.get_build_time()).c_str());
+}
+
+ObjectInstanceTree::~ObjectInstanceTree()
+{
+    for (each<vector<TriangleTree*> > i = m_triangle_trees; i; ++i)
+        delete *i;
+}
+
+void ObjectInstanceTree::update_non_geometry(const bool enable_intersection_filters)
+{
+    for (each<vector<TriangleTree*> > i = m_triangle_trees; i; ++i)
+        (*i)->update_non_geometry(enable_intersection_filters);
+}
+
+size_t ObjectInstanceTree::get_memory_size() const
+{
+    size_t memory_size =
+          TreeType::get_memory_size()
+        - sizeof(*static_cast<const TreeType*>(this))
+        + sizeof(*this)
+        + m_items.capacity() * sizeof(Item)
+        + m_triangle_trees.capacity() * sizeof(TriangleTree*);
+
+    for (const_each<vector<TriangleTree*> > i = m_triangle_trees; i; ++i)
+        memory_size += (*i)->get_memory_size();
+
+    return memory_size;
+}
+
+
+//
+// Utility function to transform a ray to the space of an object instance.
+//
+
+namespace
+{
+    template <typename RayType>
+    void compute_object_instance_ray(
+        const Transformd&           object_instance_transform,
+        const RayType&              input_ray,
+        RayType&                    output_ray)
+    {
+        output_ray.m_org = object_instance_transform.point_to_local(input_ray.m_org);
+        output_ray.m_dir = object_instance_transform.vector_to_local(input_ray.m_dir);
+
+        // The direction is not normalized: distances along the ray are the same in both spaces.
+        output_ray.m_tmin = input_ray.m_tmin;
+        output_ray.m_tmax = input_ray.m_tmax;
+    }
+}
+
+
+//
+// ObjectInstanceLeafVisitor class implementation.
+//
+
+bool ObjectInstanceLeafVisitor::visit(
+    const ObjectInstanceTree::NodeType&     node,
+    const Ray3d&                            ray,
+    const RayInfo3d&                        ray_info,
+    double&                                 distance
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+    , bvh::TraversalStatistics&             stats
+#endif
+    )
+{
+    for (size_t item_index = node.get_item_index(),
+                item_count = node.get_item_count();
+                item_count--;
+                item_index++)
+    {
+        const ObjectInstanceTree::Item& item = m_tree.m_items[item_index];
+
+        // Skip this object instance if it isn't visible for this ray.
+        if (!(item.m_vis_flags & m_shading_point.m_ray.m_flags))
+            continue;
+
+        FOUNDATION_BVH_TRAVERSAL_STATS(stats.m_intersected_items.insert(1));
+
+        // Transform the ray to object space.
+        ShadingPoint local_shading_point;
+        compute_object_instance_ray(
+            item.m_transform,
+            m_shading_point.m_ray,
+            local_shading_point.m_ray);
+        local_shading_point.m_ray.m_has_differentials = false;
+        local_shading_point.m_ray.m_time = m_shading_point.m_ray.m_time;
+        local_shading_point.m_ray.m_flags = m_shading_point.m_ray.m_flags;
+        local_shading_point.m_ray.m_depth = m_shading_point.m_ray.m_depth;
+        local_shading_point.m_ray.m_medium_count = m_shading_point.m_ray.m_medium_count;
+        const RayInfo3d local_ray_info(local_shading_point.m_ray);
+
+        // Check the intersection between the ray and the shared triangle tree.
+        const TriangleTree& triangle_tree = *item.m_triangle_tree;
+        TriangleTreeIntersector intersector;
+        TriangleLeafVisitor visitor(triangle_tree, local_shading_point, item.m_object_instance_index);
+        if (triangle_tree.get_moving_triangle_count() > 0)
+        {
+            intersector.intersect_motion(
+                triangle_tree,
+                local_shading_point.m_ray,
+                local_ray_info,
+                local_shading_point.m_ray.m_time.m_normalized,
+                visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+                , m_triangle_tree_stats
+#endif
+                );
+        }
+        else
+        {
+            intersector.intersect_no_motion(
+                triangle_tree,
+                local_shading_point.m_ray,
+                local_ray_info,
+                visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+                , m_triangle_tree_stats
+#endif
+                );
+        }
+        visitor.read_hit_triangle_data();
+
+        // Keep track of the closest hit.
+        if (local_shading_point.hit() && local_shading_point.m_ray.m_tmax < m_shading_point.m_ray.m_tmax)
+        {
+            m_shading_point.m_ray.m_tmax = local_shading_point.m_ray.m_tmax;
+            m_shading_point.m_primitive_type = local_shading_point.m_primitive_type;
+            m_shading_point.m_bary = local_shading_point.m_bary;
+            m_shading_point.m_object_instance_index = local_shading_point.m_object_instance_index;
+            m_shading_point.m_region_index = local_shading_point.m_region_index;
+            m_shading_point.m_primitive_index = local_shading_point.m_primitive_index;
+
+            // Transform the support plane of the hit triangle to assembly space.
+            TriangleSupportPlaneType& support_plane = m_shading_point.m_triangle_support_plane;
+            support_plane = local_shading_point.m_triangle_support_plane;
+            support_plane.m_v0 = item.m_transform.point_to_parent(support_plane.m_v0);
+            support_plane.m_e0 = item.m_transform.vector_to_parent(support_plane.m_e0);
+            support_plane.m_e1 = item.m_transform.vector_to_parent(support_plane.m_e1);
+        }
+    }
+
+    // Continue traversal.
+    distance = m_shading_point.m_ray.m_tmax;
+    return true;
+}
+
+
+//
+// ObjectInstanceLeafProbeVisitor class implementation.
+//
+
+bool ObjectInstanceLeafProbeVisitor::visit(
+    const ObjectInstanceTree::NodeType&     node,
+    const Ray3d&                            ray,
+    const RayInfo3d&                        ray_info,
+    double&                                 distance
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+    , bvh::TraversalStatistics&             stats
+#endif
+    )
+{
+    for (size_t item_index = node.get_item_index(),
+                item_count = node.get_item_count();
+                item_count--;
+                item_index++)
+    {
+        const ObjectInstanceTree::Item& item = m_tree.m_items[item_index];
+
+        // Skip this object instance if it isn't visible for this ray.
+        if (!(item.m_vis_flags & m_ray_flags))
+            continue;
+
+        FOUNDATION_BVH_TRAVERSAL_STATS(stats.m_intersected_items.insert(1));
+
+        // Transform the ray to object space.
+        Ray3d local_ray;
+        compute_object_instance_ray(item.m_transform, ray, local_ray);
+        const RayInfo3d local_ray_info(local_ray);
+
+        // Check the intersection between the ray and the shared triangle tree.
+        const TriangleTree& triangle_tree = *item.m_triangle_tree;
+        TriangleTreeProbeIntersector intersector;
+        TriangleLeafProbeVisitor visitor(triangle_tree, m_ray_time, m_ray_flags);
+        if (triangle_tree.get_moving_triangle_count() > 0)
+        {
+            intersector.intersect_motion(
+                triangle_tree,
+                local_ray,
+                local_ray_info,
+                m_ray_time,
+                visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+                , m_triangle_tree_stats
+#endif
+                );
+        }
+        else
+        {
+            intersector.intersect_no_motion(
+                triangle_tree,
+                local_ray,
+                local_ray_info,
+                visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+                , m_triangle_tree_stats
+#endif
+                );
+        }
+
+        // Terminate traversal if there was a hit.
+        if (visitor.hit())
+        {
+            m_hit = true;
+            return false;
+        }
+    }
+
+    // Continue traversal.
+    distance = ray.m_tmax;
+    return true;
+}
+
+}   // namespace renderer
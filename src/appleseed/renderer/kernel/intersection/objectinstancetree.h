@@ -0,0 +1,267 @@
+
+//
+// This source file is part of appleseed.
+// Visit http://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2010-2013 Francois Beaune, Jupiter Jazz Limited
+// Copyright (c) 2014-2017 Francois Beaune, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#ifndef APPLESEED_RENDERER_KERNEL_INTERSECTION_OBJECTINSTANCETREE_H
+#define APPLESEED_RENDERER_KERNEL_INTERSECTION_OBJECTINSTANCETREE_H
+
+// appleseed.renderer headers.
+#include "renderer/kernel/intersection/probevisitorbase.h"
+#include "renderer/kernel/intersection/triangletree.h"
+#include "renderer/modeling/scene/visibilityflags.h"
+
+// appleseed.foundation headers.
+#include "foundation/core/concepts/noncopyable.h"
+#include "foundation/math/aabb.h"
+#include "foundation/math/bvh.h"
+#include "foundation/math/ray.h"
+#include "foundation/math/transform.h"
+#include "foundation/utility/alignedvector.h"
+
+// Standard headers.
+#include <cstddef>
+#include <vector>
+
+// Forward declarations.
+namespace foundation    { class JobQueue; }
+namespace renderer      { class Assembly; }
+namespace renderer      { class Scene; }
+namespace renderer      { class ShadingPoint; }
+
+namespace renderer
+{
+
+//
+// Object instance tree.
+//
+// Tree of the object instances of an assembly that don't store copies of the triangles
+// of their object: the triangles of the object are stored once, in object space, in a
+// triangle tree shared by all its instances, and rays are transformed to object space.
+//
+
+class ObjectInstanceTree
+  : public foundation::bvh::Tree<
+               foundation::AlignedVector<
+                   foundation::bvh::Node<foundation::AABB3d>
+               >
+           >
+{
+  public:
+    // Constructor, builds the tree for groups of object instances of the same object.
+    // Shared triangle trees are built one after the other, each one using the worker
+    // threads servicing 'build_job_queue', if any.
+    ObjectInstanceTree(
+        const Scene&                        scene,
+        const Assembly&                     assembly,
+        const ObjectInstanceGroupVector&    object_instance_groups,
+        foundation::JobQueue*               build_job_queue,
+        const size_t                        build_thread_count);
+
+    // Destructor.
+    ~ObjectInstanceTree();
+
+    // Update the non-geometry aspects of the shared triangle trees.
+    void update_non_geometry(const bool enable_intersection_filters);
+
+    // Return the number of object instances and of shared triangle trees.
+    size_t get_object_instance_count() const;
+    size_t get_triangle_tree_count() const;
+
+    // Return the size (in bytes) of this object in memory.
+    size_t get_memory_size() const;
+
+  private:
+    friend class ObjectInstanceLeafVisitor;
+    friend class ObjectInstanceLeafProbeVisitor;
+
+    struct Item
+    {
+        const TriangleTree*                 m_triangle_tree;            // object space triangle tree
+        size_t                              m_object_instance_index;
+        VisibilityFlags::Type               m_vis_flags;
+        foundation::Transformd              m_transform;                // object instance transform
+    };
+
+    std::vector<Item>                       m_items;
+    std::vector<TriangleTree*>              m_triangle_trees;           // one per object
+};
+
+
+//
+// Object instance leaf visitor, used during tree intersection.
+//
+
+class ObjectInstanceLeafVisitor
+  : public foundation::NonCopyable
+{
+  public:
+    // Constructor.
+    ObjectInstanceLeafVisitor(
+        const ObjectInstanceTree&                   tree,
+        ShadingPoint&                               shading_point
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+        , foundation::bvh::TraversalStatistics&     triangle_tree_stats
+#endif
+        );
+
+    // Visit a leaf.
+    bool visit(
+        const ObjectInstanceTree::NodeType&         node,
+        const foundation::Ray3d&                    ray,
+        const foundation::RayInfo3d&                ray_info,
+        double&                                     distance
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+        , foundation::bvh::TraversalStatistics&     stats
+#endif
+        );
+
+  private:
+    const ObjectInstanceTree&                       m_tree;
+    ShadingPoint&                                   m_shading_point;
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+    foundation::bvh::TraversalStatistics&           m_triangle_tree_stats;
+#endif
+};
+
+
+//
+// Object instance leaf visitor for probe rays, only return boolean answers
+// (whether an intersection was found or not).
+//
+
+class ObjectInstanceLeafProbeVisitor
+  : public ProbeVisitorBase
+{
+  public:
+    // Constructor.
+    ObjectInstanceLeafProbeVisitor(
+        const ObjectInstanceTree&                   tree,
+        const double                                ray_time,
+        const VisibilityFlags::Type                 ray_flags
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+        , foundation::bvh::TraversalStatistics&     triangle_tree_stats
+#endif
+        );
+
+    // Visit a leaf.
+    bool visit(
+        const ObjectInstanceTree::NodeType&         node,
+        const foundation::Ray3d&                    ray,
+        const foundation::RayInfo3d&                ray_info,
+        double&                                     distance
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+        , foundation::bvh::TraversalStatistics&     stats
+#endif
+        );
+
+  private:
+    const ObjectInstanceTree&                       m_tree;
+    const double                                    m_ray_time;
+    const VisibilityFlags::Type                     m_ray_flags;
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+    foundation::bvh::TraversalStatistics&           m_triangle_tree_stats;
+#endif
+};
+
+
+//
+// Object instance tree intersectors.
+//
+
+typedef foundation::bvh::Intersector<
+    ObjectInstanceTree,
+    ObjectInstanceLeafVisitor,
+    foundation::Ray3d
+> ObjectInstanceTreeIntersector;
+
+typedef foundation::bvh::Intersector<
+    ObjectInstanceTree,
+    ObjectInstanceLeafProbeVisitor,
+    foundation::Ray3d
+> ObjectInstanceTreeProbeIntersector;
+
+
+//
+// ObjectInstanceTree class implementation.
+//
+
+inline size_t ObjectInstanceTree::get_object_instance_count() const
+{
+    return m_items.size();
+}
+
+inline size_t ObjectInstanceTree::get_triangle_tree_count() const
+{
+    return m_triangle_trees.size();
+}
+
+
+//
+// ObjectInstanceLeafVisitor class implementation.
+//
+
+inline ObjectInstanceLeafVisitor::ObjectInstanceLeafVisitor(
+    const ObjectInstanceTree&                       tree,
+    ShadingPoint&                                   shading_point
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+    , foundation::bvh::TraversalStatistics&         triangle_tree_stats
+#endif
+    )
+  : m_tree(tree)
+  , m_shading_point(shading_point)
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+  , m_triangle_tree_stats(triangle_tree_stats)
+#endif
+{
+}
+
+
+//
+// ObjectInstanceLeafProbeVisitor class implementation.
+//
+
+inline ObjectInstanceLeafProbeVisitor::ObjectInstanceLeafProbeVisitor(
+    const ObjectInstanceTree&                       tree,
+    const double                                    ray_time,
+    const VisibilityFlags::Type                     ray_flags
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+    , foundation::bvh::TraversalStatistics&         triangle_tree_stats
+#endif
+    )
+  : m_tree(tree)
+  , m_ray_time(ray_time)
+  , m_ray_flags(ray_flags)
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+  , m_triangle_tree_stats(triangle_tree_stats)
+#endif
+{
+}
+
+}       // namespace renderer
+
+#endif  // !APPLESEED_RENDERER_KERNEL_INTERSECTION_OBJECTINSTANCETREE_H
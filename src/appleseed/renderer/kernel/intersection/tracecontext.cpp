@@ -89,4 +89,12 @@ void TraceContext::update()
     m_assembly_tree->update();
 }
 
+StatisticsVector TraceContext::get_statistics() const
+{
+    return
+        StatisticsVector::make(
+            "assembly tree statistics",
+            m_assembly_tree->get_statistics());
+}
+
 }   // namespace renderer
@@ -32,6 +32,7 @@
 
 // appleseed.foundation headers.
 #include "foundation/core/concepts/noncopyable.h"
+#include "foundation/utility/statistics.h"
 
 // appleseed.main headers.
 #include "main/dllsymbol.h"
@@ -69,6 +70,9 @@ class APPLESEED_DLLSYMBOL TraceContext
     // Synchronize the trace context with the scene.
     void update();
 
+    // Return statistics about the acceleration structures.
+    foundation::StatisticsVector get_statistics() const;
+
   private:
     const Scene&    m_scene;
     AssemblyTree*   m_assembly_tree;
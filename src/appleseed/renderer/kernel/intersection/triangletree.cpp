@@ -33,6 +33,7 @@
 // appleseed.renderer headers.
 #include "renderer/global/globallogger.h"
 #include "renderer/kernel/intersection/intersectionfilter.h"
+#include "renderer/kernel/intersection/objectinstancetree.h"
 #include "renderer/kernel/intersection/triangleencoder.h"
 #include "renderer/kernel/intersection/triangleitemhandler.h"
 #include "renderer/kernel/intersection/trianglevertexinfo.h"
@@ -66,8 +67,10 @@
 #include "foundation/utility/alignedallocator.h"
 #include "foundation/utility/api/apistring.h"
 #include "foundation/utility/foreach.h"
+#include "foundation/utility/job/jobqueue.h"
 #include "foundation/utility/makevector.h"
 #include "foundation/utility/memory.h"
+#include "foundation/utility/otherwise.h"
 #include "foundation/utility/statistics.h"
 #include "foundation/utility/stopwatch.h"
 #include "foundation/utility/string.h"
@@ -90,6 +93,36 @@ namespace renderer
 
 namespace
 {
+    TriangleTree::Layout get_wide_layout(
+        const size_t                    branching_factor,
+        const string&                   node_quantization)
+    {
+        if (node_quantization == "8")
+            return branching_factor == 4 ? TriangleTree::Wide4Quantized8Layout : TriangleTree::Wide8Quantized8Layout;
+
+        if (node_quantization == "16")
+            return branching_factor == 4 ? TriangleTree::Wide4Quantized16Layout : TriangleTree::Wide8Quantized16Layout;
+
+        return branching_factor == 4 ? TriangleTree::Wide4Layout : TriangleTree::Wide8Layout;
+    }
+
+    const char* get_quantization_label(const TriangleTree::Layout layout)
+    {
+        switch (layout)
+        {
+          case TriangleTree::Wide4Quantized8Layout:
+          case TriangleTree::Wide8Quantized8Layout:
+            return "8 bits";
+
+          case TriangleTree::Wide4Quantized16Layout:
+          case TriangleTree::Wide8Quantized16Layout:
+            return "16 bits";
+
+          default:
+            return "none";
+        }
+    }
+
     template <typename Vector>
     void increase_capacity(Vector* vec, const size_t count)
     {
@@ -107,7 +140,8 @@ namespace
     void collect_static_triangles(
         const GAABB3&                   tree_bbox,
         const RegionInfo&               region_info,
-        const ObjectInstance&           object_instance,
+        const Transformd&               transform,
+        const VisibilityFlags::Type     vis_flags,
         const StaticTriangleTess&       tess,
         const bool                      save_memory,
         vector<TriangleKey>*            triangle_keys,
@@ -116,7 +150,6 @@ namespace
         vector<AABBType>*               triangle_bboxes,
         size_t&                         triangle_vertex_count)
     {
-        const Transformd& transform = object_instance.get_transform();
         const size_t triangle_count = tess.m_primitives.size();
 
         if (save_memory)
@@ -180,7 +213,7 @@ namespace
                     TriangleVertexInfo(
                         triangle_vertex_count,
                         0,
-                        object_instance.get_vis_flags()));
+                        vis_flags));
             }
 
             // Store the triangle vertices.
@@ -202,7 +235,8 @@ namespace
     void collect_moving_triangles(
         const GAABB3&                   tree_bbox,
         const RegionInfo&               region_info,
-        const ObjectInstance&           object_instance,
+        const Transformd&               transform,
+        const VisibilityFlags::Type     vis_flags,
         const StaticTriangleTess&       tess,
         const double                    time,
         const bool                      save_memory,
@@ -212,7 +246,6 @@ namespace
         vector<AABBType>*               triangle_bboxes,
         size_t&                         triangle_vertex_count)
     {
-        const Transformd& transform = object_instance.get_transform();
         const size_t motion_segment_count = tess.get_motion_segment_count();
         const size_t triangle_count = tess.m_primitives.size();
 
@@ -293,7 +326,7 @@ namespace
                     TriangleVertexInfo(
                         triangle_vertex_count,
                         motion_segment_count,
-                        object_instance.get_vis_flags()));
+                        vis_flags));
             }
 
             // Store the triangle vertices.
@@ -334,6 +367,9 @@ namespace
 
         size_t triangle_vertex_count = 0;
 
+        // Trees shared by several object instances are built in object space.
+        const bool object_space = !arguments.m_shared_object_instances.empty();
+
         const size_t region_count = arguments.m_regions.size();
 
         for (size_t i = 0; i < region_count; ++i)
@@ -346,6 +382,10 @@ namespace
                 arguments.m_assembly.object_instances().get_by_index(
                     region_info.get_object_instance_index());
             assert(object_instance);
+            const Transformd& transform =
+                object_space ? Transformd::identity() : object_instance->get_transform();
+            const VisibilityFlags::Type vis_flags =
+                object_space ? VisibilityFlags::AllRays : object_instance->get_vis_flags();
 
             // Retrieve the object.
             Object& object = object_instance->get_object();
@@ -365,7 +405,8 @@ namespace
                 collect_moving_triangles(
                     arguments.m_bbox,
                     region_info,
-                    *object_instance,
+                    transform,
+                    vis_flags,
                     tess.ref(),
                     time,
                     save_memory,
@@ -380,7 +421,8 @@ namespace
                 collect_static_triangles(
                     arguments.m_bbox,
                     region_info,
-                    *object_instance,
+                    transform,
+                    vis_flags,
                     tess.ref(),
                     save_memory,
                     triangle_keys,
@@ -394,22 +436,29 @@ namespace
 }
 
 TriangleTree::Arguments::Arguments(
-    const Scene&            scene,
-    const UniqueID          triangle_tree_uid,
-    const GAABB3&           bbox,
-    const Assembly&         assembly,
-    const RegionInfoVector& regions)
+    const Scene&                        scene,
+    const UniqueID                      triangle_tree_uid,
+    const GAABB3&                       bbox,
+    const Assembly&                     assembly,
+    const RegionInfoVector&             regions,
+    const ObjectInstanceIndexVector&    shared_object_instances,
+    const ObjectInstanceGroupVector&    object_instance_groups)
   : m_scene(scene)
   , m_triangle_tree_uid(triangle_tree_uid)
   , m_bbox(bbox)
   , m_assembly(assembly)
   , m_regions(regions)
+  , m_shared_object_instances(shared_object_instances)
+  , m_object_instance_groups(object_instance_groups)
+  , m_build_job_queue(0)
+  , m_build_thread_count(1)
 {
 }
 
 TriangleTree::TriangleTree(const Arguments& arguments)
   : TreeType(AlignedAllocator<void>(System::get_l1_data_cache_line_size()))
   , m_arguments(arguments)
+  , m_layout(BinaryLayout)
 {
     // Retrieve construction parameters.
     const MessageContext message_context(
@@ -418,6 +467,8 @@ TriangleTree::TriangleTree(const Arguments& arguments)
     const string algorithm = params.get_optional<string>("algorithm", "bvh", make_vector("bvh", "sbvh"), message_context);
     const double time = params.get_optional<double>("time", 0.5);
     const bool save_memory = params.get_optional<bool>("save_temporary_memory", false);
+    const size_t branching_factor = params.get_optional<size_t>("branching_factor", 2, make_vector("2", "4", "8"), message_context);
+    const string node_quantization = params.get_optional<string>("node_quantization", "none", make_vector("none", "8", "16"), message_context);
 
     // Start stopwatch.
     Stopwatch<DefaultWallclockTimer> stopwatch;
@@ -436,6 +487,50 @@ TriangleTree::TriangleTree(const Arguments& arguments)
     assert(m_nodes.size() == m_nodes.capacity());
 #endif
 
+    // Collapse the tree into a wide tree. Wide trees don't support motion blur.
+    if (branching_factor > 2)
+    {
+        if (m_moving_triangle_count == 0)
+        {
+            m_layout = get_wide_layout(branching_factor, node_quantization);
+
+            switch (m_layout)
+            {
+              case Wide4Layout: collapse<WideTree4>(statistics); break;
+              case Wide8Layout: collapse<WideTree8>(statistics); break;
+              case Wide4Quantized8Layout: collapse<WideTree4Q8>(statistics); break;
+              case Wide8Quantized8Layout: collapse<WideTree8Q8>(statistics); break;
+              case Wide4Quantized16Layout: collapse<WideTree4Q16>(statistics); break;
+              case Wide8Quantized16Layout: collapse<WideTree8Q16>(statistics); break;
+              assert_otherwise;
+            }
+        }
+        else
+        {
+            RENDERER_LOG_DEBUG(
+                "triangle tree #" FMT_UNIQUE_ID " contains moving triangles, using a branching factor of 2.",
+                m_arguments.m_triangle_tree_uid);
+        }
+    }
+    else if (node_quantization != "none")
+    {
+        RENDERER_LOG_WARNING(
+            "node quantization requires a branching factor of 4 or 8, ignoring it for triangle tree #" FMT_UNIQUE_ID ".",
+            m_arguments.m_triangle_tree_uid);
+    }
+
+    // Build the tree of object instances sharing the geometry of their object.
+    if (!m_arguments.m_object_instance_groups.empty())
+    {
+        m_object_instance_tree.reset(
+            new ObjectInstanceTree(
+                m_arguments.m_scene,
+                m_arguments.m_assembly,
+                m_arguments.m_object_instance_groups,
+                m_arguments.m_build_job_queue,
+                m_arguments.m_build_thread_count));
+    }
+
     // Print triangle tree statistics.
     statistics.insert_size("nodes alignment", alignment(&m_nodes[0]));
     statistics.insert_time("total time", stopwatch.measure().get_seconds());
@@ -460,6 +555,9 @@ void TriangleTree::update_non_geometry(const bool enable_intersection_filters)
         m_arguments.m_assembly.get_parameters().get_optional<bool>("enable_intersection_filters", true))
         update_intersection_filters();
     else delete_intersection_filters();
+
+    if (m_object_instance_tree.get())
+        m_object_instance_tree->update_non_geometry(enable_intersection_filters);
 }
 
 size_t TriangleTree::get_memory_size() const
@@ -468,8 +566,10 @@ size_t TriangleTree::get_memory_size() const
           TreeType::get_memory_size()
         - sizeof(*static_cast<const TreeType*>(this))
         + sizeof(*this)
+        + (m_wide_tree.get() ? m_wide_tree->get_memory_size() : 0)
         + m_triangle_keys.capacity() * sizeof(TriangleKey)
-        + m_leaf_data.capacity() * sizeof(uint8);
+        + m_leaf_data.capacity() * sizeof(uint8)
+        + (m_object_instance_tree.get() ? m_object_instance_tree->get_memory_size() : 0);
 }
 
 namespace
@@ -505,6 +605,21 @@ namespace
 
         return count;
     }
+
+    size_t get_build_thread_count(
+        const ParamArray&               params,
+        const TriangleTree::Arguments&  arguments,
+        const size_t                    triangle_count)
+    {
+        // Small trees are faster to build on a single thread.
+        if (arguments.m_build_job_queue == 0 || triangle_count < TriangleTreeMinParallelBuildSize)
+            return 1;
+
+        const size_t thread_count =
+            params.get_optional<size_t>("build_threads", arguments.m_build_thread_count);
+
+        return max<size_t>(min(thread_count, arguments.m_build_thread_count), 1);
+    }
 }
 
 void TriangleTree::build_bvh(
@@ -565,13 +680,36 @@ void TriangleTree::build_bvh(
     // Build the tree.
     typedef bvh::Builder<TriangleTree, Partitioner> Builder;
     Builder builder;
-    builder.build<DefaultWallclockTimer>(
-        *this,
-        partitioner,
-        triangle_keys.size(),
-        max_leaf_size);
+    const size_t thread_count =
+        get_build_thread_count(
+            params,
+            m_arguments,
+            triangle_keys.size());
+    if (thread_count > 1)
+    {
+        partitioner.enable_parallel_build(
+            *m_arguments.m_build_job_queue,
+            thread_count,
+            TriangleTreeMinParallelSplitSize);
+        builder.build<DefaultWallclockTimer>(
+            *this,
+            partitioner,
+            triangle_keys.size(),
+            max_leaf_size,
+            *m_arguments.m_build_job_queue,
+            thread_count);
+    }
+    else
+    {
+        builder.build<DefaultWallclockTimer>(
+            *this,
+            partitioner,
+            triangle_keys.size(),
+            max_leaf_size);
+    }
     statistics.merge(
         bvh::TreeStatistics<TriangleTree>(*this, AABB3d(m_arguments.m_bbox)));
+    statistics.insert("build threads", thread_count);
 
     stopwatch.start();
 
@@ -674,6 +812,20 @@ void TriangleTree::build_sbvh(
         interior_node_traversal_cost,
         triangle_intersection_cost);
 
+    // Enable parallel splits if the tree is built in parallel.
+    const size_t thread_count =
+        get_build_thread_count(
+            params,
+            m_arguments,
+            triangle_keys.size());
+    if (thread_count > 1)
+    {
+        partitioner.enable_parallel_build(
+            *m_arguments.m_build_job_queue,
+            thread_count,
+            TriangleTreeMinParallelSplitSize);
+    }
+
     // Create the root leaf.
     Partitioner::LeafType* root_leaf = partitioner.create_root_leaf();
     const AABB3d root_leaf_bbox = partitioner.compute_leaf_bbox(*root_leaf);
@@ -681,12 +833,26 @@ void TriangleTree::build_sbvh(
     // Build the tree.
     typedef bvh::SpatialBuilder<TriangleTree, Partitioner> Builder;
     Builder builder;
-    builder.build<DefaultWallclockTimer>(
-        *this,
-        partitioner,
-        root_leaf,
-        root_leaf_bbox);
+    if (thread_count > 1)
+    {
+        builder.build<DefaultWallclockTimer>(
+            *this,
+            partitioner,
+            root_leaf,
+            root_leaf_bbox,
+            *m_arguments.m_build_job_queue,
+            thread_count);
+    }
+    else
+    {
+        builder.build<DefaultWallclockTimer>(
+            *this,
+            partitioner,
+            root_leaf,
+            root_leaf_bbox);
+    }
     statistics.merge(bvh::TreeStatistics<TriangleTree>(*this, AABB3d(m_arguments.m_bbox)));
+    statistics.insert("build threads", thread_count);
 
     // Add splits statistics.
     const size_t spatial_splits = partitioner.get_spatial_split_count();
@@ -769,6 +935,24 @@ namespace
 #endif
 }
 
+template <typename WideTreeType>
+void TriangleTree::collapse(Statistics& statistics)
+{
+    WideTreeHolder<WideTreeType>* holder = new WideTreeHolder<WideTreeType>();
+    m_wide_tree.reset(holder);
+
+    bvh::Collapser<TriangleTree, WideTreeType> collapser;
+    collapser.template collapse<DefaultWallclockTimer>(
+        *this,
+        holder->m_tree,
+        AABB3d(m_arguments.m_bbox));
+
+    statistics.insert("branching factor", WideTreeType::NodeType::Width);
+    statistics.insert("node quantization", get_quantization_label(m_layout));
+    statistics.merge(bvh::WideTreeStatistics<TriangleTree, WideTreeType>(*this, holder->m_tree));
+    statistics.insert_time("collapse time", collapser.get_collapse_time());
+}
+
 vector<GAABB3> TriangleTree::compute_motion_bboxes(
     const vector<size_t>&               triangle_indices,
     const vector<TriangleVertexInfo>&   triangle_vertex_infos,
@@ -1256,6 +1440,9 @@ void TriangleTree::update_intersection_filters()
     // Collect object instances.
     IndexSet object_instances;
     collect_object_instances(m_arguments.m_regions, object_instances);
+    object_instances.insert(
+        m_arguments.m_shared_object_instances.begin(),
+        m_arguments.m_shared_object_instances.end());
 
     // Create filter keys and map object instances to filter keys.
     FilterKeySet filter_keys;
@@ -1306,6 +1493,34 @@ TriangleTreeFactory::TriangleTreeFactory(const TriangleTree::Arguments& argument
 {
 }
 
+size_t TriangleTreeFactory::estimate_triangle_count() const
+{
+    size_t triangle_count = 0;
+
+    for (const_each<RegionInfoVector> i = m_arguments.m_regions; i; ++i)
+    {
+        const ObjectInstance* object_instance =
+            m_arguments.m_assembly.object_instances().get_by_index(i->get_object_instance_index());
+        assert(object_instance);
+
+        Access<RegionKit> region_kit(&object_instance->get_object().get_region_kit());
+        const IRegion* region = (*region_kit)[i->get_region_index()];
+        Access<StaticTriangleTess> tess(&region->get_static_triangle_tess());
+
+        triangle_count += tess->m_primitives.size();
+    }
+
+    return triangle_count;
+}
+
+void TriangleTreeFactory::set_build_job_queue(
+    JobQueue*                   job_queue,
+    const size_t                thread_count)
+{
+    m_arguments.m_build_job_queue = job_queue;
+    m_arguments.m_build_thread_count = thread_count;
+}
+
 auto_ptr<TriangleTree> TriangleTreeFactory::create()
 {
     return auto_ptr<TriangleTree>(new TriangleTree(m_arguments));
@@ -1410,7 +1625,7 @@ bool TriangleLeafVisitor::visit(
                 {
                     const TriangleKey& triangle_key = m_tree.m_triangle_keys[triangle_index];
                     const IntersectionFilter* filter =
-                        m_tree.m_intersection_filters[triangle_key.get_object_instance_index()];
+                        m_tree.m_intersection_filters[get_object_instance_index(triangle_key)];
                     if (filter && !filter->accept(triangle_key, u, v))
                         continue;
                 }
@@ -1465,7 +1680,7 @@ bool TriangleLeafVisitor::visit(
                 {
                     const TriangleKey& triangle_key = m_tree.m_triangle_keys[triangle_index];
                     const IntersectionFilter* filter =
-                        m_tree.m_intersection_filters[triangle_key.get_object_instance_index()];
+                        m_tree.m_intersection_filters[get_object_instance_index(triangle_key)];
                     if (filter && !filter->accept(triangle_key, u, v))
                         continue;
                 }
@@ -1494,7 +1709,7 @@ void TriangleLeafVisitor::read_hit_triangle_data() const
 
         // Copy the triangle key.
         const TriangleKey& triangle_key = m_tree.m_triangle_keys[m_hit_triangle_index];
-        m_shading_point.m_object_instance_index = triangle_key.get_object_instance_index();
+        m_shading_point.m_object_instance_index = get_object_instance_index(triangle_key);
         m_shading_point.m_region_index = triangle_key.get_region_index();
         m_shading_point.m_primitive_index = triangle_key.get_triangle_index();
 
@@ -44,22 +44,27 @@
 #include "foundation/math/aabb.h"
 #include "foundation/math/bvh.h"
 #include "foundation/math/ray.h"
+#include "foundation/platform/compiler.h"
 #include "foundation/platform/types.h"
 #include "foundation/utility/alignedvector.h"
+#include "foundation/utility/otherwise.h"
 #include "foundation/utility/lazy.h"
 #include "foundation/utility/poolallocator.h"
 #include "foundation/utility/uid.h"
 
 // Standard headers.
+#include <cassert>
 #include <cstddef>
 #include <map>
 #include <memory>
 #include <vector>
 
 // Forward declarations.
+namespace foundation    { class JobQueue; }
 namespace foundation    { class Statistics; }
 namespace renderer      { class Assembly; }
 namespace renderer      { class IntersectionFilter; }
+namespace renderer      { class ObjectInstanceTree; }
 namespace renderer      { class ParamArray; }
 namespace renderer      { class Scene; }
 namespace renderer      { class ShadingPoint; }
@@ -69,6 +74,10 @@ namespace renderer
 
 typedef std::map<foundation::uint64, IntersectionFilter*> IntersectionFilterRepository;
 
+// Indices of object instances within an assembly.
+typedef std::vector<size_t> ObjectInstanceIndexVector;
+typedef std::vector<ObjectInstanceIndexVector> ObjectInstanceGroupVector;
+
 
 //
 // Triangle tree.
@@ -82,6 +91,40 @@ class TriangleTree
            >
 {
   public:
+    // Memory layouts of the tree used for intersection.
+    enum Layout
+    {
+        BinaryLayout,                           // binary tree, the only layout supporting motion blur
+        Wide4Layout,                            // 4-wide tree
+        Wide8Layout,                            // 8-wide tree
+        Wide4Quantized8Layout,                  // 4-wide tree, bounding boxes quantized to 8 bits
+        Wide8Quantized8Layout,                  // 8-wide tree, bounding boxes quantized to 8 bits
+        Wide4Quantized16Layout,                 // 4-wide tree, bounding boxes quantized to 16 bits
+        Wide8Quantized16Layout                  // 8-wide tree, bounding boxes quantized to 16 bits
+    };
+
+    // Wide trees, used instead of the binary tree when the branching factor is 4 or 8.
+    typedef foundation::bvh::WideTree<
+        foundation::AlignedVector<foundation::bvh::WideNode<4> >
+    > WideTree4;
+    typedef foundation::bvh::WideTree<
+        foundation::AlignedVector<foundation::bvh::WideNode<8> >
+    > WideTree8;
+
+    // Wide trees with child bounding boxes quantized to 8 or 16 bits.
+    typedef foundation::bvh::WideTree<
+        foundation::AlignedVector<foundation::bvh::QuantizedWideNode<4, foundation::uint8> >
+    > WideTree4Q8;
+    typedef foundation::bvh::WideTree<
+        foundation::AlignedVector<foundation::bvh::QuantizedWideNode<8, foundation::uint8> >
+    > WideTree8Q8;
+    typedef foundation::bvh::WideTree<
+        foundation::AlignedVector<foundation::bvh::QuantizedWideNode<4, foundation::uint16> >
+    > WideTree4Q16;
+    typedef foundation::bvh::WideTree<
+        foundation::AlignedVector<foundation::bvh::QuantizedWideNode<8, foundation::uint16> >
+    > WideTree8Q16;
+
     // Construction arguments.
     struct Arguments
     {
@@ -91,13 +134,32 @@ class TriangleTree
         const Assembly&                         m_assembly;
         const RegionInfoVector                  m_regions;
 
+        // Object instances sharing the tree. If not empty, the tree is built in object space
+        // from the regions of the first of these object instances, and the visibility flags
+        // of the object instances are not baked into the tree.
+        const ObjectInstanceIndexVector         m_shared_object_instances;
+
+        // Groups of object instances of the same object, each intersected through a tree
+        // shared by the object instances of the group. These object instances must not be
+        // referenced by the regions.
+        const ObjectInstanceGroupVector         m_object_instance_groups;
+
+        // Job queue serviced by the worker threads that may be used to build the tree, and
+        // number of these threads. The tree never starts threads of its own: it is built on
+        // the calling thread if there is no job queue. The job queue must not be used by
+        // anything else while the tree is being built.
+        foundation::JobQueue*                   m_build_job_queue;
+        size_t                                  m_build_thread_count;
+
         // Constructor.
         Arguments(
             const Scene&                        scene,
             const foundation::UniqueID          triangle_tree_uid,
             const GAABB3&                       bbox,
             const Assembly&                     assembly,
-            const RegionInfoVector&             regions);
+            const RegionInfoVector&             regions,
+            const ObjectInstanceIndexVector&    shared_object_instances = ObjectInstanceIndexVector(),
+            const ObjectInstanceGroupVector&    object_instance_groups = ObjectInstanceGroupVector());
     };
 
     // Constructor, builds the tree for a given set of regions.
@@ -113,24 +175,58 @@ class TriangleTree
     size_t get_static_triangle_count() const;
     size_t get_moving_triangle_count() const;
 
+    // Return the memory layout of the tree used for intersection.
+    Layout get_layout() const;
+
+    // Return the tree of object instances sharing the geometry of their object, if any.
+    const ObjectInstanceTree* get_object_instance_tree() const;
+
     // Return the size (in bytes) of this object in memory.
     size_t get_memory_size() const;
 
   private:
     friend class TriangleLeafVisitor;
     friend class TriangleLeafProbeVisitor;
+    template <typename Visitor> friend class GenericTriangleTreeIntersector;
 
     const Arguments                             m_arguments;
 
     size_t                                      m_static_triangle_count;
     size_t                                      m_moving_triangle_count;
 
+    // Wide tree collapsed from the binary tree, whose type is given by the layout.
+    class WideTreeHolderBase
+      : public foundation::NonCopyable
+    {
+      public:
+        virtual ~WideTreeHolderBase() {}
+        virtual size_t get_memory_size() const = 0;
+    };
+
+    template <typename WideTreeType>
+    class WideTreeHolder
+      : public WideTreeHolderBase
+    {
+      public:
+        WideTreeType m_tree;
+
+        virtual size_t get_memory_size() const APPLESEED_OVERRIDE
+        {
+            return sizeof(*this) - sizeof(m_tree) + m_tree.get_memory_size();
+        }
+    };
+
+    Layout                                      m_layout;
+    std::auto_ptr<WideTreeHolderBase>           m_wide_tree;
+
     std::vector<TriangleKey>                    m_triangle_keys;
     std::vector<foundation::uint8>              m_leaf_data;
 
     IntersectionFilterRepository                m_intersection_filters_repository;
     std::vector<const IntersectionFilter*>      m_intersection_filters;
 
+    std::auto_ptr<ObjectInstanceTree>           m_object_instance_tree;
+
     void build_bvh(
         const ParamArray&                       params,
         const double                            time,
@@ -143,6 +239,12 @@ class TriangleTree
         const bool                              save_memory,
         foundation::Statistics&                 statistics);
 
+    template <typename WideTreeType>
+    const WideTreeType& get_wide_tree() const;
+
+    template <typename WideTreeType>
+    void collapse(foundation::Statistics& statistics);
+
     std::vector<GAABB3> compute_motion_bboxes(
         const std::vector<size_t>&              triangle_indices,
         const std::vector<TriangleVertexInfo>&  triangle_vertex_infos,
@@ -173,6 +275,14 @@ class TriangleTreeFactory
     explicit TriangleTreeFactory(
         const TriangleTree::Arguments& arguments);
 
+    // Return an upper bound of the number of triangles of the tree.
+    size_t estimate_triangle_count() const;
+
+    // Set the job queue and the number of worker threads used to build the tree.
+    void set_build_job_queue(
+        foundation::JobQueue*                   job_queue,
+        const size_t                            thread_count);
+
     // Create the triangle tree.
     virtual std::auto_ptr<TriangleTree> create();
 
@@ -210,10 +320,12 @@ class TriangleLeafVisitor
   : public foundation::NonCopyable
 {
   public:
-    // Constructor.
+    // Constructor. Hits are reported on the object instance referenced by the triangle keys,
+    // unless an object instance index is provided (trees shared by several object instances).
     TriangleLeafVisitor(
         const TriangleTree&                     tree,
-        ShadingPoint&                           shading_point);
+        ShadingPoint&                           shading_point,
+        const size_t                            object_instance_index = ~size_t(0));
 
     // Visit a leaf.
     bool visit(
@@ -233,9 +345,12 @@ class TriangleLeafVisitor
     const TriangleTree&     m_tree;
     const bool              m_has_intersection_filters;
     ShadingPoint&           m_shading_point;
+    const size_t            m_object_instance_index;
     GTriangleType           m_interpolated_triangle;
     const GTriangleType*    m_hit_triangle;
     size_t                  m_hit_triangle_index;
+
+    size_t get_object_instance_index(const TriangleKey& triangle_key) const;
 };
 
 
@@ -274,22 +389,72 @@ class TriangleLeafProbeVisitor
 
 
 //
-// Triangle tree intersectors.
+// Triangle tree intersector, dispatching to the binary or to the wide
+// intersector depending on the layout of the tree.
+//
+// Wide trees are only built for trees without moving triangles,
+// intersect_motion() therefore always traverses the binary tree.
 //
 
-typedef foundation::bvh::Intersector<
-    TriangleTree,
-    TriangleLeafVisitor,
-    foundation::Ray3d,          // make sure we pick the SSE2-optimized version of foundation::bvh::Intersector
-    TriangleTreeStackSize
-> TriangleTreeIntersector;
+template <typename Visitor>
+class GenericTriangleTreeIntersector
+  : public foundation::NonCopyable
+{
+  public:
+    void intersect_no_motion(
+        const TriangleTree&                     tree,
+        const foundation::Ray3d&                ray,
+        const foundation::RayInfo3d&            ray_info,
+        Visitor&                                visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+        , foundation::bvh::TraversalStatistics& stats
+#endif
+        ) const;
+
+    void intersect_motion(
+        const TriangleTree&                     tree,
+        const foundation::Ray3d&                ray,
+        const foundation::RayInfo3d&            ray_info,
+        const double                            ray_time,
+        Visitor&                                visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+        , foundation::bvh::TraversalStatistics& stats
+#endif
+        ) const;
+
+  private:
+    foundation::bvh::Intersector<
+        TriangleTree,
+        Visitor,
+        foundation::Ray3d,      // make sure we pick the SSE2-optimized version of foundation::bvh::Intersector
+        TriangleTreeStackSize
+    > m_intersector;
+
+    template <typename WideTreeType>
+    void intersect_wide(
+        const TriangleTree&                     tree,
+        const foundation::Ray3d&                ray,
+        const foundation::RayInfo3d&            ray_info,
+        Visitor&                                visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+        , foundation::bvh::TraversalStatistics& stats
+#endif
+        ) const;
+
+    // Type of the instances of intersect_wide().
+    typedef void (GenericTriangleTreeIntersector::*IntersectWideMethod)(
+        const TriangleTree&                     tree,
+        const foundation::Ray3d&                ray,
+        const foundation::RayInfo3d&            ray_info,
+        Visitor&                                visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+        , foundation::bvh::TraversalStatistics& stats
+#endif
+        ) const;
+};
 
-typedef foundation::bvh::Intersector<
-    TriangleTree,
-    TriangleLeafProbeVisitor,
-    foundation::Ray3d,          // make sure we pick the SSE2-optimized version of foundation::bvh::Intersector
-    TriangleTreeStackSize
-> TriangleTreeProbeIntersector;
+typedef GenericTriangleTreeIntersector<TriangleLeafVisitor> TriangleTreeIntersector;
+typedef GenericTriangleTreeIntersector<TriangleLeafProbeVisitor> TriangleTreeProbeIntersector;
 
 
 //
@@ -306,6 +471,23 @@ inline size_t TriangleTree::get_moving_triangle_count() const
     return m_moving_triangle_count;
 }
 
+inline TriangleTree::Layout TriangleTree::get_layout() const
+{
+    return m_layout;
+}
+
+template <typename WideTreeType>
+inline const WideTreeType& TriangleTree::get_wide_tree() const
+{
+    assert(m_wide_tree.get());
+    return static_cast<const WideTreeHolder<WideTreeType>*>(m_wide_tree.get())->m_tree;
+}
+
+inline const ObjectInstanceTree* TriangleTree::get_object_instance_tree() const
+{
+    return m_object_instance_tree.get();
+}
+
 
 //
 // TriangleLeafVisitor class implementation.
@@ -313,14 +495,24 @@ inline size_t TriangleTree::get_moving_triangle_count() const
 
 inline TriangleLeafVisitor::TriangleLeafVisitor(
     const TriangleTree&         tree,
-    ShadingPoint&               shading_point)
+    ShadingPoint&               shading_point,
+    const size_t                object_instance_index)
   : m_tree(tree)
   , m_has_intersection_filters(!tree.m_intersection_filters.empty())
   , m_shading_point(shading_point)
+  , m_object_instance_index(object_instance_index)
   , m_hit_triangle(0)
 {
 }
 
+inline size_t TriangleLeafVisitor::get_object_instance_index(const TriangleKey& triangle_key) const
+{
+    return
+        m_object_instance_index == ~size_t(0)
+            ? triangle_key.get_object_instance_index()
+            : m_object_instance_index;
+}
+
 
 //
 // TriangleLeafProbeVisitor class implementation.
@@ -337,6 +529,117 @@ inline TriangleLeafProbeVisitor::TriangleLeafProbeVisitor(
 {
 }
 
+
+//
+// GenericTriangleTreeIntersector class implementation.
+//
+
+template <typename Visitor>
+inline void GenericTriangleTreeIntersector<Visitor>::intersect_no_motion(
+    const TriangleTree&                     tree,
+    const foundation::Ray3d&                ray,
+    const foundation::RayInfo3d&            ray_info,
+    Visitor&                                visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+    , foundation::bvh::TraversalStatistics& stats
+#endif
+    ) const
+{
+    if (tree.m_layout == TriangleTree::BinaryLayout)
+    {
+        m_intersector.intersect_no_motion(
+            tree,
+            ray,
+            ray_info,
+            visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+            , stats
+#endif
+            );
+        return;
+    }
+
+    // Select the intersection method for the layout of the wide tree.
+    IntersectWideMethod intersect_wide_method = 0;
+    switch (tree.m_layout)
+    {
+      case TriangleTree::Wide4Layout: intersect_wide_method = &GenericTriangleTreeIntersector::template intersect_wide<TriangleTree::WideTree4>; break;
+      case TriangleTree::Wide8Layout: intersect_wide_method = &GenericTriangleTreeIntersector::template intersect_wide<TriangleTree::WideTree8>; break;
+      case TriangleTree::Wide4Quantized8Layout: intersect_wide_method = &GenericTriangleTreeIntersector::template intersect_wide<TriangleTree::WideTree4Q8>; break;
+      case TriangleTree::Wide8Quantized8Layout: intersect_wide_method = &GenericTriangleTreeIntersector::template intersect_wide<TriangleTree::WideTree8Q8>; break;
+      case TriangleTree::Wide4Quantized16Layout: intersect_wide_method = &GenericTriangleTreeIntersector::template intersect_wide<TriangleTree::WideTree4Q16>; break;
+      case TriangleTree::Wide8Quantized16Layout: intersect_wide_method = &GenericTriangleTreeIntersector::template intersect_wide<TriangleTree::WideTree8Q16>; break;
+      assert_otherwise;
+    }
+
+    (this->*intersect_wide_method)(
+        tree,
+        ray,
+        ray_info,
+        visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+        , stats
+#endif
+        );
+}
+
+template <typename Visitor>
+inline void GenericTriangleTreeIntersector<Visitor>::intersect_motion(
+    const TriangleTree&                     tree,
+    const foundation::Ray3d&                ray,
+    const foundation::RayInfo3d&            ray_info,
+    const double                            ray_time,
+    Visitor&                                visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+    , foundation::bvh::TraversalStatistics& stats
+#endif
+    ) const
+{
+    assert(tree.m_layout == TriangleTree::BinaryLayout);
+
+    m_intersector.intersect_motion(
+        tree,
+        ray,
+        ray_info,
+        ray_time,
+        visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+        , stats
+#endif
+        );
+}
+
+template <typename Visitor>
+template <typename WideTreeType>
+inline void GenericTriangleTreeIntersector<Visitor>::intersect_wide(
+    const TriangleTree&                     tree,
+    const foundation::Ray3d&                ray,
+    const foundation::RayInfo3d&            ray_info,
+    Visitor&                                visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+    , foundation::bvh::TraversalStatistics& stats
+#endif
+    ) const
+{
+    foundation::bvh::WideIntersector<
+        TriangleTree,
+        WideTreeType,
+        Visitor,
+        TriangleTreeWideStackSize
+    > intersector;
+
+    intersector.intersect_no_motion(
+        tree,
+        tree.template get_wide_tree<WideTreeType>(),
+        ray,
+        ray_info,
+        visitor
+#ifdef FOUNDATION_BVH_ENABLE_TRAVERSAL_STATS
+        , stats
+#endif
+        );
+}
+
 }       // namespace renderer
 
 #endif  // !APPLESEED_RENDERER_KERNEL_INTERSECTION_TRIANGLETREE_H
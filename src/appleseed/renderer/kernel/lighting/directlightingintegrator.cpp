@@ -61,7 +61,12 @@ namespace renderer
 // Call graph:
 //
 //   compute_outgoing_radiance_bsdf_sampling
-//       take_single_bsdf_sample
+//       take_bsdf_samples
+//           take_single_bsdf_sample
+//
+//   compute_outgoing_radiance_bsdf_sampling_low_variance
+//       take_bsdf_samples
+//           take_single_bsdf_sample
 //
 //   compute_outgoing_radiance_light_sampling
 //       add_emitting_triangle_sample_contribution
@@ -76,7 +81,7 @@ namespace renderer
 //       compute_outgoing_radiance_light_sampling
 //
 //   compute_outgoing_radiance_combined_sampling_low_variance
-//       compute_outgoing_radiance_bsdf_sampling
+//       compute_outgoing_radiance_bsdf_sampling_low_variance
 //       compute_outgoing_radiance_light_sampling_low_variance
 //
 //   compute_incoming_radiance
@@ -117,6 +122,35 @@ void DirectLightingIntegrator::compute_outgoing_radiance_bsdf_sampling(
     const MISHeuristic          mis_heuristic,
     const Dual3d&               outgoing,
     Spectrum&                   radiance) const
+{
+    take_bsdf_samples(
+        sampling_context,
+        mis_heuristic,
+        false,                  // MIS with compute_outgoing_radiance_light_sampling()
+        outgoing,
+        radiance);
+}
+
+void DirectLightingIntegrator::compute_outgoing_radiance_bsdf_sampling_low_variance(
+    SamplingContext&            sampling_context,
+    const MISHeuristic          mis_heuristic,
+    const Dual3d&               outgoing,
+    Spectrum&                   radiance) const
+{
+    take_bsdf_samples(
+        sampling_context,
+        mis_heuristic,
+        true,                   // MIS with compute_outgoing_radiance_light_sampling_low_variance()
+        outgoing,
+        radiance);
+}
+
+void DirectLightingIntegrator::take_bsdf_samples(
+    SamplingContext&            sampling_context,
+    const MISHeuristic          mis_heuristic,
+    const bool                  low_variance,
+    const Dual3d&               outgoing,
+    Spectrum&                   radiance) const
 {
     radiance.set(0.0f);
 
@@ -129,6 +163,7 @@ void DirectLightingIntegrator::compute_outgoing_radiance_bsdf_sampling(
         take_single_bsdf_sample(
             sampling_context,
             mis_heuristic,
+            low_variance,
             outgoing,
             radiance);
     }
@@ -165,6 +200,7 @@ void DirectLightingIntegrator::compute_outgoing_radiance_light_sampling(
         LightSample sample;
         m_light_sampler.sample(
             m_time,
+            m_point,
             sampling_context.next2<Vector3f>(),
             sample);
 
@@ -208,9 +244,47 @@ void DirectLightingIntegrator::compute_outgoing_radiance_light_sampling_low_vari
     if (m_bsdf.is_purely_specular())
         return;
 
-    // Add contributions from emitting triangles only.
-    if (m_light_sampler.get_emitting_triangle_count() > 0)
+    if (m_light_sampler.has_light_tree())
+    {
+        // Add contributions from the emitters of the light tree: emitting triangles
+        // and non-physical light sources with a position.
+        sampling_context.split_in_place(3, m_light_sample_count);
+
+        for (size_t i = 0; i < m_light_sample_count; ++i)
+        {
+            LightSample sample;
+            m_light_sampler.sample_light_tree(
+                m_time,
+                m_point,
+                sampling_context.next2<Vector3f>(),
+                sample);
+
+            if (sample.m_triangle)
+            {
+                add_emitting_triangle_sample_contribution(
+                    sample,
+                    mis_heuristic,
+                    outgoing,
+                    radiance);
+            }
+            else
+            {
+                add_non_physical_light_sample_contribution(
+                    sample,
+                    outgoing,
+                    radiance);
+            }
+        }
+
+        if (m_light_sample_count > 1)
+        {
+            const float rcp_light_sample_count = 1.0f / m_light_sample_count;
+            radiance *= rcp_light_sample_count;
+        }
+    }
+    else if (m_light_sampler.get_emitting_triangle_count() > 0)
     {
+        // Add contributions from emitting triangles only.
         sampling_context.split_in_place(3, m_light_sample_count);
 
         for (size_t i = 0; i < m_light_sample_count; ++i)
@@ -236,8 +310,8 @@ void DirectLightingIntegrator::compute_outgoing_radiance_light_sampling_low_vari
         }
     }
 
-    // Add contributions from non-physical light sources only.
-    for (size_t i = 0, e = m_light_sampler.get_non_physical_light_count(); i < e; ++i)
+    // Add contributions from non-physical light sources that are not in the light tree.
+    for (size_t i = 0, e = m_light_sampler.get_individual_light_count(); i < e; ++i)
     {
         LightSample sample;
         m_light_sampler.sample_non_physical_light(m_time, i, sample);
@@ -276,7 +350,7 @@ void DirectLightingIntegrator::compute_outgoing_radiance_combined_sampling_low_v
     const Dual3d&               outgoing,
     Spectrum&                   radiance) const
 {
-    compute_outgoing_radiance_bsdf_sampling(
+    compute_outgoing_radiance_bsdf_sampling_low_variance(
         sampling_context,
         MISPower2,
         outgoing,
@@ -311,6 +385,7 @@ bool DirectLightingIntegrator::compute_incoming_radiance(
     LightSample sample;
     m_light_sampler.sample(
         m_time,
+        m_point,
         sampling_context.next2<Vector3f>(),
         sample);
 
@@ -427,6 +502,7 @@ bool DirectLightingIntegrator::compute_incoming_radiance(
 void DirectLightingIntegrator::take_single_bsdf_sample(
     SamplingContext&            sampling_context,
     const MISHeuristic          mis_heuristic,
+    const bool                  low_variance,
     const Dual3d&               outgoing,
     Spectrum&                   radiance) const
 {
@@ -513,7 +589,10 @@ void DirectLightingIntegrator::take_single_bsdf_sample(
             const float bsdf_prob_area = sample.m_probability * cos_on / static_cast<float>(square_distance);
 
             // Compute the probability density wrt. surface area mesure of the light sample.
-            const float light_prob_area = m_light_sampler.evaluate_pdf(light_shading_point);
+            const float light_prob_area =
+                low_variance
+                    ? m_light_sampler.evaluate_pdf_low_variance(light_shading_point)
+                    : m_light_sampler.evaluate_pdf(light_shading_point);
 
             // Apply the weighting function.
             weight *=
@@ -67,6 +67,10 @@ namespace renderer
 //   The number of shadow rays cast by these functions may be as high as the number of light
 //   samples passed to the constructor plus the number of non-physical lights in the scene.
 //
+//   When the light sampler uses a light tree, non-physical light sources with a position are
+//   sampled together with light-emitting triangles, and only distant light sources are sampled
+//   individually.
+//
 
 class DirectLightingIntegrator
 {
@@ -101,6 +105,11 @@ class DirectLightingIntegrator
         const foundation::MISHeuristic  mis_heuristic,
         const foundation::Dual3d&       outgoing,                   // world space outgoing direction, unit-length
         Spectrum&                       radiance) const;
+    void compute_outgoing_radiance_bsdf_sampling_low_variance(
+        SamplingContext&                sampling_context,
+        const foundation::MISHeuristic  mis_heuristic,
+        const foundation::Dual3d&       outgoing,                   // world space outgoing direction, unit-length
+        Spectrum&                       radiance) const;
 
     // Compute outgoing radiance due to direct lighting via light sampling only.
     void compute_outgoing_radiance_light_sampling(
@@ -138,9 +147,17 @@ class DirectLightingIntegrator
     const size_t                        m_light_sample_count;
     const bool                          m_indirect;
 
+    void take_bsdf_samples(
+        SamplingContext&                sampling_context,
+        const foundation::MISHeuristic  mis_heuristic,
+        const bool                      low_variance,               // weight against low variance light sampling?
+        const foundation::Dual3d&       outgoing,
+        Spectrum&                       radiance) const;
+
     void take_single_bsdf_sample(
         SamplingContext&                sampling_context,
         const foundation::MISHeuristic  mis_heuristic,
+        const bool                      low_variance,
         const foundation::Dual3d&       outgoing,
         Spectrum&                       radiance) const;
 
@@ -38,7 +38,9 @@
 #include "renderer/kernel/shading/shadingray.h"
 #include "renderer/kernel/tessellation/statictessellation.h"
 #include "renderer/modeling/edf/edf.h"
+#include "renderer/modeling/light/directionallight.h"
 #include "renderer/modeling/light/light.h"
+#include "renderer/modeling/light/sunlight.h"
 #include "renderer/modeling/material/material.h"
 #include "renderer/modeling/object/iregion.h"
 #include "renderer/modeling/object/object.h"
@@ -54,13 +56,20 @@
 
 // appleseed.foundation headers.
 #include "foundation/math/sampling/mappings.h"
+#include "foundation/math/aabb.h"
 #include "foundation/math/scalar.h"
+#include "foundation/platform/timers.h"
 #include "foundation/utility/foreach.h"
 #include "foundation/utility/lazy.h"
+#include "foundation/utility/makevector.h"
+#include "foundation/utility/stopwatch.h"
 #include "foundation/utility/string.h"
 
 // Standard headers.
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstring>
 #include <string>
 
 using namespace foundation;
@@ -104,6 +113,25 @@ void LightSample::make_shading_point(
 // LightSampler class implementation.
 //
 
+namespace
+{
+    // Return true if a given light is infinitely far away and therefore has no position.
+    bool is_distant_light(const Light& light)
+    {
+        return
+            strcmp(light.get_model(), DirectionalLightFactory().get_model()) == 0 ||
+            strcmp(light.get_model(), SunLightFactory().get_model()) == 0;
+    }
+
+    struct IsDistantLight
+    {
+        bool operator()(const NonPhysicalLightInfo& light_info) const
+        {
+            return is_distant_light(*light_info.m_light);
+        }
+    };
+}
+
 LightSampler::LightSampler(const Scene& scene, const ParamArray& params)
   : m_params(params)
   , m_emitting_triangle_hash_table(m_triangle_key_hasher)
@@ -114,6 +142,28 @@ LightSampler::LightSampler(const Scene& scene, const ParamArray& params)
     collect_non_physical_lights(scene.assembly_instances(), TransformSequence());
     m_non_physical_light_count = m_non_physical_lights.size();
 
+    // Only non-physical lights with a position can be stored in the light tree;
+    // move the distant ones in front of the others since they are sampled individually.
+    m_individual_light_count =
+        m_params.m_light_tree
+            ? stable_partition(
+                  m_non_physical_lights.begin(),
+                  m_non_physical_lights.end(),
+                  IsDistantLight()) - m_non_physical_lights.begin()
+            : m_non_physical_light_count;
+
+    // Insert the non-physical lights into the CDFs.
+    for (size_t i = 0; i < m_non_physical_light_count; ++i)
+    {
+        // todo: compute importance.
+        float importance = 1.0f;
+        importance *= m_non_physical_lights[i].m_light->get_uncached_importance_multiplier();
+        m_non_physical_lights_cdf.insert(i, importance);
+
+        if (i < m_individual_light_count)
+            m_individual_lights_cdf.insert(i, importance);
+    }
+
     // Collect all light-emitting triangles.
     collect_emitting_triangles(
         scene.assembly_instances(),
@@ -127,12 +177,18 @@ LightSampler::LightSampler(const Scene& scene, const ParamArray& params)
         m_non_physical_lights_cdf.prepare();
     if (m_emitting_triangles_cdf.valid())
         m_emitting_triangles_cdf.prepare();
+    if (m_individual_lights_cdf.valid())
+        m_individual_lights_cdf.prepare();
 
     // Store the triangle probability densities into the emitting triangles.
     const size_t emitting_triangle_count = m_emitting_triangles.size();
     for (size_t i = 0; i < emitting_triangle_count; ++i)
         m_emitting_triangles[i].m_triangle_prob = m_emitting_triangles_cdf[i].second;
 
+    // Build the light tree.
+    if (m_params.m_light_tree)
+        build_light_tree();
+
    RENDERER_LOG_INFO(
         "found %s %s, %s emitting %s.",
         pretty_int(m_non_physical_light_count).c_str(),
@@ -180,17 +236,10 @@ void LightSampler::collect_non_physical_lights(
         const Light& light = *i;
 
         // Copy the light into the light vector.
-        const size_t light_index = m_non_physical_lights.size();
         NonPhysicalLightInfo light_info;
         light_info.m_transform_sequence = transform_sequence;
         light_info.m_light = &light;
         m_non_physical_lights.push_back(light_info);
-
-        // Insert the light into the CDF.
-        // todo: compute importance.
-        float importance = 1.0f;
-        importance *= light.get_uncached_importance_multiplier();
-        m_non_physical_lights_cdf.insert(light_index, importance);
     }
 }
 
@@ -424,6 +473,97 @@ void LightSampler::build_emitting_triangle_hash_table()
     }
 }
 
+void LightSampler::build_light_tree()
+{
+    const size_t emitting_triangle_count = m_emitting_triangles.size();
+    const size_t tree_light_count = m_non_physical_light_count - m_individual_light_count;
+
+    if (emitting_triangle_count + tree_light_count == 0)
+        return;
+
+    RENDERER_LOG_INFO("building light tree...");
+
+    Stopwatch<DefaultWallclockTimer> stopwatch;
+    stopwatch.start();
+
+    LightTree::ItemVector items;
+    items.reserve(emitting_triangle_count + tree_light_count);
+
+    // Emitting triangles emit in the hemisphere centered on their normal; bound their
+    // geometric normal and their vertex normals since both are used to cull light samples.
+    for (size_t i = 0; i < emitting_triangle_count; ++i)
+    {
+        const EmittingTriangle& triangle = m_emitting_triangles[i];
+
+        LightTree::Item item;
+        item.m_bbox.invalidate();
+        item.m_bbox.insert(triangle.m_v0);
+        item.m_bbox.insert(triangle.m_v1);
+        item.m_bbox.insert(triangle.m_v2);
+        item.m_axis = triangle.m_geometric_normal;
+
+        const double min_cos =
+            min(
+                min(
+                    dot(triangle.m_geometric_normal, triangle.m_n0),
+                    dot(triangle.m_geometric_normal, triangle.m_n1)),
+                dot(triangle.m_geometric_normal, triangle.m_n2));
+        item.m_normal_angle = acos(foundation::clamp(min_cos, -1.0, 1.0));
+
+        // The power of the triangle is estimated without evaluating its EDF.
+        float importance_multiplier = 1.0f;
+        if (const EDF* edf = triangle.m_material->get_uncached_edf())
+            importance_multiplier = edf->get_uncached_importance_multiplier();
+        item.m_power = triangle.m_area * importance_multiplier;
+
+        items.push_back(item);
+    }
+
+    // Non-physical lights are considered to emit in all directions. The bounding box of
+    // a moving light encloses its positions at the keys of its transform sequence.
+    for (size_t i = m_individual_light_count; i < m_non_physical_light_count; ++i)
+    {
+        const NonPhysicalLightInfo& light_info = m_non_physical_lights[i];
+        const TransformSequence& transform_sequence = light_info.m_transform_sequence;
+
+        const Transformd earliest_transform =
+              light_info.m_light->get_transform()
+            * transform_sequence.get_earliest_transform();
+
+        LightTree::Item item;
+        item.m_bbox.invalidate();
+        item.m_bbox.insert(earliest_transform.point_to_parent(Vector3d(0.0)));
+
+        for (size_t j = 0, e = transform_sequence.size(); j < e; ++j)
+        {
+            float time;
+            Transformd transform;
+            transform_sequence.get_transform(j, time, transform);
+
+            const Transformd light_transform = light_info.m_light->get_transform() * transform;
+            item.m_bbox.insert(light_transform.point_to_parent(Vector3d(0.0)));
+        }
+
+        item.m_axis = Vector3d(0.0, 1.0, 0.0);
+        item.m_normal_angle = Pi<double>();
+        item.m_power = light_info.m_light->get_uncached_importance_multiplier();
+
+        items.push_back(item);
+    }
+
+    m_light_tree.build(items);
+
+    stopwatch.measure();
+
+    RENDERER_LOG_INFO(
+        "built light tree with %s %s and %s %s in %s.",
+        pretty_uint(items.size()).c_str(),
+        plural(items.size(), "emitter").c_str(),
+        pretty_uint(m_light_tree.get_node_count()).c_str(),
+        plural(m_light_tree.get_node_count(), "node").c_str(),
+        pretty_time(stopwatch.get_seconds()).c_str());
+}
+
 void LightSampler::sample_non_physical_lights(
     const ShadingRay::Time&             time,
     const Vector3f&                     s,
@@ -456,6 +596,7 @@ void LightSampler::sample_emitting_triangles(
     const EmitterCDF::ItemWeightPair result = m_emitting_triangles_cdf.sample(s[0]);
     const size_t emitter_index = result.first;
     const float emitter_prob = result.second;
+    assert(m_emitting_triangles[emitter_index].m_triangle_prob == emitter_prob);
 
     light_sample.m_light = 0;
     sample_emitting_triangle(
@@ -502,7 +643,95 @@ void LightSampler::sample(
     else sample_emitting_triangles(time, s, light_sample);
 }
 
+void LightSampler::sample(
+    const ShadingRay::Time&             time,
+    const Vector3d&                     point,
+    const Vector3f&                     s,
+    LightSample&                        light_sample) const
+{
+    if (!has_light_tree())
+    {
+        sample(time, s, light_sample);
+        return;
+    }
+
+    if (m_individual_lights_cdf.valid())
+    {
+        if (s[0] < 0.5f)
+        {
+            const EmitterCDF::ItemWeightPair result = m_individual_lights_cdf.sample(s[0] * 2.0f);
+
+            light_sample.m_triangle = 0;
+            sample_non_physical_light(
+                time,
+                result.first,
+                result.second,
+                light_sample);
+        }
+        else
+        {
+            sample_light_tree(
+                time,
+                point,
+                Vector3f((s[0] - 0.5f) * 2.0f, s[1], s[2]),
+                light_sample);
+        }
+
+        light_sample.m_probability *= 0.5f;
+    }
+    else sample_light_tree(time, point, s, light_sample);
+}
+
+void LightSampler::sample_light_tree(
+    const ShadingRay::Time&             time,
+    const Vector3d&                     point,
+    const Vector3f&                     s,
+    LightSample&                        light_sample) const
+{
+    assert(has_light_tree());
+
+    float item_prob;
+    const size_t item_index = m_light_tree.sample(point, s[0], item_prob);
+
+    const size_t emitting_triangle_count = m_emitting_triangles.size();
+
+    if (item_index < emitting_triangle_count)
+    {
+        light_sample.m_light = 0;
+        sample_emitting_triangle(
+            time,
+            Vector2f(s[1], s[2]),
+            item_index,
+            item_prob,
+            light_sample);
+    }
+    else
+    {
+        light_sample.m_triangle = 0;
+        sample_non_physical_light(
+            time,
+            m_individual_light_count + item_index - emitting_triangle_count,
+            item_prob,
+            light_sample);
+    }
+
+    assert(light_sample.m_probability > 0.0f);
+}
+
 float LightSampler::evaluate_pdf(const ShadingPoint& shading_point) const
+{
+    // sample() picks between two sets of emitters with equal probability when both exist.
+    const bool two_sets =
+        has_light_tree()
+            ? m_individual_lights_cdf.valid()
+            : m_non_physical_lights_cdf.valid();
+
+    const float pdf = evaluate_pdf_low_variance(shading_point);
+
+    return two_sets ? 0.5f * pdf : pdf;
+}
+
+float LightSampler::evaluate_pdf_low_variance(const ShadingPoint& shading_point) const
 {
     assert(shading_point.is_triangle_primitive());
 
@@ -512,8 +741,22 @@ float LightSampler::evaluate_pdf(const ShadingPoint& shading_point) const
         shading_point.get_region_index(),
         shading_point.get_primitive_index());
 
-    const EmittingTriangle* triangle = m_emitting_triangle_hash_table.get(triangle_key);
-    return triangle->m_triangle_prob * triangle->m_rcp_area;
+    // Triangles of archives loaded on demand are not known to the light sampler.
+    const EmittingTriangle* const* triangle = m_emitting_triangle_hash_table.find(triangle_key);
+    if (triangle == 0)
+        return 0.0f;
+
+    if (has_light_tree())
+    {
+        const size_t triangle_index = static_cast<size_t>(*triangle - &m_emitting_triangles.front());
+        const float triangle_prob =
+            m_light_tree.evaluate_pdf(
+                shading_point.get_ray().m_org,
+                triangle_index);
+        return triangle_prob * (*triangle)->m_rcp_area;
+    }
+
+    return (*triangle)->m_triangle_prob * (*triangle)->m_rcp_area;
 }
 
 void LightSampler::sample_non_physical_light(
@@ -544,7 +787,6 @@ void LightSampler::sample_emitting_triangle(
 {
     // Fetch the emitting triangle.
     const EmittingTriangle& emitting_triangle = m_emitting_triangles[triangle_index];
-    assert(emitting_triangle.m_triangle_prob == triangle_prob);
 
     // Store a pointer to the emitting triangle.
     light_sample.m_triangle = &emitting_triangle;
@@ -602,6 +844,11 @@ void LightSampler::store_object_area_in_shadergroups(
 
 LightSampler::Parameters::Parameters(const ParamArray& params)
   : m_importance_sampling(params.get_optional<bool>("enable_importance_sampling", false))
+  , m_light_tree(
+        params.get_optional<string>(
+            "algorithm",
+            "cdf",
+            make_vector("cdf", "light_tree")) == "light_tree")
 {
 }
 
@@ -32,6 +32,7 @@
 
 // appleseed.renderer headers.
 #include "renderer/kernel/intersection/intersectionsettings.h"
+#include "renderer/kernel/lighting/lighttree.h"
 #include "renderer/kernel/shading/shadingray.h"
 #include "renderer/modeling/scene/containers.h"
 #include "renderer/utility/transformsequence.h"
@@ -171,6 +172,12 @@ class LightSample
 // The light sampler collects all the light-emitting entities (non-physical lights, mesh lights)
 // and allows to sample them.
 //
+// By default, emitters are chosen from CDFs weighted by their power only. When the "algorithm"
+// parameter is set to "light_tree", emitting triangles and non-physical lights with a position
+// are also stored into a light tree, which allows to choose them according to their estimated
+// contribution at the point being lit. Distant lights (directional and sun lights) are always
+// chosen from a CDF.
+//
 
 class LightSampler
   : public foundation::NonCopyable
@@ -190,6 +197,13 @@ class LightSampler
     // Return true if the scene contains at least one light or emitting triangle.
     bool has_lights_or_emitting_triangles() const;
 
+    // Return true if the light tree is enabled and contains at least one emitter.
+    bool has_light_tree() const;
+
+    // Return the number of non-physical lights that are not stored in the light tree: all of them
+    // when the light tree is disabled, only the distant ones otherwise. These lights come first.
+    size_t get_individual_light_count() const;
+
     // Sample the set of non-physical lights.
     void sample_non_physical_lights(
         const ShadingRay::Time&             time,
@@ -214,13 +228,34 @@ class LightSampler
         const foundation::Vector3f&         s,
         LightSample&                        light_sample) const;
 
+    // Sample the sets of non-physical lights and emitting triangles for a given world space point.
+    // Equivalent to the method above when the light tree is disabled.
+    void sample(
+        const ShadingRay::Time&             time,
+        const foundation::Vector3d&         point,
+        const foundation::Vector3f&         s,
+        LightSample&                        light_sample) const;
+
+    // Sample the emitters of the light tree for a given world space point.
+    void sample_light_tree(
+        const ShadingRay::Time&             time,
+        const foundation::Vector3d&         point,
+        const foundation::Vector3f&         s,
+        LightSample&                        light_sample) const;
+
     // Compute the probability density in area measure of a given light sample.
+    // When the light tree is enabled, the origin of the ray that hit the light
+    // is taken as the point being lit. evaluate_pdf() matches sample() while
+    // evaluate_pdf_low_variance() matches sample_emitting_triangles(), or
+    // sample_light_tree() when the light tree is enabled.
     float evaluate_pdf(const ShadingPoint& shading_point) const;
+    float evaluate_pdf_low_variance(const ShadingPoint& shading_point) const;
 
   private:
     struct Parameters
     {
         const bool m_importance_sampling;
+        const bool m_light_tree;
 
         explicit Parameters(const ParamArray& params);
     };
@@ -233,11 +268,15 @@ class LightSampler
 
     NonPhysicalLightVector      m_non_physical_lights;
     size_t                      m_non_physical_light_count;
+    size_t                      m_individual_light_count;
 
     EmittingTriangleVector      m_emitting_triangles;
 
     EmitterCDF                  m_non_physical_lights_cdf;
     EmitterCDF                  m_emitting_triangles_cdf;
+    EmitterCDF                  m_individual_lights_cdf;
+
+    LightTree                   m_light_tree;               // emitting triangles first, then non-physical lights with a position
 
     EmittingTriangleKeyHasher   m_triangle_key_hasher;
     EmittingTriangleHashTable   m_emitting_triangle_hash_table;
@@ -266,6 +305,9 @@ class LightSampler
     // Build a hash table that allows to find the emitting triangle at a given shading point.
     void build_emitting_triangle_hash_table();
 
+    // Build the light tree from the emitting triangles and the non-physical lights with a position.
+    void build_light_tree();
+
     // Sample a given non-physical light.
     void sample_non_physical_light(
         const ShadingRay::Time&             time,
@@ -353,6 +395,16 @@ inline bool LightSampler::has_lights_or_emitting_triangles() const
     return m_non_physical_lights_cdf.valid() || m_emitting_triangles_cdf.valid();
 }
 
+inline bool LightSampler::has_light_tree() const
+{
+    return !m_light_tree.empty();
+}
+
+inline size_t LightSampler::get_individual_light_count() const
+{
+    return m_individual_light_count;
+}
+
 inline void LightSampler::sample_non_physical_light(
     const ShadingRay::Time&                 time,
     const size_t                            light_index,
@@ -0,0 +1,336 @@
+
+//
+// This source file is part of appleseed.
+// Visit http://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2010-2013 Francois Beaune, Jupiter Jazz Limited
+// Copyright (c) 2014-2017 Francois Beaune, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// Interface header.
+#include "lighttree.h"
+
+// appleseed.foundation headers.
+#include "foundation/math/scalar.h"
+
+// Standard headers.
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+using namespace foundation;
+using namespace std;
+
+namespace renderer
+{
+
+namespace
+{
+    // Order items by the center of their bounding box along a given dimension.
+    struct ItemCenterOrder
+    {
+        const LightTree::ItemVector&    m_items;
+        const size_t                    m_dim;
+
+        ItemCenterOrder(
+            const LightTree::ItemVector&    items,
+            const size_t                    dim)
+          : m_items(items)
+          , m_dim(dim)
+        {
+        }
+
+        bool operator()(const size_t lhs, const size_t rhs) const
+        {
+            return m_items[lhs].m_bbox.center(m_dim) < m_items[rhs].m_bbox.center(m_dim);
+        }
+    };
+
+    // Compute the smallest cone containing two cones given by their axis and half-angle.
+    void merge_cones(
+        const Vector3d&     axis_a,
+        const double        angle_a,
+        const Vector3d&     axis_b,
+        const double        angle_b,
+        Vector3d&           axis,
+        double&             angle)
+    {
+        // Make sure the first cone is the widest one.
+        if (angle_a < angle_b)
+        {
+            merge_cones(axis_b, angle_b, axis_a, angle_a, axis, angle);
+            return;
+        }
+
+        const double angle_d = acos(foundation::clamp(dot(axis_a, axis_b), -1.0, 1.0));
+
+        // The second cone is contained in the first one.
+        if (min(angle_d + angle_b, Pi<double>()) <= angle_a)
+        {
+            axis = axis_a;
+            angle = angle_a;
+            return;
+        }
+
+        // The merged cone covers all directions.
+        const double merged_angle = 0.5 * (angle_a + angle_d + angle_b);
+        if (merged_angle >= Pi<double>())
+        {
+            axis = axis_a;
+            angle = Pi<double>();
+            return;
+        }
+
+        // Rotate the axis of the first cone toward the axis of the second one.
+        const double rotation = merged_angle - angle_a;
+        const Vector3d merged_axis = sin(angle_d - rotation) * axis_a + sin(rotation) * axis_b;
+        const double merged_axis_norm = norm(merged_axis);
+
+        // The axes are nearly opposite: fall back to a cone covering all directions.
+        if (merged_axis_norm < 1.0e-6)
+        {
+            axis = axis_a;
+            angle = Pi<double>();
+            return;
+        }
+
+        axis = merged_axis / merged_axis_norm;
+        angle = merged_angle;
+    }
+}
+
+
+//
+// LightTree class implementation.
+//
+
+LightTree::LightTree()
+{
+}
+
+void LightTree::build(const ItemVector& items)
+{
+    m_nodes.clear();
+    m_item_leaves.clear();
+
+    if (items.empty())
+        return;
+
+    const size_t item_count = items.size();
+    m_item_leaves.resize(item_count);
+
+    vector<size_t> item_indices(item_count);
+    for (size_t i = 0; i < item_count; ++i)
+        item_indices[i] = i;
+
+    // A binary tree with one item per leaf has exactly 2 * N - 1 nodes.
+    m_nodes.reserve(2 * item_count - 1);
+    m_nodes.push_back(Node());
+    m_nodes[0].m_parent = ~size_t(0);
+
+    build_node(items, item_indices, 0, item_count, 0);
+
+    assert(m_nodes.size() == 2 * item_count - 1);
+}
+
+void LightTree::build_node(
+    const ItemVector&       items,
+    vector<size_t>&         item_indices,
+    const size_t            begin,
+    const size_t            end,
+    const size_t            node_index)
+{
+    assert(end > begin);
+
+    if (end - begin == 1)
+    {
+        // Create a leaf node.
+        const size_t item_index = item_indices[begin];
+        const Item& item = items[item_index];
+        Node& node = m_nodes[node_index];
+        node.m_bbox = item.m_bbox;
+        node.m_axis = item.m_axis;
+        node.m_normal_angle = item.m_normal_angle;
+        node.m_power = static_cast<double>(item.m_power);
+        node.m_index = item_index;
+        node.m_leaf = true;
+        m_item_leaves[item_index] = node_index;
+        return;
+    }
+
+    // Split the items at the median of their centers, along the dimension in which the centers spread the most.
+    AABB3d center_bbox;
+    center_bbox.invalidate();
+    for (size_t i = begin; i < end; ++i)
+        center_bbox.insert(items[item_indices[i]].m_bbox.center());
+    const size_t split_dim = max_index(center_bbox.extent());
+    const size_t middle = (begin + end) / 2;
+    nth_element(
+        item_indices.begin() + begin,
+        item_indices.begin() + middle,
+        item_indices.begin() + end,
+        ItemCenterOrder(items, split_dim));
+
+    // Create and build the child nodes.
+    const size_t child_index = m_nodes.size();
+    m_nodes.push_back(Node());
+    m_nodes.push_back(Node());
+    m_nodes[child_index].m_parent = node_index;
+    m_nodes[child_index + 1].m_parent = node_index;
+    build_node(items, item_indices, begin, middle, child_index);
+    build_node(items, item_indices, middle, end, child_index + 1);
+
+    // Bound the child nodes.
+    const Node& left = m_nodes[child_index];
+    const Node& right = m_nodes[child_index + 1];
+    Node& node = m_nodes[node_index];
+    node.m_bbox = left.m_bbox;
+    node.m_bbox.insert(right.m_bbox);
+    merge_cones(
+        left.m_axis, left.m_normal_angle,
+        right.m_axis, right.m_normal_angle,
+        node.m_axis, node.m_normal_angle);
+    node.m_power = left.m_power + right.m_power;
+    node.m_index = child_index;
+    node.m_leaf = false;
+}
+
+size_t LightTree::sample(
+    const Vector3d&         point,
+    const float             s,
+    float&                  probability) const
+{
+    assert(!empty());
+
+    // Use double precision to keep enough bits of the sample for the deepest levels.
+    const double MaxSample = 1.0 - numeric_limits<double>::epsilon();
+    double u = static_cast<double>(s);
+    double prob = 1.0;
+
+    size_t node_index = 0;
+
+    while (!m_nodes[node_index].m_leaf)
+    {
+        const Node& node = m_nodes[node_index];
+        const double left_prob = compute_left_probability(node, point);
+
+        if (u < left_prob)
+        {
+            u /= left_prob;
+            prob *= left_prob;
+            node_index = node.m_index;
+        }
+        else
+        {
+            const double right_prob = 1.0 - left_prob;
+            u = (u - left_prob) / right_prob;
+            prob *= right_prob;
+            node_index = node.m_index + 1;
+        }
+
+        u = min(u, MaxSample);
+    }
+
+    probability = static_cast<float>(prob);
+
+    return m_nodes[node_index].m_index;
+}
+
+float LightTree::evaluate_pdf(
+    const Vector3d&         point,
+    const size_t            item_index) const
+{
+    assert(item_index < m_item_leaves.size());
+
+    double prob = 1.0;
+
+    // Walk up from the leaf of the item to the root, accumulating the probabilities of the choices.
+    size_t node_index = m_item_leaves[item_index];
+
+    while (node_index != 0)
+    {
+        const size_t parent_index = m_nodes[node_index].m_parent;
+        const Node& parent = m_nodes[parent_index];
+        const double left_prob = compute_left_probability(parent, point);
+        prob *= node_index == parent.m_index ? left_prob : 1.0 - left_prob;
+        node_index = parent_index;
+    }
+
+    return static_cast<float>(prob);
+}
+
+double LightTree::compute_importance(
+    const Node&             node,
+    const Vector3d&         point)
+{
+    const Vector3d d = point - node.m_bbox.center();
+    const double square_dist = square_norm(d);
+    const double radius = node.m_bbox.radius();
+    const double square_radius = square(radius);
+
+    // Don't let the distance fall below the size of the node, otherwise the importance
+    // of nodes close to or containing the point would be unbounded.
+    double importance = node.m_power / max(square_dist, square_radius);
+
+    // Bound the angle between the normals of the emitters and the direction toward the point.
+    // Emitters don't light points lying more than Pi/2 away from their normal.
+    if (node.m_normal_angle < Pi<double>() && square_dist > square_radius)
+    {
+        const double dist = sqrt(square_dist);
+        const double angle = acos(foundation::clamp(dot(node.m_axis, d) / dist, -1.0, 1.0));
+        const double bbox_angle = asin(radius / dist);
+        const double min_angle = angle - node.m_normal_angle - bbox_angle;
+
+        if (min_angle >= HalfPi<double>())
+            return 0.0;
+
+        if (min_angle > 0.0)
+            importance *= cos(min_angle);
+    }
+
+    return importance;
+}
+
+double LightTree::compute_left_probability(
+    const Node&             node,
+    const Vector3d&         point) const
+{
+    assert(!node.m_leaf);
+
+    const Node& left = m_nodes[node.m_index];
+    const Node& right = m_nodes[node.m_index + 1];
+
+    const double left_importance = compute_importance(left, point);
+    const double right_importance = compute_importance(right, point);
+    const double total_importance = left_importance + right_importance;
+
+    if (total_importance > 0.0)
+        return left_importance / total_importance;
+
+    // Neither child can light the point: fall back to their power.
+    const double total_power = left.m_power + right.m_power;
+    return total_power > 0.0 ? left.m_power / total_power : 0.5;
+}
+
+}   // namespace renderer
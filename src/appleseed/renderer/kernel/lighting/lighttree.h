@@ -0,0 +1,159 @@
+
+//
+// This source file is part of appleseed.
+// Visit http://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2010-2013 Francois Beaune, Jupiter Jazz Limited
+// Copyright (c) 2014-2017 Francois Beaune, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#ifndef APPLESEED_RENDERER_KERNEL_LIGHTING_LIGHTTREE_H
+#define APPLESEED_RENDERER_KERNEL_LIGHTING_LIGHTTREE_H
+
+// appleseed.foundation headers.
+#include "foundation/core/concepts/noncopyable.h"
+#include "foundation/math/aabb.h"
+#include "foundation/math/vector.h"
+
+// Standard headers.
+#include <cstddef>
+#include <vector>
+
+namespace renderer
+{
+
+//
+// A bounding volume hierarchy over light emitters, allowing to choose an emitter
+// in O(log N) with a probability that depends on the point being lit.
+//
+// Every node bounds the position, the emission directions and the power of the
+// emitters below it. At each interior node, a child is chosen with a probability
+// proportional to an estimate of its contribution at the shading point (its power
+// divided by the square distance to its bounds, and zero if all its emitters face
+// away from the shading point). The probability of an emitter is the product of the
+// probabilities of the choices made along the path from the root to its leaf.
+//
+// References:
+//
+//   Importance Sampling of Many Lights with Adaptive Tree Splitting
+//   Alejandro Conty Estevez, Christopher Kulla, HPG 2018
+//
+
+class LightTree
+  : public foundation::NonCopyable
+{
+  public:
+    // An emitter to insert into the tree.
+    struct Item
+    {
+        foundation::AABB3d      m_bbox;                 // world space bounding box of the emitter
+        foundation::Vector3d    m_axis;                 // axis of the cone bounding the emitter's normals, unit-length
+        double                  m_normal_angle;         // half-angle of this cone, in radians; Pi if the emitter is omnidirectional
+        float                   m_power;                // estimated power of the emitter
+    };
+
+    typedef std::vector<Item> ItemVector;
+
+    // Constructor, builds an empty tree.
+    LightTree();
+
+    // Build the tree. The index of an item in the vector identifies it in the tree.
+    void build(const ItemVector& items);
+
+    // Return true if the tree contains no item.
+    bool empty() const;
+
+    // Return the number of items in the tree.
+    size_t size() const;
+
+    // Return the number of nodes in the tree.
+    size_t get_node_count() const;
+
+    // Choose an item given a world space point and a sample in [0,1).
+    // Returns the index of the item and its probability.
+    size_t sample(
+        const foundation::Vector3d&     point,
+        const float                     s,
+        float&                          probability) const;
+
+    // Return the probability with which a given item is chosen at a given point.
+    float evaluate_pdf(
+        const foundation::Vector3d&     point,
+        const size_t                    item_index) const;
+
+  private:
+    struct Node
+    {
+        foundation::AABB3d      m_bbox;
+        foundation::Vector3d    m_axis;
+        double                  m_normal_angle;
+        double                  m_power;
+        size_t                  m_parent;               // index of the parent node, ~0 for the root node
+        size_t                  m_index;                // index of the first child for interior nodes, index of the item for leaves
+        bool                    m_leaf;
+    };
+
+    std::vector<Node>           m_nodes;
+    std::vector<size_t>         m_item_leaves;          // index of the leaf node of each item
+
+    void build_node(
+        const ItemVector&               items,
+        std::vector<size_t>&            item_indices,
+        const size_t                    begin,
+        const size_t                    end,
+        const size_t                    node_index);
+
+    // Estimate the contribution of the emitters of a given node at a given point.
+    static double compute_importance(
+        const Node&                     node,
+        const foundation::Vector3d&     point);
+
+    // Return the probability of choosing the left child of a given interior node.
+    double compute_left_probability(
+        const Node&                     node,
+        const foundation::Vector3d&     point) const;
+};
+
+
+//
+// LightTree class implementation.
+//
+
+inline bool LightTree::empty() const
+{
+    return m_item_leaves.empty();
+}
+
+inline size_t LightTree::size() const
+{
+    return m_item_leaves.size();
+}
+
+inline size_t LightTree::get_node_count() const
+{
+    return m_nodes.size();
+}
+
+}       // namespace renderer
+
+#endif  // !APPLESEED_RENDERER_KERNEL_LIGHTING_LIGHTTREE_H
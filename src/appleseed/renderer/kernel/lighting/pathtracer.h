@@ -169,11 +169,16 @@ size_t PathTracer<PathVisitor, Adjoint>::trace(
     // here to silence a gcc warning.
     foundation::Vector3d medium_start(0.0);
 
+    // Allocations made by the previous path vertex are released at every iteration,
+    // while allocations made by the caller before the path was started are preserved.
+    foundation::Arena& arena = shading_context.get_arena();
+    const foundation::Arena::Marker arena_marker = arena.get_marker();
+
     size_t iterations = 0;
 
     while (true)
     {
-        shading_context.get_arena().clear();
+        arena.rewind(arena_marker);
 
 #ifndef NDEBUG
         // Save the sampling context at the beginning of the iteration.
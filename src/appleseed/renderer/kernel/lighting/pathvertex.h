@@ -175,7 +175,8 @@ inline float PathVertex::get_bsdf_prob_area() const
 
 inline float PathVertex::get_light_prob_area(const LightSampler& light_sampler) const
 {
-    return light_sampler.evaluate_pdf(*m_shading_point);
+    // Path tracers sample lights with the low variance strategy of the direct lighting integrator.
+    return light_sampler.evaluate_pdf_low_variance(*m_shading_point);
 }
 
 }       // namespace renderer
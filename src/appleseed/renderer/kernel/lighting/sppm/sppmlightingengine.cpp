@@ -323,8 +323,7 @@ namespace
                 const float radius = m_pass_callback.get_lookup_radius();
 
                 // Find the nearby photons around the path vertex.
-                const knn::Query3f query(photon_map, m_answer);
-                query.run(point, radius * radius);
+                photon_map.query(point, radius * radius, m_answer);
                 const size_t photon_count = m_answer.size();
 
                 // Compute the square radius of the lookup disk.
@@ -436,6 +435,7 @@ namespace
                     // The photons store flux but we are computing reflected radiance.
                     // The first step of the flux -> radiance conversion is done here.
                     // The conversion will be completed when doing density estimation.
+                    assert(photon.m_flux.m_wavelength < Spectrum::Samples);
                     float bsdf_mono_value = spectral_bsdf_value[photon.m_flux.m_wavelength];
                     bsdf_mono_value /= abs(dot(photon.m_incoming, photon.m_geometric_normal));
                     bsdf_mono_value *= photon.m_flux.m_amplitude;
@@ -563,18 +563,19 @@ namespace
             Spectrum&               radiance)
         {
             const SPPMPhotonMap& photon_map = m_pass_callback.get_photon_map();
-            const knn::Query3f query(photon_map, m_answer);
-
-            query.run(
+            photon_map.query(
                 Vector3f(shading_point.get_point()),
-                square(m_params.m_view_photons_radius));
-
-            radiance.set(0.0f);
+                square(m_params.m_view_photons_radius),
+                m_answer);
 
             const size_t photon_count = m_answer.size();
 
             if (m_params.m_photon_type == SPPMParameters::Monochromatic)
             {
+                // Monochromatic photons index all the samples of the spectrum.
+                radiance.resize(Spectrum::Samples);
+                radiance.set(0.0f);
+
                 for (size_t i = 0; i < photon_count; ++i)
                 {
                     const knn::Answer<float>::Entry& photon = m_answer.get(i);
@@ -585,6 +586,8 @@ namespace
             }
             else
             {
+                radiance.set(0.0f);
+
                 for (size_t i = 0; i < photon_count; ++i)
                 {
                     const knn::Answer<float>::Entry& photon = m_answer.get(i);
@@ -739,6 +742,37 @@ Dictionary SPPMLightingEngineFactory::get_params_metadata()
             .insert("label", "IBL Photons per Pass")
             .insert("help", "Number of environment photons per render pass"));
 
+    metadata.dictionaries().insert(
+        "max_photon_memory_mb",
+        Dictionary()
+            .insert("type", "int")
+            .insert("default", "0")
+            .insert("min", "0")
+            .insert("label", "Max Photon Memory")
+            .insert("help", "Maximum memory in megabytes used by the photons of a render pass (0 for unlimited); larger passes are split into sub-passes"));
+
+    metadata.dictionaries().insert(
+        "photon_map",
+        Dictionary()
+            .insert("type", "enum")
+            .insert("values", "kdtree|hashgrid")
+            .insert("default", "kdtree")
+            .insert("label", "Photon Map")
+            .insert("help", "Data structure used to look up photons")
+            .insert(
+                "options",
+                Dictionary()
+                    .insert(
+                        "kdtree",
+                        Dictionary()
+                            .insert("label", "K-D Tree")
+                            .insert("help", "Store photons in a k-d tree"))
+                    .insert(
+                        "hashgrid",
+                        Dictionary()
+                            .insert("label", "Hashed Grid")
+                            .insert("help", "Store photons in a hashed grid, faster to build and to query"))));
+
     metadata.dictionaries().insert(
         "initial_radius",
         Dictionary()
@@ -88,10 +88,28 @@ namespace
             value == "rt" ? SPPMParameters::RayTraced :
             SPPMParameters::Off;
     }
+
+    SPPMParameters::PhotonMapType get_photon_map_type(
+        const ParamArray&   params,
+        const char*         name,
+        const char*         default_value)
+    {
+        const string value =
+            params.get_optional<string>(
+                name,
+                default_value,
+                make_vector("kdtree", "hashgrid"));
+
+        return
+            value == "hashgrid"
+                ? SPPMParameters::HashGrid
+                : SPPMParameters::KdTree;
+    }
 }
 
 SPPMParameters::SPPMParameters(const ParamArray& params)
   : m_sampling_mode(get_sampling_context_mode(params))
+  , m_thread_count(get_rendering_thread_count(params))
   , m_photon_type(get_photon_type(params, "photon_type", "poly"))
   , m_dl_mode(get_mode(params, "dl_mode", "rt"))
   , m_enable_ibl(params.get_optional<bool>("enable_ibl", true))
@@ -99,12 +117,14 @@ SPPMParameters::SPPMParameters(const ParamArray& params)
   , m_light_photon_count(params.get_optional<size_t>("light_photons_per_pass", 1000000))
   , m_env_photon_count(params.get_optional<size_t>("env_photons_per_pass", 1000000))
   , m_photon_packet_size(params.get_optional<size_t>("photon_packet_size", 100000))
+  , m_max_photon_memory(params.get_optional<size_t>("max_photon_memory_mb", 0) * 1024 * 1024)
   , m_photon_tracing_max_path_length(nz(params.get_optional<size_t>("photon_tracing_max_path_length", 0)))
   , m_photon_tracing_rr_min_path_length(nz(params.get_optional<size_t>("photon_tracing_rr_min_path_length", 6)))
   , m_path_tracing_max_path_length(nz(params.get_optional<size_t>("path_tracing_max_path_length", 0)))
   , m_path_tracing_rr_min_path_length(nz(params.get_optional<size_t>("path_tracing_rr_min_path_length", 6)))
   , m_transparency_threshold(params.get_optional<float>("transparency_threshold", 0.001f))
   , m_max_iterations(params.get_optional<size_t>("max_iterations", 1000))
+  , m_photon_map_type(get_photon_map_type(params, "photon_map", "kdtree"))
   , m_initial_radius_percents(params.get_optional<float>("initial_radius", 0.1f))
   , m_alpha(params.get_optional<float>("alpha", 0.7f))
   , m_max_photons_per_estimate(params.get_optional<size_t>("max_photons_per_estimate", 100))
@@ -136,10 +156,12 @@ void SPPMParameters::print() const
         "sppm photon tracing settings:\n"
         "  light photons                 %s\n"
         "  environment photons           %s\n"
+        "  max photon memory             %s\n"
         "  max path length               %s\n"
         "  rr min path length            %s",
         pretty_uint(m_light_photon_count).c_str(),
         pretty_uint(m_env_photon_count).c_str(),
+        m_max_photon_memory == 0 ? "unlimited" : pretty_size(m_max_photon_memory).c_str(),
         m_photon_tracing_max_path_length == size_t(~0) ? "infinite" : pretty_uint(m_photon_tracing_max_path_length).c_str(),
         m_photon_tracing_rr_min_path_length == size_t(~0) ? "infinite" : pretty_uint(m_photon_tracing_rr_min_path_length).c_str());
 
@@ -147,6 +169,7 @@ void SPPMParameters::print() const
         "sppm path tracing settings:\n"
         "  max path length               %s\n"
         "  rr min path length            %s\n"
+        "  photon map                    %s\n"
         "  initial radius                %s%%\n"
         "  alpha                         %s\n"
         "  max photons per estimate      %s\n"
@@ -154,6 +177,7 @@ void SPPMParameters::print() const
         "  dl light threshold            %s",
         m_path_tracing_max_path_length == size_t(~0) ? "infinite" : pretty_uint(m_path_tracing_max_path_length).c_str(),
         m_path_tracing_rr_min_path_length == size_t(~0) ? "infinite" : pretty_uint(m_path_tracing_rr_min_path_length).c_str(),
+        m_photon_map_type == HashGrid ? "hashed grid" : "k-d tree",
         pretty_scalar(m_initial_radius_percents, 3).c_str(),
         pretty_scalar(m_alpha, 1).c_str(),
         pretty_uint(m_max_photons_per_estimate).c_str(),
@@ -46,8 +46,10 @@ struct SPPMParameters
 {
     enum PhotonType { Monochromatic, Polychromatic };
     enum Mode { RayTraced, SPPM, Off };
+    enum PhotonMapType { KdTree, HashGrid };
 
     const SamplingContext::Mode m_sampling_mode;
+    const size_t                m_thread_count;                         // number of rendering threads
     const PhotonType            m_photon_type;
 
     const Mode                  m_dl_mode;                              // direct lighting mode
@@ -57,6 +59,7 @@ struct SPPMParameters
     const size_t                m_light_photon_count;                   // number of photons emitted from the lights
     const size_t                m_env_photon_count;                     // number of photons emitted from the environment
     const size_t                m_photon_packet_size;                   // number of photons per tracing job
+    const size_t                m_max_photon_memory;                    // maximum memory used by the photons of a pass, in bytes, 0 for unlimited
 
     const size_t                m_photon_tracing_max_path_length;       // maximum photon tracing path length, ~0 for unlimited
     const size_t                m_photon_tracing_rr_min_path_length;    // minimum photon tracing path length before Russian Roulette kicks in, ~0 for unlimited
@@ -67,6 +70,7 @@ struct SPPMParameters
     const float                 m_transparency_threshold;
     const size_t                m_max_iterations;                       // maximum number of iteration during path tracing
 
+    const PhotonMapType         m_photon_map_type;                      // data structure used for photon lookups
     const float                 m_initial_radius_percents;              // initial lookup radius as a percentage of the scene diameter
     const float                 m_alpha;                                // radius shrinking control
     const size_t                m_max_photons_per_estimate;             // maximum number of photons per density estimation
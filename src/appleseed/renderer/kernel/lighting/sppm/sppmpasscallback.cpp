@@ -73,6 +73,7 @@ SPPMPassCallback::SPPMPassCallback(
         shading_system,
         params)
   , m_pass_number(0)
+  , m_next_slice(0)
 {
     // Compute the initial lookup radius.
     const GAABB3 scene_bbox = scene.compute_bbox();
@@ -104,40 +105,91 @@ void SPPMPassCallback::pre_render(
 
     m_stopwatch.start();
 
-    // Create a new set of photons.
+    // Create a new set of photons, releasing the photon map of the previous (sub-)pass first.
+    // When photon memory is bounded, a pass may only trace some of its slices; the camera
+    // paths of that sub-pass gather these photons only, and the remaining slices are traced
+    // by the following sub-passes.
+    m_photon_map.reset();
     m_photons.clear_keep_memory();
-    m_photon_tracer.trace_photons(
-        m_photons,
-        hash_uint32(m_pass_number),
-        job_queue,
-        abort_switch);
+    const size_t first_slice = m_next_slice;
+    const size_t end_slice =
+        m_photon_tracer.trace_photons(
+            m_photons,
+            hash_uint32(m_pass_number),
+            first_slice,
+            job_queue,
+            abort_switch);
+
+    m_stopwatch.measure();
+    const double trace_time = m_stopwatch.get_seconds();
 
     // Stop there if rendering was aborted.
     if (abort_switch.is_aborted())
         return;
 
+    const size_t slice_count = m_photon_tracer.get_slice_count();
+    m_next_slice = end_slice < slice_count ? end_slice : 0;
+
     // Build a new photon map.
-    m_photon_map.reset(new SPPMPhotonMap(m_photons));
+    m_photon_map.reset(
+        new SPPMPhotonMap(
+            m_params.m_photon_map_type,
+            m_photons,
+            m_params.m_view_photons ? m_params.m_view_photons_radius : m_lookup_radius,
+            job_queue,
+            m_params.m_thread_count));
+
+    if (first_slice == 0 && end_slice == slice_count)
+    {
+        RENDERER_LOG_INFO(
+            "sppm pass %s: traced photons in %s, built photon map in %s.",
+            pretty_uint(m_pass_number + 1).c_str(),
+            pretty_time(trace_time).c_str(),
+            pretty_time(m_photon_map->get_build_time()).c_str());
+    }
+    else
+    {
+        RENDERER_LOG_INFO(
+            "sppm pass %s: traced photon slices %s to %s of %s in %s, built photon map in %s.",
+            pretty_uint(m_pass_number + 1).c_str(),
+            pretty_uint(first_slice + 1).c_str(),
+            pretty_uint(end_slice).c_str(),
+            pretty_uint(slice_count).c_str(),
+            pretty_time(trace_time).c_str(),
+            pretty_time(m_photon_map->get_build_time()).c_str());
+    }
 }
 
-void SPPMPassCallback::post_render(
+bool SPPMPassCallback::post_render(
     const Frame&            frame,
     JobQueue&               job_queue,
     IAbortSwitch&           abort_switch)
 {
+    m_stopwatch.measure();
+
+    // Only complete passes shrink the lookup radius.
+    if (m_next_slice > 0)
+    {
+        RENDERER_LOG_INFO(
+            "sppm pass %s: sub-pass completed in %s.",
+            pretty_uint(m_pass_number + 1).c_str(),
+            pretty_time(m_stopwatch.get_seconds()).c_str());
+        return true;
+    }
+
     // Shrink the lookup radius for the next pass.
     const float k = (m_pass_number + m_params.m_alpha) / (m_pass_number + 1);
     assert(k <= 1.0);
     m_lookup_radius *= sqrt(k);
 
-    m_stopwatch.measure();
-
     RENDERER_LOG_INFO(
         "sppm pass %s completed in %s.",
         pretty_uint(m_pass_number + 1).c_str(),
         pretty_time(m_stopwatch.get_seconds()).c_str());
 
     ++m_pass_number;
+
+    return true;
 }
 
 }   // namespace renderer
@@ -99,7 +99,7 @@ class SPPMPassCallback
         foundation::IAbortSwitch&   abort_switch) APPLESEED_OVERRIDE;
 
     // This method is called at the end of a pass.
-    virtual void post_render(
+    virtual bool post_render(
         const Frame&                frame,
         foundation::JobQueue&       job_queue,
         foundation::IAbortSwitch&   abort_switch) APPLESEED_OVERRIDE;
@@ -118,6 +118,7 @@ class SPPMPassCallback
     const SPPMParameters            m_params;
     SPPMPhotonTracer                m_photon_tracer;
     foundation::uint32              m_pass_number;
+    size_t                          m_next_slice;
     SPPMPhotonVector                m_photons;
     std::auto_ptr<SPPMPhotonMap>    m_photon_map;
     float                           m_initial_lookup_radius;
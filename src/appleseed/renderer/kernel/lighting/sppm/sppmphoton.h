@@ -53,7 +53,7 @@ namespace renderer
 
 struct SpectrumLine
 {
-    foundation::uint32      m_wavelength;
+    foundation::uint32      m_wavelength;           // index of a Spectrum sample: a wavelength, or an RGB channel in RGB-only builds
     float                   m_amplitude;
 };
 
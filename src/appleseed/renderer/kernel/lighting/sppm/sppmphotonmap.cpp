@@ -48,10 +48,21 @@ using namespace foundation;
 namespace renderer
 {
 
-SPPMPhotonMap::SPPMPhotonMap(SPPMPhotonVector& photons)
+SPPMPhotonMap::SPPMPhotonMap(
+    const SPPMParameters::PhotonMapType type,
+    SPPMPhotonVector&                   photons,
+    const float                         lookup_radius,
+    JobQueue&                           job_queue,
+    const size_t                        thread_count)
+  : m_type(type)
+  , m_build_time(0.0)
 {
     const size_t photon_count = photons.size();
 
+    // The hashed grid needs a positive cell size.
+    if (m_type == SPPMParameters::HashGrid && !(lookup_radius > 0.0f))
+        m_type = SPPMParameters::KdTree;
+
     if (photon_count > 0)
     {
         RENDERER_LOG_INFO(
@@ -59,13 +70,43 @@ SPPMPhotonMap::SPPMPhotonMap(SPPMPhotonVector& photons)
             pretty_uint(photon_count).c_str(),
             photon_count > 1 ? "photons" : "photon");
 
-        knn::Builder3f builder(*this);
-        builder.build_move_points<DefaultWallclockTimer>(photons.m_positions);
-
         Statistics statistics;
-        statistics.insert_time("build time", builder.get_build_time());
-        statistics.insert_size("size", photons.get_memory_size());
-        statistics.merge(knn::TreeStatistics<knn::Tree3f>(*this));
+
+        if (m_type == SPPMParameters::HashGrid)
+        {
+            // Cells twice as large as the lookup radius limit lookups to 2x2x2 cells.
+            const float cell_size = 2.0f * lookup_radius;
+
+            knn::HashGridBuilder3f builder(m_grid);
+            builder.build_move_points<DefaultWallclockTimer>(
+                photons.m_positions,
+                cell_size,
+                job_queue,
+                thread_count);
+            m_build_time = builder.get_build_time();
+
+            statistics.insert("type", "hashed grid");
+            statistics.insert_time("build time", m_build_time);
+            statistics.insert("build threads", thread_count);
+            statistics.insert_size("size", photons.get_memory_size() + m_grid.get_memory_size());
+            statistics.insert("cell size", cell_size);
+            statistics.insert("buckets", m_grid.get_bucket_count());
+        }
+        else
+        {
+            knn::Builder3f builder(m_tree);
+            builder.build_move_points<DefaultWallclockTimer>(
+                photons.m_positions,
+                job_queue,
+                thread_count);
+            m_build_time = builder.get_build_time();
+
+            statistics.insert("type", "k-d tree");
+            statistics.insert_time("build time", m_build_time);
+            statistics.insert("build threads", thread_count);
+            statistics.insert_size("size", photons.get_memory_size());
+            statistics.merge(knn::TreeStatistics<knn::Tree3f>(m_tree));
+        }
 
         RENDERER_LOG_DEBUG("%s",
             StatisticsVector::make(
@@ -79,4 +120,9 @@ SPPMPhotonMap::SPPMPhotonMap(SPPMPhotonVector& photons)
     }
 }
 
+double SPPMPhotonMap::get_build_time() const
+{
+    return m_build_time;
+}
+
 }   // namespace renderer
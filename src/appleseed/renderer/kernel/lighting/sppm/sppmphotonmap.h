@@ -30,23 +30,115 @@
 #ifndef APPLESEED_RENDERER_KERNEL_LIGHTING_SPPM_SPPMPHOTONMAP_H
 #define APPLESEED_RENDERER_KERNEL_LIGHTING_SPPM_SPPMPHOTONMAP_H
 
+// appleseed.renderer headers.
+#include "renderer/kernel/lighting/sppm/sppmparameters.h"
+
 // appleseed.foundation headers.
+#include "foundation/core/concepts/noncopyable.h"
 #include "foundation/math/knn.h"
+#include "foundation/math/vector.h"
+
+// Standard headers.
+#include <cstddef>
 
 // Forward declarations.
-namespace renderer  { class SPPMPhotonVector; }
+namespace foundation    { class JobQueue; }
+namespace renderer      { class SPPMPhotonVector; }
 
 namespace renderer
 {
 
+//
+// The photon map is either a k-d tree, which is efficient for any lookup radius,
+// or a hashed grid, which is cheaper to build and to query when the lookup radius
+// is known in advance.
+//
+
 class SPPMPhotonMap
-  : public foundation::knn::Tree3f
+  : public foundation::NonCopyable
 {
   public:
-    // Constructor, *moves* the photon positions into the map.
-    explicit SPPMPhotonMap(SPPMPhotonVector& photons);
+    // Constructor, *moves* the photon positions into the map. The map is built
+    // using the worker threads servicing the job queue. The hashed grid is built
+    // for lookups of a given radius.
+    SPPMPhotonMap(
+        const SPPMParameters::PhotonMapType type,
+        SPPMPhotonVector&                   photons,
+        const float                         lookup_radius,
+        foundation::JobQueue&               job_queue,
+        const size_t                        thread_count);
+
+    // Return true if the map does not contain any photon.
+    bool empty() const;
+
+    // Transform an internal index to a photon index.
+    size_t remap(const size_t i) const;
+
+    // Return the position of the i'th photon, where i is an internal index.
+    const foundation::Vector3f& get_point(const size_t i) const;
+
+    // Find the photons nearest to a given point within a given distance.
+    void query(
+        const foundation::Vector3f&         point,
+        const float                         max_square_distance,
+        foundation::knn::Answer<float>&     answer) const;
+
+    // Return the construction time of the map.
+    double get_build_time() const;
+
+  private:
+    SPPMParameters::PhotonMapType           m_type;
+    foundation::knn::Tree3f                 m_tree;
+    foundation::knn::HashGrid3f             m_grid;
+    double                                  m_build_time;
 };
 
+
+//
+// SPPMPhotonMap class implementation.
+//
+
+inline bool SPPMPhotonMap::empty() const
+{
+    return
+        m_type == SPPMParameters::HashGrid
+            ? m_grid.empty()
+            : m_tree.empty();
+}
+
+inline size_t SPPMPhotonMap::remap(const size_t i) const
+{
+    return
+        m_type == SPPMParameters::HashGrid
+            ? m_grid.remap(i)
+            : m_tree.remap(i);
+}
+
+inline const foundation::Vector3f& SPPMPhotonMap::get_point(const size_t i) const
+{
+    return
+        m_type == SPPMParameters::HashGrid
+            ? m_grid.get_point(i)
+            : m_tree.get_point(i);
+}
+
+inline void SPPMPhotonMap::query(
+    const foundation::Vector3f&             point,
+    const float                             max_square_distance,
+    foundation::knn::Answer<float>&         answer) const
+{
+    if (m_type == SPPMParameters::HashGrid)
+    {
+        const foundation::knn::HashGridQuery3f query(m_grid, answer);
+        query.run(point, max_square_distance);
+    }
+    else
+    {
+        const foundation::knn::Query3f query(m_tree, answer);
+        query.run(point, max_square_distance);
+    }
+}
+
 }       // namespace renderer
 
 #endif  // !APPLESEED_RENDERER_KERNEL_LIGHTING_SPPM_SPPMPHOTONMAP_H
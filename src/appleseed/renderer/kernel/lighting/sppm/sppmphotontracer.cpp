@@ -79,8 +79,10 @@
 #include <algorithm>
 #include <cassert>
 #include <cstddef>
+#include <vector>
 
 using namespace foundation;
+using namespace std;
 
 namespace renderer
 {
@@ -152,7 +154,7 @@ namespace
 
                 if (m_params.m_photon_type == SPPMParameters::Monochromatic)
                 {
-                    // Choose a wavelength at random.
+                    // Choose a wavelength at random (an RGB channel in RGB-only builds).
                     vertex.m_sampling_context.split_in_place(1, 1);
                     const uint32 wavelength =
                         truncate<uint32>(
@@ -697,6 +699,24 @@ SPPMPhotonTracer::SPPMPhotonTracer(
   , m_oiio_texture_system(oiio_texture_system)
   , m_shading_system(shading_system)
 {
+    m_light_photon_count =
+        m_light_sampler.has_lights_or_emitting_triangles()
+            ? m_params.m_light_photon_count
+            : 0;
+
+    m_env_photon_count =
+        m_params.m_enable_ibl && m_scene.get_environment()->get_environment_edf()
+            ? m_params.m_env_photon_count
+            : 0;
+
+    // Divide the photons of a pass into slices of at most one packet of light photons
+    // and one packet of environment photons. Since every slice holds the same fraction
+    // of light and environment photons, any range of slices is a smaller, unbiased pass.
+    const size_t max_photon_count = max(m_light_photon_count, m_env_photon_count);
+    m_slice_count =
+        max<size_t>(
+            (max_photon_count + m_params.m_photon_packet_size - 1) / m_params.m_photon_packet_size,
+            1);
 }
 
 namespace
@@ -757,12 +777,38 @@ namespace
     }
 }
 
-void SPPMPhotonTracer::trace_photons(
+namespace
+{
+    // Scale the flux of a range of photons.
+    void scale_photon_flux(
+        const SPPMParameters&   params,
+        SPPMPhotonVector&       photons,
+        const size_t            begin,
+        const size_t            end,
+        const float             factor)
+    {
+        if (params.m_photon_type == SPPMParameters::Monochromatic)
+        {
+            for (size_t i = begin; i < end; ++i)
+                photons.m_mono_photons[i].m_flux.m_amplitude *= factor;
+        }
+        else
+        {
+            for (size_t i = begin; i < end; ++i)
+                photons.m_poly_photons[i].m_flux *= factor;
+        }
+    }
+}
+
+size_t SPPMPhotonTracer::trace_photons(
     SPPMPhotonVector&       photons,
     const size_t            pass_hash,
+    const size_t            first_slice,
     JobQueue&               job_queue,
     IAbortSwitch&           abort_switch)
 {
+    assert(first_slice < m_slice_count);
+
     // Start stopwatch.
     Stopwatch<DefaultWallclockTimer> stopwatch;
     stopwatch.start();
@@ -774,43 +820,68 @@ void SPPMPhotonTracer::trace_photons(
         Transformd::identity(),
         photon_targets);
 
-    // Schedule photon tracing jobs.
     size_t job_count = 0;
-    size_t emitted_photon_count = 0;
-    if (m_light_sampler.has_lights_or_emitting_triangles())
+    size_t emitted_light_photon_count = 0;
+    size_t emitted_env_photon_count = 0;
+    size_t end_slice;
+
+    if (m_params.m_max_photon_memory == 0)
     {
-        schedule_light_photon_tracing_jobs(
+        RENDERER_LOG_INFO(
+            "tracing %s sppm light %s and %s sppm environment %s...",
+            pretty_uint(m_light_photon_count).c_str(),
+            m_light_photon_count > 1 ? "photons" : "photon",
+            pretty_uint(m_env_photon_count).c_str(),
+            m_env_photon_count > 1 ? "photons" : "photon");
+
+        // Trace all slices at once.
+        assert(first_slice == 0);
+        end_slice = m_slice_count;
+        schedule_photon_tracing_jobs(
             photon_targets,
             photons,
+            photons,
             pass_hash,
+            0,
+            end_slice,
             job_queue,
             job_count,
-            emitted_photon_count,
+            emitted_light_photon_count,
+            emitted_env_photon_count,
             abort_switch);
+        job_queue.wait_until_completion();
     }
-    if (m_params.m_enable_ibl && m_scene.get_environment()->get_environment_edf())
+    else
     {
-        schedule_environment_photon_tracing_jobs(
-            photon_targets,
-            photons,
-            pass_hash,
-            job_queue,
-            job_count,
-            emitted_photon_count,
-            abort_switch);
+        end_slice =
+            trace_photons_within_budget(
+                photon_targets,
+                photons,
+                pass_hash,
+                first_slice,
+                job_queue,
+                job_count,
+                emitted_light_photon_count,
+                emitted_env_photon_count,
+                abort_switch);
     }
 
-    // Wait until the photon tracing jobs have completed.
-    job_queue.wait_until_completion();
-
     // Update photon tracing statistics.
-    m_total_emitted_photon_count += emitted_photon_count;
+    m_total_emitted_photon_count += emitted_light_photon_count + emitted_env_photon_count;
     m_total_stored_photon_count += photons.size();
 
     // Print photon tracing statistics.
     Statistics statistics;
     statistics.insert("tracing jobs", job_count);
     statistics.insert_time("tracing time", stopwatch.measure().get_seconds());
+    if (m_params.m_max_photon_memory > 0)
+    {
+        statistics.insert(
+            "slices",
+            pretty_uint(first_slice + 1) + " to " + pretty_uint(end_slice) +
+            " of " + pretty_uint(m_slice_count));
+        statistics.insert_size("photon memory", photons.get_memory_size());
+    }
     statistics.insert("total emitted", m_total_emitted_photon_count);
     statistics.insert(
         "total stored",
@@ -821,85 +892,190 @@ void SPPMPhotonTracer::trace_photons(
         StatisticsVector::make(
             "sppm photon tracing statistics",
             statistics).to_string().c_str());
+
+    return end_slice;
 }
 
-void SPPMPhotonTracer::schedule_light_photon_tracing_jobs(
+size_t SPPMPhotonTracer::trace_photons_within_budget(
     const LightTargetArray& photon_targets,
     SPPMPhotonVector&       photons,
     const size_t            pass_hash,
+    const size_t            first_slice,
     JobQueue&               job_queue,
     size_t&                 job_count,
-    size_t&                 emitted_photon_count,
+    size_t&                 emitted_light_photon_count,
+    size_t&                 emitted_env_photon_count,
     IAbortSwitch&           abort_switch)
 {
-    RENDERER_LOG_INFO(
-        "tracing %s sppm light %s...",
-        pretty_uint(m_params.m_light_photon_count).c_str(),
-        m_params.m_light_photon_count > 1 ? "photons" : "photon");
-
-    for (size_t i = 0; i < m_params.m_light_photon_count; i += m_params.m_photon_packet_size)
+    const size_t photon_size =
+        sizeof(Vector3f) +
+        (m_params.m_photon_type == SPPMParameters::Monochromatic
+            ? sizeof(SPPMMonoPhoton)
+            : sizeof(SPPMPolyPhoton));
+    const size_t max_photon_count = max<size_t>(m_params.m_max_photon_memory / photon_size, 1);
+
+    // Ranges of stored light and environment photons.
+    vector<size_t> light_photon_ranges;
+    vector<size_t> env_photon_ranges;
+
+    // Trace windows of slices in parallel, each slice into its own photon vectors,
+    // then accept slices in order for as long as their photons fit in the budget.
+    // The outcome doesn't depend on the order in which the jobs complete.
+    const size_t window_size = m_params.m_thread_count;
+    size_t slice = first_slice;
+    bool full = false;
+
+    while (!full && slice < m_slice_count && !abort_switch.is_aborted())
     {
-        const size_t photon_begin = i;
-        const size_t photon_end = min(i + m_params.m_photon_packet_size, m_params.m_light_photon_count);
+        const size_t window_begin = slice;
+        const size_t window_end = min(window_begin + window_size, m_slice_count);
 
-        job_queue.schedule(
-            new LightPhotonTracingJob(
-                m_scene,
+        vector<SPPMPhotonVector*> light_photons(window_end - window_begin);
+        vector<SPPMPhotonVector*> env_photons(window_end - window_begin);
+        vector<size_t> light_counts(window_end - window_begin, 0);
+        vector<size_t> env_counts(window_end - window_begin, 0);
+
+        for (size_t i = window_begin; i < window_end; ++i)
+        {
+            light_photons[i - window_begin] = new SPPMPhotonVector();
+            env_photons[i - window_begin] = new SPPMPhotonVector();
+            schedule_photon_tracing_jobs(
                 photon_targets,
-                m_light_sampler,
-                m_trace_context,
-                m_texture_store,
-                m_oiio_texture_system,
-                m_shading_system,
-                m_params,
-                photons,
-                photon_begin,
-                photon_end,
+                *light_photons[i - window_begin],
+                *env_photons[i - window_begin],
                 pass_hash,
-                abort_switch));
+                i,
+                i + 1,
+                job_queue,
+                job_count,
+                light_counts[i - window_begin],
+                env_counts[i - window_begin],
+                abort_switch);
+        }
 
-        ++job_count;
-        emitted_photon_count += photon_end - photon_begin;
+        job_queue.wait_until_completion();
+
+        for (size_t i = window_begin; i < window_end; ++i)
+        {
+            const SPPMPhotonVector& light = *light_photons[i - window_begin];
+            const SPPMPhotonVector& env = *env_photons[i - window_begin];
+
+            // Always accept the first slice, otherwise tracing would never progress.
+            if (i > first_slice && photons.size() + light.size() + env.size() > max_photon_count)
+            {
+                full = true;
+                break;
+            }
+
+            light_photon_ranges.push_back(photons.size());
+            photons.append(light);
+            light_photon_ranges.push_back(photons.size());
+
+            env_photon_ranges.push_back(photons.size());
+            photons.append(env);
+            env_photon_ranges.push_back(photons.size());
+
+            emitted_light_photon_count += light_counts[i - window_begin];
+            emitted_env_photon_count += env_counts[i - window_begin];
+            ++slice;
+        }
+
+        for (size_t i = 0; i < light_photons.size(); ++i)
+        {
+            delete light_photons[i];
+            delete env_photons[i];
+        }
+    }
+
+    if (photons.size() > max_photon_count)
+    {
+        RENDERER_LOG_WARNING(
+            "a single slice of sppm photons exceeds the photon memory budget, consider reducing the photon packet size.");
+    }
+
+    // Normalize the flux of the stored photons as if they were the only photons of the pass.
+    if (emitted_light_photon_count > 0)
+    {
+        const float factor = static_cast<float>(m_light_photon_count) / emitted_light_photon_count;
+        for (size_t i = 0; i < light_photon_ranges.size(); i += 2)
+            scale_photon_flux(m_params, photons, light_photon_ranges[i], light_photon_ranges[i + 1], factor);
+    }
+    if (emitted_env_photon_count > 0)
+    {
+        const float factor = static_cast<float>(m_env_photon_count) / emitted_env_photon_count;
+        for (size_t i = 0; i < env_photon_ranges.size(); i += 2)
+            scale_photon_flux(m_params, photons, env_photon_ranges[i], env_photon_ranges[i + 1], factor);
     }
+
+    return slice;
 }
 
-void SPPMPhotonTracer::schedule_environment_photon_tracing_jobs(
+void SPPMPhotonTracer::schedule_photon_tracing_jobs(
     const LightTargetArray& photon_targets,
-    SPPMPhotonVector&       photons,
+    SPPMPhotonVector&       light_photons,
+    SPPMPhotonVector&       env_photons,
     const size_t            pass_hash,
+    const size_t            slice_begin,
+    const size_t            slice_end,
     JobQueue&               job_queue,
     size_t&                 job_count,
-    size_t&                 emitted_photon_count,
+    size_t&                 emitted_light_photon_count,
+    size_t&                 emitted_env_photon_count,
     IAbortSwitch&           abort_switch)
 {
-    RENDERER_LOG_INFO(
-        "tracing %s sppm environment %s...",
-        pretty_uint(m_params.m_env_photon_count).c_str(),
-        m_params.m_env_photon_count > 1 ? "photons" : "photon");
-
-    for (size_t i = 0; i < m_params.m_env_photon_count; i += m_params.m_photon_packet_size)
+    for (size_t slice = slice_begin; slice < slice_end; ++slice)
     {
-        const size_t photon_begin = i;
-        const size_t photon_end = min(i + m_params.m_photon_packet_size, m_params.m_env_photon_count);
+        // Light photons of this slice.
+        const size_t light_photon_begin = m_light_photon_count * slice / m_slice_count;
+        const size_t light_photon_end = m_light_photon_count * (slice + 1) / m_slice_count;
 
-        job_queue.schedule(
-            new EnvironmentPhotonTracingJob(
-                m_scene,
-                photon_targets,
-                m_light_sampler,
-                m_trace_context,
-                m_texture_store,
-                m_oiio_texture_system,
-                m_shading_system,
-                m_params,
-                photons,
-                photon_begin,
-                photon_end,
-                pass_hash,
-                abort_switch));
+        if (light_photon_begin < light_photon_end)
+        {
+            job_queue.schedule(
+                new LightPhotonTracingJob(
+                    m_scene,
+                    photon_targets,
+                    m_light_sampler,
+                    m_trace_context,
+                    m_texture_store,
+                    m_oiio_texture_system,
+                    m_shading_system,
+                    m_params,
+                    light_photons,
+                    light_photon_begin,
+                    light_photon_end,
+                    pass_hash,
+                    abort_switch));
+
+            ++job_count;
+            emitted_light_photon_count += light_photon_end - light_photon_begin;
+        }
+
+        // Environment photons of this slice.
+        const size_t env_photon_begin = m_env_photon_count * slice / m_slice_count;
+        const size_t env_photon_end = m_env_photon_count * (slice + 1) / m_slice_count;
 
-        ++job_count;
-        emitted_photon_count += photon_end - photon_begin;
+        if (env_photon_begin < env_photon_end)
+        {
+            job_queue.schedule(
+                new EnvironmentPhotonTracingJob(
+                    m_scene,
+                    photon_targets,
+                    m_light_sampler,
+                    m_trace_context,
+                    m_texture_store,
+                    m_oiio_texture_system,
+                    m_shading_system,
+                    m_params,
+                    env_photons,
+                    env_photon_begin,
+                    env_photon_end,
+                    pass_hash,
+                    abort_switch));
+
+            ++job_count;
+            emitted_env_photon_count += env_photon_end - env_photon_begin;
+        }
     }
 }
 
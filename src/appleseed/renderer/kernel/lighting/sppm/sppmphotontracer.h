@@ -77,42 +77,71 @@ class SPPMPhotonTracer
         OSL::ShadingSystem&         shading_system,
         const SPPMParameters&       params);
 
-    void trace_photons(
+    // The photons of a pass are divided into slices. When the photon memory is unlimited,
+    // all slices are traced at once. Otherwise, consecutive slices are traced starting at
+    // a given slice for as long as their photons fit in the budget, and their flux is
+    // scaled such that they form a complete, smaller pass. Return the index of the first
+    // slice that was not traced, or the number of slices if the last slice was traced.
+    size_t trace_photons(
         SPPMPhotonVector&           photons,
         const size_t                pass_hash,
+        const size_t                first_slice,
         foundation::JobQueue&       job_queue,
         foundation::IAbortSwitch&   abort_switch);
 
+    // Return the number of slices the photons of a pass are divided into.
+    size_t get_slice_count() const;
+
   private:
     const SPPMParameters            m_params;
     const Scene&                    m_scene;
     const LightSampler&             m_light_sampler;
     const TraceContext&             m_trace_context;
     TextureStore&                   m_texture_store;
+    size_t                          m_light_photon_count;
+    size_t                          m_env_photon_count;
+    size_t                          m_slice_count;
     size_t                          m_total_emitted_photon_count;
     size_t                          m_total_stored_photon_count;
     OIIO::TextureSystem&            m_oiio_texture_system;
     OSL::ShadingSystem&             m_shading_system;
 
-    void schedule_light_photon_tracing_jobs(
+    size_t trace_photons_within_budget(
         const LightTargetArray&     photon_targets,
         SPPMPhotonVector&           photons,
         const size_t                pass_hash,
+        const size_t                first_slice,
         foundation::JobQueue&       job_queue,
         size_t&                     job_count,
-        size_t&                     emitted_photon_count,
+        size_t&                     emitted_light_photon_count,
+        size_t&                     emitted_env_photon_count,
         foundation::IAbortSwitch&   abort_switch);
 
-    void schedule_environment_photon_tracing_jobs(
+    void schedule_photon_tracing_jobs(
         const LightTargetArray&     photon_targets,
-        SPPMPhotonVector&           photons,
+        SPPMPhotonVector&           light_photons,
+        SPPMPhotonVector&           env_photons,
         const size_t                pass_hash,
+        const size_t                slice_begin,
+        const size_t                slice_end,
         foundation::JobQueue&       job_queue,
         size_t&                     job_count,
-        size_t&                     emitted_photon_count,
+        size_t&                     emitted_light_photon_count,
+        size_t&                     emitted_env_photon_count,
         foundation::IAbortSwitch&   abort_switch);
 };
 
+
+
+//
+// SPPMPhotonTracer class implementation.
+//
+
+inline size_t SPPMPhotonTracer::get_slice_count() const
+{
+    return m_slice_count;
+}
+
 }       // namespace renderer
 
 #endif  // !APPLESEED_RENDERER_KERNEL_LIGHTING_SPPM_SPPMPHOTONTRACER_H
@@ -38,6 +38,7 @@
 #include "foundation/image/color.h"
 #include "foundation/image/image.h"
 #include "foundation/image/tile.h"
+#include "foundation/math/aabb.h"
 #include "foundation/utility/statistics.h"
 
 // Standard headers.
@@ -71,6 +72,7 @@ namespace
             const Frame&    frame,
             const size_t    tile_x,
             const size_t    tile_y,
+            const AABB2u&   region,
             const size_t    pass_hash,
             IAbortSwitch&   abort_switch) APPLESEED_OVERRIDE
         {
@@ -80,9 +82,26 @@ namespace
             assert(tile_y < image.properties().m_tile_count_y);
 
             Tile& tile = image.tile(tile_x, tile_y);
+            assert(region.max.x < tile.get_width());
+            assert(region.max.y < tile.get_height());
+
+            // Set all pixels of the region to opaque black.
+            const Color4f black(0.0f, 0.0f, 0.0f, 1.0f);
+            for (size_t y = region.min.y; y <= region.max.y; ++y)
+            {
+                for (size_t x = region.min.x; x <= region.max.x; ++x)
+                    tile.set_pixel(x, y, black);
+            }
+        }
 
-            // Set all pixels of the tile to opaque black.
-            tile.clear(Color4f(0.0f, 0.0f, 0.0f, 1.0f));
+        virtual double estimate_tile_cost(
+            const Frame&    frame,
+            const size_t    tile_x,
+            const size_t    tile_y,
+            IAbortSwitch&   abort_switch) APPLESEED_OVERRIDE
+        {
+            // All tiles cost the same.
+            return 1.0;
         }
 
         virtual StatisticsVector get_statistics() const APPLESEED_OVERRIDE
@@ -38,6 +38,8 @@
 #include "foundation/image/color.h"
 #include "foundation/image/image.h"
 #include "foundation/image/tile.h"
+#include "foundation/math/aabb.h"
+#include "foundation/math/vector.h"
 #include "foundation/utility/statistics.h"
 
 // Standard headers.
@@ -71,6 +73,7 @@ namespace
             const Frame&    frame,
             const size_t    tile_x,
             const size_t    tile_y,
+            const AABB2u&   region,
             const size_t    pass_hash,
             IAbortSwitch&   abort_switch) APPLESEED_OVERRIDE
         {
@@ -80,15 +83,15 @@ namespace
             assert(tile_y < image.properties().m_tile_count_y);
 
             Tile& tile = image.tile(tile_x, tile_y);
-            const size_t tile_width = tile.get_width();
-            const size_t tile_height = tile.get_height();
-            const size_t max_x = tile_width - 1;
-            const size_t max_y = tile_height - 1;
+            const size_t max_x = tile.get_width() - 1;
+            const size_t max_y = tile.get_height() - 1;
+            assert(region.max.x <= max_x);
+            assert(region.max.y <= max_y);
 
-            // Draw a pixel-sized checkerboard inside the tile.
-            for (size_t y = 0; y < tile_height; ++y)
+            // Draw a pixel-sized checkerboard inside the region.
+            for (size_t y = region.min.y; y <= region.max.y; ++y)
             {
-                for (size_t x = 0; x < tile_width; ++x)
+                for (size_t x = region.min.x; x <= region.max.x; ++x)
                 {
                     const float gray = 0.6f + ((x + y) & 1) * 0.2f;
                     const Color4f pixel_color(gray, gray, gray, 1.0f);
@@ -97,16 +100,38 @@ namespace
             }
 
             // Color the corners of the tile.
-            tile.set_pixel(0,     0,     Color4f(1.0f, 0.0f, 0.0f, 1.0f));      // top left pixel is red
-            tile.set_pixel(max_x, 0,     Color4f(0.0f, 1.0f, 0.0f, 1.0f));      // top right pixel is green
-            tile.set_pixel(0,     max_y, Color4f(1.0f, 1.0f, 1.0f, 1.0f));      // bottom left pixel is white
-            tile.set_pixel(max_x, max_y, Color4f(0.0f, 0.0f, 1.0f, 1.0f));      // bottom right pixel is blue
+            set_corner(tile, region, 0,     0,     Color4f(1.0f, 0.0f, 0.0f, 1.0f));    // top left pixel is red
+            set_corner(tile, region, max_x, 0,     Color4f(0.0f, 1.0f, 0.0f, 1.0f));    // top right pixel is green
+            set_corner(tile, region, 0,     max_y, Color4f(1.0f, 1.0f, 1.0f, 1.0f));    // bottom left pixel is white
+            set_corner(tile, region, max_x, max_y, Color4f(0.0f, 0.0f, 1.0f, 1.0f));    // bottom right pixel is blue
+        }
+
+        virtual double estimate_tile_cost(
+            const Frame&    frame,
+            const size_t    tile_x,
+            const size_t    tile_y,
+            IAbortSwitch&   abort_switch) APPLESEED_OVERRIDE
+        {
+            // All tiles cost the same.
+            return 1.0;
         }
 
         virtual StatisticsVector get_statistics() const APPLESEED_OVERRIDE
         {
             return StatisticsVector();
         }
+
+      private:
+        static void set_corner(
+            Tile&           tile,
+            const AABB2u&   region,
+            const size_t    x,
+            const size_t    y,
+            const Color4f&  color)
+        {
+            if (region.contains(Vector2u(x, y)))
+                tile.set_pixel(x, y, color);
+        }
     };
 }
 
@@ -36,6 +36,8 @@
 #include "renderer/kernel/aov/aovsettings.h"
 #include "renderer/kernel/aov/imagestack.h"
 #include "renderer/kernel/aov/tilestack.h"
+#include "renderer/kernel/rendering/final/adaptivesamplingbudget.h"
+#include "renderer/kernel/rendering/final/variancetracker.h"
 #include "renderer/kernel/rendering/final/variationtracker.h"
 #include "renderer/kernel/rendering/isamplerenderer.h"
 #include "renderer/kernel/rendering/pixelcontext.h"
@@ -48,6 +50,7 @@
 
 // appleseed.foundation headers.
 #include "foundation/image/color.h"
+#include "foundation/image/colorspace.h"
 #include "foundation/image/image.h"
 #include "foundation/image/tile.h"
 #include "foundation/math/aabb.h"
@@ -126,6 +129,8 @@ namespace
 
             if (m_params.m_diagnostics)
                 m_diagnostics.reset(new Tile(tile.get_width(), tile.get_height(), 2, PixelFormatFloat));
+
+            m_tile_bbox.invalidate();
         }
 
         virtual void on_tile_end(
@@ -133,14 +138,12 @@ namespace
             Tile&                       tile,
             TileStack&                  aov_tiles) APPLESEED_OVERRIDE
         {
-            if (m_params.m_diagnostics)
+            // Only store diagnostics for the region of the tile that was rendered.
+            if (m_params.m_diagnostics && m_tile_bbox.is_valid())
             {
-                const size_t width = tile.get_width();
-                const size_t height = tile.get_height();
-
-                for (size_t y = 0; y < height; ++y)
+                for (int y = m_tile_bbox.min.y; y <= m_tile_bbox.max.y; ++y)
                 {
-                    for (size_t x = 0; x < width; ++x)
+                    for (int x = m_tile_bbox.min.x; x <= m_tile_bbox.max.x; ++x)
                     {
                         Color<float, 2> values;
                         m_diagnostics->get_pixel(x, y, values);
@@ -168,6 +171,8 @@ namespace
         {
             const size_t aov_count = frame.aov_images().size();
 
+            m_tile_bbox = tile_bbox;
+
             on_pixel_begin();
 
             m_scratch_fb->clear();
@@ -329,6 +334,206 @@ namespace
         int                                 m_scratch_fb_half_height;
         auto_ptr<ShadingResultFrameBuffer>  m_scratch_fb;
         auto_ptr<Tile>                      m_diagnostics;
+        AABB2i                              m_tile_bbox;
+
+        static Color4f scalar_to_color(const float value)
+        {
+            static const Color4f Blue(0.0f, 0.0f, 1.0f, 1.0f);
+            static const Color4f Red(1.0f, 0.0f, 0.0f, 1.0f);
+            return lerp(Blue, Red, saturate(value));
+        }
+    };
+
+    //
+    // Budgeted adaptive pixel renderer.
+    //
+    // Instead of refining each pixel to completion in a single pass, this pixel
+    // renderer takes, in every pass, the number of samples that the adaptive sampling
+    // budget allotted to the pixel, and accumulates the luminance of these samples
+    // into a per-pixel variance estimator that persists across passes.
+    //
+
+    class BudgetedAdaptivePixelRenderer
+      : public PixelRendererBase
+    {
+      public:
+        BudgetedAdaptivePixelRenderer(
+            const Frame&                frame,
+            ISampleRendererFactory*     factory,
+            AdaptiveSamplingBudget&     budget,
+            const ParamArray&           params,
+            const size_t                thread_index)
+          : m_params(params)
+          , m_sample_renderer(factory->create(thread_index))
+          , m_budget(budget)
+        {
+            m_error_aov_index = frame.create_extra_aov_image("error");
+
+            if (m_params.m_diagnostics)
+                m_samples_aov_index = frame.create_extra_aov_image("samples");
+
+            if ((thread_index == 0) &&
+                (m_error_aov_index == size_t(~0) || (m_params.m_diagnostics && m_samples_aov_index == size_t(~0))))
+            {
+                RENDERER_LOG_WARNING(
+                    "could not create some of the adaptive sampling AOVs, maximum number of AOVs (" FMT_SIZE_T ") reached.",
+                    MaxAOVCount);
+            }
+        }
+
+        virtual void release() APPLESEED_OVERRIDE
+        {
+            delete this;
+        }
+
+        virtual void on_tile_begin(
+            const Frame&                frame,
+            Tile&                       tile,
+            TileStack&                  aov_tiles) APPLESEED_OVERRIDE
+        {
+            m_tile_bbox.invalidate();
+        }
+
+        virtual void on_tile_end(
+            const Frame&                frame,
+            Tile&                       tile,
+            TileStack&                  aov_tiles) APPLESEED_OVERRIDE
+        {
+            if (!m_tile_bbox.is_valid())
+                return;
+
+            // Store the relative error of each pixel (clamped to 100%) in the error AOV.
+            for (int y = m_tile_bbox.min.y; y <= m_tile_bbox.max.y; ++y)
+            {
+                for (int x = m_tile_bbox.min.x; x <= m_tile_bbox.max.x; ++x)
+                {
+                    const size_t ix = static_cast<size_t>(m_tile_origin.x + x);
+                    const size_t iy = static_cast<size_t>(m_tile_origin.y + y);
+
+                    if (m_error_aov_index != size_t(~0))
+                    {
+                        const float error = min(m_budget.get_pixel_error(ix, iy), 1.0f);
+                        aov_tiles.set_pixel(x, y, m_error_aov_index, Color4f(error, error, error, 1.0f));
+                    }
+
+                    if (m_params.m_diagnostics && m_samples_aov_index != size_t(~0))
+                    {
+                        const float samples =
+                            static_cast<float>(m_budget.get_pixel_tracker(ix, iy).get_size()) / m_params.m_max_samples;
+                        aov_tiles.set_pixel(x, y, m_samples_aov_index, scalar_to_color(samples));
+                    }
+                }
+            }
+        }
+
+        virtual void render_pixel(
+            const Frame&                frame,
+            Tile&                       tile,
+            TileStack&                  aov_tiles,
+            const AABB2i&               tile_bbox,
+            const size_t                pass_hash,
+            const Vector2i&             pi,
+            const Vector2i&             pt,
+            SamplingContext::RNGType&   rng,
+            ShadingResultFrameBuffer&   framebuffer) APPLESEED_OVERRIDE
+        {
+            const size_t aov_count = frame.aov_images().size();
+
+            m_tile_bbox = tile_bbox;
+            m_tile_origin = pi - pt;
+
+            const size_t sample_count = m_budget.get_pixel_sample_count(pi.x, pi.y);
+            if (sample_count == 0)
+                return;
+
+            on_pixel_begin();
+
+            // Only the tile that owns a pixel may update its statistics; pixels in the
+            // tile margins are also rendered by the neighboring tiles.
+            VarianceTracker* tracker =
+                tile_bbox.contains(pt) ? &m_budget.get_pixel_tracker(pi.x, pi.y) : 0;
+
+            // Create a sampling context.
+            const size_t frame_width = frame.image().properties().m_canvas_width;
+            const size_t instance =
+                mix_uint32(
+                    static_cast<uint32>(pass_hash),
+                    static_cast<uint32>(pi.y * frame_width + pi.x));
+            SamplingContext sampling_context(
+                rng,
+                m_params.m_sampling_mode,
+                2,                          // number of dimensions
+                0,                          // number of samples -- unknown
+                instance);                  // initial instance number
+
+            for (size_t i = 0; i < sample_count; ++i)
+            {
+                // Generate a uniform sample in [0,1)^2.
+                const Vector2d s = sampling_context.next2<Vector2d>();
+
+                // Compute the sample position in NDC.
+                const Vector2d sample_position = frame.get_sample_position(pi.x + s.x, pi.y + s.y);
+
+                // Create a pixel context that identifies the pixel and sample currently being rendered.
+                const PixelContext pixel_context(pi, sample_position);
+
+                // Render the sample.
+                ShadingResult shading_result(aov_count);
+                SamplingContext child_sampling_context(sampling_context);
+                m_sample_renderer->render_sample(
+                    child_sampling_context,
+                    pixel_context,
+                    sample_position,
+                    shading_result);
+
+                // Ignore invalid samples.
+                if (!shading_result.is_valid_linear_rgb())
+                {
+                    signal_invalid_sample();
+                    continue;
+                }
+
+                // Merge the sample into the framebuffer.
+                framebuffer.add(
+                    static_cast<float>(pt.x + s.x),
+                    static_cast<float>(pt.y + s.y),
+                    shading_result);
+
+                // Update statistics for this pixel.
+                if (tracker)
+                    tracker->insert(luminance(shading_result.m_main.m_color.rgb()));
+            }
+
+            on_pixel_end(pi);
+        }
+
+        virtual StatisticsVector get_statistics() const APPLESEED_OVERRIDE
+        {
+            return m_sample_renderer->get_statistics();
+        }
+
+      private:
+        struct Parameters
+        {
+            const SamplingContext::Mode     m_sampling_mode;
+            const size_t                    m_max_samples;
+            const bool                      m_diagnostics;
+
+            explicit Parameters(const ParamArray& params)
+              : m_sampling_mode(get_sampling_context_mode(params))
+              , m_max_samples(params.get_required<size_t>("max_samples", 256))
+              , m_diagnostics(params.get_optional<bool>("enable_diagnostics", false))
+            {
+            }
+        };
+
+        const Parameters                    m_params;
+        auto_release_ptr<ISampleRenderer>   m_sample_renderer;
+        AdaptiveSamplingBudget&             m_budget;
+        size_t                              m_error_aov_index;
+        size_t                              m_samples_aov_index;
+        AABB2i                              m_tile_bbox;
+        Vector2i                            m_tile_origin;
 
         static Color4f scalar_to_color(const float value)
         {
@@ -347,9 +552,11 @@ namespace
 AdaptivePixelRendererFactory::AdaptivePixelRendererFactory(
     const Frame&                frame,
     ISampleRendererFactory*     factory,
+    AdaptiveSamplingBudget*     budget,
     const ParamArray&           params)
   : m_frame(frame)
   , m_factory(factory)
+  , m_budget(budget)
   , m_params(params)
 {
 }
@@ -362,6 +569,16 @@ void AdaptivePixelRendererFactory::release()
 IPixelRenderer* AdaptivePixelRendererFactory::create(
     const size_t                thread_index)
 {
+    if (m_budget)
+    {
+        return new BudgetedAdaptivePixelRenderer(
+            m_frame,
+            m_factory,
+            *m_budget,
+            m_params,
+            thread_index);
+    }
+
     return new AdaptivePixelRenderer(
         m_frame,
         m_factory,
@@ -397,6 +614,52 @@ Dictionary AdaptivePixelRendererFactory::get_params_metadata()
             .insert("label", "Quality")
             .insert("help", "Quality factor"));
 
+    metadata.dictionaries().insert(
+        "estimator",
+        Dictionary()
+            .insert("type", "enum")
+            .insert("values", "variation|variance")
+            .insert("default", "variation")
+            .insert("label", "Estimator")
+            .insert("help", "Method used to estimate pixel noise")
+            .insert(
+                "options",
+                Dictionary()
+                    .insert(
+                        "variation",
+                        Dictionary()
+                            .insert("label", "Variation")
+                            .insert("help", "Refine each pixel in a single pass until its running mean stabilizes"))
+                    .insert(
+                        "variance",
+                        Dictionary()
+                            .insert("label", "Variance")
+                            .insert("help", "Distribute a sample or time budget across passes based on per-pixel variance estimates"))));
+
+    metadata.dictionaries().insert(
+        "noise_level",
+        Dictionary()
+            .insert("type", "float")
+            .insert("default", "0.01")
+            .insert("label", "Noise Level")
+            .insert("help", "Target relative error of pixel values, at 95% confidence (variance estimator only)"));
+
+    metadata.dictionaries().insert(
+        "sample_budget",
+        Dictionary()
+            .insert("type", "float")
+            .insert("default", "0.0")
+            .insert("label", "Sample Budget")
+            .insert("help", "Average number of samples per pixel allowed for the whole render, 0 for unlimited (variance estimator only)"));
+
+    metadata.dictionaries().insert(
+        "time_budget",
+        Dictionary()
+            .insert("type", "float")
+            .insert("default", "0.0")
+            .insert("label", "Time Budget")
+            .insert("help", "Rendering time allowed in seconds, 0 for unlimited (variance estimator only)"));
+
     metadata.dictionaries().insert(
         "enable_diagnostics",
         Dictionary()
@@ -42,6 +42,7 @@
 
 // Forward declarations.
 namespace foundation    { class Dictionary; }
+namespace renderer      { class AdaptiveSamplingBudget; }
 namespace renderer      { class Frame; }
 namespace renderer      { class ISampleRendererFactory; }
 
@@ -51,6 +52,11 @@ namespace renderer
 //
 // Adaptive pixel renderer.
 //
+// Without a sampling budget, each pixel is refined in a single pass until the
+// spread of its running mean falls below a threshold. With a sampling budget,
+// samples are distributed across tiles and pixels over multiple passes based on
+// per-pixel variance estimates (see AdaptiveSamplingBudget).
+//
 
 class AdaptivePixelRendererFactory
   : public IPixelRendererFactory
@@ -60,6 +66,7 @@ class AdaptivePixelRendererFactory
     AdaptivePixelRendererFactory(
         const Frame&                frame,
         ISampleRendererFactory*     factory,
+        AdaptiveSamplingBudget*     budget,         // optional
         const ParamArray&           params);
 
     // Delete this instance.
@@ -75,6 +82,7 @@ class AdaptivePixelRendererFactory
   private:
     const Frame&                    m_frame;
     ISampleRendererFactory*         m_factory;
+    AdaptiveSamplingBudget*         m_budget;
     ParamArray                      m_params;
 };
 
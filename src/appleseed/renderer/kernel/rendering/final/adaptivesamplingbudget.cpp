@@ -0,0 +1,274 @@
+
+//
+// This source file is part of appleseed.
+// Visit http://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2010-2013 Francois Beaune, Jupiter Jazz Limited
+// Copyright (c) 2014-2017 Francois Beaune, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// Interface header.
+#include "adaptivesamplingbudget.h"
+
+// appleseed.renderer headers.
+#include "renderer/global/globallogger.h"
+#include "renderer/modeling/frame/frame.h"
+
+// appleseed.foundation headers.
+#include "foundation/image/canvasproperties.h"
+#include "foundation/image/image.h"
+#include "foundation/math/scalar.h"
+#include "foundation/utility/statistics.h"
+#include "foundation/utility/string.h"
+
+// Standard headers.
+#include <algorithm>
+#include <cmath>
+
+using namespace foundation;
+using namespace std;
+
+namespace renderer
+{
+
+//
+// AdaptiveSamplingBudget class implementation.
+//
+
+AdaptiveSamplingBudget::Parameters::Parameters(const ParamArray& params)
+  : m_min_samples(max<size_t>(params.get_optional<size_t>("min_samples", 16), 2))
+  , m_max_samples(params.get_optional<size_t>("max_samples", 256))
+  , m_noise_level(params.get_optional<float>("noise_level", 0.01f))
+  , m_sample_budget(params.get_optional<double>("sample_budget", 0.0))
+  , m_time_budget(params.get_optional<double>("time_budget", 0.0))
+  , m_max_pass_count(params.get_optional<size_t>("passes", 0))
+{
+}
+
+AdaptiveSamplingBudget::AdaptiveSamplingBudget(
+    const Frame&            frame,
+    const ParamArray&       params)
+  : m_params(params)
+  , m_frame_width(frame.image().properties().m_canvas_width)
+  , m_crop_window(frame.get_crop_window())
+  , m_pixel_count((m_crop_window.extent()[0] + 1) * (m_crop_window.extent()[1] + 1))
+  , m_pass_number(0)
+  , m_total_samples(0)
+  , m_pass_start_time(0.0)
+{
+    const CanvasProperties& props = frame.image().properties();
+
+    m_trackers.resize(props.m_pixel_count);
+
+    // The first pass takes 'min' samples in every pixel of the crop window.
+    m_sample_counts.resize(props.m_pixel_count, 0);
+    for (size_t y = m_crop_window.min.y; y <= m_crop_window.max.y; ++y)
+    {
+        for (size_t x = m_crop_window.min.x; x <= m_crop_window.max.x; ++x)
+            m_sample_counts[y * m_frame_width + x] = static_cast<uint32>(m_params.m_min_samples);
+    }
+
+    RENDERER_LOG_INFO(
+        "adaptive sampling: target noise level %s, %s to %s samples/pixel, sample budget %s, time budget %s.",
+        pretty_percent(m_params.m_noise_level, 1.0f, 2).c_str(),
+        pretty_uint(m_params.m_min_samples).c_str(),
+        pretty_uint(m_params.m_max_samples).c_str(),
+        m_params.m_sample_budget > 0.0 ? (pretty_scalar(m_params.m_sample_budget, 1) + " samples/pixel").c_str() : "unlimited",
+        m_params.m_time_budget > 0.0 ? pretty_time(m_params.m_time_budget).c_str() : "unlimited");
+}
+
+void AdaptiveSamplingBudget::release()
+{
+    delete this;
+}
+
+void AdaptiveSamplingBudget::pre_render(
+    const Frame&            frame,
+    JobQueue&               job_queue,
+    IAbortSwitch&           abort_switch)
+{
+    if (m_pass_number == 0)
+        m_stopwatch.start();
+
+    m_pass_start_time = m_stopwatch.measure().get_seconds();
+}
+
+bool AdaptiveSamplingBudget::post_render(
+    const Frame&            frame,
+    JobQueue&               job_queue,
+    IAbortSwitch&           abort_switch)
+{
+    const double elapsed_time = m_stopwatch.measure().get_seconds();
+    const double pass_time = elapsed_time - m_pass_start_time;
+
+    uint64 total_samples = 0;
+    double total_demand = 0.0;
+    double error_sum = 0.0;
+    size_t converged_pixel_count = 0;
+
+    // Estimate how many more samples each pixel needs to reach the target noise level.
+    for (size_t y = m_crop_window.min.y; y <= m_crop_window.max.y; ++y)
+    {
+        for (size_t x = m_crop_window.min.x; x <= m_crop_window.max.x; ++x)
+        {
+            const size_t pixel_index = y * m_frame_width + x;
+            const VarianceTracker& tracker = m_trackers[pixel_index];
+            const size_t sample_count = tracker.get_size();
+            const float error = tracker.get_relative_error();
+
+            total_samples += sample_count;
+            error_sum += min(error, 1.0f);
+
+            size_t demand = 0;
+
+            if (error <= m_params.m_noise_level || sample_count >= m_params.m_max_samples)
+                ++converged_pixel_count;
+            else
+            {
+                // The standard error decreases as 1/sqrt(n).
+                const double required =
+                    sample_count > 1
+                        ? ceil(sample_count * square(static_cast<double>(error) / m_params.m_noise_level))
+                        : static_cast<double>(m_params.m_min_samples);
+                demand =
+                    static_cast<size_t>(
+                        foundation::clamp(
+                            required - sample_count,
+                            1.0,
+                            static_cast<double>(m_params.m_max_samples - sample_count)));
+            }
+
+            m_sample_counts[pixel_index] = static_cast<uint32>(demand);
+            total_demand += demand;
+        }
+    }
+
+    const uint64 pass_samples = total_samples - m_total_samples;
+    m_total_samples = total_samples;
+    ++m_pass_number;
+
+    const double noise_level = m_pixel_count > 0 ? error_sum / m_pixel_count : 0.0;
+
+    RENDERER_LOG_INFO(
+        "adaptive sampling pass %s completed in %s: noise level %s, %s pixels converged, %s samples/pixel on average.",
+        pretty_uint(m_pass_number).c_str(),
+        pretty_time(pass_time).c_str(),
+        pretty_percent(noise_level, 1.0, 2).c_str(),
+        pretty_percent(converged_pixel_count, m_pixel_count).c_str(),
+        pretty_ratio(total_samples, static_cast<uint64>(m_pixel_count)).c_str());
+
+    if (total_demand == 0.0)
+    {
+        print_statistics("target noise level reached", noise_level, converged_pixel_count);
+        return false;
+    }
+
+    // By default, a pass costs about as much as the first one.
+    double capacity = static_cast<double>(m_params.m_min_samples) * m_pixel_count;
+
+    // Don't exceed the sample budget.
+    if (m_params.m_sample_budget > 0.0)
+    {
+        const double remaining_samples = m_params.m_sample_budget * m_pixel_count - total_samples;
+        if (remaining_samples < 1.0)
+        {
+            print_statistics("sample budget exhausted", noise_level, converged_pixel_count);
+            return false;
+        }
+        capacity = min(capacity, remaining_samples);
+    }
+
+    // Don't exceed the time budget, assuming the cost of a sample stays the same as in the last pass.
+    if (m_params.m_time_budget > 0.0)
+    {
+        const double remaining_time = m_params.m_time_budget - elapsed_time;
+        const double affordable_samples =
+            pass_time > 0.0 ? remaining_time * pass_samples / pass_time : capacity;
+        if (affordable_samples < 1.0)
+        {
+            print_statistics("time budget exhausted", noise_level, converged_pixel_count);
+            return false;
+        }
+        capacity = min(capacity, affordable_samples);
+    }
+
+    if (m_params.m_max_pass_count > 0 && m_pass_number >= m_params.m_max_pass_count)
+    {
+        print_statistics("maximum number of passes reached", noise_level, converged_pixel_count);
+        return false;
+    }
+
+    // Hand out the samples of the next pass to pixels in proportion to their demand.
+    // Rounding errors are carried over from pixel to pixel so that the pass never
+    // takes more samples than the capacity; pixels may get no sample in this pass.
+    const double scale = min(capacity / total_demand, 1.0);
+    double carry = 0.0;
+    uint64 next_pass_samples = 0;
+    size_t active_pixel_count = 0;
+
+    for (size_t y = m_crop_window.min.y; y <= m_crop_window.max.y; ++y)
+    {
+        for (size_t x = m_crop_window.min.x; x <= m_crop_window.max.x; ++x)
+        {
+            uint32& sample_count = m_sample_counts[y * m_frame_width + x];
+
+            if (sample_count > 0)
+            {
+                carry += sample_count * scale;
+                sample_count = static_cast<uint32>(carry);
+                carry -= sample_count;
+
+                next_pass_samples += sample_count;
+                if (sample_count > 0)
+                    ++active_pixel_count;
+            }
+        }
+    }
+
+    RENDERER_LOG_DEBUG(
+        "adaptive sampling: next pass distributes %s samples over %s pixels.",
+        pretty_uint(next_pass_samples).c_str(),
+        pretty_uint(active_pixel_count).c_str());
+
+    return true;
+}
+
+void AdaptiveSamplingBudget::print_statistics(
+    const char*             stop_reason,
+    const double            noise_level,
+    const size_t            converged_pixel_count) const
+{
+    Statistics stats;
+    stats.insert<uint64>("passes", m_pass_number);
+    stats.insert<string>("stop reason", stop_reason);
+    stats.insert_percent("noise level", noise_level, 1.0, 2);
+    stats.insert_percent("target noise level", static_cast<double>(m_params.m_noise_level), 1.0, 2);
+    stats.insert_percent("converged pixels", converged_pixel_count, m_pixel_count);
+    stats.insert("samples/pixel", static_cast<double>(m_total_samples) / max<size_t>(m_pixel_count, 1));
+    stats.insert_time("render time", m_stopwatch.get_seconds());
+
+    RENDERER_LOG_INFO(
+        "%s",
+        StatisticsVector::make("adaptive sampling statistics", stats).to_string().c_str());
+}
+
+}   // namespace renderer
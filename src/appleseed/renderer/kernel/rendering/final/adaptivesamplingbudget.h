@@ -0,0 +1,178 @@
+
+//
+// This source file is part of appleseed.
+// Visit http://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2010-2013 Francois Beaune, Jupiter Jazz Limited
+// Copyright (c) 2014-2017 Francois Beaune, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef APPLESEED_RENDERER_KERNEL_RENDERING_FINAL_ADAPTIVESAMPLINGBUDGET_H
+#define APPLESEED_RENDERER_KERNEL_RENDERING_FINAL_ADAPTIVESAMPLINGBUDGET_H
+
+// appleseed.renderer headers.
+#include "renderer/kernel/rendering/final/variancetracker.h"
+#include "renderer/kernel/rendering/ipasscallback.h"
+#include "renderer/utility/paramarray.h"
+
+// appleseed.foundation headers.
+#include "foundation/math/aabb.h"
+#include "foundation/platform/compiler.h"
+#include "foundation/platform/timers.h"
+#include "foundation/platform/types.h"
+#include "foundation/utility/stopwatch.h"
+
+// Standard headers.
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+// Forward declarations.
+namespace foundation    { class IAbortSwitch; }
+namespace foundation    { class JobQueue; }
+namespace renderer      { class Frame; }
+
+namespace renderer
+{
+
+//
+// Distribute a global sample budget or time budget across the pixels
+// of the frame over multiple passes of the generic frame renderer.
+//
+// Every pixel keeps a VarianceTracker over all the passes. At the end of each
+// pass, the number of additional samples each pixel needs to bring its relative
+// error down to the target noise level is estimated from the 1/sqrt(n) decay of
+// the standard error, and the samples of the next pass are handed out to pixels
+// in proportion to that demand. Rendering stops as soon as every pixel reaches the
+// target noise level, or when the sample budget, the time budget or the optional
+// maximum number of passes is exhausted.
+//
+// Pixel sample counts are only modified between passes, so they can be read for
+// any pixel during a pass. Variance trackers, however, must only be updated by
+// the thread rendering the tile that contains the pixel.
+//
+
+class AdaptiveSamplingBudget
+  : public IPassCallback
+{
+  public:
+    // Constructor.
+    AdaptiveSamplingBudget(
+        const Frame&                frame,
+        const ParamArray&           params);
+
+    // Delete this instance.
+    virtual void release() APPLESEED_OVERRIDE;
+
+    // This method is called at the beginning of a pass.
+    virtual void pre_render(
+        const Frame&                frame,
+        foundation::JobQueue&       job_queue,
+        foundation::IAbortSwitch&   abort_switch) APPLESEED_OVERRIDE;
+
+    // This method is called at the end of a pass.
+    virtual bool post_render(
+        const Frame&                frame,
+        foundation::JobQueue&       job_queue,
+        foundation::IAbortSwitch&   abort_switch) APPLESEED_OVERRIDE;
+
+    // Return the target noise level, as a relative error.
+    float get_noise_level() const;
+
+    // Return the number of samples to take in a given pixel during the current pass.
+    size_t get_pixel_sample_count(const size_t x, const size_t y) const;
+
+    // Access the variance tracker of a given pixel.
+    VarianceTracker& get_pixel_tracker(const size_t x, const size_t y);
+    const VarianceTracker& get_pixel_tracker(const size_t x, const size_t y) const;
+
+    // Return the relative error of a given pixel, or 0 if it has not been sampled yet.
+    float get_pixel_error(const size_t x, const size_t y) const;
+
+  private:
+    struct Parameters
+    {
+        const size_t                m_min_samples;
+        const size_t                m_max_samples;
+        const float                 m_noise_level;
+        const double                m_sample_budget;
+        const double                m_time_budget;
+        const size_t                m_max_pass_count;
+
+        explicit Parameters(const ParamArray& params);
+    };
+
+    const Parameters                m_params;
+    const size_t                    m_frame_width;
+    const foundation::AABB2u        m_crop_window;
+    const size_t                    m_pixel_count;
+    std::vector<VarianceTracker>    m_trackers;
+    std::vector<foundation::uint32> m_sample_counts;
+    size_t                          m_pass_number;
+    foundation::uint64              m_total_samples;
+    double                          m_pass_start_time;
+    foundation::Stopwatch<foundation::DefaultWallclockTimer>
+                                    m_stopwatch;
+
+    void print_statistics(
+        const char*                 stop_reason,
+        const double                noise_level,
+        const size_t                converged_pixel_count) const;
+};
+
+
+//
+// AdaptiveSamplingBudget class implementation.
+//
+
+inline float AdaptiveSamplingBudget::get_noise_level() const
+{
+    return m_params.m_noise_level;
+}
+
+inline size_t AdaptiveSamplingBudget::get_pixel_sample_count(const size_t x, const size_t y) const
+{
+    assert(y * m_frame_width + x < m_sample_counts.size());
+    return m_sample_counts[y * m_frame_width + x];
+}
+
+inline VarianceTracker& AdaptiveSamplingBudget::get_pixel_tracker(const size_t x, const size_t y)
+{
+    assert(y * m_frame_width + x < m_trackers.size());
+    return m_trackers[y * m_frame_width + x];
+}
+
+inline const VarianceTracker& AdaptiveSamplingBudget::get_pixel_tracker(const size_t x, const size_t y) const
+{
+    assert(y * m_frame_width + x < m_trackers.size());
+    return m_trackers[y * m_frame_width + x];
+}
+
+inline float AdaptiveSamplingBudget::get_pixel_error(const size_t x, const size_t y) const
+{
+    const VarianceTracker& tracker = get_pixel_tracker(x, y);
+    return tracker.get_size() > 0 ? tracker.get_relative_error() : 0.0f;
+}
+
+}       // namespace renderer
+
+#endif  // !APPLESEED_RENDERER_KERNEL_RENDERING_FINAL_ADAPTIVESAMPLINGBUDGET_H
@@ -0,0 +1,124 @@
+
+//
+// This source file is part of appleseed.
+// Visit http://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2010-2013 Francois Beaune, Jupiter Jazz Limited
+// Copyright (c) 2014-2017 Francois Beaune, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef APPLESEED_RENDERER_KERNEL_RENDERING_FINAL_VARIANCETRACKER_H
+#define APPLESEED_RENDERER_KERNEL_RENDERING_FINAL_VARIANCETRACKER_H
+
+// appleseed.foundation headers.
+#include "foundation/platform/types.h"
+
+// Standard headers.
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+namespace renderer
+{
+
+//
+// Track the running mean and variance of a stream of values using Welford's
+// algorithm, and derive confidence bounds on the mean from them.
+//
+// Unlike VariationTracker, which only measures how much the running mean moved
+// during a batch of samples, this estimator can be resumed at any time (for
+// instance across rendering passes) and gives a statistically meaningful error
+// estimate: with n samples of sample variance s^2, the standard error of the
+// mean is sqrt(s^2 / n), and the true mean lies within z standard errors of the
+// estimated mean with a probability given by the normal distribution (about 95%
+// for z = 1.96).
+//
+// Reference:
+//
+//   http://en.wikipedia.org/wiki/Algorithms_for_calculating_variance
+//
+
+class VarianceTracker
+{
+  public:
+    VarianceTracker()
+      : m_size(0)
+      , m_mean(0.0f)
+      , m_m2(0.0f)
+    {
+    }
+
+    void insert(const float value)
+    {
+        ++m_size;
+
+        const float delta = value - m_mean;
+        m_mean += delta / m_size;
+        m_m2 += delta * (value - m_mean);
+    }
+
+    size_t get_size() const
+    {
+        return m_size;
+    }
+
+    float get_mean() const
+    {
+        return m_mean;
+    }
+
+    // Return the unbiased sample variance.
+    float get_variance() const
+    {
+        return m_size > 1 ? std::max(m_m2, 0.0f) / (m_size - 1) : 0.0f;
+    }
+
+    // Return the standard error of the mean.
+    float get_standard_error() const
+    {
+        return m_size > 1 ? std::sqrt(get_variance() / m_size) : 0.0f;
+    }
+
+    // Return the half-width of the confidence interval on the mean, relative to the
+    // mean itself. Means smaller than min_mean are clamped to avoid spending samples
+    // on imperceptible noise in very dark regions. Fewer than two samples do not
+    // carry any information about the variance, in which case the error is infinite.
+    float get_relative_error(
+        const float min_mean = 1.0e-3f,
+        const float z = 1.96f) const
+    {
+        if (m_size < 2)
+            return std::numeric_limits<float>::max();
+
+        return z * get_standard_error() / std::max(std::abs(m_mean), min_mean);
+    }
+
+  private:
+    foundation::uint32  m_size;
+    float               m_mean;
+    float               m_m2;
+};
+
+}       // namespace renderer
+
+#endif  // !APPLESEED_RENDERER_KERNEL_RENDERING_FINAL_VARIANCETRACKER_H
@@ -38,20 +38,26 @@
 #include "renderer/kernel/rendering/ipasscallback.h"
 #include "renderer/kernel/rendering/itilecallback.h"
 #include "renderer/kernel/rendering/itilerenderer.h"
+#include "renderer/modeling/frame/frame.h"
 #include "renderer/utility/settingsparsing.h"
 
 // appleseed.foundation headers.
 #include "foundation/core/concepts/noncopyable.h"
+#include "foundation/image/canvasproperties.h"
+#include "foundation/image/image.h"
 #include "foundation/math/hash.h"
 #include "foundation/platform/thread.h"
+#include "foundation/platform/timers.h"
 #include "foundation/platform/types.h"
 #include "foundation/utility/containers/dictionary.h"
 #include "foundation/utility/foreach.h"
 #include "foundation/utility/job.h"
 #include "foundation/utility/statistics.h"
+#include "foundation/utility/stopwatch.h"
 #include "foundation/utility/string.h"
 
 // Standard headers.
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
 #include <memory>
@@ -67,6 +73,52 @@ namespace renderer
 
 namespace
 {
+    //
+    // Job estimating the rendering cost of a single tile.
+    //
+
+    class TileCostEstimationJob
+      : public IJob
+    {
+      public:
+        TileCostEstimationJob(
+            vector<ITileRenderer*>&     tile_renderers,
+            const Frame&                frame,
+            const size_t                tile_x,
+            const size_t                tile_y,
+            double&                     tile_cost,
+            IAbortSwitch&               abort_switch)
+          : m_tile_renderers(tile_renderers)
+          , m_frame(frame)
+          , m_tile_x(tile_x)
+          , m_tile_y(tile_y)
+          , m_tile_cost(tile_cost)
+          , m_abort_switch(abort_switch)
+        {
+        }
+
+        virtual void execute(const size_t thread_index) APPLESEED_OVERRIDE
+        {
+            assert(thread_index < m_tile_renderers.size());
+
+            m_tile_cost =
+                m_tile_renderers[thread_index]->estimate_tile_cost(
+                    m_frame,
+                    m_tile_x,
+                    m_tile_y,
+                    m_abort_switch);
+        }
+
+      private:
+        vector<ITileRenderer*>&         m_tile_renderers;
+        const Frame&                    m_frame;
+        const size_t                    m_tile_x;
+        const size_t                    m_tile_y;
+        double&                         m_tile_cost;
+        IAbortSwitch&                   m_abort_switch;
+    };
+
+
     //
     // Generic frame renderer.
     //
@@ -84,6 +136,7 @@ namespace
           : m_frame(frame)
           , m_params(params)
           , m_pass_callback(pass_callback)
+          , m_thread_stats(m_params.m_thread_count)
           , m_is_rendering(false)
         {
             // We must have a renderer factory, but it's OK not to have a callback factory.
@@ -95,7 +148,7 @@ namespace
                     global_logger(),
                     m_job_queue,
                     m_params.m_thread_count,
-                    JobManager::KeepRunningOnEmptyQueue));
+                    JobManager::KeepRunningOnEmptyQueue | JobManager::WorkStealing));
 
             // Instantiate tile renderers, one per rendering thread.
             m_tile_renderers.reserve(m_params.m_thread_count);
@@ -113,9 +166,11 @@ namespace
             RENDERER_LOG_INFO(
                 "rendering settings:\n"
                 "  sampling mode                 %s\n"
-                "  threads                       %s",
+                "  threads                       %s\n"
+                "  tile splitting                %s",
                 get_sampling_context_mode_name(get_sampling_context_mode(params)).c_str(),
-                pretty_int(m_params.m_thread_count).c_str());
+                pretty_int(m_params.m_thread_count).c_str(),
+                m_params.m_tile_splitting ? "on" : "off");
         }
 
         virtual ~GenericFrameRenderer()
@@ -159,6 +214,9 @@ namespace
 
             m_abort_switch.clear();
 
+            // Reset per-thread statistics.
+            m_thread_stats.assign(m_params.m_thread_count, TileJob::ThreadStatistics());
+
             // Start job execution.
             m_job_manager->start();
 
@@ -172,6 +230,8 @@ namespace
                     m_tile_renderers,
                     m_tile_callbacks,
                     m_pass_callback,
+                    m_params.m_tile_splitting,
+                    m_thread_stats,
                     m_job_queue,
                     m_abort_switch,
                     m_is_rendering));
@@ -208,6 +268,7 @@ namespace
         {
             stop_rendering();
 
+            print_frame_renderer_stats();
             print_tile_renderers_stats();
         }
 
@@ -217,11 +278,13 @@ namespace
             const size_t                        m_thread_count;     // number of rendering threads
             const TileJobFactory::TileOrdering  m_tile_ordering;    // tile rendering order
             const size_t                        m_pass_count;       // number of rendering passes
+            const bool                          m_tile_splitting;   // split the last tiles of a pass among idle threads
 
             explicit Parameters(const ParamArray& params)
               : m_thread_count(get_rendering_thread_count(params))
               , m_tile_ordering(get_tile_ordering(params))
               , m_pass_count(params.get_optional<size_t>("passes", 1))
+              , m_tile_splitting(params.get_optional<bool>("tile_splitting", false))
             {
             }
 
@@ -246,6 +309,10 @@ namespace
                 {
                     return TileJobFactory::RandomOrdering;
                 }
+                else if (tile_ordering == "cost")
+                {
+                    return TileJobFactory::CostOrdering;
+                }
                 else
                 {
                     RENDERER_LOG_ERROR(
@@ -270,6 +337,8 @@ namespace
                 vector<ITileRenderer*>&             tile_renderers,
                 vector<ITileCallback*>&             tile_callbacks,
                 IPassCallback*                      pass_callback,
+                const bool                          tile_splitting,
+                TileJob::ThreadStatisticsVector&    thread_stats,
                 JobQueue&                           job_queue,
                 IAbortSwitch&                       abort_switch,
                 bool&                               is_rendering)
@@ -279,6 +348,9 @@ namespace
               , m_tile_renderers(tile_renderers)
               , m_tile_callbacks(tile_callbacks)
               , m_pass_callback(pass_callback)
+              , m_tile_splitting(tile_splitting)
+              , m_thread_stats(thread_stats)
+              , m_tile_rendering_time(0.0)
               , m_job_queue(job_queue)
               , m_abort_switch(abort_switch)
               , m_is_rendering(is_rendering)
@@ -300,6 +372,15 @@ namespace
                         assert(!m_job_queue.has_scheduled_or_running_jobs());
                     }
 
+                    // Estimate the cost of each tile before the first pass.
+                    if (pass == 0 && m_tile_ordering == TileJobFactory::CostOrdering)
+                    {
+                        estimate_tile_costs();
+
+                        if (m_abort_switch.is_aborted())
+                            break;
+                    }
+
                     // Create tile jobs.
                     const uint32 pass_hash = hash_uint32(static_cast<uint32>(pass));
                     TileJobFactory::TileJobVector tile_jobs;
@@ -309,9 +390,14 @@ namespace
                         m_tile_renderers,
                         m_tile_callbacks,
                         pass_hash,
+                        m_tile_splitting ? &m_job_queue : 0,
+                        m_thread_stats,
                         tile_jobs,
                         m_abort_switch);
 
+                    Stopwatch<DefaultWallclockTimer> stopwatch(0);
+                    stopwatch.start();
+
                     // Schedule tile jobs.
                     for (const_each<TileJobFactory::TileJobVector> i = tile_jobs; i; ++i)
                         m_job_queue.schedule(*i);
@@ -319,29 +405,92 @@ namespace
                     // Wait until tile jobs have effectively stopped.
                     m_job_queue.wait_until_completion();
 
+                    stopwatch.measure();
+                    m_tile_rendering_time += stopwatch.get_seconds();
+
                     // Invoke the post-pass callback if there is one.
                     if (m_pass_callback)
                     {
                         assert(!m_job_queue.has_scheduled_or_running_jobs());
-                        m_pass_callback->post_render(m_frame, m_job_queue, m_abort_switch);
+                        const bool proceed = m_pass_callback->post_render(m_frame, m_job_queue, m_abort_switch);
                         assert(!m_job_queue.has_scheduled_or_running_jobs());
+
+                        // The pass callback may end rendering early, e.g. once the image has converged.
+                        if (!proceed)
+                            break;
                     }
                 }
 
                 m_is_rendering = false;
             }
 
+            // Return the wall clock time spent rendering tiles, in seconds.
+            double get_tile_rendering_time() const
+            {
+                return m_tile_rendering_time;
+            }
+
           private:
             const Frame&                            m_frame;
             const TileJobFactory::TileOrdering      m_tile_ordering;
             vector<ITileRenderer*>&                 m_tile_renderers;
             vector<ITileCallback*>&                 m_tile_callbacks;
             IPassCallback*                          m_pass_callback;
+            const bool                              m_tile_splitting;
+            TileJob::ThreadStatisticsVector&        m_thread_stats;
+            double                                  m_tile_rendering_time;
             const size_t                            m_pass_count;
             JobQueue&                               m_job_queue;
             IAbortSwitch&                           m_abort_switch;
             bool&                                   m_is_rendering;
             TileJobFactory                          m_tile_job_factory;
+
+            // Render a sparse subset of the pixels of each tile to estimate tile costs.
+            void estimate_tile_costs()
+            {
+                const CanvasProperties& props = m_frame.image().properties();
+                vector<double> tile_costs(props.m_tile_count, 0.0);
+
+                Stopwatch<DefaultWallclockTimer> stopwatch(0);
+                stopwatch.start();
+
+                for (size_t tile_y = 0; tile_y < props.m_tile_count_y; ++tile_y)
+                {
+                    for (size_t tile_x = 0; tile_x < props.m_tile_count_x; ++tile_x)
+                    {
+                        m_job_queue.schedule(
+                            new TileCostEstimationJob(
+                                m_tile_renderers,
+                                m_frame,
+                                tile_x,
+                                tile_y,
+                                tile_costs[tile_y * props.m_tile_count_x + tile_x],
+                                m_abort_switch));
+                    }
+                }
+
+                m_job_queue.wait_until_completion();
+
+                stopwatch.measure();
+
+                double max_cost = 0.0;
+                double total_cost = 0.0;
+
+                for (size_t i = 0; i < tile_costs.size(); ++i)
+                {
+                    max_cost = max(max_cost, tile_costs[i]);
+                    total_cost += tile_costs[i];
+                }
+
+                const double avg_cost = total_cost / tile_costs.size();
+
+                RENDERER_LOG_INFO(
+                    "estimated tile costs in %s (most expensive tile: %sx the average).",
+                    pretty_time(stopwatch.get_seconds()).c_str(),
+                    avg_cost > 0.0 ? pretty_ratio(max_cost, avg_cost).c_str() : "n/a");
+
+                m_tile_job_factory.set_tile_costs(tile_costs);
+            }
         };
 
         const Frame&                m_frame;            // target framebuffer
@@ -355,12 +504,43 @@ namespace
         vector<ITileCallback*>      m_tile_callbacks;   // tile callbacks, none or one per thread
         IPassCallback*              m_pass_callback;
 
+        TileJob::ThreadStatisticsVector m_thread_stats; // tile job statistics, one per thread
+
         TileJobFactory              m_tile_job_factory;
 
         bool                        m_is_rendering;
         auto_ptr<PassManagerFunc>   m_pass_manager_func;
         auto_ptr<boost::thread>     m_pass_manager_thread;
 
+        void print_frame_renderer_stats() const
+        {
+            if (m_pass_manager_func.get() == 0)
+                return;
+
+            double busy_time = 0.0;
+            uint64 split_tile_count = 0;
+
+            for (size_t i = 0; i < m_thread_stats.size(); ++i)
+            {
+                busy_time += m_thread_stats[i].m_busy_time;
+                split_tile_count += m_thread_stats[i].m_split_tile_count;
+            }
+
+            // Idle thread time is the time during which rendering threads had no tile to work on.
+            const double total_time = m_pass_manager_func->get_tile_rendering_time() * m_params.m_thread_count;
+            const double idle_time = max(total_time - busy_time, 0.0);
+
+            Statistics stats;
+            stats.insert_time("tile rendering time", m_pass_manager_func->get_tile_rendering_time());
+            stats.insert_time("idle thread time", idle_time);
+            stats.insert_percent("idle thread ratio", idle_time, total_time);
+            stats.insert("split tiles", split_tile_count);
+
+            RENDERER_LOG_INFO(
+                "%s",
+                StatisticsVector::make("generic frame renderer statistics", stats).to_string().c_str());
+        }
+
         void print_tile_renderers_stats() const
         {
             assert(!m_tile_renderers.empty());
@@ -438,11 +618,19 @@ Dictionary GenericFrameRendererFactory::get_params_metadata()
             .insert("label", "Passes")
             .insert("help", "Number of render passes"));
 
+    metadata.dictionaries().insert(
+        "tile_splitting",
+        Dictionary()
+            .insert("type", "bool")
+            .insert("default", "false")
+            .insert("label", "Tile Splitting")
+            .insert("help", "Split the last tiles of each pass among idle rendering threads; images then depend on thread scheduling"));
+
     metadata.dictionaries().insert(
         "tile_ordering",
         Dictionary()
             .insert("type", "enum")
-            .insert("values", "linear|spiral|hilbert|random")
+            .insert("values", "linear|spiral|hilbert|random|cost")
             .insert("default", "spiral")
             .insert("label", "Tile Order")
             .insert("help", "Tile rendering order")
@@ -468,7 +656,12 @@ Dictionary GenericFrameRendererFactory::get_params_metadata()
                         "random",
                         Dictionary()
                             .insert("label", "Random")
-                            .insert("help", "Random tile ordering"))));
+                            .insert("help", "Random tile ordering"))
+                    .insert(
+                        "cost",
+                        Dictionary()
+                            .insert("label", "Cost")
+                            .insert("help", "Render the most expensive tiles first, as estimated by a quick pre-pass"))));
 
     return metadata;
 }
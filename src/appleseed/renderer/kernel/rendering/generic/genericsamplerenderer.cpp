@@ -302,6 +302,7 @@ namespace
             stats.merge(m_texture_cache.get_statistics());
             stats.merge(m_intersector.get_statistics());
             stats.merge(m_lighting_engine->get_statistics());
+            stats.merge(m_shading_context.get_statistics());
             return stats;
         }
 
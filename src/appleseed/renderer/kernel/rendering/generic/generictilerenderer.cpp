@@ -53,14 +53,17 @@
 #include "foundation/math/vector.h"
 #include "foundation/platform/arch.h"
 #include "foundation/platform/breakpoint.h"
+#include "foundation/platform/timers.h"
 #include "foundation/platform/types.h"
 #include "foundation/utility/autoreleaseptr.h"
 #include "foundation/utility/iostreamop.h"
 #include "foundation/utility/job.h"
 #include "foundation/utility/statistics.h"
+#include "foundation/utility/stopwatch.h"
 #include "foundation/utility/string.h"
 
 // Standard headers.
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <memory>
@@ -113,6 +116,7 @@ namespace
             const Frame&    frame,
             const size_t    tile_x,
             const size_t    tile_y,
+            const AABB2u&   region,
             const size_t    pass_hash,
             IAbortSwitch&   abort_switch) APPLESEED_OVERRIDE
         {
@@ -142,6 +146,13 @@ namespace
             tile_bbox.min.y -= tile_origin_y;
             tile_bbox.max.x -= tile_origin_x;
             tile_bbox.max.y -= tile_origin_y;
+            const AABB2i full_tile_bbox = tile_bbox;
+
+            // Restrict rendering to the requested region of the tile.
+            tile_bbox = AABB2i::intersect(tile_bbox, AABB2i(region));
+            if (!tile_bbox.is_valid())
+                return;
+            const bool partial_tile = tile_bbox != full_tile_bbox;
 
             // Pad the bounding box with tile margins.
             AABB2i padded_tile_bbox;
@@ -159,19 +170,45 @@ namespace
                     frame,
                     tile_x,
                     tile_y,
-                    tile_bbox);
+                    AABB2u(full_tile_bbox));
             assert(framebuffer);
 
-            // Seed the RNG with the tile index and the pass hash.
+            // When only a region of the tile is rendered, other regions may be rendered
+            // concurrently into the same framebuffer: accumulate samples into a private
+            // framebuffer first, and merge it into the shared one once we're done.
+            auto_ptr<ShadingResultFrameBuffer> region_framebuffer;
+            if (partial_tile)
+            {
+                region_framebuffer.reset(
+                    new ShadingResultFrameBuffer(
+                        tile.get_width(),
+                        tile.get_height(),
+                        frame.aov_images().size(),
+                        AABB2u(tile_bbox),
+                        frame.get_filter()));
+                region_framebuffer->clear();
+            }
+
+            // Seed the RNG with the tile index and the pass hash, and with the first row
+            // of the region when only a band of the tile is rendered so that the bands of
+            // a split tile don't reuse the same random sequences.
             // Seeding the RNG per tile instead of per pixel has potential consequences on
             // debugging: rendering a subset of a tile may lead to different computations
             // than rendering the full tile, e.g. if the sampling context switches to random
             // sampling because the number of dimensions becomes too high.
             const size_t tile_index = tile_y * frame_properties.m_tile_count_x + tile_x;
 #ifdef APPLESEED_ARCH64
-            m_rng = SamplingContext::RNGType(hash_uint64_to_uint32(pass_hash ^ tile_index));
+            const size_t seed =
+                partial_tile
+                    ? mix_uint64(pass_hash, tile_index, static_cast<uint64>(region.min.y))
+                    : pass_hash ^ tile_index;
+            m_rng = SamplingContext::RNGType(hash_uint64_to_uint32(seed));
 #else
-            m_rng = SamplingContext::RNGType(pass_hash ^ tile_index);
+            const size_t seed =
+                partial_tile
+                    ? mix_uint32(pass_hash, tile_index, static_cast<uint32>(region.min.y))
+                    : pass_hash ^ tile_index;
+            m_rng = SamplingContext::RNGType(seed);
 #endif
 
             // Loop over tile pixels.
@@ -208,13 +245,23 @@ namespace
                     pi,
                     pt,
                     m_rng,
-                    *framebuffer);
+                    partial_tile ? *region_framebuffer : *framebuffer);
+            }
+
+            // Merge the samples of the region into the tile framebuffer.
+            if (partial_tile)
+            {
+                for (int y = tile_bbox.min.y; y <= tile_bbox.max.y; ++y)
+                {
+                    for (int x = tile_bbox.min.x; x <= tile_bbox.max.x; ++x)
+                        framebuffer->merge(x, y, *region_framebuffer, x, y, 1.0f);
+                }
             }
 
             // Develop the framebuffer to the tile.
             if (frame.is_premultiplied_alpha())
-                framebuffer->develop_to_tile_premult_alpha(tile, aov_tiles);
-            else framebuffer->develop_to_tile_straight_alpha(tile, aov_tiles);
+                framebuffer->develop_to_tile_premult_alpha(tile, aov_tiles, AABB2u(tile_bbox));
+            else framebuffer->develop_to_tile_straight_alpha(tile, aov_tiles, AABB2u(tile_bbox));
 
             // Release the framebuffer.
             m_framebuffer_factory->destroy(framebuffer);
@@ -223,6 +270,94 @@ namespace
             m_pixel_renderer->on_tile_end(frame, tile, aov_tiles);
         }
 
+        virtual double estimate_tile_cost(
+            const Frame&    frame,
+            const size_t    tile_x,
+            const size_t    tile_y,
+            IAbortSwitch&   abort_switch) APPLESEED_OVERRIDE
+        {
+            // Retrieve frame properties.
+            const CanvasProperties& frame_properties = frame.image().properties();
+            assert(tile_x < frame_properties.m_tile_count_x);
+            assert(tile_y < frame_properties.m_tile_count_y);
+
+            // Retrieve tile properties.
+            Tile& tile = frame.image().tile(tile_x, tile_y);
+            TileStack aov_tiles = frame.aov_images().tiles(tile_x, tile_y);
+            const int tile_origin_x = static_cast<int>(frame_properties.m_tile_width * tile_x);
+            const int tile_origin_y = static_cast<int>(frame_properties.m_tile_height * tile_y);
+
+            // Compute the tile space bounding box of the pixels to render.
+            AABB2i tile_bbox;
+            tile_bbox.min.x = tile_origin_x;
+            tile_bbox.min.y = tile_origin_y;
+            tile_bbox.max.x = tile_origin_x + static_cast<int>(tile.get_width()) - 1;
+            tile_bbox.max.y = tile_origin_y + static_cast<int>(tile.get_height()) - 1;
+            tile_bbox = AABB2i::intersect(tile_bbox, AABB2i(frame.get_crop_window()));
+            if (!tile_bbox.is_valid())
+                return 0.0;
+            tile_bbox.min.x -= tile_origin_x;
+            tile_bbox.min.y -= tile_origin_y;
+            tile_bbox.max.x -= tile_origin_x;
+            tile_bbox.max.y -= tile_origin_y;
+
+            Stopwatch<DefaultWallclockTimer> stopwatch(0);
+            stopwatch.start();
+
+            m_pixel_renderer->on_tile_begin(frame, tile, aov_tiles);
+
+            // Samples are accumulated into a throwaway framebuffer.
+            ShadingResultFrameBuffer framebuffer(
+                tile.get_width(),
+                tile.get_height(),
+                frame.aov_images().size(),
+                AABB2u(tile_bbox),
+                frame.get_filter());
+            framebuffer.clear();
+
+            // Pass an empty bounding box to the pixel renderer so that it doesn't
+            // consider any of the pixels as belonging to the tile (and for instance
+            // doesn't update per-pixel statistics with these samples).
+            AABB2i no_pixels;
+            no_pixels.invalidate();
+
+            // Use a pass hash that never occurs during rendering.
+            const size_t pass_hash = ~size_t(0);
+            const size_t tile_index = tile_y * frame_properties.m_tile_count_x + tile_x;
+            m_rng = SamplingContext::RNGType(static_cast<uint32>(tile_index));
+
+            // Render one pixel out of CostEstimationStride x CostEstimationStride.
+            const int CostEstimationStride = 8;
+            const int start_x = tile_bbox.min.x + min(CostEstimationStride, tile_bbox.extent()[0] + 1) / 2;
+            const int start_y = tile_bbox.min.y + min(CostEstimationStride, tile_bbox.extent()[1] + 1) / 2;
+
+            for (int y = start_y; y <= tile_bbox.max.y; y += CostEstimationStride)
+            {
+                for (int x = start_x; x <= tile_bbox.max.x; x += CostEstimationStride)
+                {
+                    if (abort_switch.is_aborted())
+                        return 0.0;
+
+                    const Vector2i pt(x, y);
+                    const Vector2i pi(tile_origin_x + pt.x, tile_origin_y + pt.y);
+
+                    m_pixel_renderer->render_pixel(
+                        frame,
+                        tile,
+                        aov_tiles,
+                        no_pixels,
+                        pass_hash,
+                        pi,
+                        pt,
+                        m_rng,
+                        framebuffer);
+                }
+            }
+
+            stopwatch.measure();
+            return stopwatch.get_seconds();
+        }
+
         virtual StatisticsVector get_statistics() const APPLESEED_OVERRIDE
         {
             return m_pixel_renderer->get_statistics();
@@ -39,8 +39,12 @@
 #include "foundation/image/canvasproperties.h"
 #include "foundation/image/image.h"
 #include "foundation/image/tile.h"
+#include "foundation/math/vector.h"
+#include "foundation/platform/timers.h"
+#include "foundation/utility/stopwatch.h"
 
 // Standard headers.
+#include <algorithm>
 #include <cassert>
 #include <exception>
 
@@ -61,6 +65,8 @@ TileJob::TileJob(
     const size_t                tile_x,
     const size_t                tile_y,
     const size_t                pass_hash,
+    JobQueue*                   job_queue,
+    ThreadStatisticsVector&     thread_stats,
     IAbortSwitch&               abort_switch)
   : m_tile_renderers(tile_renderers)
   , m_tile_callbacks(tile_callbacks)
@@ -68,19 +74,61 @@ TileJob::TileJob(
   , m_tile_x(tile_x)
   , m_tile_y(tile_y)
   , m_pass_hash(pass_hash)
+  , m_job_queue(job_queue)
+  , m_thread_stats(thread_stats)
   , m_abort_switch(abort_switch)
+  , m_split(0)
 {
     // Either there is no tile callback, or there is the same number
     // of tile callbacks and rendering threads.
     assert(
            m_tile_callbacks.size() == 0
         || m_tile_callbacks.size() == tile_renderers.size());
+
+    // There are as many thread statistics as rendering threads.
+    assert(m_thread_stats.size() == tile_renderers.size());
+
+    // Render the whole tile by default.
+    const Tile& tile = frame.image().tile(tile_x, tile_y);
+    m_region.min = Vector2u(0, 0);
+    m_region.max = Vector2u(tile.get_width() - 1, tile.get_height() - 1);
+}
+
+TileJob::TileJob(
+    const TileJob&              parent,
+    const AABB2u&               region,
+    TileSplit*                  split)
+  : m_tile_renderers(parent.m_tile_renderers)
+  , m_tile_callbacks(parent.m_tile_callbacks)
+  , m_frame(parent.m_frame)
+  , m_tile_x(parent.m_tile_x)
+  , m_tile_y(parent.m_tile_y)
+  , m_pass_hash(parent.m_pass_hash)
+  , m_job_queue(parent.m_job_queue)
+  , m_thread_stats(parent.m_thread_stats)
+  , m_abort_switch(parent.m_abort_switch)
+  , m_region(region)
+  , m_split(split)
+{
+}
+
+TileJob::~TileJob()
+{
+    if (m_split && --m_split->m_job_count == 0)
+        delete m_split;
 }
 
 void TileJob::execute(const size_t thread_index)
 {
     assert(thread_index < m_tile_renderers.size());
 
+    Stopwatch<DefaultWallclockTimer> stopwatch(0);
+    stopwatch.start();
+
+    // Split the tile into bands if this is one of the last tiles of the pass.
+    if (m_job_queue && m_split == 0)
+        split_tile(thread_index);
+
     // Retrieve the tile callback.
     ITileCallback* tile_callback =
         m_tile_callbacks.size() == m_tile_renderers.size()
@@ -90,15 +138,11 @@ void TileJob::execute(const size_t thread_index)
     // Call the pre-render tile callback.
     if (tile_callback)
     {
-        const Image& frame_image = m_frame.image();
-
-        const CanvasProperties& frame_props = frame_image.properties();
-        const size_t x = m_tile_x * frame_props.m_tile_width;
-        const size_t y = m_tile_y * frame_props.m_tile_height;
-
-        const Tile& tile = frame_image.tile(m_tile_x, m_tile_y);
-        const size_t width = tile.get_width();
-        const size_t height = tile.get_height();
+        const CanvasProperties& frame_props = m_frame.image().properties();
+        const size_t x = m_tile_x * frame_props.m_tile_width + m_region.min.x;
+        const size_t y = m_tile_y * frame_props.m_tile_height + m_region.min.y;
+        const size_t width = m_region.max.x - m_region.min.x + 1;
+        const size_t height = m_region.max.y - m_region.min.y + 1;
 
         tile_callback->pre_render(x, y, width, height);
     }
@@ -110,22 +154,68 @@ void TileJob::execute(const size_t thread_index)
             m_frame,
             m_tile_x,
             m_tile_y,
+            m_region,
             m_pass_hash,
             m_abort_switch);
     }
     catch (const exception&)
     {
         // Call the post-render tile callback.
-        if (tile_callback)
+        if (is_last_region() && tile_callback)
             tile_callback->post_render_tile(&m_frame, m_tile_x, m_tile_y);
 
         // Rethrow the exception.
         throw;
     }
 
-    // Call the post-render tile callback.
-    if (tile_callback)
+    // Call the post-render tile callback once the whole tile is rendered.
+    if (is_last_region() && tile_callback)
         tile_callback->post_render_tile(&m_frame, m_tile_x, m_tile_y);
+
+    stopwatch.measure();
+    m_thread_stats[thread_index].m_busy_time += stopwatch.get_seconds();
+}
+
+void TileJob::split_tile(const size_t thread_index)
+{
+    if (m_abort_switch.is_aborted())
+        return;
+
+    // Only split tiles when fewer tiles than threads remain to be rendered.
+    const size_t thread_count = m_tile_renderers.size();
+    const size_t remaining_tile_count = m_job_queue->get_scheduled_job_count() + 1;
+    if (remaining_tile_count >= thread_count)
+        return;
+
+    // Share the threads among the remaining tiles, but keep bands tall enough
+    // for the effort wasted in tile margins to remain reasonable.
+    const size_t MinBandHeight = 8;
+    const size_t height = m_region.max.y - m_region.min.y + 1;
+    const size_t band_count = min(thread_count / remaining_tile_count, height / MinBandHeight);
+    if (band_count < 2)
+        return;
+
+    m_split = new TileSplit();
+    m_split->m_job_count = band_count;
+    m_split->m_pending_band_count = band_count;
+
+    // Schedule one job per band, except for the first band which is rendered by this job.
+    for (size_t i = 1; i < band_count; ++i)
+    {
+        AABB2u band = m_region;
+        band.min.y = m_region.min.y + i * height / band_count;
+        band.max.y = m_region.min.y + (i + 1) * height / band_count - 1;
+        m_job_queue->schedule(new TileJob(*this, band, m_split));
+    }
+
+    m_region.max.y = m_region.min.y + height / band_count - 1;
+
+    ++m_thread_stats[thread_index].m_split_tile_count;
+}
+
+bool TileJob::is_last_region()
+{
+    return m_split == 0 || --m_split->m_pending_band_count == 0;
 }
 
 }   // namespace renderer
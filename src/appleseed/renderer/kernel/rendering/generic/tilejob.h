@@ -31,6 +31,8 @@
 #define APPLESEED_RENDERER_KERNEL_RENDERING_GENERIC_TILEJOB_H
 
 // appleseed.foundation headers.
+#include "foundation/math/aabb.h"
+#include "foundation/platform/atomic.h"
 #include "foundation/utility/job.h"
 
 // Standard headers.
@@ -48,6 +50,11 @@ namespace renderer
 //
 // Tile rendering job.
 //
+// When a job queue is provided, a tile job that starts while fewer tiles than
+// rendering threads remain to be rendered splits its tile into horizontal bands
+// and schedules one job per band, so that threads that would otherwise stay idle
+// at the end of the pass can help finishing the last tiles.
+//
 
 class TileJob
   : public foundation::IJob
@@ -56,6 +63,21 @@ class TileJob
     typedef std::vector<ITileRenderer*> TileRendererVector;
     typedef std::vector<ITileCallback*> TileCallbackVector;
 
+    // Per-thread statistics. Each rendering thread only updates its own entry.
+    struct ThreadStatistics
+    {
+        double                      m_busy_time;            // time spent executing tile jobs, in seconds
+        size_t                      m_split_tile_count;     // number of tiles split into multiple jobs
+
+        ThreadStatistics()
+          : m_busy_time(0.0)
+          , m_split_tile_count(0)
+        {
+        }
+    };
+
+    typedef std::vector<ThreadStatistics> ThreadStatisticsVector;
+
     // Constructor.
     TileJob(
         const TileRendererVector&   tile_renderers,
@@ -64,19 +86,48 @@ class TileJob
         const size_t                tile_x,
         const size_t                tile_y,
         const size_t                pass_hash,
+        foundation::JobQueue*       job_queue,              // optional, enables tile splitting
+        ThreadStatisticsVector&     thread_stats,
         foundation::IAbortSwitch&   abort_switch);
 
+    // Destructor.
+    ~TileJob();
+
     // Execute the job.
     virtual void execute(const size_t thread_index);
 
   private:
+    // State shared by the jobs rendering the bands of a split tile.
+    struct TileSplit
+    {
+        boost::atomic<size_t>       m_job_count;            // number of band jobs not yet destroyed
+        boost::atomic<size_t>       m_pending_band_count;   // number of bands not yet rendered
+    };
+
     const TileRendererVector&       m_tile_renderers;
     const TileCallbackVector&       m_tile_callbacks;
     const Frame&                    m_frame;
     const size_t                    m_tile_x;
     const size_t                    m_tile_y;
     const size_t                    m_pass_hash;
+    foundation::JobQueue*           m_job_queue;
+    ThreadStatisticsVector&         m_thread_stats;
     foundation::IAbortSwitch&       m_abort_switch;
+    foundation::AABB2u              m_region;
+    TileSplit*                      m_split;
+
+    // Constructor for band jobs.
+    TileJob(
+        const TileJob&              parent,
+        const foundation::AABB2u&   region,
+        TileSplit*                  split);
+
+    // Split the tile into bands if the end of the pass is near.
+    void split_tile(const size_t thread_index);
+
+    // Signal that the region of this job was rendered, and return whether it was
+    // the last region of the tile left to render.
+    bool is_last_region();
 };
 
 }       // namespace renderer
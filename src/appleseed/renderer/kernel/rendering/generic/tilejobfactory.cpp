@@ -40,6 +40,7 @@
 #include "foundation/utility/otherwise.h"
 
 // Standard headers.
+#include <algorithm>
 #include <cassert>
 
 using namespace foundation;
@@ -48,16 +49,43 @@ using namespace std;
 namespace renderer
 {
 
+namespace
+{
+    // Order tiles by decreasing cost.
+    struct TileCostOrder
+    {
+        const vector<double>& m_tile_costs;
+
+        explicit TileCostOrder(const vector<double>& tile_costs)
+          : m_tile_costs(tile_costs)
+        {
+        }
+
+        bool operator()(const size_t lhs, const size_t rhs) const
+        {
+            return m_tile_costs[lhs] > m_tile_costs[rhs];
+        }
+    };
+}
+
+
 //
 // TileJobFactory class implementation.
 //
 
+void TileJobFactory::set_tile_costs(const vector<double>& tile_costs)
+{
+    m_tile_costs = tile_costs;
+}
+
 void TileJobFactory::create(
     const Frame&                        frame,
     const TileOrdering                  tile_ordering,
     const TileJob::TileRendererVector&  tile_renderers,
     const TileJob::TileCallbackVector&  tile_callbacks,
     const size_t                        pass_hash,
+    JobQueue*                           job_queue,
+    TileJob::ThreadStatisticsVector&    thread_stats,
     TileJobVector&                      tile_jobs,
     IAbortSwitch&                       abort_switch)
 {
@@ -90,6 +118,8 @@ void TileJobFactory::create(
                 tile_x,
                 tile_y,
                 pass_hash,
+                job_queue,
+                thread_stats,
                 abort_switch));
     }
 }
@@ -128,6 +158,17 @@ void TileJobFactory::generate_tile_ordering(
             m_rng);
         break;
 
+      case CostOrdering:
+        // Schedule the most expensive tiles first so that the longest jobs don't end
+        // up in the tail of the frame. Ties are broken by the spiral ordering.
+        spiral_ordering(
+            tiles,
+            frame_properties.m_tile_count_x,
+            frame_properties.m_tile_count_y);
+        if (m_tile_costs.size() == frame_properties.m_tile_count)
+            stable_sort(tiles.begin(), tiles.end(), TileCostOrder(m_tile_costs));
+        break;
+
       assert_otherwise;
     }
 }
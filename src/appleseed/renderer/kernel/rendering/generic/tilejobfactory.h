@@ -43,6 +43,7 @@
 // Forward declarations.
 namespace foundation    { class CanvasProperties; }
 namespace foundation    { class IAbortSwitch; }
+namespace foundation    { class JobQueue; }
 namespace renderer      { class Frame; }
 namespace renderer      { class TileJob; }
 
@@ -64,9 +65,13 @@ class TileJobFactory
         LinearOrdering,
         SpiralOrdering,
         HilbertOrdering,
-        RandomOrdering
+        RandomOrdering,
+        CostOrdering            // most expensive tiles first, requires tile costs
     };
 
+    // Set the estimated rendering cost of each tile, indexed by tile_y * tile_count_x + tile_x.
+    void set_tile_costs(const std::vector<double>& tile_costs);
+
     // Create tile jobs for a given frame.
     void create(
         const Frame&                        frame,
@@ -74,11 +79,14 @@ class TileJobFactory
         const TileJob::TileRendererVector&  tile_renderers,
         const TileJob::TileCallbackVector&  tile_callbacks,
         const size_t                        pass_hash,
+        foundation::JobQueue*               job_queue,          // optional, enables tile splitting
+        TileJob::ThreadStatisticsVector&    thread_stats,
         TileJobVector&                      tile_jobs,
         foundation::IAbortSwitch&           abort_switch);
 
   private:
     foundation::MersenneTwister             m_rng;
+    std::vector<double>                     m_tile_costs;
 
     void generate_tile_ordering(
         const foundation::CanvasProperties& frame_properties,
@@ -40,10 +40,12 @@
 #include "foundation/image/image.h"
 #include "foundation/image/pixel.h"
 #include "foundation/image/tile.h"
+#include "foundation/math/scalar.h"
 #include "foundation/utility/job/iabortswitch.h"
 
-// Boost headers.
-#include "boost/chrono/duration.hpp"
+// Standard headers.
+#include <algorithm>
+#include <cassert>
 
 using namespace foundation;
 using namespace std;
@@ -51,23 +53,53 @@ using namespace std;
 namespace renderer
 {
 
-GlobalSampleAccumulationBuffer::GlobalSampleAccumulationBuffer(
+namespace
+{
+    // Height in pixels of the stripes.
+    const size_t StripeHeight = 16;
+}
+
+GlobalSampleAccumulationBuffer::Stripe::Stripe(
     const size_t    width,
     const size_t    height,
     const Filter2f& filter)
   : m_fb(width, height, 3, filter)
+{
+    m_fb.clear();
+}
+
+GlobalSampleAccumulationBuffer::GlobalSampleAccumulationBuffer(
+    const size_t    width,
+    const size_t    height,
+    const Filter2f& filter)
+  : m_width(width)
+  , m_height(height)
+  , m_filter(filter)
   , m_filter_rcp_norm_factor(1.0f / compute_normalization_factor(filter))
+  , m_first_stripe(0)
 {
+    for (size_t y = 0; y < height; y += StripeHeight)
+        m_stripes.push_back(new Stripe(width, min(StripeHeight, height - y), filter));
+
+    m_sample_count = 0;
 }
 
-void GlobalSampleAccumulationBuffer::clear()
+GlobalSampleAccumulationBuffer::~GlobalSampleAccumulationBuffer()
 {
-    // Request exclusive access.
-    boost::unique_lock<boost::shared_mutex> lock(m_mutex);
+    for (size_t i = 0, e = m_stripes.size(); i < e; ++i)
+        delete m_stripes[i];
+}
 
+void GlobalSampleAccumulationBuffer::clear()
+{
     m_sample_count = 0;
 
-    m_fb.clear();
+    for (size_t i = 0, e = m_stripes.size(); i < e; ++i)
+    {
+        Stripe& stripe = *m_stripes[i];
+        boost::mutex::scoped_lock lock(stripe.m_mutex);
+        stripe.m_fb.clear();
+    }
 }
 
 void GlobalSampleAccumulationBuffer::store_samples(
@@ -75,33 +107,82 @@ void GlobalSampleAccumulationBuffer::store_samples(
     const Sample    samples[],
     IAbortSwitch&   abort_switch)
 {
-    // Request non-exclusive access.
-    boost::shared_lock<boost::shared_mutex> lock(m_mutex, boost::defer_lock);
-    while (true)
+    const size_t stripe_count = m_stripes.size();
+    const float fh = static_cast<float>(m_height);
+    const float yradius = m_filter.get_yradius();
+    const int max_y = static_cast<int>(m_height) - 1;
+
+    // Bin the samples by stripe. Samples whose filter footprint
+    // straddles several stripes are stored into each of them.
+    vector<size_t> offsets(stripe_count + 1, 0);
+    vector<uint32> first_stripes(sample_count);
+    vector<uint32> last_stripes(sample_count);
+
+    for (size_t i = 0; i < sample_count; ++i)
     {
-        if (abort_switch.is_aborted())
-            return;
-        if (lock.try_lock_for(boost::chrono::milliseconds(5)))
-            break;
+        const float dy = samples[i].m_position.y * fh - 0.5f;
+        const int min_row = max(truncate<int>(fast_ceil(dy - yradius)), 0);
+        const int max_row = min(truncate<int>(fast_floor(dy + yradius)), max_y);
+
+        // Skip samples that don't affect any pixel.
+        if (min_row > max_row)
+        {
+            first_stripes[i] = 1;
+            last_stripes[i] = 0;
+            continue;
+        }
+
+        first_stripes[i] = static_cast<uint32>(min_row / StripeHeight);
+        last_stripes[i] = static_cast<uint32>(max_row / StripeHeight);
+
+        for (uint32 s = first_stripes[i]; s <= last_stripes[i]; ++s)
+            ++offsets[s + 1];
     }
 
-    const float fw = static_cast<float>(m_fb.get_width());
-    const float fh = static_cast<float>(m_fb.get_height());
-    size_t counter = 0;
+    for (size_t s = 1; s <= stripe_count; ++s)
+        offsets[s] += offsets[s - 1];
 
-    const Sample* sample_end = samples + sample_count;
-    for (const Sample* s = samples; s < sample_end; ++s)
+    vector<uint32> indices(max<size_t>(offsets[stripe_count], 1));
+    vector<size_t> cursors(offsets.begin(), offsets.end() - 1);
+
+    for (size_t i = 0; i < sample_count; ++i)
+    {
+        for (uint32 s = first_stripes[i]; s <= last_stripes[i]; ++s)
+            indices[cursors[s]++] = static_cast<uint32>(i);
+    }
+
+    // Successive calls start with different stripes to spread threads over the buffer.
+    // Stripes that are busy are skipped and updated once all other stripes are done.
+    const size_t first_stripe = m_first_stripe++ % stripe_count;
+    vector<size_t> busy_stripes;
+
+    for (size_t i = 0; i < stripe_count; ++i)
     {
-        if ((counter++ & 4096) == 0 && abort_switch.is_aborted())
+        const size_t s = (first_stripe + i) % stripe_count;
+
+        if (offsets[s] == offsets[s + 1])
+            continue;
+
+        boost::mutex::scoped_lock lock(m_stripes[s]->m_mutex, boost::try_to_lock);
+
+        if (!lock.owns_lock())
+        {
+            busy_stripes.push_back(s);
+            continue;
+        }
+
+        if (!store_samples_in_stripe(s, samples, &indices[offsets[s]], offsets[s + 1] - offsets[s], abort_switch))
             return;
+    }
 
-        const float fx = s->m_position.x * fw;
-        const float fy = s->m_position.y * fh;
+    for (size_t i = 0, e = busy_stripes.size(); i < e; ++i)
+    {
+        const size_t s = busy_stripes[i];
 
-        Color3f value(s->m_color.rgb());
-        value *= m_filter_rcp_norm_factor;
+        boost::mutex::scoped_lock lock(m_stripes[s]->m_mutex);
 
-        m_fb.add(fx, fy, &value[0]);
+        if (!store_samples_in_stripe(s, samples, &indices[offsets[s]], offsets[s + 1] - offsets[s], abort_switch))
+            return;
     }
 }
 
@@ -109,68 +190,89 @@ void GlobalSampleAccumulationBuffer::develop_to_frame(
     Frame&          frame,
     IAbortSwitch&   abort_switch)
 {
-    // Request exclusive access.
-    boost::unique_lock<boost::shared_mutex> lock(m_mutex, boost::defer_lock);
-    while (true)
+    assert(frame.image().properties().m_canvas_width == m_width);
+    assert(frame.image().properties().m_canvas_height == m_height);
+    assert(frame.image().properties().m_channel_count == 4);
+
+    const float scale = 1.0f / m_sample_count;
+
+    for (size_t i = 0, e = m_stripes.size(); i < e; ++i)
     {
         if (abort_switch.is_aborted())
             return;
-        if (lock.try_lock_for(boost::chrono::milliseconds(5)))
-            break;
+
+        boost::mutex::scoped_lock lock(m_stripes[i]->m_mutex);
+
+        develop_stripe(frame, i, scale);
     }
+}
 
-    Image& image = frame.image();
-    const CanvasProperties& frame_props = image.properties();
+void GlobalSampleAccumulationBuffer::increment_sample_count(const uint64 delta_sample_count)
+{
+    m_sample_count += delta_sample_count;
+}
 
-    assert(frame_props.m_canvas_width == m_fb.get_width());
-    assert(frame_props.m_canvas_height == m_fb.get_height());
-    assert(frame_props.m_channel_count == 4);
+bool GlobalSampleAccumulationBuffer::store_samples_in_stripe(
+    const size_t    stripe_index,
+    const Sample    samples[],
+    const uint32    indices[],
+    const size_t    index_count,
+    IAbortSwitch&   abort_switch)
+{
+    FilteredTile& fb = m_stripes[stripe_index]->m_fb;
 
-    const float scale = 1.0f / m_sample_count;
+    const float fw = static_cast<float>(m_width);
+    const float fh = static_cast<float>(m_height);
+    const float origin_y = static_cast<float>(stripe_index * StripeHeight);
 
-    for (size_t ty = 0; ty < frame_props.m_tile_count_y; ++ty)
+    for (size_t i = 0; i < index_count; ++i)
     {
-        for (size_t tx = 0; tx < frame_props.m_tile_count_x; ++tx)
-        {
-            if (abort_switch.is_aborted())
-                return;
+        if ((i & 4095) == 0 && abort_switch.is_aborted())
+            return false;
 
-            Tile& tile = image.tile(tx, ty);
+        const Sample& sample = samples[indices[i]];
 
-            const size_t x = tx * frame_props.m_tile_width;
-            const size_t y = ty * frame_props.m_tile_height;
+        const float fx = sample.m_position.x * fw;
+        const float fy = sample.m_position.y * fh - origin_y;
 
-            develop_to_tile(tile, x, y, tx, ty, scale);
-        }
+        Color3f value(sample.m_color.rgb());
+        value *= m_filter_rcp_norm_factor;
+
+        fb.add_exclusive(fx, fy, &value[0]);
     }
-}
 
-void GlobalSampleAccumulationBuffer::increment_sample_count(const uint64 delta_sample_count)
-{
-    m_sample_count += delta_sample_count;
+    return true;
 }
 
-void GlobalSampleAccumulationBuffer::develop_to_tile(
-    Tile&           tile,
-    const size_t    origin_x,
-    const size_t    origin_y,
-    const size_t    tile_x,
-    const size_t    tile_y,
+void GlobalSampleAccumulationBuffer::develop_stripe(
+    Frame&          frame,
+    const size_t    stripe_index,
     const float     scale) const
 {
-    const size_t tile_width = tile.get_width();
-    const size_t tile_height = tile.get_height();
+    Image& image = frame.image();
+    const CanvasProperties& frame_props = image.properties();
+    const FilteredTile& fb = m_stripes[stripe_index]->m_fb;
+    const size_t origin_y = stripe_index * StripeHeight;
 
-    for (size_t y = 0; y < tile_height; ++y)
+    for (size_t y = 0, h = fb.get_height(); y < h; ++y)
     {
-        for (size_t x = 0; x < tile_width; ++x)
+        const size_t ty = (origin_y + y) / frame_props.m_tile_height;
+        const size_t py = origin_y + y - ty * frame_props.m_tile_height;
+
+        for (size_t tx = 0; tx < frame_props.m_tile_count_x; ++tx)
         {
-            const float* ptr = m_fb.pixel(origin_x + x, origin_y + y);
+            Tile& tile = image.tile(tx, ty);
+            const size_t origin_x = tx * frame_props.m_tile_width;
+
+            for (size_t x = 0, w = tile.get_width(); x < w; ++x)
+            {
+                const float* ptr = fb.pixel(origin_x + x, y);
 
-            Color4f color(ptr[1], ptr[2], ptr[3], 1.0f);
-            color.rgb() *= scale;
+                Color4f color(ptr[1], ptr[2], ptr[3], 1.0f);
+                color.rgb() *= scale;
 
-            tile.set_pixel(x, y, color);
+                tile.set_pixel(x, py, color);
+            }
         }
     }
 }
@@ -36,22 +36,33 @@
 // appleseed.foundation headers.
 #include "foundation/image/filteredtile.h"
 #include "foundation/math/filter.h"
+#include "foundation/platform/atomic.h"
 #include "foundation/platform/compiler.h"
 #include "foundation/platform/thread.h"
 #include "foundation/platform/types.h"
 
 // Standard headers.
 #include <cstddef>
+#include <vector>
 
 // Forward declarations.
 namespace foundation    { class IAbortSwitch; }
-namespace foundation    { class Tile; }
 namespace renderer      { class Frame; }
 namespace renderer      { class Sample; }
 
 namespace renderer
 {
 
+//
+// A sample accumulation buffer covering the whole frame, for samples that may land
+// anywhere in the frame (e.g. light tracing samples).
+//
+// The buffer is divided into horizontal stripes, each protected by its own mutex.
+// Samples are binned by stripe and each stripe is updated without atomic operations,
+// such that threads storing samples only contend when they update the same stripe.
+// Developing the buffer locks one stripe at a time.
+//
+
 class GlobalSampleAccumulationBuffer
   : public SampleAccumulationBuffer
 {
@@ -62,6 +73,9 @@ class GlobalSampleAccumulationBuffer
         const size_t                height,
         const foundation::Filter2f& filter);
 
+    // Destructor.
+    ~GlobalSampleAccumulationBuffer();
+
     // Reset the buffer to its initial state. Thread-safe.
     virtual void clear() APPLESEED_OVERRIDE;
 
@@ -80,16 +94,36 @@ class GlobalSampleAccumulationBuffer
     void increment_sample_count(const foundation::uint64 delta_sample_count);
 
   private:
-    boost::shared_mutex             m_mutex;
-    foundation::FilteredTile        m_fb;
+    struct Stripe
+    {
+        boost::mutex                m_mutex;
+        foundation::FilteredTile    m_fb;
+
+        Stripe(
+            const size_t                width,
+            const size_t                height,
+            const foundation::Filter2f& filter);
+    };
+
+    const size_t                    m_width;
+    const size_t                    m_height;
+    const foundation::Filter2f&     m_filter;
     const float                     m_filter_rcp_norm_factor;
+    std::vector<Stripe*>            m_stripes;
+    boost::atomic<size_t>           m_first_stripe;
+
+    // Store the samples binned to a given stripe. The stripe must be locked.
+    bool store_samples_in_stripe(
+        const size_t                stripe_index,
+        const Sample                samples[],
+        const foundation::uint32    indices[],
+        const size_t                index_count,
+        foundation::IAbortSwitch&   abort_switch);
 
-    void develop_to_tile(
-        foundation::Tile&           tile,
-        const size_t                origin_x,
-        const size_t                origin_y,
-        const size_t                tile_x,
-        const size_t                tile_y,
+    // Develop a given stripe to a frame. The stripe must be locked.
+    void develop_stripe(
+        Frame&                      frame,
+        const size_t                stripe_index,
         const float                 scale) const;
 };
 
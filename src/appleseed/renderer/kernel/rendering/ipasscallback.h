@@ -60,8 +60,9 @@ class APPLESEED_DLLSYMBOL IPassCallback
         foundation::JobQueue&       job_queue,
         foundation::IAbortSwitch&   abort_switch) = 0;
 
-    // This method is called at the end of a pass.
-    virtual void post_render(
+    // This method is called at the end of a pass. Return false to stop rendering
+    // after this pass, even if more passes were requested.
+    virtual bool post_render(
         const Frame&                frame,
         foundation::JobQueue&       job_queue,
         foundation::IAbortSwitch&   abort_switch) = 0;
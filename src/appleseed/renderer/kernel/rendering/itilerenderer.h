@@ -32,6 +32,7 @@
 
 // appleseed.foundation headers.
 #include "foundation/core/concepts/iunknown.h"
+#include "foundation/math/aabb.h"
 
 // Standard headers.
 #include <cstddef>
@@ -52,14 +53,25 @@ class ITileRenderer
   : public foundation::IUnknown
 {
   public:
-    // Render a tile.
+    // Render a region of a tile. The region is expressed in tile space and may be
+    // smaller than the tile when the tile was split into multiple jobs, in which
+    // case different regions of the same tile may be rendered concurrently.
     virtual void render_tile(
         const Frame&                frame,
         const size_t                tile_x,
         const size_t                tile_y,
+        const foundation::AABB2u&   region,
         const size_t                pass_hash,
         foundation::IAbortSwitch&   abort_switch) = 0;
 
+    // Estimate the cost of rendering a tile by rendering a sparse subset of its pixels.
+    // The frame is left untouched. Return a value proportional to the rendering cost.
+    virtual double estimate_tile_cost(
+        const Frame&                frame,
+        const size_t                tile_x,
+        const size_t                tile_y,
+        foundation::IAbortSwitch&   abort_switch) = 0;
+
     // Retrieve performance statistics.
     virtual foundation::StatisticsVector get_statistics() const = 0;
 };
@@ -32,6 +32,7 @@
 
 // appleseed.renderer headers.
 #include "renderer/global/globallogger.h"
+#include "renderer/kernel/intersection/tracecontext.h"
 #include "renderer/kernel/rendering/iframerenderer.h"
 #include "renderer/kernel/rendering/renderercomponents.h"
 #include "renderer/kernel/rendering/serialrenderercontroller.h"
@@ -265,6 +266,9 @@ IRendererController::Status MasterRenderer::initialize_and_render_frame_sequence
     // Print texture store performance statistics.
     RENDERER_LOG_DEBUG("%s", texture_store.get_statistics().to_string().c_str());
 
+    // Print trace context statistics.
+    RENDERER_LOG_DEBUG("%s", m_project.get_trace_context().get_statistics().to_string().c_str());
+
     return status;
 }
 
@@ -272,6 +276,8 @@ IRendererController::Status MasterRenderer::render_frame_sequence(
     RendererComponents&     components,
     IAbortSwitch&           abort_switch)
 {
+    bool restarted = false;
+
     while (true)
     {
         IFrameRenderer& frame_renderer = components.get_frame_renderer();
@@ -282,6 +288,11 @@ IRendererController::Status MasterRenderer::render_frame_sequence(
         // of the scene which assumes the scene is up-to-date and ready to be rendered.
         m_renderer_controller->on_frame_begin();
 
+        // Pick up assembly instances moved since the last frame; the assembly tree is
+        // refitted when possible and left untouched when no assembly instance changed.
+        if (restarted)
+            m_project.update_trace_context();
+
         // Perform pre-frame rendering actions. Don't proceed if that failed.
         OnFrameBeginRecorder recorder;
         if (!components.get_shading_engine().on_frame_begin(m_project, recorder, &abort_switch) ||
@@ -333,6 +344,7 @@ IRendererController::Status MasterRenderer::render_frame_sequence(
             return status;
 
           case IRendererController::RestartRendering:
+            restarted = true;
             break;
 
           assert_otherwise;
@@ -74,6 +74,9 @@ ShadingResultFrameBuffer* PermanentShadingResultFrameBufferFactory::create(
     const size_t tile_count_x = frame.image().properties().m_tile_count_x;
     const size_t index = tile_y * tile_count_x + tile_x;
 
+    // Different regions of a tile may be rendered concurrently.
+    boost::mutex::scoped_lock lock(m_mutex);
+
     if (m_framebuffers[index] == 0)
     {
         const Tile& tile = frame.image().tile(tile_x, tile_y);
@@ -36,6 +36,7 @@
 // appleseed.foundation headers.
 #include "foundation/math/aabb.h"
 #include "foundation/platform/compiler.h"
+#include "foundation/platform/thread.h"
 
 // Standard headers.
 #include <cstddef>
@@ -72,7 +73,8 @@ class PermanentShadingResultFrameBufferFactory
         ShadingResultFrameBuffer*   framebuffer) APPLESEED_OVERRIDE;
 
   private:
-    std::vector<ShadingResultFrameBuffer*> m_framebuffers;
+    boost::mutex                            m_mutex;
+    std::vector<ShadingResultFrameBuffer*>  m_framebuffers;
 };
 
 }       // namespace renderer
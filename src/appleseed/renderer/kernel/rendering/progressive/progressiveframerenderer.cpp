@@ -119,7 +119,7 @@ namespace
                     global_logger(),
                     m_job_queue,
                     m_params.m_thread_count,
-                    JobManager::KeepRunningOnEmptyQueue));
+                    JobManager::KeepRunningOnEmptyQueue | JobManager::WorkStealing));
 
             // Instantiate sample generators, one per rendering thread.
             m_sample_generators.reserve(m_params.m_thread_count);
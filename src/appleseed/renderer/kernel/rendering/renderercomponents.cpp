@@ -43,6 +43,7 @@
 #include "renderer/kernel/rendering/debug/debugtilerenderer.h"
 #include "renderer/kernel/rendering/ephemeralshadingresultframebufferfactory.h"
 #include "renderer/kernel/rendering/final/adaptivepixelrenderer.h"
+#include "renderer/kernel/rendering/final/adaptivesamplingbudget.h"
 #include "renderer/kernel/rendering/final/uniformpixelrenderer.h"
 #include "renderer/kernel/rendering/generic/genericframerenderer.h"
 #include "renderer/kernel/rendering/generic/genericsamplegenerator.h"
@@ -54,6 +55,7 @@
 #include "renderer/utility/paramarray.h"
 
 // Standard headers.
+#include <limits>
 #include <string>
 
 using namespace std;
@@ -105,6 +107,7 @@ RendererComponents::RendererComponents(
   , m_texture_store(texture_store)
   , m_texture_system(texture_system)
   , m_shading_system(shading_system)
+  , m_adaptive_sampling_budget(0)
 {
 }
 
@@ -312,11 +315,35 @@ bool RendererComponents::create_pixel_renderer_factory()
             return false;
         }
 
+        ParamArray params = get_child_and_inherit_globals(m_params, "adaptive_pixel_renderer");
+        const string estimator = params.get_optional<string>("estimator", "variation");
+
+        if (estimator == "variance")
+        {
+            if (m_pass_callback.get())
+            {
+                RENDERER_LOG_ERROR("cannot use the variance estimator of the adaptive pixel renderer with this lighting engine.");
+                return false;
+            }
+
+            copy_param(params, m_params, "passes");
+            m_adaptive_sampling_budget = new AdaptiveSamplingBudget(m_frame, params);
+            m_pass_callback.reset(m_adaptive_sampling_budget);
+        }
+        else if (estimator != "variation")
+        {
+            RENDERER_LOG_ERROR(
+                "invalid value for \"estimator\" parameter: \"%s\".",
+                estimator.c_str());
+            return false;
+        }
+
         m_pixel_renderer_factory.reset(
             new AdaptivePixelRendererFactory(
                 m_frame,
                 m_sample_renderer_factory.get(),
-                get_child_and_inherit_globals(m_params, "adaptive_pixel_renderer")));
+                m_adaptive_sampling_budget,
+                params));
         return true;
     }
     else
@@ -330,7 +357,15 @@ bool RendererComponents::create_pixel_renderer_factory()
 
 bool RendererComponents::create_shading_result_framebuffer_factory()
 {
-    const string name = m_params.get_optional<string>("shading_result_framebuffer", "ephemeral");
+    // A sampling budget spreads the samples of a pixel over multiple passes,
+    // so they must be accumulated in a framebuffer that persists across passes.
+    const string name =
+        m_params.get_optional<string>(
+            "shading_result_framebuffer",
+            m_adaptive_sampling_budget ? "permanent" : "ephemeral");
+
+    if (m_adaptive_sampling_budget && name == "ephemeral")
+        RENDERER_LOG_WARNING("the adaptive sampling budget requires a permanent shading result framebuffer.");
 
     if (name.empty())
     {
@@ -422,13 +457,20 @@ bool RendererComponents::create_frame_renderer_factory()
             return false;
         }
 
+        ParamArray params = get_child_and_inherit_globals(m_params, "generic_frame_renderer");
+
+        // The adaptive sampling budget decides when to stop rendering: unless explicitly
+        // bounded, render as many passes as the budget needs.
+        if (m_adaptive_sampling_budget && !params.strings().exist("passes"))
+            params.insert("passes", numeric_limits<size_t>::max());
+
         m_frame_renderer.reset(
             GenericFrameRendererFactory::create(
                 m_frame,
                 m_tile_renderer_factory.get(),
                 m_tile_callback_factory,
                 m_pass_callback.get(),
-                get_child_and_inherit_globals(m_params, "generic_frame_renderer")));
+                params));
         return true;
     }
     else if (name == "progressive")
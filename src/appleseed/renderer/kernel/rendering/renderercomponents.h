@@ -60,6 +60,7 @@ END_OSL_INCLUDES
 #include <memory>
 
 // Forward declarations.
+namespace renderer  { class AdaptiveSamplingBudget; }
 namespace renderer  { class Frame; }
 namespace renderer  { class IFrameRenderer; }
 namespace renderer  { class ITileCallbackFactory; }
@@ -114,6 +115,7 @@ class RendererComponents
     std::auto_ptr<IShadingResultFrameBufferFactory>     m_shading_result_framebuffer_factory;
     std::auto_ptr<ITileRendererFactory>                 m_tile_renderer_factory;
     std::auto_ptr<IPassCallback>                        m_pass_callback;
+    AdaptiveSamplingBudget*                             m_adaptive_sampling_budget;
     foundation::auto_release_ptr<IFrameRenderer>        m_frame_renderer;
 
     bool create_lighting_engine_factory();
@@ -78,13 +78,16 @@ class ShadingResultFrameBuffer
         const size_t                    source_y,
         const float                     scaling);
 
+    // Develop the pixels of a given region (in tile space) to a tile.
     void develop_to_tile_premult_alpha(
         foundation::Tile&               tile,
-        TileStack&                      aov_tiles) const;
+        TileStack&                      aov_tiles,
+        const foundation::AABB2u&       region) const;
 
     void develop_to_tile_straight_alpha(
         foundation::Tile&               tile,
-        TileStack&                      aov_tiles) const;
+        TileStack&                      aov_tiles,
+        const foundation::AABB2u&       region) const;
 
   private:
     const size_t                        m_aov_count;
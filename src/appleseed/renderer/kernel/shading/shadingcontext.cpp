@@ -35,6 +35,11 @@
 #include "renderer/kernel/shading/closures.h"
 #include "renderer/modeling/shadergroup/shadergroup.h"
 
+// appleseed.foundation headers.
+#include "foundation/math/population.h"
+#include "foundation/platform/types.h"
+#include "foundation/utility/arena.h"
+
 using namespace foundation;
 
 namespace renderer
@@ -165,4 +170,21 @@ void ShadingContext::choose_bsdf_closure_shading_basis(
     m_shadergroup_exec.choose_bsdf_closure_shading_basis(shading_point, s);
 }
 
+StatisticsVector ShadingContext::get_statistics() const
+{
+    // Populations so that merging the statistics of all rendering threads
+    // reports the smallest, average and largest footprint of their arenas.
+    Population<uint64> arena_high_water_mark;
+    arena_high_water_mark.insert(m_arena.get_high_water_mark());
+
+    Population<uint64> arena_chunk_count;
+    arena_chunk_count.insert(m_arena.get_chunk_count());
+
+    Statistics stats;
+    stats.insert("arena high-water mark", arena_high_water_mark, "bytes");
+    stats.insert("arena chunks", arena_chunk_count);
+
+    return StatisticsVector::make("shading context statistics", stats);
+}
+
 }   // namespace renderer
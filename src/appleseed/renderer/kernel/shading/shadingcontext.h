@@ -36,6 +36,7 @@
 // appleseed.foundation headers.
 #include "foundation/core/concepts/noncopyable.h"
 #include "foundation/math/vector.h"
+#include "foundation/utility/statistics.h"
 
 // OpenImageIO headers.
 #include "foundation/platform/oiioheaderguards.h"
@@ -143,6 +144,9 @@ class ShadingContext
         const ShadingPoint&         shading_point,
         const foundation::Vector2f& s) const;
 
+    // Retrieve performance statistics.
+    foundation::StatisticsVector get_statistics() const;
+
   private:
     const Intersector&              m_intersector;
     Tracer&                         m_tracer;
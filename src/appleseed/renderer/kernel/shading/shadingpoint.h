@@ -261,6 +261,7 @@ class ShadingPoint
     friend class AssemblyLeafVisitor;
     friend class CurveLeafVisitor;
     friend class Intersector;
+    friend class ObjectInstanceLeafVisitor;
     friend class OSLShaderGroupExec;
     friend class RegionLeafVisitor;
     friend class RendererServices;
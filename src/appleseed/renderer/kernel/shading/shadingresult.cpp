@@ -134,7 +134,7 @@ namespace
 
     inline void transform_spectrum_to_linear_rgb(const LightingConditions& lighting, Spectrum& s)
     {
-        s = ciexyz_to_linear_rgb(spectrum_to_ciexyz<float>(lighting, s));
+        s = s.convert_to_rgb(lighting);
     }
 }
 
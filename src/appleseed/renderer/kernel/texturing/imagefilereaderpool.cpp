@@ -0,0 +1,155 @@
+
+//
+// This source file is part of appleseed.
+// Visit http://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2010-2013 Francois Beaune, Jupiter Jazz Limited
+// Copyright (c) 2014-2017 Francois Beaune, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// Interface header.
+#include "imagefilereaderpool.h"
+
+// appleseed.renderer headers.
+#include "renderer/global/globallogger.h"
+
+// appleseed.foundation headers.
+#include "foundation/image/genericprogressiveimagefilereader.h"
+#include "foundation/utility/foreach.h"
+
+// Standard headers.
+#include <algorithm>
+#include <cassert>
+
+using namespace foundation;
+using namespace std;
+
+namespace renderer
+{
+
+namespace
+{
+    const size_t MaxReadersPerFile = 4;
+}
+
+ImageFileReaderPool::ImageFileReaderPool(const size_t max_open_files)
+  : m_max_open_files(max<size_t>(max_open_files, 1))
+  , m_open_file_count(0)
+{
+}
+
+ImageFileReaderPool::~ImageFileReaderPool()
+{
+    assert(m_idle_readers.size() == m_open_file_count);
+
+    for (const_each<IdleReaderList> i = m_idle_readers; i; ++i)
+        delete i->m_reader;
+}
+
+GenericProgressiveImageFileReader* ImageFileReaderPool::acquire(const string& filepath)
+{
+    boost::mutex::scoped_lock lock(m_mutex);
+
+    while (true)
+    {
+        // Reuse an idle reader of this file.
+        for (IdleReaderList::iterator i = m_idle_readers.begin(); i != m_idle_readers.end(); ++i)
+        {
+            if (i->m_filepath == filepath)
+            {
+                GenericProgressiveImageFileReader* reader = i->m_reader;
+                m_idle_readers.erase(i);
+                return reader;
+            }
+        }
+
+        size_t& open_count = m_open_counts[filepath];
+
+        if (open_count < MaxReadersPerFile)
+        {
+            // Open a new reader if the cap allows it.
+            if (m_open_file_count < m_max_open_files)
+            {
+                ++m_open_file_count;
+                ++open_count;
+                lock.unlock();
+                return open_reader(filepath);
+            }
+
+            // Otherwise close the least recently used idle reader to make room.
+            if (!m_idle_readers.empty())
+            {
+                const IdleReader victim = m_idle_readers.back();
+                m_idle_readers.pop_back();
+                --m_open_counts[victim.m_filepath];
+                ++open_count;
+                lock.unlock();
+                delete victim.m_reader;
+                return open_reader(filepath);
+            }
+        }
+
+        // Wait for a reader to be returned to the pool.
+        m_reader_released.wait(lock);
+    }
+}
+
+void ImageFileReaderPool::release(
+    const string&                       filepath,
+    GenericProgressiveImageFileReader*  reader)
+{
+    boost::mutex::scoped_lock lock(m_mutex);
+
+    IdleReader idle_reader;
+    idle_reader.m_filepath = filepath;
+    idle_reader.m_reader = reader;
+    m_idle_readers.push_front(idle_reader);
+
+    m_reader_released.notify_all();
+}
+
+GenericProgressiveImageFileReader* ImageFileReaderPool::open_reader(const string& filepath)
+{
+    GenericProgressiveImageFileReader* reader =
+        new GenericProgressiveImageFileReader(&global_logger());
+
+    try
+    {
+        reader->open(filepath.c_str());
+    }
+    catch (...)
+    {
+        delete reader;
+
+        boost::mutex::scoped_lock lock(m_mutex);
+        --m_open_counts[filepath];
+        --m_open_file_count;
+        m_reader_released.notify_all();
+
+        throw;
+    }
+
+    return reader;
+}
+
+}   // namespace renderer
@@ -0,0 +1,145 @@
+
+//
+// This source file is part of appleseed.
+// Visit http://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2010-2013 Francois Beaune, Jupiter Jazz Limited
+// Copyright (c) 2014-2017 Francois Beaune, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#ifndef APPLESEED_RENDERER_KERNEL_TEXTURING_IMAGEFILEREADERPOOL_H
+#define APPLESEED_RENDERER_KERNEL_TEXTURING_IMAGEFILEREADERPOOL_H
+
+// appleseed.foundation headers.
+#include "foundation/core/concepts/noncopyable.h"
+#include "foundation/platform/thread.h"
+
+// Boost headers.
+#include "boost/thread/condition_variable.hpp"
+
+// Standard headers.
+#include <cstddef>
+#include <list>
+#include <map>
+#include <string>
+
+// Forward declarations.
+namespace foundation    { class GenericProgressiveImageFileReader; }
+
+namespace renderer
+{
+
+//
+// A pool of image file readers, owned by a texture store and used by the textures
+// to read their tiles.
+//
+// A few readers may be kept open on each file, such that tiles of the same file
+// are read concurrently. The total number of open readers is capped: when the cap
+// is reached, the least recently used idle reader of another file is closed to make
+// room, or the caller waits until a reader is returned to the pool.
+//
+
+class ImageFileReaderPool
+  : public foundation::NonCopyable
+{
+  public:
+    // Constructor.
+    explicit ImageFileReaderPool(const size_t max_open_files);
+
+    // Destructor, closes all readers. All readers must have been returned to the pool.
+    ~ImageFileReaderPool();
+
+    // Acquire a reader open on a given file. Thread-safe.
+    foundation::GenericProgressiveImageFileReader* acquire(const std::string& filepath);
+
+    // Return a reader to the pool. Thread-safe.
+    void release(
+        const std::string&                              filepath,
+        foundation::GenericProgressiveImageFileReader*  reader);
+
+    // Acquire a reader from the pool and return it when going out of scope.
+    class ScopedReader
+      : public foundation::NonCopyable
+    {
+      public:
+        ScopedReader(
+            ImageFileReaderPool&                        pool,
+            const std::string&                          filepath);
+
+        ~ScopedReader();
+
+        foundation::GenericProgressiveImageFileReader* operator->() const;
+
+      private:
+        ImageFileReaderPool&                            m_pool;
+        const std::string&                              m_filepath;
+        foundation::GenericProgressiveImageFileReader*  m_reader;
+    };
+
+  private:
+    struct IdleReader
+    {
+        std::string                                     m_filepath;
+        foundation::GenericProgressiveImageFileReader*  m_reader;
+    };
+
+    typedef std::list<IdleReader> IdleReaderList;
+    typedef std::map<std::string, size_t> OpenCountMap;
+
+    const size_t                    m_max_open_files;
+    boost::mutex                    m_mutex;
+    boost::condition_variable       m_reader_released;
+    size_t                          m_open_file_count;
+    OpenCountMap                    m_open_counts;      // number of open readers per file
+    IdleReaderList                  m_idle_readers;     // most recently used first
+
+    foundation::GenericProgressiveImageFileReader* open_reader(const std::string& filepath);
+};
+
+
+//
+// ImageFileReaderPool::ScopedReader class implementation.
+//
+
+inline ImageFileReaderPool::ScopedReader::ScopedReader(
+    ImageFileReaderPool&    pool,
+    const std::string&      filepath)
+  : m_pool(pool)
+  , m_filepath(filepath)
+  , m_reader(pool.acquire(filepath))
+{
+}
+
+inline ImageFileReaderPool::ScopedReader::~ScopedReader()
+{
+    m_pool.release(m_filepath, m_reader);
+}
+
+inline foundation::GenericProgressiveImageFileReader* ImageFileReaderPool::ScopedReader::operator->() const
+{
+    return m_reader;
+}
+
+}       // namespace renderer
+
+#endif  // !APPLESEED_RENDERER_KERNEL_TEXTURING_IMAGEFILEREADERPOOL_H
@@ -32,18 +32,23 @@
 
 // appleseed.renderer headers.
 #include "renderer/global/globallogger.h"
+#include "renderer/modeling/scene/archiveassembly.h"
 #include "renderer/modeling/scene/assembly.h"
 #include "renderer/modeling/scene/scene.h"
 #include "renderer/modeling/texture/texture.h"
 #include "renderer/utility/paramarray.h"
 
 // appleseed.foundation headers.
+#include "foundation/image/canvasproperties.h"
 #include "foundation/image/color.h"
 #include "foundation/image/colorspace.h"
 #include "foundation/image/tile.h"
+#include "foundation/math/hash.h"
+#include "foundation/platform/compiler.h"
 #include "foundation/utility/api/apistring.h"
 #include "foundation/utility/containers/dictionary.h"
 #include "foundation/utility/foreach.h"
+#include "foundation/utility/job.h"
 #include "foundation/utility/memory.h"
 #include "foundation/utility/statistics.h"
 #include "foundation/utility/string.h"
@@ -51,6 +56,7 @@
 // Standard headers.
 #include <algorithm>
 #include <string>
+#include <vector>
 
 using namespace foundation;
 using namespace std;
@@ -58,6 +64,99 @@ using namespace std;
 namespace renderer
 {
 
+//
+// TextureStore::PrefetchJob class implementation.
+//
+
+class TextureStore::PrefetchJob
+  : public IJob
+{
+  public:
+    PrefetchJob(
+        TextureStore&       store,
+        const TileKey&      key)
+      : m_store(store)
+      , m_key(key)
+    {
+    }
+
+    virtual void execute(const size_t thread_index) APPLESEED_OVERRIDE
+    {
+        if (m_store.m_io_abort_switch.is_aborted())
+            return;
+
+        // Tiles of other levels are not prefetched, see the comment of the TextureStore class.
+        assert(m_key.m_level == 0);
+
+        const CanvasProperties& props = m_store.m_tile_swapper.get_texture_properties(m_key);
+        const size_t tile_x = m_key.get_tile_x();
+        const size_t tile_y = m_key.get_tile_y();
+
+        // Prefetch the (up to) eight neighbors of the tile.
+        for (size_t y = tile_y > 0 ? tile_y - 1 : 0; y <= tile_y + 1 && y < props.m_tile_count_y; ++y)
+        {
+            for (size_t x = tile_x > 0 ? tile_x - 1 : 0; x <= tile_x + 1 && x < props.m_tile_count_x; ++x)
+            {
+                if (x != tile_x || y != tile_y)
+                    m_store.prefetch_tile(TileKey(m_key.m_assembly_uid, m_key.m_texture_uid, x, y));
+            }
+        }
+    }
+
+  private:
+    TextureStore&           m_store;
+    const TileKey           m_key;
+};
+
+
+//
+// TextureStore::LoadTileJob class implementation.
+//
+
+class TextureStore::LoadTileJob
+  : public IJob
+{
+  public:
+    // The job must own the tile record.
+    LoadTileJob(
+        TextureStore&       store,
+        const TileKey&      key,
+        TileRecord&         record)
+      : m_store(store)
+      , m_key(key)
+      , m_record(record)
+    {
+    }
+
+    virtual void execute(const size_t thread_index) APPLESEED_OVERRIDE
+    {
+        assert(m_key.m_level == 0);
+
+        Tile* tile;
+
+        try
+        {
+            tile = m_store.m_tile_swapper.load_tile(m_key);
+        }
+        catch (...)
+        {
+            // Threads keep using the fallback tile until the tile is acquired again.
+            m_store.abort_loading(m_key, m_record);
+            m_store.release(m_record);
+            throw;
+        }
+
+        m_store.finish_loading(m_key, m_record, tile);
+        m_store.release(m_record);
+    }
+
+  private:
+    TextureStore&           m_store;
+    const TileKey           m_key;
+    TileRecord&             m_record;
+};
+
+
 //
 // TextureStore class implementation.
 //
@@ -65,16 +164,185 @@ namespace renderer
 TextureStore::TextureStore(
     const Scene&        scene,
     const ParamArray&   params)
-  : m_tile_swapper(scene, params)
-  , m_tile_cache(m_tile_key_hasher, m_tile_swapper)
+  : m_reader_pool(params.get_optional<size_t>("max_open_files", 256))
+  , m_tile_swapper(scene, params, m_reader_pool)
+  , m_prefetch(
+        params.get_optional<size_t>("io_threads", 0) > 0 &&
+        params.get_optional<bool>("prefetch", true))
+  , m_low_res_fallback(
+        params.get_optional<size_t>("io_threads", 0) > 0 &&
+        params.get_optional<bool>("low_res_fallback", false))
+  , m_prefetch_request_count(0)
+  , m_prefetch_load_count(0)
+  , m_prefetch_hit_count(0)
+  , m_demand_load_count(0)
+  , m_fallback_count(0)
+{
+    const size_t shard_count = max<size_t>(params.get_optional<size_t>("shard_count", 16), 1);
+
+    // Each shard evicts its own tiles, so it gets an equal share of the memory limit.
+    const size_t shard_memory_limit = max<size_t>(m_tile_swapper.get_memory_limit() / shard_count, 1);
+
+    for (size_t i = 0; i < shard_count; ++i)
+        m_shards.push_back(new Shard(m_tile_key_hasher, m_tile_swapper, shard_memory_limit));
+
+    const size_t io_thread_count = params.get_optional<size_t>("io_threads", 0);
+
+    if (io_thread_count > 0)
+    {
+        m_io_job_manager.reset(
+            new JobManager(
+                global_logger(),
+                m_io_job_queue,
+                io_thread_count,
+                JobManager::KeepRunningOnEmptyQueue |
+                JobManager::KeepRunningOnJobFailure));
+        m_io_job_manager->start();
+    }
+}
+
+TextureStore::~TextureStore()
+{
+    if (m_io_job_manager.get())
+    {
+        // Pending prefetches are skipped, but tiles still being loaded in the
+        // background must be completed before the store can be destroyed.
+        m_io_abort_switch.abort();
+        m_io_job_queue.wait_until_completion();
+        m_io_job_manager->stop();
+    }
+
+    for (size_t i = 0; i < m_shards.size(); ++i)
+        delete m_shards[i];
+
+    for (const_each<FallbackTileMap> i = m_fallback_tiles; i; ++i)
+        delete i->second;
+}
+
+TextureStore::TileRecord& TextureStore::acquire(
+    const TileKey&      key,
+    const bool          allow_fallback)
 {
+    Shard& shard = get_shard(key);
+
+    boost::mutex::scoped_lock lock(shard.m_mutex, boost::defer_lock);
+    lock_shard(shard, lock);
+    ++shard.m_acquire_count;
+
+    TileRecord& record = shard.m_tile_cache.get(key);
+    atomic_inc(&record.m_owners);
+
+    if (record.m_prefetched)
+    {
+        // First acquisition of a tile loaded (or being loaded) by the prefetcher.
+        record.m_prefetched = false;
+        ++m_prefetch_hit_count;
+    }
+
+    if (record.m_tile.load(boost::memory_order_acquire) != 0)
+        return record;
+
+    Tile* fallback_tile = allow_fallback ? get_fallback_tile(key) : 0;
+
+    if (record.m_loading)
+    {
+        if (fallback_tile)
+        {
+            // Another thread is loading this tile: use the fallback tile meanwhile.
+            record.m_fallback_tile = fallback_tile;
+            ++m_fallback_count;
+        }
+        else
+        {
+            // Another thread is loading this tile: wait until it's done.
+            ++shard.m_load_wait_count;
+            while (record.m_loading)
+                shard.m_tile_loaded.wait(lock);
+        }
+
+        // Unless the other thread failed to load the tile, in which case we try ourselves.
+        if (fallback_tile || record.m_tile.load(boost::memory_order_acquire) != 0)
+            return record;
+    }
+
+    // Load the tile without holding the lock. The tile record cannot
+    // be evicted from the cache in the meantime since we own it.
+    record.m_loading = true;
+    ++m_demand_load_count;
+
+    if (fallback_tile)
+    {
+        // The tile will be loaded in the background, the job owns the record too.
+        record.m_fallback_tile = fallback_tile;
+        atomic_inc(&record.m_owners);
+        ++m_fallback_count;
+    }
+
+    lock.unlock();
+
+    if (m_prefetch && key.m_level == 0)
+        prefetch_neighbors(key);
+
+    if (fallback_tile)
+        m_io_job_queue.schedule(new LoadTileJob(*this, key, record));
+    else
+    {
+        Tile* tile;
+
+        try
+        {
+            tile = load_tile(key);
+        }
+        catch (...)
+        {
+            // Don't leave threads waiting for a tile that will never be loaded.
+            abort_loading(key, record);
+            release(record);
+            throw;
+        }
+
+        finish_loading(key, record, tile);
+    }
+
+    return record;
 }
 
 StatisticsVector TextureStore::get_statistics() const
 {
-    Statistics stats = make_single_stage_cache_stats(m_tile_cache);
+    Statistics stats;
+
+    for (size_t i = 0; i < m_shards.size(); ++i)
+        stats.merge(make_single_stage_cache_stats(m_shards[i]->m_tile_cache));
+
     stats.insert_size("peak size", m_tile_swapper.get_peak_memory_size());
 
+    if (m_prefetch)
+    {
+        const uint64 hit_count = m_prefetch_hit_count.load();
+        const uint64 miss_count = m_demand_load_count.load();
+        stats.insert(
+            "prefetch",
+            "hits " + pretty_uint(hit_count) + "  "
+            "misses " + pretty_uint(miss_count) +
+                " (hit rate " + pretty_percent(hit_count, hit_count + miss_count) + ")  "
+            "requests " + pretty_uint(m_prefetch_request_count.load()) + "  "
+            "loads " + pretty_uint(m_prefetch_load_count.load()));
+    }
+
+    if (m_low_res_fallback)
+        stats.insert<uint64>("fallbacks", m_fallback_count.load());
+
+    for (size_t i = 0; i < m_shards.size(); ++i)
+    {
+        const Shard& shard = *m_shards[i];
+        stats.insert(
+            "shard #" + to_string(i),
+            "acquisitions " + pretty_uint(shard.m_acquire_count) + "  "
+            "contended " + pretty_uint(shard.m_contended_count) +
+                " (" + pretty_percent(shard.m_contended_count, shard.m_acquire_count) + ")  "
+            "load waits " + pretty_uint(shard.m_load_wait_count));
+    }
+
     return StatisticsVector::make("texture store statistics", stats);
 }
 
@@ -91,9 +359,258 @@ Dictionary TextureStore::get_params_metadata()
             .insert("label", "Texture Cache Size")
             .insert("help", "Texture cache size in bytes"));
 
+    metadata.dictionaries().insert(
+        "max_open_files",
+        Dictionary()
+            .insert("type", "int")
+            .insert("default", "256")
+            .insert("label", "Max Open Texture Files")
+            .insert("help", "Maximum number of texture files kept open at the same time"));
+
+    metadata.dictionaries().insert(
+        "io_threads",
+        Dictionary()
+            .insert("type", "int")
+            .insert("default", "0")
+            .insert("label", "I/O Threads")
+            .insert("help", "Number of background threads used to prefetch and load texture tiles"));
+
+    metadata.dictionaries().insert(
+        "prefetch",
+        Dictionary()
+            .insert("type", "bool")
+            .insert("default", "true")
+            .insert("label", "Prefetch Tiles")
+            .insert("help", "Prefetch the neighbors of missed texture tiles (requires I/O threads)"));
+
+    metadata.dictionaries().insert(
+        "low_res_fallback",
+        Dictionary()
+            .insert("type", "bool")
+            .insert("default", "false")
+            .insert("label", "Low Resolution Fallback")
+            .insert("help", "Use the average color of the first loaded tile of a texture while its other tiles are loaded in the background (requires I/O threads)"));
+
     return metadata;
 }
 
+TextureStore::Shard& TextureStore::get_shard(const TileKey& key)
+{
+    const uint32 hash = hash_uint64_to_uint32(m_tile_key_hasher(key));
+    return *m_shards[hash % m_shards.size()];
+}
+
+Tile* TextureStore::load_tile(const TileKey& key)
+{
+    if (key.m_level == 0)
+        return m_tile_swapper.load_tile(key);
+
+    // Acquire the (up to) four tiles of the next finer level covered by this tile.
+    // Fallback tiles must not be used since they would be baked into this tile.
+    const CanvasProperties finer_props =
+        get_level_properties(m_tile_swapper.get_texture_properties(key), key.m_level - 1);
+    TileRecord* finer_records[4];
+    const Tile* finer_tiles[4];
+    for (size_t y = 0; y < 2; ++y)
+    {
+        for (size_t x = 0; x < 2; ++x)
+        {
+            const size_t finer_tile_x = 2 * key.get_tile_x() + x;
+            const size_t finer_tile_y = 2 * key.get_tile_y() + y;
+            const size_t i = y * 2 + x;
+
+            if (finer_tile_x < finer_props.m_tile_count_x && finer_tile_y < finer_props.m_tile_count_y)
+            {
+                finer_records[i] =
+                    &acquire(
+                        TileKey(
+                            key.m_assembly_uid,
+                            key.m_texture_uid,
+                            finer_tile_x,
+                            finer_tile_y,
+                            key.m_level - 1),
+                        false);
+                finer_tiles[i] = finer_records[i]->m_tile.load(boost::memory_order_acquire);
+            }
+            else
+            {
+                finer_records[i] = 0;
+                finer_tiles[i] = 0;
+            }
+        }
+    }
+
+    Tile* tile = m_tile_swapper.build_level_tile(key, finer_tiles);
+
+    for (size_t i = 0; i < 4; ++i)
+    {
+        if (finer_records[i])
+            release(*finer_records[i]);
+    }
+
+    return tile;
+}
+
+void TextureStore::finish_loading(
+    const TileKey&      key,
+    TileRecord&         record,
+    Tile*               tile)
+{
+    if (m_low_res_fallback)
+        create_fallback_tile(key, *tile);
+
+    Shard& shard = get_shard(key);
+    boost::mutex::scoped_lock lock(shard.m_mutex, boost::defer_lock);
+    lock_shard(shard, lock);
+
+    shard.m_tile_swapper.track_loaded_tile(*tile);
+
+    // Publish the tile to threads that read it without holding the lock.
+    record.m_tile.store(tile, boost::memory_order_release);
+    record.m_loading = false;
+    shard.m_tile_loaded.notify_all();
+}
+
+void TextureStore::abort_loading(
+    const TileKey&      key,
+    TileRecord&         record)
+{
+    Shard& shard = get_shard(key);
+    boost::mutex::scoped_lock lock(shard.m_mutex, boost::defer_lock);
+    lock_shard(shard, lock);
+
+    record.m_loading = false;
+    shard.m_tile_loaded.notify_all();
+}
+
+void TextureStore::prefetch_tile(const TileKey& key)
+{
+    ++m_prefetch_request_count;
+
+    Shard& shard = get_shard(key);
+    boost::mutex::scoped_lock lock(shard.m_mutex, boost::defer_lock);
+    lock_shard(shard, lock);
+
+    // Don't evict tiles to make room for tiles that might never be used.
+    if (shard.m_tile_swapper.is_full(0))
+        return;
+
+    if (shard.m_tile_cache.contains(key))
+        return;
+
+    TileRecord& record = shard.m_tile_cache.get(key);
+    atomic_inc(&record.m_owners);
+    record.m_loading = true;
+    record.m_prefetched = true;
+
+    lock.unlock();
+
+    assert(key.m_level == 0);
+
+    Tile* tile;
+
+    try
+    {
+        tile = m_tile_swapper.load_tile(key);
+    }
+    catch (...)
+    {
+        // Don't leave threads waiting for a tile that will never be loaded.
+        abort_loading(key, record);
+        release(record);
+        throw;
+    }
+
+    ++m_prefetch_load_count;
+
+    finish_loading(key, record, tile);
+    release(record);
+}
+
+void TextureStore::prefetch_neighbors(const TileKey& key)
+{
+    m_io_job_queue.schedule(new PrefetchJob(*this, key));
+}
+
+Tile* TextureStore::get_fallback_tile(const TileKey& key)
+{
+    boost::mutex::scoped_lock lock(m_fallback_tiles_mutex);
+
+    const FallbackTileMap::const_iterator i =
+        m_fallback_tiles.find(TextureKey(key.m_assembly_uid, key.m_texture_uid));
+
+    return i != m_fallback_tiles.end() ? i->second : 0;
+}
+
+void TextureStore::create_fallback_tile(const TileKey& key, const Tile& tile)
+{
+    const TextureKey texture_key(key.m_assembly_uid, key.m_texture_uid);
+
+    {
+        boost::mutex::scoped_lock lock(m_fallback_tiles_mutex);
+        if (m_fallback_tiles.find(texture_key) != m_fallback_tiles.end())
+            return;
+    }
+
+    // Compute the average color of the tile.
+    const size_t channel_count = tile.get_channel_count();
+    const size_t pixel_count = tile.get_pixel_count();
+    vector<float> average(channel_count, 0.0f);
+    vector<float> pixel(channel_count);
+    for (size_t i = 0; i < pixel_count; ++i)
+    {
+        tile.get_pixel(i, &pixel[0]);
+        for (size_t c = 0; c < channel_count; ++c)
+            average[c] += pixel[c];
+    }
+    for (size_t c = 0; c < channel_count; ++c)
+        average[c] /= pixel_count;
+
+    // Create a full-size tile of that color, since it will stand in for any tile of the texture.
+    const CanvasProperties& props = m_tile_swapper.get_texture_properties(key);
+    Tile* fallback_tile =
+        new Tile(
+            props.m_tile_width,
+            props.m_tile_height,
+            channel_count,
+            tile.get_pixel_format());
+    for (size_t i = 0; i < fallback_tile->get_pixel_count(); ++i)
+        fallback_tile->set_pixel(i, &average[0]);
+
+    boost::mutex::scoped_lock lock(m_fallback_tiles_mutex);
+
+    if (!m_fallback_tiles.insert(make_pair(texture_key, fallback_tile)).second)
+        delete fallback_tile;
+}
+
+void TextureStore::lock_shard(
+    Shard&                      shard,
+    boost::mutex::scoped_lock&  lock)
+{
+    if (!lock.try_lock())
+    {
+        lock.lock();
+        ++shard.m_contended_count;
+    }
+}
+
+
+//
+// TextureStore::Shard class implementation.
+//
+
+TextureStore::Shard::Shard(
+    TileKeyHasher&      tile_key_hasher,
+    TileSwapper&        tile_swapper,
+    const size_t        memory_limit)
+  : m_tile_swapper(tile_swapper, memory_limit)
+  , m_tile_cache(tile_key_hasher, m_tile_swapper)
+  , m_acquire_count(0)
+  , m_contended_count(0)
+  , m_load_wait_count(0)
+{
+}
+
 
 //
 // TextureStore::TileSwapper class implementation.
@@ -161,10 +678,12 @@ namespace
 }
 
 TextureStore::TileSwapper::TileSwapper(
-    const Scene&        scene,
-    const ParamArray&   params)
+    const Scene&            scene,
+    const ParamArray&       params,
+    ImageFileReaderPool&    reader_pool)
   : m_scene(scene)
   , m_params(params)
+  , m_reader_pool(reader_pool)
   , m_memory_size(0)
   , m_peak_memory_size(0)
 {
@@ -173,14 +692,15 @@ TextureStore::TileSwapper::TileSwapper(
 
 void TextureStore::TileSwapper::load(const TileKey& key, TileRecord& record)
 {
-    // Fetch the texture container.
-    const TextureContainer& textures =
-        key.m_assembly_uid == UniqueID(~0)
-            ? m_scene.textures()
-            : m_assemblies[key.m_assembly_uid]->textures();
+    record = TileRecord();
+}
+
+Tile* TextureStore::TileSwapper::load_tile(const TileKey& key)
+{
+    assert(key.m_level == 0);
 
     // Fetch the texture.
-    Texture* texture = textures.get_by_uid(key.m_texture_uid);
+    Texture* texture = get_textures(key).get_by_uid(key.m_texture_uid);
 
     if (m_params.m_track_tile_loading)
     {
@@ -193,8 +713,7 @@ void TextureStore::TileSwapper::load(const TileKey& key, TileRecord& record)
     }
 
     // Load the tile.
-    record.m_tile = texture->load_tile(key.get_tile_x(), key.get_tile_y());
-    record.m_owners = 0;
+    Tile* tile = texture->load_tile(m_reader_pool, key.get_tile_x(), key.get_tile_y());
 
     // Convert the tile to the linear RGB color space.
     switch (texture->get_color_space())
@@ -203,78 +722,195 @@ void TextureStore::TileSwapper::load(const TileKey& key, TileRecord& record)
         break;
 
       case ColorSpaceSRGB:
-        convert_tile_srgb_to_linear_rgb(*record.m_tile);
+        convert_tile_srgb_to_linear_rgb(*tile);
         break;
 
       case ColorSpaceCIEXYZ:
-        convert_tile_ciexyz_to_linear_rgb(*record.m_tile);
+        convert_tile_ciexyz_to_linear_rgb(*tile);
         break;
 
       assert_otherwise;
     }
 
-    // Track the amount of memory used by the tile cache.
-    m_memory_size += record.m_tile->get_memory_size();
-    m_peak_memory_size = max(m_peak_memory_size, m_memory_size);
+    track_loaded_tile(*tile);
 
-    if (m_params.m_track_store_size)
+    return tile;
+}
+
+Tile* TextureStore::TileSwapper::build_level_tile(
+    const TileKey&      key,
+    const Tile*         finer_tiles[4])
+{
+    assert(key.m_level > 0);
+    assert(finer_tiles[0]);
+
+    const CanvasProperties& texture_props = get_texture_properties(key);
+    const CanvasProperties props = get_level_properties(texture_props, key.m_level);
+    const CanvasProperties finer_props = get_level_properties(texture_props, key.m_level - 1);
+
+    const size_t tile_x = key.get_tile_x();
+    const size_t tile_y = key.get_tile_y();
+    const size_t origin_x = tile_x * props.m_tile_width;
+    const size_t origin_y = tile_y * props.m_tile_height;
+    const size_t channel_count = finer_tiles[0]->get_channel_count();
+
+    Tile* tile =
+        new Tile(
+            props.get_tile_width(tile_x),
+            props.get_tile_height(tile_y),
+            channel_count,
+            PixelFormatFloat);
+
+    // Box-filter 2x2 blocks of texels of the finer level. Texels past the edges
+    // of the finer level (only when it is one texel wide or high) are clamped.
+    for (size_t y = 0; y < tile->get_height(); ++y)
     {
-        if (m_memory_size > m_params.m_memory_limit)
-        {
-            RENDERER_LOG_DEBUG(
-                "texture store size is %s, exceeding capacity %s by %s",
-                pretty_size(m_memory_size).c_str(),
-                pretty_size(m_params.m_memory_limit).c_str(),
-                pretty_size(m_memory_size - m_params.m_memory_limit).c_str());
-        }
-        else
+        size_t fy[2];
+        fy[0] = 2 * (origin_y + y);
+        fy[1] = min(fy[0] + 1, finer_props.m_canvas_height - 1);
+
+        for (size_t x = 0; x < tile->get_width(); ++x)
         {
-            RENDERER_LOG_DEBUG(
-                "texture store size is %s, below capacity %s by %s",
-                pretty_size(m_memory_size).c_str(),
-                pretty_size(m_params.m_memory_limit).c_str(),
-                pretty_size(m_params.m_memory_limit - m_memory_size).c_str());
+            size_t fx[2];
+            fx[0] = 2 * (origin_x + x);
+            fx[1] = min(fx[0] + 1, finer_props.m_canvas_width - 1);
+
+            for (size_t c = 0; c < channel_count; ++c)
+            {
+                float sum = 0.0f;
+
+                for (size_t j = 0; j < 2; ++j)
+                {
+                    const size_t finer_tile_y = fy[j] / finer_props.m_tile_height;
+                    const size_t pixel_y = fy[j] - finer_tile_y * finer_props.m_tile_height;
+
+                    for (size_t i = 0; i < 2; ++i)
+                    {
+                        const size_t finer_tile_x = fx[i] / finer_props.m_tile_width;
+                        const size_t pixel_x = fx[i] - finer_tile_x * finer_props.m_tile_width;
+
+                        const Tile* finer_tile =
+                            finer_tiles[(finer_tile_y - 2 * tile_y) * 2 + (finer_tile_x - 2 * tile_x)];
+                        assert(finer_tile);
+
+                        sum += finer_tile->get_component<float>(pixel_x, pixel_y, c);
+                    }
+                }
+
+                tile->set_component(x, y, c, 0.25f * sum);
+            }
         }
     }
+
+    if (m_params.m_track_tile_loading)
+    {
+        RENDERER_LOG_DEBUG(
+            "built tile (" FMT_SIZE_T ", " FMT_SIZE_T ") of level " FMT_SIZE_T " "
+            "from texture \"%s\"...",
+            tile_x,
+            tile_y,
+            static_cast<size_t>(key.m_level),
+            get_textures(key).get_by_uid(key.m_texture_uid)->get_path().c_str());
+    }
+
+    track_loaded_tile(*tile);
+
+    return tile;
 }
 
 bool TextureStore::TileSwapper::unload(const TileKey& key, TileRecord& record)
 {
-    // Cannot unload tiles that are still in use.
+    // Cannot unload tiles that are still in use (this includes tiles being loaded).
     if (atomic_read(&record.m_owners) > 0)
         return false;
 
+    // Nothing to unload if the tile failed to load.
+    Tile* tile = record.m_tile.load(boost::memory_order_acquire);
+    if (tile == 0)
+        return true;
+
     // Track the amount of memory used by the tile cache.
-    const size_t tile_memory_size = record.m_tile->get_memory_size();
-    assert(m_memory_size >= tile_memory_size);
+    const size_t tile_memory_size = tile->get_memory_size();
+    assert(m_memory_size.load() >= tile_memory_size);
     m_memory_size -= tile_memory_size;
 
-    // Fetch the texture container.
-    const TextureContainer& textures =
-        key.m_assembly_uid == UniqueID(~0)
-            ? m_scene.textures()
-            : m_assemblies[key.m_assembly_uid]->textures();
-
     // Fetch the texture.
-    Texture* texture = textures.get_by_uid(key.m_texture_uid);
+    Texture* texture = get_textures(key).get_by_uid(key.m_texture_uid);
 
     if (m_params.m_track_tile_unloading)
     {
         RENDERER_LOG_DEBUG(
-            "unloading tile (" FMT_SIZE_T ", " FMT_SIZE_T ") "
+            "unloading tile (" FMT_SIZE_T ", " FMT_SIZE_T ") of level " FMT_SIZE_T " "
             "from texture \"%s\"...",
             key.get_tile_x(),
             key.get_tile_y(),
+            static_cast<size_t>(key.m_level),
             texture->get_path().c_str());
     }
 
-    // Unload the tile.
-    texture->unload_tile(key.get_tile_x(), key.get_tile_y(), record.m_tile);
+    // Unload the tile. Tiles of coarser levels are owned by the store.
+    if (key.m_level == 0)
+        texture->unload_tile(key.get_tile_x(), key.get_tile_y(), tile);
+    else delete tile;
 
     // Successfully unloaded the tile.
     return true;
 }
 
+namespace
+{
+    // Find an assembly by UID, skipping archives that are being loaded on demand.
+    const Assembly* find_loaded_assembly(
+        const AssemblyContainer&    assemblies,
+        const UniqueID              assembly_uid)
+    {
+        for (const_each<AssemblyContainer> i = assemblies; i; ++i)
+        {
+            if (i->get_uid() == assembly_uid)
+                return &*i;
+
+            const ArchiveAssembly* archive = dynamic_cast<const ArchiveAssembly*>(&*i);
+            if (archive && archive->is_pending())
+                continue;
+
+            const Assembly* assembly = find_loaded_assembly(i->assemblies(), assembly_uid);
+            if (assembly)
+                return assembly;
+        }
+
+        return 0;
+    }
+}
+
+void TextureStore::TileSwapper::track_loaded_tile(const Tile& tile)
+{
+    // Track the amount of memory used by the tile cache.
+    const size_t memory_size = m_memory_size += tile.get_memory_size();
+    size_t peak_memory_size = m_peak_memory_size.load();
+    while (peak_memory_size < memory_size &&
+           !m_peak_memory_size.compare_exchange_weak(peak_memory_size, memory_size)) {}
+
+    if (m_params.m_track_store_size)
+    {
+        if (memory_size > m_params.m_memory_limit)
+        {
+            RENDERER_LOG_DEBUG(
+                "texture store size is %s, exceeding capacity %s by %s",
+                pretty_size(memory_size).c_str(),
+                pretty_size(m_params.m_memory_limit).c_str(),
+                pretty_size(memory_size - m_params.m_memory_limit).c_str());
+        }
+        else
+        {
+            RENDERER_LOG_DEBUG(
+                "texture store size is %s, below capacity %s by %s",
+                pretty_size(memory_size).c_str(),
+                pretty_size(m_params.m_memory_limit).c_str(),
+                pretty_size(m_params.m_memory_limit - memory_size).c_str());
+        }
+    }
+}
+
 void TextureStore::TileSwapper::gather_assemblies(const AssemblyContainer& assemblies)
 {
     for (const_each<AssemblyContainer> i = assemblies; i; ++i)
@@ -284,6 +920,68 @@ void TextureStore::TileSwapper::gather_assemblies(const AssemblyContainer& assem
     }
 }
 
+const CanvasProperties& TextureStore::TileSwapper::get_texture_properties(const TileKey& key) const
+{
+    return get_textures(key).get_by_uid(key.m_texture_uid)->properties();
+}
+
+const TextureContainer& TextureStore::TileSwapper::get_textures(const TileKey& key) const
+{
+    if (key.m_assembly_uid == UniqueID(~0))
+        return m_scene.textures();
+
+    const AssemblyMap::const_iterator i = m_assemblies.find(key.m_assembly_uid);
+    if (i != m_assemblies.end())
+        return i->second->textures();
+
+    // The assembly was loaded on demand after the texture store was created.
+    boost::mutex::scoped_lock lock(m_late_assemblies_mutex);
+    const Assembly*& assembly = m_late_assemblies[key.m_assembly_uid];
+    if (assembly == 0)
+        assembly = find_loaded_assembly(m_scene.assemblies(), key.m_assembly_uid);
+    assert(assembly);
+
+    return assembly->textures();
+}
+
+
+//
+// TextureStore::ShardTileSwapper class implementation.
+//
+
+TextureStore::ShardTileSwapper::ShardTileSwapper(
+    TileSwapper&        tile_swapper,
+    const size_t        memory_limit)
+  : m_tile_swapper(tile_swapper)
+  , m_memory_limit(memory_limit)
+  , m_memory_size(0)
+{
+}
+
+void TextureStore::ShardTileSwapper::load(const TileKey& key, TileRecord& record)
+{
+    m_tile_swapper.load(key, record);
+}
+
+bool TextureStore::ShardTileSwapper::unload(const TileKey& key, TileRecord& record)
+{
+    const Tile* tile = record.m_tile.load(boost::memory_order_acquire);
+    const size_t tile_memory_size = tile ? tile->get_memory_size() : 0;
+
+    if (!m_tile_swapper.unload(key, record))
+        return false;
+
+    assert(m_memory_size >= tile_memory_size);
+    m_memory_size -= tile_memory_size;
+
+    return true;
+}
+
+void TextureStore::ShardTileSwapper::track_loaded_tile(const Tile& tile)
+{
+    m_memory_size += tile.get_memory_size();
+}
+
 
 //
 // TextureStore::TileSwapper::Parameters class implementation.
@@ -31,21 +31,32 @@
 #define APPLESEED_RENDERER_KERNEL_TEXTURING_TEXTURESTORE_H
 
 // appleseed.renderer headers.
+#include "renderer/kernel/texturing/imagefilereaderpool.h"
 #include "renderer/modeling/scene/containers.h"
 
 // appleseed.foundation headers.
 #include "foundation/core/concepts/noncopyable.h"
+#include "foundation/image/canvasproperties.h"
 #include "foundation/math/hash.h"
 #include "foundation/platform/atomic.h"
 #include "foundation/platform/thread.h"
 #include "foundation/platform/types.h"
 #include "foundation/utility/cache.h"
+#include "foundation/utility/job.h"
 #include "foundation/utility/uid.h"
 
+// Boost headers.
+#include "boost/atomic/atomic.hpp"
+#include "boost/thread/condition_variable.hpp"
+
 // Standard headers.
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
 #include <map>
+#include <memory>
+#include <utility>
+#include <vector>
 
 // Forward declarations.
 namespace foundation    { class Dictionary; }
@@ -60,6 +71,28 @@ namespace renderer
 //
 // A shared store for texture tiles (the backend of the thread-local texture cache).
 //
+// Tiles are distributed over a number of independent shards according to a hash
+// of their key, such that threads acquiring tiles from different shards never
+// contend for the same lock. Tiles are loaded outside of the shard lock: threads
+// acquiring a tile being loaded by another thread wait for it without preventing
+// other threads from acquiring other tiles of the same shard. Each shard evicts
+// its own tiles and is given an equal share of the memory limit of the store.
+//
+// Optionally, a pool of background I/O threads prefetches the neighbors of tiles
+// that are missed. When a low resolution fallback is enabled, threads missing a
+// tile do not wait for it to be loaded: they are handed a constant tile of the
+// average color of the first tile loaded from the texture while the tile is loaded
+// in the background. The fallback is only an approximation of the texture: a true
+// average would require reading the whole texture before any fallback can be used.
+//
+// Textures are MIP-mapped on demand: a tile of level n > 0 is built by box-filtering
+// the (up to) four tiles of level n - 1 it covers, which are themselves acquired from
+// the store. Level n has the resolution of the texture divided by 2^n and the same
+// tile size as the texture. Only tiles of level 0 are prefetched or loaded in the
+// background: a background I/O thread building a tile of level n > 0 would have to
+// wait for tiles of level n - 1, possibly for a tile whose loading is queued behind
+// it on the I/O threads.
+//
 
 class TextureStore
   : public foundation::NonCopyable
@@ -71,6 +104,7 @@ class TextureStore
         foundation::UniqueID    m_assembly_uid;
         foundation::UniqueID    m_texture_uid;
         foundation::uint32      m_tile_xy;
+        foundation::uint32      m_level;            // MIP level, 0 is the full resolution level
 
         TileKey();
 
@@ -78,7 +112,8 @@ class TextureStore
             const foundation::UniqueID  assembly_uid,
             const foundation::UniqueID  texture_uid,
             const size_t                tile_x,
-            const size_t                tile_y);
+            const size_t                tile_y,
+            const size_t                level = 0);
 
         TileKey(
             const foundation::UniqueID  assembly_uid,
@@ -101,8 +136,18 @@ class TextureStore
 
     struct TileRecord
     {
-        foundation::Tile*           m_tile;
-        volatile foundation::uint32 m_owners;
+        boost::atomic<foundation::Tile*>    m_tile;             // null while the tile is being loaded
+        foundation::Tile*                   m_fallback_tile;    // tile to use while the tile is being loaded, or null
+        volatile foundation::uint32         m_owners;
+        bool                                m_loading;          // protected by the mutex of the shard
+        bool                                m_prefetched;       // protected by the mutex of the shard
+
+        TileRecord();
+        TileRecord(const TileRecord& rhs);
+        TileRecord& operator=(const TileRecord& rhs);
+
+        // Return the tile, or the fallback tile if the tile is not loaded yet.
+        const foundation::Tile& get_tile() const;
     };
 
     // Constructor.
@@ -110,6 +155,9 @@ class TextureStore
         const Scene&        scene,
         const ParamArray&   params = ParamArray());
 
+    // Destructor.
+    ~TextureStore();
+
     // Acquire an element from the cache. Thread-safe.
     TileRecord& acquire(const TileKey& key);
 
@@ -122,6 +170,14 @@ class TextureStore
     // Return the metadata of the texture store parameters.
     static foundation::Dictionary get_params_metadata();
 
+    // Return the number of MIP levels of a texture, including its full resolution level.
+    static size_t get_level_count(const foundation::CanvasProperties& props);
+
+    // Return the canvas properties of a given MIP level of a texture.
+    static foundation::CanvasProperties get_level_properties(
+        const foundation::CanvasProperties& props,
+        const size_t                        level);
+
   private:
     struct TileKeyHasher
     {
@@ -134,17 +190,31 @@ class TextureStore
       public:
         // Constructor.
         TileSwapper(
-            const Scene&        scene,
-            const ParamArray&   params);
+            const Scene&            scene,
+            const ParamArray&       params,
+            ImageFileReaderPool&    reader_pool);
 
-        // Load a cache line.
+        // Load a cache line. The tile itself is loaded later by load_tile(),
+        // outside of the lock of the shard.
         void load(const TileKey& key, TileRecord& record);
 
         // Unload a cache line.
         bool unload(const TileKey& key, TileRecord& record);
 
-        // Return true if the cache is full, false otherwise.
-        bool is_full(const size_t element_count) const;
+        // Load a tile of level 0. Thread-safe.
+        foundation::Tile* load_tile(const TileKey& key);
+
+        // Build a tile of level n > 0 from the (up to) four tiles of level n - 1 it covers,
+        // in row-major order. Missing tiles (past the edges of the texture) are null. Thread-safe.
+        foundation::Tile* build_level_tile(
+            const TileKey&              key,
+            const foundation::Tile*     finer_tiles[4]);
+
+        // Return the properties of the texture a tile belongs to. Thread-safe.
+        const foundation::CanvasProperties& get_texture_properties(const TileKey& key) const;
+
+        // Return the maximum memory size in bytes of the tile cache.
+        size_t get_memory_limit() const;
 
         // Return the peak memory size in bytes of the tile cache.
         size_t get_peak_memory_size() const;
@@ -162,26 +232,142 @@ class TextureStore
 
         typedef std::map<foundation::UniqueID, const Assembly*> AssemblyMap;
 
-        const Scene&        m_scene;
-        const Parameters    m_params;
-        size_t              m_memory_size;
-        size_t              m_peak_memory_size;
-        AssemblyMap         m_assemblies;
+        const Scene&                m_scene;
+        const Parameters            m_params;
+        ImageFileReaderPool&        m_reader_pool;
+        boost::atomic<size_t>       m_memory_size;
+        boost::atomic<size_t>       m_peak_memory_size;
+        AssemblyMap                 m_assemblies;
+        mutable boost::mutex        m_late_assemblies_mutex;
+        mutable AssemblyMap         m_late_assemblies;  // assemblies of archives loaded on demand
 
         void gather_assemblies(const AssemblyContainer& assemblies);
+
+        void track_loaded_tile(const foundation::Tile& tile);
+
+        const TextureContainer& get_textures(const TileKey& key) const;
+    };
+
+    // The swapper of the tile cache of a shard. Shards evict their tiles independently,
+    // so each of them only gets a share of the memory limit of the store.
+    class ShardTileSwapper
+      : public foundation::NonCopyable
+    {
+      public:
+        // Constructor.
+        ShardTileSwapper(
+            TileSwapper&        tile_swapper,
+            const size_t        memory_limit);
+
+        // Load a cache line.
+        void load(const TileKey& key, TileRecord& record);
+
+        // Unload a cache line.
+        bool unload(const TileKey& key, TileRecord& record);
+
+        // Return true if the cache is full, false otherwise.
+        bool is_full(const size_t element_count) const;
+
+        // Account for a tile loaded into the shard.
+        void track_loaded_tile(const foundation::Tile& tile);
+
+      private:
+        TileSwapper&                m_tile_swapper;
+        const size_t                m_memory_limit;
+        size_t                      m_memory_size;      // protected by the mutex of the shard
     };
 
     typedef foundation::LRUCache<
         TileKey,
         TileKeyHasher,
         TileRecord,
-        TileSwapper
+        ShardTileSwapper
     > TileCache;
 
-    boost::mutex            m_mutex;
-    TileKeyHasher           m_tile_key_hasher;
-    TileSwapper             m_tile_swapper;
-    TileCache               m_tile_cache;
+    struct Shard
+      : public foundation::NonCopyable
+    {
+        boost::mutex                m_mutex;
+        boost::condition_variable   m_tile_loaded;
+        ShardTileSwapper            m_tile_swapper;
+        TileCache                   m_tile_cache;
+
+        // Contention counters, protected by the mutex of the shard.
+        foundation::uint64          m_acquire_count;        // number of tile acquisitions
+        foundation::uint64          m_contended_count;      // number of acquisitions that had to wait for the lock
+        foundation::uint64          m_load_wait_count;      // number of acquisitions that had to wait for another thread to load the tile
+
+        Shard(
+            TileKeyHasher&          tile_key_hasher,
+            TileSwapper&            tile_swapper,
+            const size_t            memory_limit);
+    };
+
+    class PrefetchJob;
+    class LoadTileJob;
+
+    typedef std::pair<foundation::UniqueID, foundation::UniqueID> TextureKey;
+    typedef std::map<TextureKey, foundation::Tile*> FallbackTileMap;
+
+    ImageFileReaderPool                     m_reader_pool;
+    TileKeyHasher                           m_tile_key_hasher;
+    TileSwapper                             m_tile_swapper;
+    std::vector<Shard*>                     m_shards;
+
+    // Background I/O.
+    const bool                              m_prefetch;
+    const bool                              m_low_res_fallback;
+    foundation::JobQueue                    m_io_job_queue;
+    std::auto_ptr<foundation::JobManager>   m_io_job_manager;
+    foundation::AbortSwitch                 m_io_abort_switch;
+    boost::mutex                            m_fallback_tiles_mutex;
+    FallbackTileMap                         m_fallback_tiles;
+
+    // Background I/O statistics.
+    boost::atomic<foundation::uint64>       m_prefetch_request_count;   // number of tiles considered for prefetching
+    boost::atomic<foundation::uint64>       m_prefetch_load_count;      // number of tiles loaded by the prefetcher
+    boost::atomic<foundation::uint64>       m_prefetch_hit_count;       // number of prefetched tiles that were later acquired
+    boost::atomic<foundation::uint64>       m_demand_load_count;        // number of tiles loaded because they were acquired
+    boost::atomic<foundation::uint64>       m_fallback_count;           // number of acquisitions served by a fallback tile
+
+    Shard& get_shard(const TileKey& key);
+
+    // Acquire an element from the cache, optionally allowing the use of a fallback tile.
+    TileRecord& acquire(
+        const TileKey&              key,
+        const bool                  allow_fallback);
+
+    // Load a tile, building it from tiles of the next finer level if it is not of level 0.
+    foundation::Tile* load_tile(const TileKey& key);
+
+    // Finish loading a tile and wake up threads waiting for it.
+    void finish_loading(
+        const TileKey&              key,
+        TileRecord&                 record,
+        foundation::Tile*           tile);
+
+    // Give up loading a tile that failed to load and wake up threads waiting for it.
+    void abort_loading(
+        const TileKey&              key,
+        TileRecord&                 record);
+
+    // Load a tile, unless it is already in the store. Called from background I/O threads.
+    void prefetch_tile(const TileKey& key);
+
+    // Schedule the prefetching of the neighbors of a given tile.
+    void prefetch_neighbors(const TileKey& key);
+
+    // Return the fallback tile of the texture a tile belongs to, or null if there is none yet.
+    foundation::Tile* get_fallback_tile(const TileKey& key);
+
+    // Create the fallback tile of the texture a tile belongs to from the average color
+    // of that tile, if the texture does not have a fallback tile yet.
+    void create_fallback_tile(const TileKey& key, const foundation::Tile& tile);
+
+    // Lock the mutex of a shard, keeping track of contention.
+    static void lock_shard(
+        Shard&                      shard,
+        boost::mutex::scoped_lock&  lock);
 };
 
 
@@ -191,12 +377,7 @@ class TextureStore
 
 inline TextureStore::TileRecord& TextureStore::acquire(const TileKey& key)
 {
-    boost::mutex::scoped_lock lock(m_mutex);
-
-    TileRecord& record = m_tile_cache.get(key);
-    foundation::atomic_inc(&record.m_owners);
-
-    return record;
+    return acquire(key, m_low_res_fallback && key.m_level == 0);
 }
 
 inline void TextureStore::release(TileRecord& record) const
@@ -205,6 +386,76 @@ inline void TextureStore::release(TileRecord& record) const
     foundation::atomic_dec(&record.m_owners);
 }
 
+inline size_t TextureStore::get_level_count(const foundation::CanvasProperties& props)
+{
+    size_t level_count = 1;
+
+    for (size_t size = std::max(props.m_canvas_width, props.m_canvas_height); size > 1; size >>= 1)
+        ++level_count;
+
+    return level_count;
+}
+
+inline foundation::CanvasProperties TextureStore::get_level_properties(
+    const foundation::CanvasProperties& props,
+    const size_t                        level)
+{
+    return
+        foundation::CanvasProperties(
+            std::max<size_t>(props.m_canvas_width >> level, 1),
+            std::max<size_t>(props.m_canvas_height >> level, 1),
+            props.m_tile_width,
+            props.m_tile_height,
+            props.m_channel_count,
+            props.m_pixel_format);
+}
+
+
+//
+// TextureStore::TileRecord class implementation.
+//
+
+inline TextureStore::TileRecord::TileRecord()
+  : m_tile(0)
+  , m_fallback_tile(0)
+  , m_owners(0)
+  , m_loading(false)
+  , m_prefetched(false)
+{
+}
+
+// Records are only copied by the tile cache before they are handed out.
+inline TextureStore::TileRecord::TileRecord(const TileRecord& rhs)
+  : m_tile(rhs.m_tile.load(boost::memory_order_relaxed))
+  , m_fallback_tile(rhs.m_fallback_tile)
+  , m_owners(rhs.m_owners)
+  , m_loading(rhs.m_loading)
+  , m_prefetched(rhs.m_prefetched)
+{
+}
+
+inline TextureStore::TileRecord& TextureStore::TileRecord::operator=(const TileRecord& rhs)
+{
+    m_tile.store(rhs.m_tile.load(boost::memory_order_relaxed), boost::memory_order_relaxed);
+    m_fallback_tile = rhs.m_fallback_tile;
+    m_owners = rhs.m_owners;
+    m_loading = rhs.m_loading;
+    m_prefetched = rhs.m_prefetched;
+    return *this;
+}
+
+inline const foundation::Tile& TextureStore::TileRecord::get_tile() const
+{
+    // Pairs with the release store of the thread that loaded the tile.
+    const foundation::Tile* tile = m_tile.load(boost::memory_order_acquire);
+
+    if (tile == 0)
+        tile = m_fallback_tile;
+
+    assert(tile);
+    return *tile;
+}
+
 
 //
 // TextureStore::TileKey class implementation.
@@ -218,10 +469,12 @@ inline TextureStore::TileKey::TileKey(
     const foundation::UniqueID  assembly_uid,
     const foundation::UniqueID  texture_uid,
     const size_t                tile_x,
-    const size_t                tile_y)
+    const size_t                tile_y,
+    const size_t                level)
   : m_assembly_uid(assembly_uid)
   , m_texture_uid(texture_uid)
   , m_tile_xy(static_cast<foundation::uint32>((tile_y << 16) | tile_x))
+  , m_level(static_cast<foundation::uint32>(level))
 {
     assert(tile_x < (1UL << 16));
     assert(tile_y < (1UL << 16));
@@ -234,6 +487,7 @@ inline TextureStore::TileKey::TileKey(
   : m_assembly_uid(assembly_uid)
   , m_texture_uid(texture_uid)
   , m_tile_xy(tile_xy)
+  , m_level(0)
 {
 }
 
@@ -241,6 +495,7 @@ inline TextureStore::TileKey::TileKey(const TileKey& rhs)
   : m_assembly_uid(rhs.m_assembly_uid)
   , m_texture_uid(rhs.m_texture_uid)
   , m_tile_xy(rhs.m_tile_xy)
+  , m_level(rhs.m_level)
 {
 }
 
@@ -263,6 +518,7 @@ inline bool TextureStore::TileKey::operator==(const TileKey& rhs) const
 {
     return
         m_tile_xy == rhs.m_tile_xy &&
+        m_level == rhs.m_level &&
         m_texture_uid == rhs.m_texture_uid &&
         m_assembly_uid == rhs.m_assembly_uid;
 }
@@ -277,7 +533,9 @@ inline bool TextureStore::TileKey::operator<(const TileKey& rhs) const
     return
         m_assembly_uid == rhs.m_assembly_uid ?
             m_texture_uid == rhs.m_texture_uid ?
-                m_tile_xy < rhs.m_tile_xy :
+                m_level == rhs.m_level ?
+                    m_tile_xy < rhs.m_tile_xy :
+                m_level < rhs.m_level :
             m_texture_uid < rhs.m_texture_uid :
         m_assembly_uid < rhs.m_assembly_uid;
 }
@@ -289,7 +547,7 @@ inline bool TextureStore::TileKey::operator<(const TileKey& rhs) const
 
 inline size_t TextureStore::TileKeyHasher::operator()(const TileKey& key) const
 {
-    return foundation::mix_uint64(key.m_assembly_uid, key.m_texture_uid, key.m_tile_xy);
+    return foundation::mix_uint64(key.m_assembly_uid, key.m_texture_uid, key.m_tile_xy, key.m_level);
 }
 
 
@@ -297,14 +555,24 @@ inline size_t TextureStore::TileKeyHasher::operator()(const TileKey& key) const
 // TextureStore::TileSwapper class implementation.
 //
 
-inline bool TextureStore::TileSwapper::is_full(const size_t element_count) const
+inline size_t TextureStore::TileSwapper::get_memory_limit() const
 {
-    return m_memory_size >= m_params.m_memory_limit;
+    return m_params.m_memory_limit;
 }
 
 inline size_t TextureStore::TileSwapper::get_peak_memory_size() const
 {
-    return m_peak_memory_size;
+    return m_peak_memory_size.load();
+}
+
+
+//
+// TextureStore::ShardTileSwapper class implementation.
+//
+
+inline bool TextureStore::ShardTileSwapper::is_full(const size_t element_count) const
+{
+    return m_memory_size >= m_memory_limit;
 }
 
 }       // namespace renderer
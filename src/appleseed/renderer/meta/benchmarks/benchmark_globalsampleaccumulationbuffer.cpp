@@ -0,0 +1,121 @@
+
+//
+// This source file is part of appleseed.
+// Visit http://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2017 Francois Beaune, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// appleseed.renderer headers.
+#include "renderer/kernel/rendering/globalsampleaccumulationbuffer.h"
+#include "renderer/kernel/rendering/sample.h"
+
+// appleseed.foundation headers.
+#include "foundation/image/color.h"
+#include "foundation/math/filter.h"
+#include "foundation/math/rng/distribution.h"
+#include "foundation/math/rng/mersennetwister.h"
+#include "foundation/math/vector.h"
+#include "foundation/utility/benchmark.h"
+#include "foundation/utility/job.h"
+#include "foundation/utility/log.h"
+
+// Standard headers.
+#include <cstddef>
+#include <vector>
+
+using namespace foundation;
+using namespace renderer;
+using namespace std;
+
+BENCHMARK_SUITE(Renderer_Kernel_Rendering_GlobalSampleAccumulationBuffer)
+{
+    // Total number of samples stored by each benchmark case, whatever the number of threads.
+    const size_t SampleCount = 1024 * 1024;
+
+    // Number of samples per call to store_samples().
+    const size_t BatchSize = 4096;
+
+    struct StoreSamplesJob
+      : public IJob
+    {
+        GlobalSampleAccumulationBuffer*     m_buffer;
+        const Sample*                       m_samples;
+        AbortSwitch                         m_abort_switch;
+
+        virtual void execute(const size_t thread_index)
+        {
+            m_buffer->store_samples(BatchSize, m_samples, m_abort_switch);
+        }
+    };
+
+    template <size_t ThreadCount>
+    struct Fixture
+    {
+        Logger                              m_logger;
+        JobQueue                            m_job_queue;
+        JobManager                          m_job_manager;
+        BlackmanHarrisFilter2<float>        m_filter;
+        GlobalSampleAccumulationBuffer      m_buffer;
+        vector<Sample>                      m_samples;
+
+        Fixture()
+          : m_job_manager(m_logger, m_job_queue, ThreadCount, JobManager::KeepRunningOnEmptyQueue)
+          , m_filter(1.5f, 1.5f)
+          , m_buffer(1920, 1080, m_filter)
+          , m_samples(SampleCount)
+        {
+            MersenneTwister rng;
+
+            for (size_t i = 0; i < SampleCount; ++i)
+            {
+                m_samples[i].m_position = rand_vector1<Vector2f>(rng);
+                m_samples[i].m_color = Color4f(1.0f);
+            }
+
+            m_job_manager.start();
+        }
+
+        void store_samples()
+        {
+            const size_t JobCount = SampleCount / BatchSize;
+            StoreSamplesJob jobs[JobCount];
+
+            for (size_t i = 0; i < JobCount; ++i)
+            {
+                jobs[i].m_buffer = &m_buffer;
+                jobs[i].m_samples = &m_samples[i * BatchSize];
+                m_job_queue.schedule(&jobs[i], false);
+            }
+
+            m_job_queue.wait_until_completion();
+        }
+    };
+
+    BENCHMARK_CASE_F(StoreSamples_1Thread, Fixture<1>)          { store_samples(); }
+    BENCHMARK_CASE_F(StoreSamples_2Threads, Fixture<2>)         { store_samples(); }
+    BENCHMARK_CASE_F(StoreSamples_4Threads, Fixture<4>)         { store_samples(); }
+    BENCHMARK_CASE_F(StoreSamples_8Threads, Fixture<8>)         { store_samples(); }
+    BENCHMARK_CASE_F(StoreSamples_16Threads, Fixture<16>)       { store_samples(); }
+    BENCHMARK_CASE_F(StoreSamples_32Threads, Fixture<32>)       { store_samples(); }
+}
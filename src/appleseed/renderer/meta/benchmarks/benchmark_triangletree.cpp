@@ -0,0 +1,222 @@
+
+//
+// This source file is part of appleseed.
+// Visit http://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2017 Francois Beaune, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// appleseed.renderer headers.
+#include "renderer/global/globaltypes.h"
+#include "renderer/kernel/intersection/intersector.h"
+#include "renderer/kernel/intersection/tracecontext.h"
+#include "renderer/kernel/shading/shadingpoint.h"
+#include "renderer/kernel/shading/shadingray.h"
+#include "renderer/kernel/texturing/texturecache.h"
+#include "renderer/kernel/texturing/texturestore.h"
+#include "renderer/modeling/object/meshobject.h"
+#include "renderer/modeling/object/object.h"
+#include "renderer/modeling/object/triangle.h"
+#include "renderer/modeling/scene/assembly.h"
+#include "renderer/modeling/scene/assemblyinstance.h"
+#include "renderer/modeling/scene/containers.h"
+#include "renderer/modeling/scene/objectinstance.h"
+#include "renderer/modeling/scene/scene.h"
+#include "renderer/modeling/scene/visibilityflags.h"
+#include "renderer/utility/paramarray.h"
+#include "renderer/utility/testutils.h"
+
+// appleseed.foundation headers.
+#include "foundation/math/rng/distribution.h"
+#include "foundation/math/matrix.h"
+#include "foundation/math/rng/mersennetwister.h"
+#include "foundation/math/transform.h"
+#include "foundation/math/vector.h"
+#include "foundation/utility/autoreleaseptr.h"
+#include "foundation/utility/benchmark.h"
+#include "foundation/utility/containers/dictionary.h"
+#include "foundation/utility/string.h"
+
+// Standard headers.
+#include <cstddef>
+#include <vector>
+
+using namespace foundation;
+using namespace renderer;
+using namespace std;
+
+BENCHMARK_SUITE(Renderer_Kernel_Intersection_TriangleTree)
+{
+    const size_t TriangleCount = 100000;
+    const size_t RayCount = 1000;
+
+    // Instances of the mesh are intersected through copies of its triangles, unless
+    // ObjectInstancingThreshold is not 0 and there are at least that many instances.
+    template <size_t BranchingFactor, size_t InstanceCount = 1, size_t ObjectInstancingThreshold = 0>
+    struct TestScene
+    {
+        auto_release_ptr<Scene> m_scene;
+
+        TestScene()
+          : m_scene(SceneFactory::create())
+        {
+            MersenneTwister rng;
+
+            // Create an assembly using the requested branching factor and object instancing threshold.
+            auto_release_ptr<Assembly> assembly(
+                AssemblyFactory().create(
+                    "assembly",
+                    ParamArray()
+                        .insert_path("acceleration_structure.branching_factor", BranchingFactor)
+                        .insert_path("acceleration_structure.object_instancing_threshold", ObjectInstancingThreshold)));
+
+            // Create a mesh made of randomly placed small triangles.
+            auto_release_ptr<MeshObject> mesh_object =
+                MeshObjectFactory::create("mesh", ParamArray());
+
+            for (size_t i = 0; i < TriangleCount; ++i)
+            {
+                const GVector3 center(
+                    static_cast<GScalar>(rand_double1(rng, -1.0, 1.0)),
+                    static_cast<GScalar>(rand_double1(rng, -1.0, 1.0)),
+                    static_cast<GScalar>(rand_double1(rng, -1.0, 1.0)));
+
+                for (size_t j = 0; j < 3; ++j)
+                {
+                    const GVector3 offset(
+                        static_cast<GScalar>(rand_double1(rng, -0.02, 0.02)),
+                        static_cast<GScalar>(rand_double1(rng, -0.02, 0.02)),
+                        static_cast<GScalar>(rand_double1(rng, -0.02, 0.02)));
+                    mesh_object->push_vertex(center + offset);
+                }
+
+                const size_t base = i * 3;
+                mesh_object->push_triangle(Triangle(base + 0, base + 1, base + 2, 0));
+            }
+
+            auto_release_ptr<Object> object(mesh_object.release());
+            assembly->objects().insert(object);
+
+            // Stack the instances of the mesh along the rays.
+            for (size_t i = 0; i < InstanceCount; ++i)
+            {
+                assembly->object_instances().insert(
+                    ObjectInstanceFactory::create(
+                        ("mesh_instance_" + to_string(i)).c_str(),
+                        ParamArray(),
+                        "mesh",
+                        Transformd::from_local_to_parent(
+                            Matrix4d::make_translation(Vector3d(0.0, 0.0, 0.5 * static_cast<double>(i)))),
+                        StringDictionary()));
+            }
+
+            m_scene->assembly_instances().insert(
+                AssemblyInstanceFactory::create(
+                    "assembly_instance",
+                    ParamArray(),
+                    "assembly"));
+
+            m_scene->assemblies().insert(assembly);
+        }
+    };
+
+    template <size_t BranchingFactor, size_t InstanceCount = 1, size_t ObjectInstancingThreshold = 0>
+    struct Fixture
+      : public BindInputs<TestScene<BranchingFactor, InstanceCount, ObjectInstancingThreshold> >
+    {
+        TraceContext                m_trace_context;
+        TextureStore                m_texture_store;
+        TextureCache                m_texture_cache;
+        Intersector                 m_intersector;
+        vector<ShadingRay>          m_rays;
+        size_t                      m_hit_count;
+
+        Fixture()
+          : m_trace_context(this->m_scene.ref())
+          , m_texture_store(this->m_scene.ref())
+          , m_texture_cache(m_texture_store)
+          , m_intersector(m_trace_context, m_texture_cache)
+          , m_hit_count(0)
+        {
+            MersenneTwister rng;
+
+            // Generate rays going through the mesh.
+            for (size_t i = 0; i < RayCount; ++i)
+            {
+                const Vector3d origin(
+                    rand_double1(rng, -2.0, 2.0),
+                    rand_double1(rng, -2.0, 2.0),
+                    -3.0);
+                const Vector3d target(
+                    rand_double1(rng, -1.0, 1.0),
+                    rand_double1(rng, -1.0, 1.0),
+                    0.0);
+
+                m_rays.push_back(
+                    ShadingRay(
+                        origin,
+                        normalize(target - origin),
+                        ShadingRay::Time(),
+                        VisibilityFlags::CameraRay,
+                        0));
+            }
+
+            // Build the triangle tree before measuring.
+            trace();
+        }
+
+        void trace()
+        {
+            for (size_t i = 0; i < RayCount; ++i)
+            {
+                ShadingPoint shading_point;
+                if (m_intersector.trace(m_rays[i], shading_point))
+                    ++m_hit_count;
+            }
+        }
+
+        void trace_probe()
+        {
+            for (size_t i = 0; i < RayCount; ++i)
+            {
+                if (m_intersector.trace_probe(m_rays[i]))
+                    ++m_hit_count;
+            }
+        }
+    };
+
+    BENCHMARK_CASE_F(Trace_BranchingFactor2, Fixture<2>)        { trace(); }
+    BENCHMARK_CASE_F(Trace_BranchingFactor4, Fixture<4>)        { trace(); }
+    BENCHMARK_CASE_F(Trace_BranchingFactor8, Fixture<8>)        { trace(); }
+
+    BENCHMARK_CASE_F(TraceProbe_BranchingFactor2, Fixture<2>)   { trace_probe(); }
+    BENCHMARK_CASE_F(TraceProbe_BranchingFactor4, Fixture<4>)   { trace_probe(); }
+    BENCHMARK_CASE_F(TraceProbe_BranchingFactor8, Fixture<8>)   { trace_probe(); }
+
+    // Eight instances of the mesh, with copied or shared triangles.
+    typedef Fixture<2, 8, 0> CopiedInstancesFixture;
+    typedef Fixture<2, 8, 2> SharedInstancesFixture;
+
+    BENCHMARK_CASE_F(Trace_CopiedObjectInstances, CopiedInstancesFixture)       { trace(); }
+    BENCHMARK_CASE_F(Trace_SharedObjectInstances, SharedInstancesFixture)       { trace(); }
+}
@@ -403,3 +403,74 @@ TEST_SUITE(Renderer_Utility_DynamicSpectrum31f)
             EXPECT_FEQ(sqrt(Values[i]), result[i]);
     }
 }
+
+TEST_SUITE(Renderer_Utility_DynamicSpectrum3f)
+{
+    TEST_CASE(ConstructorTakingColor_CreatesRGB)
+    {
+        const DynamicSpectrum3f s(Color3f(1.0f, 2.0f, 3.0f));
+
+        EXPECT_TRUE(s.is_rgb());
+        EXPECT_FALSE(s.is_spectral());
+        EXPECT_EQ(3, s.size());
+    }
+
+    TEST_CASE(Upgrade_GivenRGB_CopiesRGB)
+    {
+        const DynamicSpectrum3f source(Color3f(1.0f, 2.0f, 3.0f));
+        DynamicSpectrum3f dest;
+
+        DynamicSpectrum3f::upgrade(source, dest);
+
+        EXPECT_EQ(source, dest);
+    }
+
+    TEST_CASE(Downgrade_GivenRGB_CopiesRGB)
+    {
+        const LightingConditions lighting_conditions(IlluminantCIED65, XYZCMFCIE196410Deg);
+        const DynamicSpectrum3f source(Color3f(1.0f, 2.0f, 3.0f));
+        DynamicSpectrum3f dest;
+
+        DynamicSpectrum3f::downgrade(lighting_conditions, source, dest);
+
+        EXPECT_EQ(source, dest);
+    }
+
+    TEST_CASE(ConvertToRGB_ReturnsRGB)
+    {
+        const LightingConditions lighting_conditions(IlluminantCIED65, XYZCMFCIE196410Deg);
+        const DynamicSpectrum3f s(Color3f(1.0f, 2.0f, 3.0f));
+
+        EXPECT_EQ(Color3f(1.0f, 2.0f, 3.0f), s.convert_to_rgb(lighting_conditions));
+    }
+
+    TEST_CASE(OperatorPlusEqual)
+    {
+        DynamicSpectrum3f a(Color3f(1.0f, 2.0f, 3.0f));
+        const DynamicSpectrum3f b(Color3f(4.0f, 5.0f, 6.0f));
+
+        a += b;
+
+        EXPECT_EQ(DynamicSpectrum3f(Color3f(5.0f, 7.0f, 9.0f)), a);
+    }
+
+    TEST_CASE(OperatorMultiplyEqual)
+    {
+        DynamicSpectrum3f a(Color3f(1.0f, 2.0f, 3.0f));
+        const DynamicSpectrum3f b(Color3f(4.0f, 5.0f, 6.0f));
+
+        a *= b;
+
+        EXPECT_EQ(DynamicSpectrum3f(Color3f(4.0f, 10.0f, 18.0f)), a);
+    }
+
+    TEST_CASE(Madd)
+    {
+        DynamicSpectrum3f a(Color3f(1.0f, 2.0f, 3.0f));
+        const DynamicSpectrum3f b(Color3f(4.0f, 5.0f, 6.0f));
+
+        madd(a, b, 2.0f);
+
+        EXPECT_EQ(DynamicSpectrum3f(Color3f(9.0f, 12.0f, 15.0f)), a);
+    }
+}
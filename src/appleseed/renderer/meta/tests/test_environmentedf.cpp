@@ -131,8 +131,9 @@ TEST_SUITE(Renderer_Modeling_EnvironmentEDF)
         }
 
         virtual Tile* load_tile(
-            const size_t    tile_x,
-            const size_t    tile_y) APPLESEED_OVERRIDE
+            ImageFileReaderPool&    reader_pool,
+            const size_t            tile_x,
+            const size_t            tile_y) APPLESEED_OVERRIDE
         {
             assert(tile_x == 0);
             assert(tile_y == 0);
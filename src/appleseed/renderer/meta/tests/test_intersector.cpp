@@ -35,7 +35,9 @@
 #include "renderer/kernel/shading/shadingray.h"
 #include "renderer/kernel/texturing/texturecache.h"
 #include "renderer/kernel/texturing/texturestore.h"
+#include "renderer/modeling/object/meshobject.h"
 #include "renderer/modeling/object/object.h"
+#include "renderer/modeling/object/triangle.h"
 #include "renderer/modeling/scene/assembly.h"
 #include "renderer/modeling/scene/assemblyinstance.h"
 #include "renderer/modeling/scene/containers.h"
@@ -47,14 +49,22 @@
 
 // appleseed.foundation headers.
 #include "foundation/math/matrix.h"
+#include "foundation/math/scalar.h"
 #include "foundation/math/transform.h"
 #include "foundation/math/vector.h"
 #include "foundation/utility/autoreleaseptr.h"
 #include "foundation/utility/containers/dictionary.h"
+#include "foundation/utility/string.h"
 #include "foundation/utility/test.h"
 
+// Standard headers.
+#include <cassert>
+#include <cstddef>
+#include <string>
+
 using namespace foundation;
 using namespace renderer;
+using namespace std;
 
 TEST_SUITE(Renderer_Kernel_Intersection_Intersector)
 {
@@ -142,4 +152,140 @@ TEST_SUITE(Renderer_Kernel_Intersection_Intersector)
 
         EXPECT_FALSE(hit);
     }
+
+    // Number of rays of the ray fan returned by make_fan_ray().
+    const size_t RayCount = 30;
+
+    // Return a given ray of a fan of rays leaving the origin toward +X. Some of them
+    // hit the planes of the scene below, the others miss all of them.
+    ShadingRay make_fan_ray(const size_t i)
+    {
+        assert(i < RayCount);
+
+        const double y = 0.06 * static_cast<double>(i % 6) - 0.15;
+        const double z = 0.07 * static_cast<double>(i / 6) - 0.14;
+
+        return
+            ShadingRay(
+                Vector3d(0.0, 0.0, 0.0),
+                normalize(Vector3d(1.0, y, z)),
+                0.0,                                // tmin
+                100.0,                              // tmax
+                ShadingRay::Time(),
+                VisibilityFlags::CameraRay,
+                0);                                 // depth
+    }
+
+    template <size_t ObjectInstancingThreshold>
+    struct TestSceneWithObjectInstances
+    {
+        auto_release_ptr<Scene> m_scene;
+
+        TestSceneWithObjectInstances()
+          : m_scene(SceneFactory::create())
+        {
+            auto_release_ptr<Assembly> assembly(
+                AssemblyFactory().create(
+                    "assembly",
+                    ParamArray().insert_path(
+                        "acceleration_structure.object_instancing_threshold",
+                        ObjectInstancingThreshold)));
+
+            // A unit square facing the -X direction.
+            auto_release_ptr<MeshObject> mesh_object =
+                MeshObjectFactory::create("plane", ParamArray());
+            mesh_object->push_vertex(GVector3(0.0f, -0.5f, -0.5f));
+            mesh_object->push_vertex(GVector3(0.0f, +0.5f, -0.5f));
+            mesh_object->push_vertex(GVector3(0.0f, +0.5f, +0.5f));
+            mesh_object->push_vertex(GVector3(0.0f, -0.5f, +0.5f));
+            mesh_object->push_vertex_normal(GVector3(-1.0f, 0.0f, 0.0f));
+            mesh_object->push_triangle(Triangle(0, 1, 2, 0, 0, 0, 0));
+            mesh_object->push_triangle(Triangle(2, 3, 0, 0, 0, 0, 0));
+            assembly->objects().insert(auto_release_ptr<Object>(mesh_object.release()));
+
+            // Overlapping instances of the object at increasing distances along +X.
+            for (size_t i = 0; i < 8; ++i)
+            {
+                assembly->object_instances().insert(
+                    ObjectInstanceFactory::create(
+                        ("plane_instance_" + to_string(i)).c_str(),
+                        ParamArray(),
+                        "plane",
+                        Transformd::from_local_to_parent(
+                            Matrix4d::make_translation(
+                                Vector3d(
+                                    2.0 + static_cast<double>(i),
+                                    0.3 * static_cast<double>(i % 3) - 0.3,
+                                    0.3 * static_cast<double>(i % 2) - 0.15)) *
+                            Matrix4d::make_scaling(Vector3d(1.0 - 0.05 * static_cast<double>(i)))),
+                        StringDictionary()));
+            }
+
+            m_scene->assembly_instances().insert(
+                auto_release_ptr<AssemblyInstance>(
+                    AssemblyInstanceFactory::create(
+                        "assembly_instance",
+                        ParamArray(),
+                        "assembly")));
+
+            m_scene->assemblies().insert(assembly);
+        }
+    };
+
+    template <size_t ObjectInstancingThreshold>
+    struct ObjectInstancingFixture
+      : public BindInputs<TestSceneWithObjectInstances<ObjectInstancingThreshold> >
+    {
+        TraceContext    m_trace_context;
+        TextureStore    m_texture_store;
+        TextureCache    m_texture_cache;
+        Intersector     m_intersector;
+
+        ObjectInstancingFixture()
+          : m_trace_context(this->m_scene.ref())
+          , m_texture_store(this->m_scene.ref())
+          , m_texture_cache(m_texture_store)
+          , m_intersector(m_trace_context, m_texture_cache)
+        {
+        }
+    };
+
+    TEST_CASE(Trace_GivenObjectInstancesSharingTheirObject_ReturnsSameHitsAsWithCopiedTriangles)
+    {
+        ObjectInstancingFixture<0> copied;
+        ObjectInstancingFixture<2> shared;
+
+        size_t mismatches = 0;
+        size_t hits = 0;
+
+        for (size_t i = 0; i < RayCount; ++i)
+        {
+            const ShadingRay ray = make_fan_ray(i);
+
+            ShadingPoint copied_shading_point;
+            copied.m_intersector.trace(ray, copied_shading_point);
+
+            ShadingPoint shared_shading_point;
+            shared.m_intersector.trace(ray, shared_shading_point);
+
+            if (copied_shading_point.hit() != shared_shading_point.hit())
+                ++mismatches;
+            else if (copied_shading_point.hit())
+            {
+                ++hits;
+
+                if (!feq(copied_shading_point.get_distance(), shared_shading_point.get_distance(), 1.0e-5) ||
+                    copied_shading_point.get_object_instance_index() != shared_shading_point.get_object_instance_index() ||
+                    copied_shading_point.get_primitive_index() != shared_shading_point.get_primitive_index())
+                    ++mismatches;
+            }
+
+            if (copied.m_intersector.trace_probe(ray) != shared.m_intersector.trace_probe(ray))
+                ++mismatches;
+        }
+
+        EXPECT_EQ(0, mismatches);
+        EXPECT_GT(0, hits);
+        EXPECT_LT(RayCount, hits);
+    }
 }
@@ -0,0 +1,202 @@
+
+//
+// This source file is part of appleseed.
+// Visit http://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2010-2013 Francois Beaune, Jupiter Jazz Limited
+// Copyright (c) 2014-2017 Francois Beaune, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// appleseed.renderer headers.
+#include "renderer/kernel/lighting/lighttree.h"
+
+// appleseed.foundation headers.
+#include "foundation/math/aabb.h"
+#include "foundation/math/rng/distribution.h"
+#include "foundation/math/rng/mersennetwister.h"
+#include "foundation/math/sampling/mappings.h"
+#include "foundation/math/scalar.h"
+#include "foundation/math/vector.h"
+#include "foundation/utility/test.h"
+
+// Standard headers.
+#include <cstddef>
+
+using namespace foundation;
+using namespace renderer;
+
+TEST_SUITE(Renderer_Kernel_Lighting_LightTree)
+{
+    LightTree::Item make_point_item(const Vector3d& position, const float power)
+    {
+        LightTree::Item item;
+        item.m_bbox = AABB3d(position, position);
+        item.m_axis = Vector3d(0.0, 1.0, 0.0);
+        item.m_normal_angle = Pi<double>();
+        item.m_power = power;
+        return item;
+    }
+
+    LightTree::Item make_oriented_item(const Vector3d& position, const Vector3d& normal, const float power)
+    {
+        LightTree::Item item;
+        item.m_bbox = AABB3d(position - Vector3d(0.1), position + Vector3d(0.1));
+        item.m_axis = normal;
+        item.m_normal_angle = 0.0;
+        item.m_power = power;
+        return item;
+    }
+
+    Vector3d rand_position(MersenneTwister& rng, const double extent)
+    {
+        return
+            Vector3d(
+                rand_double1(rng, -extent, extent),
+                rand_double1(rng, -extent, extent),
+                rand_double1(rng, -extent, extent));
+    }
+
+    void make_random_items(LightTree::ItemVector& items, const size_t item_count)
+    {
+        MersenneTwister rng;
+
+        for (size_t i = 0; i < item_count; ++i)
+        {
+            const Vector3d position = rand_position(rng, 10.0);
+            const float power = rand_float1(rng, 0.1f, 10.0f);
+
+            if (i % 2 == 0)
+                items.push_back(make_point_item(position, power));
+            else
+            {
+                const Vector3d normal = sample_sphere_uniform(rand_vector2<Vector2d>(rng));
+                items.push_back(make_oriented_item(position, normal, power));
+            }
+        }
+    }
+
+    TEST_CASE(Empty_GivenNoItem_ReturnsTrue)
+    {
+        LightTree tree;
+        tree.build(LightTree::ItemVector());
+
+        EXPECT_TRUE(tree.empty());
+        EXPECT_EQ(0, tree.get_node_count());
+    }
+
+    TEST_CASE(Sample_GivenSingleItem_ReturnsItemWithProbabilityOne)
+    {
+        LightTree::ItemVector items;
+        items.push_back(make_point_item(Vector3d(1.0, 2.0, 3.0), 1.0f));
+
+        LightTree tree;
+        tree.build(items);
+
+        float probability;
+        const size_t item_index = tree.sample(Vector3d(0.0), 0.5f, probability);
+
+        EXPECT_EQ(0, item_index);
+        EXPECT_EQ(1.0f, probability);
+    }
+
+    TEST_CASE(Build_GivenManyItems_CreatesOneLeafPerItem)
+    {
+        LightTree::ItemVector items;
+        make_random_items(items, 100);
+
+        LightTree tree;
+        tree.build(items);
+
+        EXPECT_EQ(100, tree.size());
+        EXPECT_EQ(199, tree.get_node_count());
+    }
+
+    TEST_CASE(EvaluatePdf_GivenManyItems_SumsToOne)
+    {
+        LightTree::ItemVector items;
+        make_random_items(items, 100);
+
+        LightTree tree;
+        tree.build(items);
+
+        const Vector3d point(1.0, -2.0, 3.0);
+        double sum = 0.0;
+
+        for (size_t i = 0; i < items.size(); ++i)
+            sum += tree.evaluate_pdf(point, i);
+
+        EXPECT_FEQ_EPS(1.0, sum, 1.0e-4);
+    }
+
+    TEST_CASE(Sample_GivenManyItems_ReturnsProbabilityEqualToEvaluatePdf)
+    {
+        LightTree::ItemVector items;
+        make_random_items(items, 100);
+
+        LightTree tree;
+        tree.build(items);
+
+        MersenneTwister rng;
+
+        for (size_t i = 0; i < 100; ++i)
+        {
+            const Vector3d point = rand_position(rng, 20.0);
+
+            float probability;
+            const size_t item_index = tree.sample(point, rand_float2(rng), probability);
+
+            ASSERT_LT(items.size(), item_index);
+            EXPECT_GT(0.0f, probability);
+            EXPECT_FEQ(tree.evaluate_pdf(point, item_index), probability);
+        }
+    }
+
+    TEST_CASE(Sample_GivenItemFacingAwayFromPoint_NeverReturnsIt)
+    {
+        LightTree::ItemVector items;
+        items.push_back(make_oriented_item(Vector3d(-1.0, 0.0, 0.0), Vector3d(0.0, 1.0, 0.0), 1.0f));
+        items.push_back(make_oriented_item(Vector3d(+1.0, 0.0, 0.0), Vector3d(0.0, -1.0, 0.0), 1000.0f));
+
+        LightTree tree;
+        tree.build(items);
+
+        const Vector3d point(0.0, 10.0, 0.0);
+
+        EXPECT_EQ(1.0f, tree.evaluate_pdf(point, 0));
+        EXPECT_EQ(0.0f, tree.evaluate_pdf(point, 1));
+    }
+
+    TEST_CASE(Sample_GivenItemsOfEqualPower_FavorsClosestItem)
+    {
+        LightTree::ItemVector items;
+        items.push_back(make_point_item(Vector3d(-10.0, 0.0, 0.0), 1.0f));
+        items.push_back(make_point_item(Vector3d(+10.0, 0.0, 0.0), 1.0f));
+
+        LightTree tree;
+        tree.build(items);
+
+        const Vector3d point(-9.0, 0.0, 0.0);
+
+        EXPECT_GT(tree.evaluate_pdf(point, 1), tree.evaluate_pdf(point, 0));
+    }
+}
@@ -28,9 +28,13 @@
 //
 
 // appleseed.renderer headers.
+#include "renderer/modeling/object/object.h"
 #include "renderer/modeling/project/project.h"
 #include "renderer/modeling/project/projectfilereader.h"
 #include "renderer/modeling/project/projectfilewriter.h"
+#include "renderer/modeling/scene/assembly.h"
+#include "renderer/modeling/scene/containers.h"
+#include "renderer/modeling/scene/scene.h"
 
 // appleseed.foundation headers.
 #include "foundation/utility/autoreleaseptr.h"
@@ -41,10 +45,13 @@
 #include "boost/filesystem.hpp"
 
 // Standard headers.
+#include <cstddef>
 #include <exception>
+#include <string>
 
 using namespace foundation;
 using namespace renderer;
+using namespace std;
 namespace bf = boost::filesystem;
 
 TEST_SUITE(Renderer_Modeling_Project_ProjectFileReader)
@@ -99,6 +106,42 @@ TEST_SUITE(Renderer_Modeling_Project_ProjectFileReader)
         }
     }
 
+    TEST_CASE(Read_GivenConcurrentMeshFileReading_PreservesObjectOrder)
+    {
+        const char* ProjectFilePath = "unit tests/inputs/test_projectfilereader_objectorder.appleseed";
+
+        ProjectFileReader reader;
+
+        auto_release_ptr<Project> serial_project =
+            reader.read(
+                ProjectFilePath,
+                0,
+                ProjectFileReader::OmitProjectSchemaValidation | ProjectFileReader::OmitConcurrentMeshFileReading);
+        ASSERT_NEQ(0, serial_project.get());
+
+        auto_release_ptr<Project> concurrent_project =
+            reader.read(
+                ProjectFilePath,
+                0,
+                ProjectFileReader::OmitProjectSchemaValidation);
+        ASSERT_NEQ(0, concurrent_project.get());
+
+        const ObjectContainer& serial_objects =
+            serial_project->get_scene()->assemblies().get_by_name("assembly")->objects();
+        const ObjectContainer& concurrent_objects =
+            concurrent_project->get_scene()->assemblies().get_by_name("assembly")->objects();
+
+        ASSERT_GT(3, serial_objects.size());
+        ASSERT_EQ(serial_objects.size(), concurrent_objects.size());
+
+        for (size_t i = 0; i < serial_objects.size(); ++i)
+        {
+            EXPECT_EQ(
+                string(serial_objects.get_by_index(i)->get_name()),
+                string(concurrent_objects.get_by_index(i)->get_name()));
+        }
+    }
+
 #if 0
     // Test waits for a brilliant solution of how to invoke it without emitting error message
 
@@ -31,8 +31,11 @@
 #include "renderer/kernel/texturing/texturestore.h"
 
 // appleseed.foundation headers.
+#include "foundation/image/canvasproperties.h"
+#include "foundation/image/pixel.h"
 #include "foundation/utility/test.h"
 
+using namespace foundation;
 using namespace renderer;
 
 TEST_SUITE(Renderer_Kernel_Texturing_TextureStore_TileKey)
@@ -46,4 +49,64 @@ TEST_SUITE(Renderer_Kernel_Texturing_TextureStore_TileKey)
         EXPECT_EQ(32323, key.get_tile_x());
         EXPECT_EQ(56565, key.get_tile_y());
     }
+
+    TEST_CASE(StoreAndRetrieveLevel)
+    {
+        const TextureStore::TileKey key(123, 12345, 32323, 56565, 7);
+
+        EXPECT_EQ(32323, key.get_tile_x());
+        EXPECT_EQ(56565, key.get_tile_y());
+        EXPECT_EQ(7, key.m_level);
+    }
+
+    TEST_CASE(OperatorEqual_GivenKeysDifferingOnlyByLevel_ReturnsFalse)
+    {
+        const TextureStore::TileKey key1(1, 2, 3, 4, 0);
+        const TextureStore::TileKey key2(1, 2, 3, 4, 1);
+
+        EXPECT_FALSE(key1 == key2);
+        EXPECT_TRUE(key1 < key2);
+    }
+}
+
+TEST_SUITE(Renderer_Kernel_Texturing_TextureStore)
+{
+    TEST_CASE(GetLevelCount_GivenSingleTexelTexture_ReturnsOne)
+    {
+        const CanvasProperties props(1, 1, 32, 32, 3, PixelFormatFloat);
+
+        EXPECT_EQ(1, TextureStore::get_level_count(props));
+    }
+
+    TEST_CASE(GetLevelCount_GivenNonSquareTexture_ReturnsLevelCountOfLargestDimension)
+    {
+        const CanvasProperties props(1024, 300, 32, 32, 3, PixelFormatFloat);
+
+        EXPECT_EQ(11, TextureStore::get_level_count(props));
+    }
+
+    TEST_CASE(GetLevelProperties_HalvesResolutionAndKeepsTileSize)
+    {
+        const CanvasProperties props(1000, 300, 64, 64, 4, PixelFormatUInt8);
+
+        const CanvasProperties level_props = TextureStore::get_level_properties(props, 2);
+
+        EXPECT_EQ(250, level_props.m_canvas_width);
+        EXPECT_EQ(75, level_props.m_canvas_height);
+        EXPECT_EQ(64, level_props.m_tile_width);
+        EXPECT_EQ(64, level_props.m_tile_height);
+        EXPECT_EQ(4, level_props.m_tile_count_x);
+        EXPECT_EQ(2, level_props.m_tile_count_y);
+    }
+
+    TEST_CASE(GetLevelProperties_GivenCoarsestLevel_ReturnsSingleTexel)
+    {
+        const CanvasProperties props(1024, 300, 32, 32, 3, PixelFormatFloat);
+
+        const CanvasProperties level_props = TextureStore::get_level_properties(props, 10);
+
+        EXPECT_EQ(1, level_props.m_canvas_width);
+        EXPECT_EQ(1, level_props.m_canvas_height);
+        EXPECT_EQ(1, level_props.m_tile_count);
+    }
 }
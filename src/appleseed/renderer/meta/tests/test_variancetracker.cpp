@@ -0,0 +1,130 @@
+
+//
+// This source file is part of appleseed.
+// Visit http://appleseedhq.net/ for additional information and resources.
+//
+// This software is released under the MIT license.
+//
+// Copyright (c) 2010-2013 Francois Beaune, Jupiter Jazz Limited
+// Copyright (c) 2014-2017 Francois Beaune, The appleseedhq Organization
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// appleseed.renderer headers.
+#include "renderer/kernel/rendering/final/variancetracker.h"
+
+// appleseed.foundation headers.
+#include "foundation/math/population.h"
+#include "foundation/math/rng/distribution.h"
+#include "foundation/math/rng/mersennetwister.h"
+#include "foundation/utility/test.h"
+
+// Standard headers.
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+using namespace foundation;
+using namespace renderer;
+using namespace std;
+
+TEST_SUITE(Renderer_Kernel_Rendering_Final_VarianceTracker)
+{
+    TEST_CASE(GetSize_GivenDefaultState_ReturnsZero)
+    {
+        VarianceTracker tracker;
+
+        EXPECT_EQ(0, tracker.get_size());
+    }
+
+    TEST_CASE(GetVariance_GivenSingleValue_ReturnsZero)
+    {
+        VarianceTracker tracker;
+        tracker.insert(5.0f);
+
+        EXPECT_EQ(5.0f, tracker.get_mean());
+        EXPECT_EQ(0.0f, tracker.get_variance());
+    }
+
+    TEST_CASE(GetRelativeError_GivenSingleValue_ReturnsInfinity)
+    {
+        VarianceTracker tracker;
+        tracker.insert(5.0f);
+
+        EXPECT_EQ(numeric_limits<float>::max(), tracker.get_relative_error());
+    }
+
+    TEST_CASE(GetVariance_GivenTwoValues_ReturnsUnbiasedSampleVariance)
+    {
+        VarianceTracker tracker;
+        tracker.insert(2.0f);
+        tracker.insert(4.0f);
+
+        EXPECT_EQ(3.0f, tracker.get_mean());
+        EXPECT_FEQ(2.0f, tracker.get_variance());
+    }
+
+    TEST_CASE(GetRelativeError_GivenConstantValues_ReturnsZero)
+    {
+        VarianceTracker tracker;
+
+        for (size_t i = 0; i < 16; ++i)
+            tracker.insert(0.5f);
+
+        EXPECT_EQ(0.0f, tracker.get_relative_error());
+    }
+
+    TEST_CASE(GetVariance_GivenRandomValues_MatchesPopulation)
+    {
+        MersenneTwister rng;
+        VarianceTracker tracker;
+        Population<float> population;
+
+        for (size_t i = 0; i < 1000; ++i)
+        {
+            const float value = rand_float1(rng);
+            tracker.insert(value);
+            population.insert(value);
+        }
+
+        // Population reports the biased (population) standard deviation.
+        const double expected_variance = population.get_dev() * population.get_dev() * 1000.0 / 999.0;
+
+        EXPECT_FEQ_EPS(population.get_mean(), static_cast<double>(tracker.get_mean()), 1.0e-5);
+        EXPECT_FEQ_EPS(expected_variance, static_cast<double>(tracker.get_variance()), 1.0e-4);
+    }
+
+    TEST_CASE(GetRelativeError_GivenFourTimesMoreSamples_IsHalved)
+    {
+        MersenneTwister rng;
+        VarianceTracker tracker;
+
+        for (size_t i = 0; i < 1000; ++i)
+            tracker.insert(rand_float1(rng));
+
+        // Uniform values in [0,1): 1.96 * sqrt((1/12) / 1000) / 0.5 ~= 0.0358.
+        const float error = tracker.get_relative_error();
+        EXPECT_FEQ_EPS(0.0358f, error, 0.05f);
+
+        for (size_t i = 0; i < 3000; ++i)
+            tracker.insert(rand_float1(rng));
+
+        EXPECT_FEQ_EPS(0.5f * error, tracker.get_relative_error(), 0.05f);
+    }
+}
@@ -375,7 +375,7 @@ namespace
             const Color3f tint_xyz =
                 values->m_base_color.is_rgb()
                     ? linear_rgb_to_ciexyz(values->m_base_color.rgb())
-                    : spectrum_to_ciexyz<float>(g_std_lighting_conditions, values->m_base_color);
+                    : values->m_base_color.convert_to_ciexyz(g_std_lighting_conditions);
 
             values->m_precomputed.m_tint_color =
                 tint_xyz[1] > 0.0f
@@ -30,6 +30,9 @@
 // Interface header.
 #include "wavelengths.h"
 
+// appleseed.renderer headers.
+#include "renderer/modeling/color/colorspace.h"
+
 // appleseed.foundation headers.
 #include "foundation/image/colorspace.h"
 #include "foundation/math/scalar.h"
@@ -48,8 +51,8 @@ namespace renderer
 // Range of wavelengths used throughout the light simulation.
 //
 
-Spectrum g_light_wavelengths_nm;
-Spectrum g_light_wavelengths_um;
+RegularSpectrum31f g_light_wavelengths_nm;
+RegularSpectrum31f g_light_wavelengths_um;
 
 namespace
 {
@@ -57,11 +60,10 @@ namespace
     {
         InitializeLightWavelengths()
         {
-            g_light_wavelengths_nm.resize(Spectrum::Samples);
             generate_wavelengths(
                 LowWavelength,
                 HighWavelength,
-                Spectrum::Samples,
+                RegularSpectrum31f::Samples,
                 &g_light_wavelengths_nm[0]);
 
             g_light_wavelengths_um = g_light_wavelengths_nm / 1000.0f;
@@ -121,9 +123,22 @@ void spectral_values_to_spectrum(
         input_spectrum_count,
         &wavelengths[0],
         input_spectrum,
-        Spectrum::Samples,
+        RegularSpectrum31f::Samples,
         &g_light_wavelengths_nm[0],
         output_spectrum);
 }
 
+void regular_spectrum_to_spectrum(
+    const RegularSpectrum31f&   input_spectrum,
+    Spectrum&                   output_spectrum)
+{
+#ifdef APPLESEED_USE_RGB_SPECTRUM
+    output_spectrum =
+        ciexyz_to_linear_rgb(
+            spectrum_to_ciexyz<float>(g_std_lighting_conditions, input_spectrum));
+#else
+    output_spectrum = input_spectrum;
+#endif
+}
+
 }   // namespace renderer
@@ -33,6 +33,9 @@
 // appleseed.renderer headers.
 #include "renderer/global/globaltypes.h"
 
+// appleseed.foundation headers.
+#include "foundation/image/regularspectrum.h"
+
 // appleseed.main headers.
 #include "main/dllsymbol.h"
 
@@ -48,8 +51,8 @@ namespace renderer
 
 const float LowWavelength = 400.0f;         // low wavelength, in nm
 const float HighWavelength = 700.0f;        // high wavelength, in nm
-extern Spectrum g_light_wavelengths_nm;     // wavelengths, in nm
-extern Spectrum g_light_wavelengths_um;     // wavelengths, in um
+extern foundation::RegularSpectrum31f g_light_wavelengths_nm;     // wavelengths, in nm
+extern foundation::RegularSpectrum31f g_light_wavelengths_um;     // wavelengths, in um
 
 
 //
@@ -63,7 +66,7 @@ APPLESEED_DLLSYMBOL void generate_wavelengths(
     const size_t    count,
     float           wavelengths[]);
 
-// Convert a set of regularly spaced spectral values to the internal spectrum format.
+// Resample a set of regularly spaced spectral values to the wavelengths of the light simulation.
 APPLESEED_DLLSYMBOL void spectral_values_to_spectrum(
     const float     low_wavelength,
     const float     high_wavelength,
@@ -71,6 +74,12 @@ APPLESEED_DLLSYMBOL void spectral_values_to_spectrum(
     const float     input_spectrum[],
     float           output_spectrum[]);
 
+// Convert a spectrum defined at the wavelengths of the light simulation to the internal
+// spectrum format. The intent of the output spectrum is left unchanged.
+APPLESEED_DLLSYMBOL void regular_spectrum_to_spectrum(
+    const foundation::RegularSpectrum31f&   input_spectrum,
+    Spectrum&                               output_spectrum);
+
 }       // namespace renderer
 
 #endif  // !APPLESEED_RENDERER_MODELING_SPECTRUM_WAVELENGTHS_H
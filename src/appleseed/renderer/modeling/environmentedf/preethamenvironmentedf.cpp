@@ -33,6 +33,7 @@
 // appleseed.renderer headers.
 #include "renderer/global/globaltypes.h"
 #include "renderer/kernel/shading/shadingcontext.h"
+#include "renderer/modeling/color/wavelengths.h"
 #include "renderer/modeling/environmentedf/environmentedf.h"
 #include "renderer/modeling/environmentedf/sphericalcoordinates.h"
 #include "renderer/modeling/input/inputarray.h"
@@ -431,7 +432,6 @@ namespace
             float luminance = xyY[2];
             RegularSpectrum31f spectrum;
             daylight_ciexy_to_spectrum(xyY[0], xyY[1], spectrum);
-            value = spectrum;
 
             // Apply luminance gamma and multiplier.
             if (m_uniform_values.m_luminance_gamma != 1.0f)
@@ -439,11 +439,12 @@ namespace
             luminance *= m_uniform_values.m_luminance_multiplier;
 
             // Compute the final sky radiance.
-            value *=
+            spectrum *=
                   luminance                                         // start with computed luminance
-                / sum_value(value * Spectrum(XYZCMFCIE19312Deg[1])) // normalize to unit luminance
+                / sum_value(spectrum * XYZCMFCIE19312Deg[1])        // normalize to unit luminance
                 * (1.0f / 683.0f)                                   // convert lumens to Watts
                 * RcpPi<float>();                                   // convert irradiance to radiance
+            regular_spectrum_to_spectrum(spectrum, value);
         }
 
         Vector3f shift(Vector3f v) const
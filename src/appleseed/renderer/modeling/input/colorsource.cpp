@@ -37,6 +37,7 @@
 
 // appleseed.foundation headers.
 #include "foundation/image/colorspace.h"
+#include "foundation/image/regularspectrum.h"
 #include "foundation/utility/api/specializedapiarrays.h"
 
 // Standard headers.
@@ -91,13 +92,14 @@ void ColorSource::initialize_from_spectrum(const ColorEntity& color_entity)
 
     m_scalar = values[0];
 
-    m_spectrum.resize(Spectrum::Samples);
+    RegularSpectrum31f spectrum;
     spectral_values_to_spectrum(
         color_entity.get_wavelength_range()[0],
         color_entity.get_wavelength_range()[1],
         values.size(),
         &values[0],
-        &m_spectrum[0]);
+        &spectrum[0]);
+    regular_spectrum_to_spectrum(spectrum, m_spectrum);
 
     // todo: this should be user-settable.
     const LightingConditions lighting_conditions(
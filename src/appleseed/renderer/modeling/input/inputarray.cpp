@@ -124,6 +124,8 @@ namespace
         uint8* evaluate(
             TextureCache&       texture_cache,
             const Vector2f&     uv,
+            const Vector2f&     duvdx,
+            const Vector2f&     duvdy,
             uint8*              ptr) const
         {
             switch (m_format)
@@ -134,7 +136,7 @@ namespace
                     float* out_scalar = reinterpret_cast<float*>(ptr);
 
                     if (m_source)
-                        m_source->evaluate(texture_cache, uv, *out_scalar);
+                        m_source->evaluate(texture_cache, uv, duvdx, duvdy, *out_scalar);
                     else *out_scalar = 0.0f;
 
                     ptr += sizeof(float);
@@ -149,7 +151,7 @@ namespace
                     new (out_spectrum) Spectrum();
 
                     if (m_source)
-                        m_source->evaluate(texture_cache, uv, *out_spectrum);
+                        m_source->evaluate(texture_cache, uv, duvdx, duvdy, *out_spectrum);
                     else out_spectrum->set(0.0f);
 
                     out_spectrum->set_intent(Spectrum::Reflectance);
@@ -166,7 +168,7 @@ namespace
                     new (out_spectrum) Spectrum();
 
                     if (m_source)
-                        m_source->evaluate(texture_cache, uv, *out_spectrum);
+                        m_source->evaluate(texture_cache, uv, duvdx, duvdy, *out_spectrum);
                     else out_spectrum->set(0.0f);
 
                     out_spectrum->set_intent(Spectrum::Illuminance);
@@ -185,7 +187,7 @@ namespace
                     new (out_alpha) Alpha();
 
                     if (m_source)
-                        m_source->evaluate(texture_cache, uv, *out_spectrum, *out_alpha);
+                        m_source->evaluate(texture_cache, uv, duvdx, duvdy, *out_spectrum, *out_alpha);
                     else
                     {
                         out_spectrum->set(0.0f);
@@ -209,7 +211,7 @@ namespace
                     new (out_alpha) Alpha();
 
                     if (m_source)
-                        m_source->evaluate(texture_cache, uv, *out_spectrum, *out_alpha);
+                        m_source->evaluate(texture_cache, uv, duvdx, duvdy, *out_spectrum, *out_alpha);
                     else
                     {
                         out_spectrum->set(0.0f);
@@ -477,6 +479,16 @@ void InputArray::evaluate(
     TextureCache&       texture_cache,
     const Vector2f&     uv,
     void*               values) const
+{
+    evaluate(texture_cache, uv, Vector2f(0.0f), Vector2f(0.0f), values);
+}
+
+void InputArray::evaluate(
+    TextureCache&       texture_cache,
+    const Vector2f&     uv,
+    const Vector2f&     duvdx,
+    const Vector2f&     duvdy,
+    void*               values) const
 {
     assert(values);
 
@@ -487,7 +499,7 @@ void InputArray::evaluate(
 #endif
 
     for (const_each<InputVector> i = impl->m_inputs; i; ++i)
-        ptr = i->evaluate(texture_cache, uv, ptr);
+        ptr = i->evaluate(texture_cache, uv, duvdx, duvdy, ptr);
 }
 
 void InputArray::evaluate_uniforms(
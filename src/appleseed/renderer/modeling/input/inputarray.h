@@ -221,6 +221,15 @@ class APPLESEED_DLLSYMBOL InputArray
         const foundation::Vector2f& uv,
         void*                       values) const;
 
+    // Like evaluate() above, but also pass the screen space partial derivatives of
+    // the texture coordinates to the sources, for MIP-mapped texture lookups.
+    void evaluate(
+        TextureCache&               texture_cache,
+        const foundation::Vector2f& uv,
+        const foundation::Vector2f& duvdx,
+        const foundation::Vector2f& duvdy,
+        void*                       values) const;
+
     // Evaluate all uniform inputs into a preallocated block of memory.
     // 'values' must be 16-byte aligned.
     void evaluate_uniforms(
@@ -111,6 +111,30 @@ void InputBinder::bind(const Scene& scene)
     }
 }
 
+void InputBinder::bind(
+    const Scene&                    scene,
+    const Assembly&                 assembly)
+{
+    try
+    {
+        // Build the symbol table of the scene.
+        SymbolTable scene_symbols;
+        build_scene_symbol_table(scene, scene_symbols);
+
+        // Bind all inputs of all entities in the assembly and its child assemblies.
+        assert(m_assembly_info.empty());
+        bind_assembly_entities_inputs(scene, scene_symbols, assembly);
+    }
+    catch (const ExceptionUnknownEntity& e)
+    {
+        RENDERER_LOG_ERROR(
+            "while binding inputs of \"%s\": could not locate entity \"%s\".",
+            e.get_context_path().c_str(),
+            e.string());
+        ++m_error_count;
+    }
+}
+
 size_t InputBinder::get_error_count() const
 {
     return m_error_count;
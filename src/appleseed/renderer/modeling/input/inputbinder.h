@@ -69,6 +69,12 @@ class InputBinder
     // Bind all inputs of all entities in a scene.
     void bind(const Scene& scene);
 
+    // Bind all inputs of all entities in an assembly of a scene whose inputs are
+    // already bound. The assembly must not reference entities of its parents.
+    void bind(
+        const Scene&                    scene,
+        const Assembly&                 assembly);
+
     // Return the number of reported binding errors.
     size_t get_error_count() const;
 
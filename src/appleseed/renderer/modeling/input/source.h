@@ -91,6 +91,47 @@ class Source
         Spectrum&                   spectrum,
         Alpha&                      alpha) const;
 
+    // Evaluate the source at a given shading point, given the screen space partial
+    // derivatives of the texture coordinates. By default, the derivatives are ignored.
+    virtual void evaluate(
+        TextureCache&               texture_cache,
+        const foundation::Vector2f& uv,
+        const foundation::Vector2f& duvdx,
+        const foundation::Vector2f& duvdy,
+        float&                      scalar) const;
+    virtual void evaluate(
+        TextureCache&               texture_cache,
+        const foundation::Vector2f& uv,
+        const foundation::Vector2f& duvdx,
+        const foundation::Vector2f& duvdy,
+        foundation::Color3f&        linear_rgb) const;
+    virtual void evaluate(
+        TextureCache&               texture_cache,
+        const foundation::Vector2f& uv,
+        const foundation::Vector2f& duvdx,
+        const foundation::Vector2f& duvdy,
+        Spectrum&                   spectrum) const;
+    virtual void evaluate(
+        TextureCache&               texture_cache,
+        const foundation::Vector2f& uv,
+        const foundation::Vector2f& duvdx,
+        const foundation::Vector2f& duvdy,
+        Alpha&                      alpha) const;
+    virtual void evaluate(
+        TextureCache&               texture_cache,
+        const foundation::Vector2f& uv,
+        const foundation::Vector2f& duvdx,
+        const foundation::Vector2f& duvdy,
+        foundation::Color3f&        linear_rgb,
+        Alpha&                      alpha) const;
+    virtual void evaluate(
+        TextureCache&               texture_cache,
+        const foundation::Vector2f& uv,
+        const foundation::Vector2f& duvdx,
+        const foundation::Vector2f& duvdy,
+        Spectrum&                   spectrum,
+        Alpha&                      alpha) const;
+
     // Evaluate the source as a uniform source.
     virtual void evaluate_uniform(
         float&                      scalar) const;
@@ -180,6 +221,68 @@ inline void Source::evaluate(
     evaluate_uniform(spectrum, alpha);
 }
 
+inline void Source::evaluate(
+    TextureCache&                   texture_cache,
+    const foundation::Vector2f&     uv,
+    const foundation::Vector2f&     duvdx,
+    const foundation::Vector2f&     duvdy,
+    float&                          scalar) const
+{
+    evaluate(texture_cache, uv, scalar);
+}
+
+inline void Source::evaluate(
+    TextureCache&                   texture_cache,
+    const foundation::Vector2f&     uv,
+    const foundation::Vector2f&     duvdx,
+    const foundation::Vector2f&     duvdy,
+    foundation::Color3f&            linear_rgb) const
+{
+    evaluate(texture_cache, uv, linear_rgb);
+}
+
+inline void Source::evaluate(
+    TextureCache&                   texture_cache,
+    const foundation::Vector2f&     uv,
+    const foundation::Vector2f&     duvdx,
+    const foundation::Vector2f&     duvdy,
+    Spectrum&                       spectrum) const
+{
+    evaluate(texture_cache, uv, spectrum);
+}
+
+inline void Source::evaluate(
+    TextureCache&                   texture_cache,
+    const foundation::Vector2f&     uv,
+    const foundation::Vector2f&     duvdx,
+    const foundation::Vector2f&     duvdy,
+    Alpha&                          alpha) const
+{
+    evaluate(texture_cache, uv, alpha);
+}
+
+inline void Source::evaluate(
+    TextureCache&                   texture_cache,
+    const foundation::Vector2f&     uv,
+    const foundation::Vector2f&     duvdx,
+    const foundation::Vector2f&     duvdy,
+    foundation::Color3f&            linear_rgb,
+    Alpha&                          alpha) const
+{
+    evaluate(texture_cache, uv, linear_rgb, alpha);
+}
+
+inline void Source::evaluate(
+    TextureCache&                   texture_cache,
+    const foundation::Vector2f&     uv,
+    const foundation::Vector2f&     duvdx,
+    const foundation::Vector2f&     duvdy,
+    Spectrum&                       spectrum,
+    Alpha&                          alpha) const
+{
+    evaluate(texture_cache, uv, spectrum, alpha);
+}
+
 inline void Source::evaluate_uniform(
     float&                          scalar) const
 {
@@ -46,6 +46,7 @@
 
 // Standard headers.
 #include <cstddef>
+#include <vector>
 
 // Forward declarations.
 namespace renderer      { class TextureCache; }
@@ -99,31 +100,80 @@ class TextureSource
         const foundation::Vector2f&         uv,
         Spectrum&                           spectrum,
         Alpha&                              alpha) const APPLESEED_OVERRIDE;
+    virtual void evaluate(
+        TextureCache&                       texture_cache,
+        const foundation::Vector2f&         uv,
+        const foundation::Vector2f&         duvdx,
+        const foundation::Vector2f&         duvdy,
+        float&                              scalar) const APPLESEED_OVERRIDE;
+    virtual void evaluate(
+        TextureCache&                       texture_cache,
+        const foundation::Vector2f&         uv,
+        const foundation::Vector2f&         duvdx,
+        const foundation::Vector2f&         duvdy,
+        foundation::Color3f&                linear_rgb) const APPLESEED_OVERRIDE;
+    virtual void evaluate(
+        TextureCache&                       texture_cache,
+        const foundation::Vector2f&         uv,
+        const foundation::Vector2f&         duvdx,
+        const foundation::Vector2f&         duvdy,
+        Spectrum&                           spectrum) const APPLESEED_OVERRIDE;
+    virtual void evaluate(
+        TextureCache&                       texture_cache,
+        const foundation::Vector2f&         uv,
+        const foundation::Vector2f&         duvdx,
+        const foundation::Vector2f&         duvdy,
+        Alpha&                              alpha) const APPLESEED_OVERRIDE;
+    virtual void evaluate(
+        TextureCache&                       texture_cache,
+        const foundation::Vector2f&         uv,
+        const foundation::Vector2f&         duvdx,
+        const foundation::Vector2f&         duvdy,
+        foundation::Color3f&                linear_rgb,
+        Alpha&                              alpha) const APPLESEED_OVERRIDE;
+    virtual void evaluate(
+        TextureCache&                       texture_cache,
+        const foundation::Vector2f&         uv,
+        const foundation::Vector2f&         duvdx,
+        const foundation::Vector2f&         duvdy,
+        Spectrum&                           spectrum,
+        Alpha&                              alpha) const APPLESEED_OVERRIDE;
 
   private:
     const foundation::UniqueID              m_assembly_uid;
     const TextureInstance&                  m_texture_instance;
     const foundation::UniqueID              m_texture_uid;
-    const foundation::CanvasProperties      m_texture_props;
     const foundation::Transformf            m_texture_transform;
-    const float                             m_scalar_canvas_width;
-    const float                             m_scalar_canvas_height;
-    const float                             m_max_x;
-    const float                             m_max_y;
+
+    // Properties of a MIP level of the texture.
+    struct Level
+    {
+        foundation::CanvasProperties        m_props;
+        float                               m_scalar_canvas_width;
+        float                               m_scalar_canvas_height;
+        float                               m_max_x;
+        float                               m_max_y;
+
+        explicit Level(const foundation::CanvasProperties& props);
+    };
+
+    std::vector<Level>                      m_levels;       // level 0 is the full resolution level
 
     // Apply the texture instance transform to UV coordinates.
     foundation::Vector2f apply_transform(
         const foundation::Vector2f&         uv) const;
 
-    // Retrieve a given texel. Return a color in the linear RGB color space.
+    // Retrieve a given texel of a given level. Return a color in the linear RGB color space.
     foundation::Color4f get_texel(
         TextureCache&                       texture_cache,
+        const size_t                        level,
         const size_t                        ix,
         const size_t                        iy) const;
 
-    // Retrieve a 2x2 block of texels. Texels are expressed in the linear RGB color space.
+    // Retrieve a 2x2 block of texels of a given level. Texels are expressed in the linear RGB color space.
     void get_texels_2x2(
         TextureCache&                       texture_cache,
+        const size_t                        level,
         const int                           ix,
         const int                           iy,
         foundation::Color4f&                t00,
@@ -131,10 +181,23 @@ class TextureSource
         foundation::Color4f&                t01,
         foundation::Color4f&                t11) const;
 
-    // Sample the texture. Return a color in the linear RGB color space.
+    // Bilinearly interpolate a given level at transformed texture coordinates.
+    foundation::Color4f sample_level_bilinear(
+        TextureCache&                       texture_cache,
+        const size_t                        level,
+        const foundation::Vector2f&         p) const;
+
+    // Sample the texture. Derivatives of the texture coordinates are only used by MIP-mapped
+    // filtering modes, where null derivatives select the full resolution level. Return a color
+    // in the linear RGB color space.
     foundation::Color4f sample_texture(
         TextureCache&                       texture_cache,
         const foundation::Vector2f&         uv) const;
+    foundation::Color4f sample_texture(
+        TextureCache&                       texture_cache,
+        const foundation::Vector2f&         uv,
+        const foundation::Vector2f&         duvdx,
+        const foundation::Vector2f&         duvdy) const;
 
     // Compute an alpha value given a linear RGBA color and the alpha mode of the texture instance.
     void evaluate_alpha(
@@ -210,6 +273,88 @@ inline void TextureSource::evaluate(
     evaluate_alpha(color, alpha);
 }
 
+inline void TextureSource::evaluate(
+    TextureCache&                           texture_cache,
+    const foundation::Vector2f&             uv,
+    const foundation::Vector2f&             duvdx,
+    const foundation::Vector2f&             duvdy,
+    float&                                  scalar) const
+{
+    const foundation::Color4f color = sample_texture(texture_cache, uv, duvdx, duvdy);
+    scalar = color[0];
+}
+
+inline void TextureSource::evaluate(
+    TextureCache&                           texture_cache,
+    const foundation::Vector2f&             uv,
+    const foundation::Vector2f&             duvdx,
+    const foundation::Vector2f&             duvdy,
+    foundation::Color3f&                    linear_rgb) const
+{
+    const foundation::Color4f color = sample_texture(texture_cache, uv, duvdx, duvdy);
+    linear_rgb = color.rgb();
+}
+
+inline void TextureSource::evaluate(
+    TextureCache&                           texture_cache,
+    const foundation::Vector2f&             uv,
+    const foundation::Vector2f&             duvdx,
+    const foundation::Vector2f&             duvdy,
+    Spectrum&                               spectrum) const
+{
+    const foundation::Color4f color = sample_texture(texture_cache, uv, duvdx, duvdy);
+    spectrum = color.rgb();
+}
+
+inline void TextureSource::evaluate(
+    TextureCache&                           texture_cache,
+    const foundation::Vector2f&             uv,
+    const foundation::Vector2f&             duvdx,
+    const foundation::Vector2f&             duvdy,
+    Alpha&                                  alpha) const
+{
+    const foundation::Color4f color = sample_texture(texture_cache, uv, duvdx, duvdy);
+    evaluate_alpha(color, alpha);
+}
+
+inline void TextureSource::evaluate(
+    TextureCache&                           texture_cache,
+    const foundation::Vector2f&             uv,
+    const foundation::Vector2f&             duvdx,
+    const foundation::Vector2f&             duvdy,
+    foundation::Color3f&                    linear_rgb,
+    Alpha&                                  alpha) const
+{
+    const foundation::Color4f color = sample_texture(texture_cache, uv, duvdx, duvdy);
+    linear_rgb = color.rgb();
+    evaluate_alpha(color, alpha);
+}
+
+inline void TextureSource::evaluate(
+    TextureCache&                           texture_cache,
+    const foundation::Vector2f&             uv,
+    const foundation::Vector2f&             duvdx,
+    const foundation::Vector2f&             duvdy,
+    Spectrum&                               spectrum,
+    Alpha&                                  alpha) const
+{
+    const foundation::Color4f color = sample_texture(texture_cache, uv, duvdx, duvdy);
+    spectrum = color.rgb();
+    evaluate_alpha(color, alpha);
+}
+
+inline foundation::Color4f TextureSource::sample_texture(
+    TextureCache&                           texture_cache,
+    const foundation::Vector2f&             uv) const
+{
+    return
+        sample_texture(
+            texture_cache,
+            uv,
+            foundation::Vector2f(0.0f),
+            foundation::Vector2f(0.0f));
+}
+
 inline void TextureSource::evaluate_alpha(
     const foundation::Color4f&              color,
     Alpha&                                  alpha) const
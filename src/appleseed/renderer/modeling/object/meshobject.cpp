@@ -368,6 +368,11 @@ void MeshObject::clear_vertex_tangent_poses()
     impl->m_tess.clear_vertex_tangent_poses();
 }
 
+StaticTriangleTess& MeshObject::get_static_triangle_tess()
+{
+    return impl->m_tess;
+}
+
 void MeshObject::reserve_material_slots(const size_t count)
 {
     impl->m_material_slots.reserve(count);
@@ -32,6 +32,7 @@
 
 // appleseed.renderer headers.
 #include "renderer/global/globaltypes.h"
+#include "renderer/kernel/tessellation/statictessellation.h"
 #include "renderer/modeling/object/object.h"
 #include "renderer/modeling/object/regionkit.h"
 
@@ -180,6 +181,9 @@ class APPLESEED_DLLSYMBOL MeshObject
     // Remove all vertex tangent poses.
     void clear_vertex_tangent_poses();
 
+    // Direct access to the tessellation of the mesh, for filling its arrays in bulk.
+    StaticTriangleTess& get_static_triangle_tess();
+
     // Insert and access material slots.
     void reserve_material_slots(const size_t count);
     size_t push_material_slot(const char* name);
@@ -44,9 +44,11 @@
 #include "foundation/math/scalar.h"
 #include "foundation/math/triangulator.h"
 #include "foundation/math/vector.h"
+#include "foundation/mesh/binarymeshfilereader.h"
 #include "foundation/mesh/genericmeshfilereader.h"
 #include "foundation/mesh/imeshbuilder.h"
 #include "foundation/mesh/imeshfilereader.h"
+#include "foundation/mesh/irenderreadymeshbuilder.h"
 #include "foundation/mesh/objmeshfilereader.h"
 #include "foundation/platform/compiler.h"
 #include "foundation/platform/defaulttimers.h"
@@ -60,6 +62,10 @@
 #include "foundation/utility/stopwatch.h"
 #include "foundation/utility/string.h"
 
+// Boost headers.
+#include "boost/filesystem/path.hpp"
+#include "boost/static_assert.hpp"
+
 // Standard headers.
 #include <algorithm>
 #include <cassert>
@@ -125,6 +131,32 @@ namespace
             return m_total_triangle_count;
         }
 
+        bool get_ignore_vertex_normals() const
+        {
+            return m_ignore_vertex_normals;
+        }
+
+        MeshObject& get_current_object() const
+        {
+            return *m_objects.back();
+        }
+
+        // Normalize a vertex normal of the current mesh, replacing null normals by arbitrary unit-length vectors.
+        void normalize_vertex_normal(GVector3& n)
+        {
+            const GScalar norm_n = norm(n);
+
+            if (norm_n > GScalar(0.0))
+                n /= norm_n;
+            else
+            {
+                ++m_null_normal_vector_count;
+                n = GVector3(GScalar(1.0), GScalar(0.0), GScalar(0.0));
+            }
+
+            ++m_normal_count;
+        }
+
         virtual void begin_mesh(const char* mesh_name) APPLESEED_OVERRIDE
         {
             // Construct the object name.
@@ -177,19 +209,7 @@ namespace
         virtual size_t push_vertex_normal(const Vector3d& v) APPLESEED_OVERRIDE
         {
             GVector3 n(v);
-
-            const GScalar norm_n = norm(n);
-
-            if (norm_n > GScalar(0.0))
-                n /= norm_n;
-            else
-            {
-                ++m_null_normal_vector_count;
-                n = GVector3(GScalar(1.0), GScalar(0.0), GScalar(0.0));
-            }
-
-            ++m_normal_count;
-
+            normalize_vertex_normal(n);
             return m_objects.back()->push_vertex_normal(n);
         }
 
@@ -399,6 +419,121 @@ namespace
         }
     };
 
+    //
+    // Builds mesh objects from render-ready meshes (binarymesh format version 4) by reading
+    // vertices, vertex normals and triangles straight into the tessellations of the objects.
+    // Naming, normal cleanup and statistics are delegated to a MeshObjectBuilder.
+    //
+
+    class RenderReadyMeshObjectBuilder
+      : public IRenderReadyMeshBuilder
+    {
+      public:
+        explicit RenderReadyMeshObjectBuilder(MeshObjectBuilder& builder)
+          : m_builder(builder)
+        {
+        }
+
+        virtual void begin_mesh(const char* name) APPLESEED_OVERRIDE
+        {
+            m_builder.begin_mesh(name);
+        }
+
+        virtual void push_material_slot(const char* name) APPLESEED_OVERRIDE
+        {
+            m_builder.push_material_slot(name);
+        }
+
+        virtual float* allocate_vertices(const size_t count) APPLESEED_OVERRIDE
+        {
+            return allocate_vectors(get_tess().m_vertices, count);
+        }
+
+        virtual float* allocate_vertex_normals(const size_t count) APPLESEED_OVERRIDE
+        {
+            return allocate_vectors(get_tess().m_vertex_normals, count);
+        }
+
+        virtual float* allocate_tex_coords(const size_t count) APPLESEED_OVERRIDE
+        {
+            // Texture coordinates live in an attribute set, they are inserted in end_mesh().
+            m_tex_coords.resize(count * 2);
+            return count > 0 ? &m_tex_coords[0] : 0;
+        }
+
+        virtual uint32* allocate_triangles(const size_t count) APPLESEED_OVERRIDE
+        {
+            BOOST_STATIC_ASSERT(sizeof(Triangle) == 10 * sizeof(uint32));
+
+            StaticTriangleTess::PrimitiveArray& triangles = get_tess().m_primitives;
+            triangles.resize(count);
+
+            return count > 0 ? &triangles[0].m_v0 : 0;
+        }
+
+        virtual void end_mesh() APPLESEED_OVERRIDE
+        {
+            StaticTriangleTess& tess = get_tess();
+
+            const size_t normal_count = tess.m_vertex_normals.size();
+            for (size_t i = 0; i < normal_count; ++i)
+                m_builder.normalize_vertex_normal(tess.m_vertex_normals[i]);
+
+            const size_t tex_coords_count = m_tex_coords.size() / 2;
+            tess.reserve_tex_coords(tex_coords_count);
+            for (size_t i = 0; i < tex_coords_count; ++i)
+                tess.push_tex_coords(GVector2(m_tex_coords[i * 2 + 0], m_tex_coords[i * 2 + 1]));
+
+            if (m_builder.get_ignore_vertex_normals())
+            {
+                const size_t triangle_count = tess.m_primitives.size();
+                for (size_t i = 0; i < triangle_count; ++i)
+                {
+                    Triangle& triangle = tess.m_primitives[i];
+                    triangle.m_n0 = Triangle::None;
+                    triangle.m_n1 = Triangle::None;
+                    triangle.m_n2 = Triangle::None;
+                }
+            }
+
+            m_builder.end_mesh();
+        }
+
+      private:
+        MeshObjectBuilder&  m_builder;
+        vector<float>       m_tex_coords;
+
+        StaticTriangleTess& get_tess() const
+        {
+            return m_builder.get_current_object().get_static_triangle_tess();
+        }
+
+        static float* allocate_vectors(StaticTriangleTess::VectorArray& vectors, const size_t count)
+        {
+            BOOST_STATIC_ASSERT(sizeof(GVector3) == 3 * sizeof(float));
+
+            vectors.resize(count);
+
+            return count > 0 ? &vectors[0][0] : 0;
+        }
+    };
+
+    // Read a render-ready binarymesh file, if the file is one. Return false otherwise.
+    bool read_render_ready_mesh_file(
+        const char*             filename,
+        MeshObjectBuilder&      builder)
+    {
+        const string extension = lower_case(boost::filesystem::path(filename).extension().string());
+
+        if (extension != ".binarymesh")
+            return false;
+
+        BinaryMeshFileReader reader(filename);
+        RenderReadyMeshObjectBuilder render_ready_builder(builder);
+
+        return reader.read_render_ready(render_ready_builder);
+    }
+
     bool read_mesh_object(
         const char*             filename,
         const char*             base_object_name,
@@ -432,6 +567,13 @@ namespace
                 reader.get_obj_options() | OBJMeshFileReader::FavorSpeedOverPrecision);
         }
 
+        // Concurrent parsing yields the same meshes; files that fit in a single chunk are still parsed on this thread.
+        if (params.get_optional<bool>("obj_concurrent_parsing", true))
+        {
+            reader.set_obj_options(
+                reader.get_obj_options() | OBJMeshFileReader::ParseConcurrently);
+        }
+
         MeshObjectBuilder builder(params, base_object_name);
 
         Stopwatch<DefaultWallclockTimer> stopwatch;
@@ -439,7 +581,8 @@ namespace
 
         try
         {
-            reader.read(builder);
+            if (!read_render_ready_mesh_file(filename, builder))
+                reader.read(builder);
         }
         catch (const OBJMeshFileReader::ExceptionInvalidFaceDef& e)
         {
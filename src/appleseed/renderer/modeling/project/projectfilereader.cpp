@@ -99,6 +99,7 @@
 #include "renderer/utility/transformsequence.h"
 
 // appleseed.foundation headers.
+#include "foundation/core/concepts/noncopyable.h"
 #include "foundation/core/exceptions/exceptionunsupportedfileformat.h"
 #include "foundation/math/aabb.h"
 #include "foundation/math/matrix.h"
@@ -107,17 +108,20 @@
 #include "foundation/math/vector.h"
 #include "foundation/platform/compiler.h"
 #include "foundation/platform/defaulttimers.h"
+#include "foundation/platform/system.h"
 #include "foundation/platform/types.h"
 #include "foundation/utility/api/apistring.h"
 #include "foundation/utility/containers/dictionary.h"
 #include "foundation/utility/foreach.h"
 #include "foundation/utility/iterators.h"
+#include "foundation/utility/job.h"
 #include "foundation/utility/log.h"
 #include "foundation/utility/memory.h"
 #include "foundation/utility/otherwise.h"
 #include "foundation/utility/searchpaths.h"
 #include "foundation/utility/stopwatch.h"
 #include "foundation/utility/string.h"
+#include "foundation/utility/uid.h"
 #include "foundation/utility/xercesc.h"
 #include "foundation/utility/zip.h"
 
@@ -133,6 +137,7 @@
 #include "boost/filesystem/operations.hpp"
 
 // Standard headers.
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
 #include <cstring>
@@ -203,6 +208,269 @@ namespace
     };
 
 
+    //
+    // A job that reads the mesh file(s) of a mesh object.
+    //
+
+    class MeshFileReadingJob
+      : public IJob
+    {
+      public:
+        MeshFileReadingJob(
+            const SearchPaths&  search_paths,
+            const string&       name,
+            const ParamArray&   params)
+          : m_search_paths(search_paths)
+          , m_name(name)
+          , m_params(params)
+          , m_success(false)
+          , m_reading_time(0.0)
+        {
+        }
+
+        ~MeshFileReadingJob()
+        {
+            // Release the objects that were never taken.
+            for (size_t i = 0; i < m_objects.size(); ++i)
+                m_objects[i]->release();
+        }
+
+        virtual void execute(const size_t thread_index) APPLESEED_OVERRIDE
+        {
+            Stopwatch<DefaultWallclockTimer> stopwatch;
+            stopwatch.start();
+
+            m_success =
+                MeshObjectReader::read(
+                    m_search_paths,
+                    m_name.c_str(),
+                    m_params,
+                    m_objects);
+
+            stopwatch.measure();
+            m_reading_time = stopwatch.get_seconds();
+        }
+
+        // Parse OBJ files on the calling thread only, unless the object requests otherwise.
+        void disable_default_concurrent_parsing()
+        {
+            if (!m_params.strings().exist("obj_concurrent_parsing"))
+                m_params.insert("obj_concurrent_parsing", false);
+        }
+
+        bool succeeded() const
+        {
+            return m_success;
+        }
+
+        double get_reading_time() const
+        {
+            return m_reading_time;
+        }
+
+        // Transfer the ownership of the objects to the caller.
+        vector<Object*> take_objects()
+        {
+            vector<Object*> objects = array_vector<vector<Object*> >(m_objects);
+            m_objects.clear();
+            return objects;
+        }
+
+      private:
+        const SearchPaths   m_search_paths;
+        const string        m_name;
+        ParamArray          m_params;
+        MeshObjectArray     m_objects;
+        bool                m_success;
+        double              m_reading_time;
+    };
+
+
+    //
+    // Defers the reading of mesh files until the whole scene is parsed, then reads
+    // them concurrently and inserts all objects into their assembly, in the order
+    // in which they were declared.
+    //
+
+    class DeferredObjectLoader
+      : public NonCopyable
+    {
+      public:
+        // An object element: either objects that are already available,
+        // or a job that will read them from disk.
+        struct DeferredObject
+        {
+            vector<Object*>         m_objects;
+            MeshFileReadingJob*     m_job;
+        };
+
+        typedef vector<DeferredObject> DeferredObjectVector;
+
+        ~DeferredObjectLoader()
+        {
+            for (size_t i = 0; i < m_assemblies.size(); ++i)
+            {
+                const DeferredObjectVector& objects = m_assemblies[i].second;
+                for (size_t j = 0; j < objects.size(); ++j)
+                {
+                    for (size_t k = 0; k < objects[j].m_objects.size(); ++k)
+                        objects[j].m_objects[k]->release();
+                }
+            }
+
+            for (size_t i = 0; i < m_jobs.size(); ++i)
+                delete m_jobs[i];
+        }
+
+        // Create a job that will read the mesh file(s) of a given mesh object.
+        MeshFileReadingJob* create_job(
+            const SearchPaths&          search_paths,
+            const string&               name,
+            const ParamArray&           params)
+        {
+            m_jobs.push_back(new MeshFileReadingJob(search_paths, name, params));
+            return m_jobs.back();
+        }
+
+        // Defer the insertion of objects into a given assembly.
+        void insert(
+            const UniqueID              assembly_uid,
+            DeferredObjectVector&       objects)
+        {
+            m_assemblies.push_back(make_pair(assembly_uid, DeferredObjectVector()));
+            m_assemblies.back().second.swap(objects);
+        }
+
+        // Read all mesh files and insert all deferred objects into their assembly.
+        void load(
+            Scene&                      scene,
+            EventCounters&              event_counters)
+        {
+            if (m_assemblies.empty())
+                return;
+
+            read_mesh_files();
+
+            // Collect all the assemblies of the scene.
+            AssemblyMap assemblies;
+            collect_assemblies(scene.assemblies(), assemblies);
+
+            for (size_t i = 0; i < m_assemblies.size(); ++i)
+            {
+                // The assembly may have been discarded, for instance because of a name clash.
+                const AssemblyMap::const_iterator it = assemblies.find(m_assemblies[i].first);
+                Assembly* assembly = it != assemblies.end() ? it->second : 0;
+
+                DeferredObjectVector& objects = m_assemblies[i].second;
+                for (size_t j = 0; j < objects.size(); ++j)
+                {
+                    DeferredObject& object = objects[j];
+
+                    if (object.m_job)
+                    {
+                        if (!object.m_job->succeeded())
+                        {
+                            event_counters.signal_error();
+                            continue;
+                        }
+
+                        object.m_objects = object.m_job->take_objects();
+                    }
+
+                    for (size_t k = 0; k < object.m_objects.size(); ++k)
+                    {
+                        auto_release_ptr<Object> entity(object.m_objects[k]);
+
+                        if (assembly == 0)
+                            continue;
+
+                        if (assembly->objects().get_by_name(entity->get_name()) != 0)
+                        {
+                            RENDERER_LOG_ERROR(
+                                "an entity with the path \"%s\" already exists.",
+                                entity->get_path().c_str());
+                            event_counters.signal_error();
+                            continue;
+                        }
+
+                        assembly->objects().insert(entity);
+                    }
+
+                    object.m_objects.clear();
+                }
+            }
+
+            m_assemblies.clear();
+        }
+
+      private:
+        typedef map<UniqueID, Assembly*> AssemblyMap;
+
+        vector<MeshFileReadingJob*>                         m_jobs;
+        vector<pair<UniqueID, DeferredObjectVector> >       m_assemblies;
+
+        void read_mesh_files() const
+        {
+            const size_t job_count = m_jobs.size();
+            const size_t thread_count =
+                min(max<size_t>(System::get_logical_cpu_core_count(), 1), job_count);
+
+            RENDERER_LOG_INFO(
+                "reading %s %s using %s %s...",
+                pretty_uint(job_count).c_str(),
+                plural(job_count, "mesh object").c_str(),
+                pretty_uint(thread_count).c_str(),
+                plural(thread_count, "thread").c_str());
+
+            // Mesh files are already read in parallel: don't let each OBJ file start
+            // as many parsing threads as there are cores on top of that.
+            if (thread_count > 1)
+            {
+                for (size_t i = 0; i < job_count; ++i)
+                    m_jobs[i]->disable_default_concurrent_parsing();
+            }
+
+            Stopwatch<DefaultWallclockTimer> stopwatch;
+            stopwatch.start();
+
+            JobQueue job_queue;
+            for (size_t i = 0; i < job_count; ++i)
+                job_queue.schedule(m_jobs[i], false);
+
+            JobManager job_manager(
+                global_logger(),
+                job_queue,
+                thread_count);
+            job_manager.start();
+            job_queue.wait_until_completion();
+
+            stopwatch.measure();
+
+            double cumulated_reading_time = 0.0;
+            for (size_t i = 0; i < job_count; ++i)
+                cumulated_reading_time += m_jobs[i]->get_reading_time();
+
+            RENDERER_LOG_INFO(
+                "read %s %s in %s (cumulated reading time: %s).",
+                pretty_uint(job_count).c_str(),
+                plural(job_count, "mesh object").c_str(),
+                pretty_time(stopwatch.get_seconds()).c_str(),
+                pretty_time(cumulated_reading_time).c_str());
+        }
+
+        static void collect_assemblies(
+            AssemblyContainer&          assemblies,
+            AssemblyMap&                map)
+        {
+            for (each<AssemblyContainer> i = assemblies; i; ++i)
+            {
+                map[i->get_uid()] = &*i;
+                collect_assemblies(i->assemblies(), map);
+            }
+        }
+    };
+
+
     //
     // A set of objects that is passed to all element handlers.
     //
@@ -235,10 +503,16 @@ namespace
             return m_event_counters;
         }
 
+        DeferredObjectLoader& get_deferred_object_loader()
+        {
+            return m_deferred_object_loader;
+        }
+
       private:
-        Project&            m_project;
-        const int           m_options;
-        EventCounters&      m_event_counters;
+        Project&                m_project;
+        const int               m_options;
+        EventCounters&          m_event_counters;
+        DeferredObjectLoader    m_deferred_object_loader;
     };
 
 
@@ -1578,6 +1852,7 @@ namespace
             ParametrizedElementHandler::start_element(attrs);
 
             clear_keep_memory(m_objects);
+            m_job = 0;
 
             m_name = get_value(attrs, "name");
             m_model = get_value(attrs, "model");
@@ -1598,6 +1873,14 @@ namespace
                                 m_name.c_str(),
                                 m_params).release());
                     }
+                    else if (!(m_context.get_options() & ProjectFileReader::OmitConcurrentMeshFileReading))
+                    {
+                        m_job =
+                            m_context.get_deferred_object_loader().create_job(
+                                m_context.get_project().search_paths(),
+                                m_name,
+                                m_params);
+                    }
                     else
                     {
                         MeshObjectArray object_array;
@@ -1642,11 +1925,18 @@ namespace
             return m_objects;
         }
 
+        // Return the job that will read the mesh file(s) of the object, if any.
+        MeshFileReadingJob* get_mesh_file_reading_job() const
+        {
+            return m_job;
+        }
+
       private:
-        ParseContext&   m_context;
-        ObjectVector    m_objects;
-        string          m_name;
-        string          m_model;
+        ParseContext&           m_context;
+        ObjectVector            m_objects;
+        MeshFileReadingJob*     m_job;
+        string                  m_name;
+        string                  m_model;
     };
 
 
@@ -2073,6 +2363,7 @@ namespace
             m_surface_shaders.clear();
             m_textures.clear();
             m_texture_instances.clear();
+            m_deferred_objects.clear();
 
             m_name = get_value(attrs, "name");
             m_model = get_value(attrs, "model", AssemblyFactory().get_model());
@@ -2103,6 +2394,13 @@ namespace
                 m_assembly->surface_shaders().swap(m_surface_shaders);
                 m_assembly->textures().swap(m_textures);
                 m_assembly->texture_instances().swap(m_texture_instances);
+
+                if (!m_deferred_objects.empty())
+                {
+                    m_context.get_deferred_object_loader().insert(
+                        m_assembly->get_uid(),
+                        m_deferred_objects);
+                }
             }
             else
             {
@@ -2111,6 +2409,14 @@ namespace
                     m_name.c_str(),
                     m_model.c_str());
                 m_context.get_event_counters().signal_error();
+
+                for (size_t i = 0; i < m_deferred_objects.size(); ++i)
+                {
+                    for (size_t j = 0; j < m_deferred_objects[i].m_objects.size(); ++j)
+                        m_deferred_objects[i].m_objects[j]->release();
+                }
+
+                m_deferred_objects.clear();
             }
         }
 
@@ -2169,9 +2475,24 @@ namespace
                 break;
 
               case ElementObject:
-                for (const_each<ObjectElementHandler::ObjectVector> i =
-                        static_cast<ObjectElementHandler*>(handler)->get_objects(); i; ++i)
-                    insert(m_objects, auto_release_ptr<Object>(*i));
+                {
+                    ObjectElementHandler* object_handler = static_cast<ObjectElementHandler*>(handler);
+
+                    // Once an object is deferred, defer all the following ones to preserve their order.
+                    if (object_handler->get_mesh_file_reading_job() || !m_deferred_objects.empty())
+                    {
+                        DeferredObjectLoader::DeferredObject deferred_object;
+                        deferred_object.m_objects = object_handler->get_objects();
+                        deferred_object.m_job = object_handler->get_mesh_file_reading_job();
+                        m_deferred_objects.push_back(deferred_object);
+                    }
+                    else
+                    {
+                        for (const_each<ObjectElementHandler::ObjectVector> i =
+                                object_handler->get_objects(); i; ++i)
+                            insert(m_objects, auto_release_ptr<Object>(*i));
+                    }
+                }
                 break;
 
               case ElementObjectInstance:
@@ -2233,6 +2554,8 @@ namespace
         SurfaceShaderContainer      m_surface_shaders;
         TextureContainer            m_textures;
         TextureInstanceContainer    m_texture_instances;
+
+        DeferredObjectLoader::DeferredObjectVector m_deferred_objects;
     };
 
 
@@ -2262,6 +2585,11 @@ namespace
 
             m_scene->get_parameters() = m_params;
 
+            // Read the mesh files whose reading was deferred.
+            m_context.get_deferred_object_loader().load(
+                m_scene.ref(),
+                m_context.get_event_counters());
+
             const GAABB3 scene_bbox = m_scene->compute_bbox();
             const Vector3d scene_center(scene_bbox.center());
 
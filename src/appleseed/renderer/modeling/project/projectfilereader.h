@@ -54,11 +54,12 @@ class APPLESEED_DLLSYMBOL ProjectFileReader
   public:
     enum Options
     {
-        Defaults                    = 0,        // none of the flags below
-        OmitReadingMeshFiles        = 1 << 0,   // do not read mesh files from disk
-        OmitProjectFileUpdate       = 1 << 1,   // do not update the project file format to the latest revision
-        OmitSearchPaths             = 1 << 2,   // do not read search paths from the project
-        OmitProjectSchemaValidation = 1 << 3    // do not validate project against schema
+        Defaults                      = 0,          // none of the flags below
+        OmitReadingMeshFiles          = 1 << 0,     // do not read mesh files from disk
+        OmitProjectFileUpdate         = 1 << 1,     // do not update the project file format to the latest revision
+        OmitSearchPaths               = 1 << 2,     // do not read search paths from the project
+        OmitProjectSchemaValidation   = 1 << 3,     // do not validate project against schema
+        OmitConcurrentMeshFileReading = 1 << 4      // read mesh files one after another while parsing the project
     };
 
     // Read a project from disk (or load a built-in project).
@@ -33,6 +33,8 @@
 #include <string>
 
 // appleseed.renderer headers.
+#include "renderer/global/globallogger.h"
+#include "renderer/modeling/input/inputbinder.h"
 #include "renderer/modeling/project/project.h"
 #include "renderer/modeling/project/projectfilereader.h"
 #include "renderer/modeling/scene/scene.h"
@@ -43,8 +45,10 @@
 #include "foundation/utility/api/specializedapiarrays.h"
 #include "foundation/utility/containers/dictionary.h"
 #include "foundation/utility/foreach.h"
+#include "foundation/utility/iostreamop.h"
 #include "foundation/utility/job/abortswitch.h"
 #include "foundation/utility/searchpaths.h"
+#include "foundation/utility/string.h"
 
 // Standard headers.
 #include <string>
@@ -62,13 +66,55 @@ namespace renderer
 namespace
 {
     const char* Model = "archive_assembly";
+
+    bool expand_child_procedural_assemblies(
+        const Project&      project,
+        const Assembly&     parent,
+        IAbortSwitch*       abort_switch)
+    {
+        for (each<AssemblyContainer> i = parent.assemblies(); i; ++i)
+        {
+            ProceduralAssembly* proc_assembly =
+                dynamic_cast<ProceduralAssembly*>(&*i);
+
+            if (proc_assembly)
+            {
+                if (!proc_assembly->expand_contents(project, &parent, abort_switch))
+                    return false;
+            }
+
+            if (!expand_child_procedural_assemblies(project, *i, abort_switch))
+                return false;
+        }
+
+        return true;
+    }
+
+    template <typename EntityContainer>
+    size_t count_entities(
+        const Assembly&     assembly,
+        EntityContainer& (Assembly::*container)() const)
+    {
+        size_t count = (assembly.*container)().size();
+
+        for (const_each<AssemblyContainer> i = assembly.assemblies(); i; ++i)
+            count += count_entities(*i, container);
+
+        return count;
+    }
 }
 
 ArchiveAssembly::ArchiveAssembly(
     const char*         name,
     const ParamArray&   params)
   : ProceduralAssembly(name, params)
+  , m_load_on_demand(params.get_optional<bool>("load_on_demand", false))
+  , m_bbox(params.get_optional<GAABB3>("bbox", GAABB3::invalid()))
   , m_archive_opened(false)
+  , m_pending(false)
+  , m_ready(true)
+  , m_loading(false)
+  , m_project(0)
 {
 }
 
@@ -100,42 +146,180 @@ bool ArchiveAssembly::expand_contents(
 {
     if (!m_archive_opened)
     {
-        // Establish and store the qualified path to the archive project.
-        const SearchPaths& search_paths = project.search_paths();
-        const string filepath =
-            to_string(search_paths.qualify(m_params.get_required<string>("filename", "")));
-
-        ProjectFileReader reader;
-        auto_release_ptr<Assembly> assembly =
-            reader.read_archive(
-                filepath.c_str(),
-                0,  // for now, we don't validate archives
-                search_paths,
-                ProjectFileReader::OmitProjectSchemaValidation);
-
-        if (assembly.get())
+        if (m_load_on_demand)
         {
-            assemblies().swap(assembly->assemblies());
-            assembly_instances().swap(assembly->assembly_instances());
-            bsdfs().swap(assembly->bsdfs());
-            bssrdfs().swap(assembly->bssrdfs());
-            colors().swap(assembly->colors());
-            edfs().swap(assembly->edfs());
-            lights().swap(assembly->lights());
-            materials().swap(assembly->materials());
-            objects().swap(assembly->objects());
-            object_instances().swap(assembly->object_instances());
-            shader_groups().swap(assembly->shader_groups());
-            surface_shaders().swap(assembly->surface_shaders());
-            textures().swap(assembly->textures());
-            texture_instances().swap(assembly->texture_instances());
-            m_archive_opened = true;
+            if (m_bbox.is_valid())
+            {
+                // Defer opening the archive until a ray enters one of its instances.
+                m_project = &project;
+                m_pending = true;
+                m_ready = false;
+                return true;
+            }
+
+            RENDERER_LOG_WARNING(
+                "archive assembly \"%s\" has no valid bounding box and cannot be loaded on demand.",
+                get_path().c_str());
         }
+
+        open_archive(project);
     }
 
     return true;
 }
 
+bool ArchiveAssembly::supports_concurrent_expansion() const
+{
+    return true;
+}
+
+bool ArchiveAssembly::is_loaded_on_demand() const
+{
+    return m_load_on_demand;
+}
+
+bool ArchiveAssembly::is_pending() const
+{
+    return m_pending;
+}
+
+void ArchiveAssembly::load_on_demand()
+{
+    if (m_ready)
+        return;
+
+    boost::mutex::scoped_lock lock(m_mutex);
+
+    if (m_loading)
+    {
+        // Another thread is loading the archive, wait until its contents are ready for rendering.
+        while (m_loading)
+            m_loaded.wait(lock);
+        return;
+    }
+
+    if (m_ready)
+        return;
+
+    // Load the archive without holding the lock: no other thread accesses
+    // the contents of the archive until they are ready.
+    m_loading = true;
+    lock.unlock();
+
+    load_and_prepare_contents();
+
+    lock.lock();
+    m_ready = true;
+    m_loading = false;
+    m_loaded.notify_all();
+}
+
+GAABB3 ArchiveAssembly::compute_local_bbox() const
+{
+    return m_pending ? m_bbox : Assembly::compute_local_bbox();
+}
+
+bool ArchiveAssembly::on_frame_begin(
+    const Project&          project,
+    const BaseGroup*        parent,
+    OnFrameBeginRecorder&   recorder,
+    IAbortSwitch*           abort_switch)
+{
+    m_project = &project;
+
+    return Assembly::on_frame_begin(project, parent, recorder, abort_switch);
+}
+
+void ArchiveAssembly::on_frame_end(
+    const Project&      project,
+    const BaseGroup*    parent)
+{
+    // Entities loaded on demand were only prepared for the current frame.
+    m_recorder.on_frame_end(project);
+
+    Assembly::on_frame_end(project, parent);
+}
+
+void ArchiveAssembly::load_and_prepare_contents()
+{
+    assert(m_project);
+
+    RENDERER_LOG_INFO("loading archive assembly \"%s\" on demand...", get_path().c_str());
+
+    const bool opened = open_archive(*m_project);
+
+    if (opened)
+    {
+        // The new entities missed scene preparation: expand nested procedural
+        // assemblies, bind entity inputs and prepare them for the current frame.
+        expand_child_procedural_assemblies(*m_project, *this, 0);
+
+        InputBinder input_binder;
+        input_binder.bind(*m_project->get_scene(), *this);
+
+        // Lights and shader groups are gathered before rendering starts.
+        const size_t light_count = count_entities(*this, &Assembly::lights);
+        if (light_count > 0)
+        {
+            RENDERER_LOG_WARNING(
+                "archive assembly \"%s\" contains %s %s, they are ignored when loading archives on demand.",
+                get_path().c_str(),
+                pretty_uint(light_count).c_str(),
+                plural(light_count, "light").c_str());
+        }
+
+        if (count_entities<ShaderGroupContainer>(*this, &Assembly::shader_groups) > 0)
+        {
+            RENDERER_LOG_WARNING(
+                "archive assembly \"%s\" contains shader groups, they are not supported when loading archives on demand.",
+                get_path().c_str());
+        }
+    }
+
+    // From now on the contents of the archive no longer change.
+    m_pending = false;
+
+    if (opened)
+        invoke_on_frame_begin_on_contents(*m_project, m_recorder, 0);
+}
+
+bool ArchiveAssembly::open_archive(const Project& project)
+{
+    // Establish and store the qualified path to the archive project.
+    const SearchPaths& search_paths = project.search_paths();
+    const string filepath =
+        to_string(search_paths.qualify(m_params.get_required<string>("filename", "")));
+
+    ProjectFileReader reader;
+    auto_release_ptr<Assembly> assembly =
+        reader.read_archive(
+            filepath.c_str(),
+            0,  // for now, we don't validate archives
+            search_paths,
+            ProjectFileReader::OmitProjectSchemaValidation);
+
+    if (assembly.get() == 0)
+        return false;
+
+    assemblies().swap(assembly->assemblies());
+    assembly_instances().swap(assembly->assembly_instances());
+    bsdfs().swap(assembly->bsdfs());
+    bssrdfs().swap(assembly->bssrdfs());
+    colors().swap(assembly->colors());
+    edfs().swap(assembly->edfs());
+    lights().swap(assembly->lights());
+    materials().swap(assembly->materials());
+    objects().swap(assembly->objects());
+    object_instances().swap(assembly->object_instances());
+    shader_groups().swap(assembly->shader_groups());
+    surface_shaders().swap(assembly->surface_shaders());
+    textures().swap(assembly->textures());
+    texture_instances().swap(assembly->texture_instances());
+    m_archive_opened = true;
+
+    return true;
+}
+
 
 //
 // ArchiveAssemblyFactory class implementation.
@@ -30,14 +30,21 @@
 #define APPLESEED_RENDERER_MODELING_SCENE_ARCHIVEASSEMBLY_H
 
 // appleseed.renderer headers.
+#include "renderer/global/globaltypes.h"
+#include "renderer/modeling/entity/onframebeginrecorder.h"
 #include "renderer/modeling/scene/basegroup.h"
 #include "renderer/modeling/scene/iassemblyfactory.h"
 #include "renderer/modeling/scene/proceduralassembly.h"
 
 // appleseed.foundation headers.
 #include "foundation/platform/compiler.h"
+#include "foundation/platform/thread.h"
 #include "foundation/utility/autoreleaseptr.h"
 
+// Boost headers.
+#include "boost/atomic/atomic.hpp"
+#include "boost/thread/condition_variable.hpp"
+
 // appleseed.main headers.
 #include "main/dllsymbol.h"
 
@@ -55,6 +62,14 @@ namespace renderer
 // An archive assembly loads and references geometries, materials and lights
 // from other appleseed projects.
 //
+// When the "load_on_demand" parameter is true, the archive is not opened when
+// procedural assemblies are expanded but the first time a ray enters the bounding
+// box of one of its instances. The bounding box of the archive contents must then
+// be provided in the "bbox" parameter ("xmin ymin zmin xmax ymax zmax").
+// The archive is loaded by the first thread that needs it, without holding any lock;
+// other threads needing it wait until it is ready. Lights and OSL shader groups of
+// archives loaded on demand are not supported and are ignored with a warning.
+//
 
 class APPLESEED_DLLSYMBOL ArchiveAssembly
   : public ProceduralAssembly
@@ -75,15 +90,52 @@ class APPLESEED_DLLSYMBOL ArchiveAssembly
         const Assembly*             parent,
         foundation::IAbortSwitch*   abort_switch = 0) APPLESEED_OVERRIDE;
 
+    // Archives are read by independent project file readers and can be expanded concurrently.
+    virtual bool supports_concurrent_expansion() const APPLESEED_OVERRIDE;
+
+    // Return true if this archive is loaded on demand.
+    bool is_loaded_on_demand() const;
+
+    // Return true if this archive is loaded on demand and hasn't been loaded yet.
+    bool is_pending() const;
+
+    // Load a pending archive. Thread-safe; can be called during rendering.
+    void load_on_demand();
+
+    // Return the declared bounding box of pending archives.
+    virtual GAABB3 compute_local_bbox() const APPLESEED_OVERRIDE;
+
+    virtual bool on_frame_begin(
+        const Project&              project,
+        const BaseGroup*            parent,
+        OnFrameBeginRecorder&       recorder,
+        foundation::IAbortSwitch*   abort_switch = 0) APPLESEED_OVERRIDE;
+
+    virtual void on_frame_end(
+        const Project&              project,
+        const BaseGroup*            parent) APPLESEED_OVERRIDE;
+
   private:
     friend class ArchiveAssemblyFactory;
 
+    const bool              m_load_on_demand;
+    const GAABB3            m_bbox;
+    bool                    m_archive_opened;
+    boost::atomic<bool>     m_pending;              // the contents of the archive are not known yet
+    boost::atomic<bool>     m_ready;                // the contents of the archive are ready for rendering
+    bool                    m_loading;              // a thread is loading the archive
+    boost::mutex            m_mutex;
+    boost::condition_variable m_loaded;
+    const Project*          m_project;
+    OnFrameBeginRecorder    m_recorder;             // entities loaded on demand during the current frame
+
     // Constructor.
     ArchiveAssembly(
         const char*                 name,
         const ParamArray&           params);
 
-    bool m_archive_opened;
+    bool open_archive(const Project& project);
+    void load_and_prepare_contents();
 };
 
 
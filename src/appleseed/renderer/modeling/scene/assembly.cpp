@@ -268,6 +268,14 @@ bool Assembly::on_frame_begin(
     if (!Entity::on_frame_begin(project, parent, recorder, abort_switch))
         return false;
 
+    return invoke_on_frame_begin_on_contents(project, recorder, abort_switch);
+}
+
+bool Assembly::invoke_on_frame_begin_on_contents(
+    const Project&          project,
+    OnFrameBeginRecorder&   recorder,
+    IAbortSwitch*           abort_switch)
+{
     bool success = true;
     success = success && invoke_on_frame_begin(project, this, colors(), recorder, abort_switch);
     success = success && invoke_on_frame_begin(project, this, textures(), recorder, abort_switch);
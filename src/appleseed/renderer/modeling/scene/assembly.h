@@ -104,7 +104,7 @@ class APPLESEED_DLLSYMBOL Assembly
 
     // Compute the local space bounding box of the assembly, including all child assemblies,
     // over the shutter interval.
-    GAABB3 compute_local_bbox() const;
+    virtual GAABB3 compute_local_bbox() const;
 
     // Compute the local space bounding box of this assembly, excluding all child assemblies,
     // over the shutter interval.
@@ -131,6 +131,12 @@ class APPLESEED_DLLSYMBOL Assembly
     // Destructor.
     ~Assembly();
 
+    // Call on_frame_begin() on all the entities contained in this assembly.
+    bool invoke_on_frame_begin_on_contents(
+        const Project&              project,
+        OnFrameBeginRecorder&       recorder,
+        foundation::IAbortSwitch*   abort_switch);
+
   private:
     friend class AssemblyFactory;
 
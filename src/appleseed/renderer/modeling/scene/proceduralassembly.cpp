@@ -49,4 +49,9 @@ ProceduralAssembly::ProceduralAssembly(
 {
 }
 
+bool ProceduralAssembly::supports_concurrent_expansion() const
+{
+    return false;
+}
+
 }   // namespace renderer
@@ -60,6 +60,11 @@ class APPLESEED_DLLSYMBOL ProceduralAssembly
         const Assembly*             parent,
         foundation::IAbortSwitch*   abort_switch = 0) = 0;
 
+    // Return true if expand_contents() may be called concurrently with the expansion
+    // of other procedural assemblies. Returns false by default, in which case the
+    // expansion of this assembly is serialized with the others that return false.
+    virtual bool supports_concurrent_expansion() const;
+
   protected:
     // Constructor.
     ProceduralAssembly(
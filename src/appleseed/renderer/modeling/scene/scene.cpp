@@ -31,6 +31,7 @@
 #include "scene.h"
 
 // appleseed.renderer headers.
+#include "renderer/global/globallogger.h"
 #include "renderer/modeling/color/colorentity.h"
 #include "renderer/modeling/environmentedf/environmentedf.h"
 #include "renderer/modeling/environmentshader/environmentshader.h"
@@ -51,9 +52,17 @@
 
 // appleseed.foundation headers.
 #include "foundation/math/vector.h"
+#include "foundation/platform/system.h"
+#include "foundation/platform/thread.h"
 #include "foundation/utility/api/specializedapiarrays.h"
 #include "foundation/utility/foreach.h"
 #include "foundation/utility/job/abortswitch.h"
+#include "foundation/utility/job/ijob.h"
+#include "foundation/utility/job/jobmanager.h"
+#include "foundation/utility/job/jobqueue.h"
+
+// Boost headers.
+#include "boost/atomic/atomic.hpp"
 
 // Standard headers.
 #include <set>
@@ -288,42 +297,116 @@ void Scene::on_render_end(const Project& project)
 
 namespace
 {
-    bool invoke_procedural_expand(
-        Assembly&               assembly,
-        const Project&          project,
-        const Assembly*         parent,
-        IAbortSwitch*           abort_switch)
+    class ExpandProceduralAssemblyJob
+      : public IJob
     {
-        ProceduralAssembly* proc_assembly =
-            dynamic_cast<ProceduralAssembly*>(&assembly);
-
-        if (proc_assembly)
+      public:
+        ExpandProceduralAssemblyJob(
+            Assembly&               assembly,
+            const Project&          project,
+            const Assembly*         parent,
+            JobQueue&               job_queue,
+            boost::mutex&           serial_expansion_mutex,
+            boost::atomic<bool>&    success,
+            IAbortSwitch*           abort_switch)
+          : m_assembly(assembly)
+          , m_project(project)
+          , m_parent(parent)
+          , m_job_queue(job_queue)
+          , m_serial_expansion_mutex(serial_expansion_mutex)
+          , m_success(success)
+          , m_abort_switch(abort_switch)
         {
-            if (!proc_assembly->expand_contents(project, parent, abort_switch))
-                return false;
         }
 
-        for (each<AssemblyContainer> i = assembly.assemblies(); i; ++i)
+        virtual void execute(const size_t thread_index) APPLESEED_OVERRIDE
         {
-            if (!invoke_procedural_expand(*i, project, &assembly, abort_switch))
-                return false;
+            if (!m_success || is_aborted(m_abort_switch))
+                return;
+
+            ProceduralAssembly* proc_assembly =
+                dynamic_cast<ProceduralAssembly*>(&m_assembly);
+
+            if (proc_assembly)
+            {
+                if (!expand(*proc_assembly))
+                {
+                    m_success = false;
+                    return;
+                }
+            }
+
+            // Child assemblies only exist once their parent is expanded,
+            // but they are independent from each other.
+            for (each<AssemblyContainer> i = m_assembly.assemblies(); i; ++i)
+            {
+                m_job_queue.schedule(
+                    new ExpandProceduralAssemblyJob(
+                        *i,
+                        m_project,
+                        &m_assembly,
+                        m_job_queue,
+                        m_serial_expansion_mutex,
+                        m_success,
+                        m_abort_switch));
+            }
         }
 
-        return true;
-    }
+      private:
+        Assembly&                   m_assembly;
+        const Project&              m_project;
+        const Assembly*             m_parent;
+        JobQueue&                   m_job_queue;
+        boost::mutex&               m_serial_expansion_mutex;
+        boost::atomic<bool>&        m_success;
+        IAbortSwitch*               m_abort_switch;
+
+        bool expand(ProceduralAssembly& proc_assembly)
+        {
+            if (proc_assembly.supports_concurrent_expansion())
+                return proc_assembly.expand_contents(m_project, m_parent, m_abort_switch);
+
+            boost::mutex::scoped_lock lock(m_serial_expansion_mutex);
+            return proc_assembly.expand_contents(m_project, m_parent, m_abort_switch);
+        }
+    };
 }
 
 bool Scene::expand_procedural_assemblies(
     const Project&          project,
     IAbortSwitch*           abort_switch)
 {
+    if (assemblies().empty())
+        return true;
+
+    // Expand independent procedural assemblies concurrently, except those
+    // that do not support it which are expanded one at a time.
+    boost::atomic<bool> success(true);
+    boost::mutex serial_expansion_mutex;
+    JobQueue job_queue;
+
     for (each<AssemblyContainer> i = assemblies(); i; ++i)
     {
-        if (!invoke_procedural_expand(*i, project, 0, abort_switch))
-            return false;
+        job_queue.schedule(
+            new ExpandProceduralAssemblyJob(
+                *i,
+                project,
+                0,
+                job_queue,
+                serial_expansion_mutex,
+                success,
+                abort_switch));
     }
 
-    return true;
+    JobManager job_manager(
+        global_logger(),
+        job_queue,
+        System::get_logical_cpu_core_count(),
+        JobManager::KeepRunningOnJobFailure);
+    job_manager.start();
+    job_queue.wait_until_completion();
+
+    return success;
 }
 
 namespace
@@ -32,6 +32,7 @@
 
 // appleseed.renderer headers.
 #include "renderer/global/globallogger.h"
+#include "renderer/kernel/texturing/imagefilereaderpool.h"
 #include "renderer/modeling/scene/basegroup.h"
 #include "renderer/modeling/texture/texture.h"
 #include "renderer/utility/messagecontext.h"
@@ -108,10 +109,12 @@ TextureInstance::TextureInstance(
 
     // Retrieve the texture filtering mode.
     const string filtering_mode =
-        m_params.get_optional<string>("filtering_mode", "bilinear", make_vector("nearest", "bilinear"), message_context);
+        m_params.get_optional<string>("filtering_mode", "bilinear", make_vector("nearest", "bilinear", "trilinear"), message_context);
     if (filtering_mode == "nearest")
         m_filtering_mode = TextureFilteringNearest;
-    else m_filtering_mode = TextureFilteringBilinear;
+    else if (filtering_mode == "bilinear")
+        m_filtering_mode = TextureFilteringBilinear;
+    else m_filtering_mode = TextureFilteringTrilinear;
 
     // Retrieve the texture alpha mode.
     const string alpha_mode =
@@ -206,11 +209,14 @@ namespace
 
         if (props.m_channel_count >= 4)
         {
+            // Tiles are read sequentially, a single open file is enough.
+            ImageFileReaderPool reader_pool(1);
+
             for (size_t y = 0; y < props.m_tile_count_y; ++y)
             {
                 for (size_t x = 0; x < props.m_tile_count_x; ++x)
                 {
-                    const Tile* tile = texture.load_tile(x, y);
+                    const Tile* tile = texture.load_tile(reader_pool, x, y);
                     const bool has_transparency = has_transparent_pixels(*tile);
                     texture.unload_tile(x, y, tile);
 
@@ -281,7 +287,8 @@ DictionaryArray TextureInstanceFactory::get_input_metadata()
             .insert("items",
                 Dictionary()
                     .insert("Nearest", "nearest")
-                    .insert("Bilinear", "bilinear"))
+                    .insert("Bilinear", "bilinear")
+                    .insert("Trilinear (MIP-Mapped)", "trilinear"))
             .insert("use", "optional")
             .insert("default", "bilinear"));
 
@@ -32,6 +32,7 @@
 
 // appleseed.renderer headers.
 #include "renderer/global/globallogger.h"
+#include "renderer/kernel/texturing/imagefilereaderpool.h"
 #include "renderer/modeling/texture/texture.h"
 #include "renderer/utility/messagecontext.h"
 #include "renderer/utility/paramarray.h"
@@ -75,7 +76,7 @@ namespace
             const ParamArray&   params,
             const SearchPaths&  search_paths)
           : Texture(name, params)
-          , m_reader(&global_logger())
+          , m_props_valid(false)
         {
             const EntityDefMessageContext message_context("texture", this);
 
@@ -106,17 +107,25 @@ namespace
             return Model;
         }
 
-        virtual void on_frame_end(
-            const Project&      project,
-            const BaseGroup*    parent) APPLESEED_OVERRIDE
+        virtual ColorSpace get_color_space() const APPLESEED_OVERRIDE
         {
-            if (m_reader.is_open())
-                m_reader.close();
+            return m_color_space;
         }
 
-        virtual ColorSpace get_color_space() const APPLESEED_OVERRIDE
+        virtual bool on_frame_begin(
+            const Project&          project,
+            const BaseGroup*        parent,
+            OnFrameBeginRecorder&   recorder,
+            IAbortSwitch*           abort_switch) APPLESEED_OVERRIDE
         {
-            return m_color_space;
+            if (!Texture::on_frame_begin(project, parent, recorder, abort_switch))
+                return false;
+
+            // The file may have changed since the previous frame: read its metadata again.
+            boost::mutex::scoped_lock lock(m_props_mutex);
+            m_props_valid = false;
+
+            return true;
         }
 
         virtual void collect_asset_paths(StringArray& paths) const APPLESEED_OVERRIDE
@@ -132,18 +141,34 @@ namespace
 
         virtual const CanvasProperties& properties() APPLESEED_OVERRIDE
         {
-            boost::mutex::scoped_lock lock(m_mutex);
-            open_image_file();
+            boost::mutex::scoped_lock lock(m_props_mutex);
+
+            if (!m_props_valid)
+            {
+                RENDERER_LOG_INFO(
+                    "opening texture file %s and reading metadata...",
+                    m_filepath.c_str());
+
+                // Tiles are read through the readers of a texture store, but metadata
+                // may be needed without one: use a reader of our own.
+                GenericProgressiveImageFileReader reader(&global_logger());
+                reader.open(m_filepath.c_str());
+                reader.read_canvas_properties(m_props);
+                reader.close();
+                m_props_valid = true;
+            }
+
             return m_props;
         }
 
         virtual Tile* load_tile(
-            const size_t        tile_x,
-            const size_t        tile_y) APPLESEED_OVERRIDE
+            ImageFileReaderPool&    reader_pool,
+            const size_t            tile_x,
+            const size_t            tile_y) APPLESEED_OVERRIDE
         {
-            boost::mutex::scoped_lock lock(m_mutex);
-            open_image_file();
-            return m_reader.read_tile(tile_x, tile_y);
+            // Tiles are read without holding any lock, each thread using its own reader.
+            ImageFileReaderPool::ScopedReader reader(reader_pool, m_filepath);
+            return reader->read_tile(tile_x, tile_y);
         }
 
         virtual void unload_tile(
@@ -158,22 +183,9 @@ namespace
         string                              m_filepath;
         ColorSpace                          m_color_space;
 
-        mutable boost::mutex                m_mutex;
-        GenericProgressiveImageFileReader   m_reader;
+        boost::mutex                        m_props_mutex;
+        bool                                m_props_valid;
         CanvasProperties                    m_props;
-
-        void open_image_file()
-        {
-            if (!m_reader.is_open())
-            {
-                RENDERER_LOG_INFO(
-                    "opening texture file %s and reading metadata...",
-                    m_filepath.c_str());
-
-                m_reader.open(m_filepath.c_str());
-                m_reader.read_canvas_properties(m_props);
-            }
-        }
     };
 }
 
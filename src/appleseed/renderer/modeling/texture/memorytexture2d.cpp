@@ -129,6 +129,7 @@ namespace
         }
 
         virtual Tile* load_tile(
+            ImageFileReaderPool&    reader_pool,
             const size_t            tile_x,
             const size_t            tile_y) APPLESEED_OVERRIDE
         {
@@ -46,6 +46,7 @@
 // Forward declarations.
 namespace foundation    { class CanvasProperties; }
 namespace foundation    { class Tile; }
+namespace renderer      { class ImageFileReaderPool; }
 namespace renderer      { class ParamArray; }
 
 namespace renderer
@@ -76,8 +77,9 @@ class APPLESEED_DLLSYMBOL Texture
     // Access canvas properties.
     virtual const foundation::CanvasProperties& properties() = 0;
 
-    // Load a given tile.
+    // Load a given tile. Textures backed by image files read them through readers of the pool.
     virtual foundation::Tile* load_tile(
+        ImageFileReaderPool&        reader_pool,
         const size_t                tile_x,
         const size_t                tile_y) = 0;
 
@@ -54,6 +54,10 @@ namespace renderer
 //
 // A spectrum that can switch between RGB and fully spectral as needed.
 //
+// When N is 3, the spectrum only ever stores linear RGB values: it is never
+// spectral, upgrading it is a no-op and its three samples fit in a single
+// 4-wide SIMD register.
+//
 
 template <typename T, size_t N>
 class DynamicSpectrum
@@ -128,6 +132,10 @@ class DynamicSpectrum
     foundation::Color<ValueType, 3> convert_to_rgb(
         const foundation::LightingConditions&   lighting_conditions) const;
 
+    // Convert the spectrum to a color in the CIE XYZ color space.
+    foundation::Color<ValueType, 3> convert_to_ciexyz(
+        const foundation::LightingConditions&   lighting_conditions) const;
+
     // Upgrade a spectrum from RGB to spectral. Returns dest.
     // 'source' and 'dest' can reference the same instance.
     static DynamicSpectrum& upgrade(
@@ -187,6 +195,8 @@ template <typename T, size_t N> void madd(DynamicSpectrum<T, N>& a, const Dynami
 // Full specializations for spectra of type float and double.
 //
 
+typedef DynamicSpectrum<float,   3> DynamicSpectrum3f;
+typedef DynamicSpectrum<double,  3> DynamicSpectrum3d;
 typedef DynamicSpectrum<float,  31> DynamicSpectrum31f;
 typedef DynamicSpectrum<double, 31> DynamicSpectrum31d;
 
@@ -285,6 +295,88 @@ template <typename T, size_t N> renderer::DynamicSpectrum<T, N> exp(const render
 namespace renderer
 {
 
+namespace impl
+{
+    // Conversions between RGB and spectral values.
+    template <typename T, size_t N>
+    struct DynamicSpectrumConversions
+    {
+        static void linear_rgb_reflectance_to_spectrum(
+            const foundation::Color<T, 3>&          linear_rgb,
+            T                                       spectrum[])
+        {
+            foundation::linear_rgb_reflectance_to_spectrum(
+                linear_rgb,
+                reinterpret_cast<foundation::RegularSpectrum<T, N>&>(spectrum[0]));
+        }
+
+        static void linear_rgb_illuminance_to_spectrum(
+            const foundation::Color<T, 3>&          linear_rgb,
+            T                                       spectrum[])
+        {
+            foundation::linear_rgb_illuminance_to_spectrum(
+                linear_rgb,
+                reinterpret_cast<foundation::RegularSpectrum<T, N>&>(spectrum[0]));
+        }
+
+        static foundation::Color<T, 3> spectrum_to_ciexyz(
+            const foundation::LightingConditions&   lighting_conditions,
+            const T                                 spectrum[])
+        {
+            return
+                foundation::spectrum_to_ciexyz<float>(
+                    lighting_conditions,
+                    reinterpret_cast<const foundation::RegularSpectrum<T, N>&>(spectrum[0]));
+        }
+
+        static foundation::Color<T, 3> spectrum_to_linear_rgb(
+            const foundation::LightingConditions&   lighting_conditions,
+            const T                                 spectrum[])
+        {
+            return foundation::ciexyz_to_linear_rgb(spectrum_to_ciexyz(lighting_conditions, spectrum));
+        }
+    };
+
+    // RGB-only spectra are never spectral: conversions are either copies or color space transforms.
+    template <typename T>
+    struct DynamicSpectrumConversions<T, 3>
+    {
+        static void linear_rgb_reflectance_to_spectrum(
+            const foundation::Color<T, 3>&          linear_rgb,
+            T                                       spectrum[])
+        {
+            spectrum[0] = linear_rgb[0];
+            spectrum[1] = linear_rgb[1];
+            spectrum[2] = linear_rgb[2];
+        }
+
+        static void linear_rgb_illuminance_to_spectrum(
+            const foundation::Color<T, 3>&          linear_rgb,
+            T                                       spectrum[])
+        {
+            spectrum[0] = linear_rgb[0];
+            spectrum[1] = linear_rgb[1];
+            spectrum[2] = linear_rgb[2];
+        }
+
+        static foundation::Color<T, 3> spectrum_to_ciexyz(
+            const foundation::LightingConditions&   lighting_conditions,
+            const T                                 spectrum[])
+        {
+            return
+                foundation::linear_rgb_to_ciexyz(
+                    foundation::Color<T, 3>(spectrum[0], spectrum[1], spectrum[2]));
+        }
+
+        static foundation::Color<T, 3> spectrum_to_linear_rgb(
+            const foundation::LightingConditions&   lighting_conditions,
+            const T                                 spectrum[])
+        {
+            return foundation::Color<T, 3>(spectrum[0], spectrum[1], spectrum[2]);
+        }
+    };
+}
+
 template <typename T, size_t N>
 inline DynamicSpectrum<T, N>::DynamicSpectrum(const Intent intent)
   : m_size(3)
@@ -393,7 +485,7 @@ inline bool DynamicSpectrum<T, N>::is_rgb() const
 template <typename T, size_t N>
 inline bool DynamicSpectrum<T, N>::is_spectral() const
 {
-    return m_size == N;
+    return N > 3 && m_size == N;
 }
 
 template <typename T, size_t N>
@@ -449,6 +541,12 @@ APPLESEED_FORCE_INLINE void DynamicSpectrum<float, 31>::set(const float val)
     }
 }
 
+template <>
+APPLESEED_FORCE_INLINE void DynamicSpectrum<float, 3>::set(const float val)
+{
+    _mm_store_ps(&m_samples[0], _mm_set1_ps(val));
+}
+
 #endif  // APPLESEED_USE_SSE
 
 template <typename T, size_t N>
@@ -481,9 +579,14 @@ template <typename T, size_t N>
 inline foundation::Color<T, 3> DynamicSpectrum<T, N>::convert_to_rgb(
     const foundation::LightingConditions& lighting_conditions) const
 {
-    return
-        foundation::ciexyz_to_linear_rgb(
-            foundation::spectrum_to_ciexyz<float>(lighting_conditions, *this));
+    return impl::DynamicSpectrumConversions<T, N>::spectrum_to_linear_rgb(lighting_conditions, m_samples);
+}
+
+template <typename T, size_t N>
+inline foundation::Color<T, 3> DynamicSpectrum<T, N>::convert_to_ciexyz(
+    const foundation::LightingConditions& lighting_conditions) const
+{
+    return impl::DynamicSpectrumConversions<T, N>::spectrum_to_ciexyz(lighting_conditions, m_samples);
 }
 
 template <typename T, size_t N>
@@ -497,17 +600,17 @@ inline DynamicSpectrum<T, N>& DynamicSpectrum<T, N>::upgrade(
     {
         if (source.get_intent() == Reflectance)
         {
-            foundation::linear_rgb_reflectance_to_spectrum(
+            impl::DynamicSpectrumConversions<T, N>::linear_rgb_reflectance_to_spectrum(
                 reinterpret_cast<const foundation::Color<ValueType, 3>&>(source[0]),
-                reinterpret_cast<foundation::RegularSpectrum<ValueType, N>&>(dest[0]));
+                &dest[0]);
             dest.set_intent(Reflectance);
         }
         else
         {
             assert(source.get_intent() == Illuminance);
-            foundation::linear_rgb_illuminance_to_spectrum(
+            impl::DynamicSpectrumConversions<T, N>::linear_rgb_illuminance_to_spectrum(
                 reinterpret_cast<const foundation::Color<ValueType, 3>&>(source[0]),
-                reinterpret_cast<foundation::RegularSpectrum<ValueType, N>&>(dest[0]));
+                &dest[0]);
             dest.set_intent(Illuminance);
         }
         dest.m_size = N;
@@ -529,10 +632,9 @@ inline DynamicSpectrum<T, N>& DynamicSpectrum<T, N>::downgrade(
     if (source.is_spectral())
     {
         reinterpret_cast<foundation::Color<ValueType, 3>&>(dest[0]) =
-            foundation::ciexyz_to_linear_rgb(
-                foundation::spectrum_to_ciexyz<float>(
-                    lighting_conditions,
-                    reinterpret_cast<const foundation::RegularSpectrum<ValueType, N>&>(source[0])));
+            impl::DynamicSpectrumConversions<T, N>::spectrum_to_linear_rgb(
+                lighting_conditions,
+                &source[0]);
         dest.m_size = 3;
         dest.m_intent = source.m_intent;
     }
@@ -828,6 +930,16 @@ APPLESEED_FORCE_INLINE DynamicSpectrum<float, 31>& operator+=(DynamicSpectrum<fl
     return lhs;
 }
 
+template <>
+APPLESEED_FORCE_INLINE DynamicSpectrum<float, 3>& operator+=(DynamicSpectrum<float, 3>& lhs, const DynamicSpectrum<float, 3>& rhs)
+{
+    assert(lhs.get_intent() == rhs.get_intent());
+
+    _mm_store_ps(&lhs[0], _mm_add_ps(_mm_load_ps(&lhs[0]), _mm_load_ps(&rhs[0])));
+
+    return lhs;
+}
+
 #endif  // APPLESEED_USE_SSE
 
 template <typename T, size_t N>
@@ -887,6 +999,14 @@ APPLESEED_FORCE_INLINE DynamicSpectrum<float, 31>& operator*=(DynamicSpectrum<fl
     return lhs;
 }
 
+template <>
+APPLESEED_FORCE_INLINE DynamicSpectrum<float, 3>& operator*=(DynamicSpectrum<float, 3>& lhs, const float rhs)
+{
+    _mm_store_ps(&lhs[0], _mm_mul_ps(_mm_load_ps(&lhs[0]), _mm_set1_ps(rhs)));
+
+    return lhs;
+}
+
 #endif  // APPLESEED_USE_SSE
 
 template <typename T, size_t N>
@@ -959,6 +1079,17 @@ APPLESEED_FORCE_INLINE DynamicSpectrum<float, 31>& operator*=(DynamicSpectrum<fl
     return lhs;
 }
 
+template <>
+APPLESEED_FORCE_INLINE DynamicSpectrum<float, 3>& operator*=(DynamicSpectrum<float, 3>& lhs, const DynamicSpectrum<float, 3>& rhs)
+{
+    _mm_store_ps(&lhs[0], _mm_mul_ps(_mm_load_ps(&lhs[0]), _mm_load_ps(&rhs[0])));
+
+    // If rhs is an illuminance, then lhs becomes an illuminance.
+    lhs.set_intent(combine_intents(lhs, rhs));
+
+    return lhs;
+}
+
 #endif  // APPLESEED_USE_SSE
 
 template <typename T, size_t N>
@@ -1134,6 +1265,28 @@ APPLESEED_FORCE_INLINE void madd(
     }
 }
 
+template <>
+APPLESEED_FORCE_INLINE void madd(
+    DynamicSpectrum<float, 3>&              a,
+    const DynamicSpectrum<float, 3>&        b,
+    const DynamicSpectrum<float, 3>&        c)
+{
+    assert(a.get_intent() == combine_intents(b, c));
+
+    _mm_store_ps(&a[0], _mm_add_ps(_mm_load_ps(&a[0]), _mm_mul_ps(_mm_load_ps(&b[0]), _mm_load_ps(&c[0]))));
+}
+
+template <>
+APPLESEED_FORCE_INLINE void madd(
+    DynamicSpectrum<float, 3>&              a,
+    const DynamicSpectrum<float, 3>&        b,
+    const float                             c)
+{
+    assert(a.get_intent() == b.get_intent());
+
+    _mm_store_ps(&a[0], _mm_add_ps(_mm_load_ps(&a[0]), _mm_mul_ps(_mm_load_ps(&b[0]), _mm_set_ps1(c))));
+}
+
 #endif  // APPLESEED_USE_SSE
 
 }       // namespace renderer
@@ -1380,6 +1533,26 @@ APPLESEED_FORCE_INLINE renderer::DynamicSpectrum<float, 31> lerp(
     return result;
 }
 
+template <>
+APPLESEED_FORCE_INLINE renderer::DynamicSpectrum<float, 3> lerp(
+    const renderer::DynamicSpectrum<float, 3>& a,
+    const renderer::DynamicSpectrum<float, 3>& b,
+    const renderer::DynamicSpectrum<float, 3>& t)
+{
+    assert(a.get_intent() == b.get_intent());
+    assert(a.get_intent() == t.get_intent());
+
+    renderer::DynamicSpectrum<float, 3> result;
+
+    const __m128 t4 = _mm_load_ps(&t[0]);
+    const __m128 one_minus_t4 = _mm_sub_ps(_mm_set1_ps(1.0f), t4);
+    const __m128 x = _mm_mul_ps(_mm_load_ps(&a[0]), one_minus_t4);
+    const __m128 y = _mm_mul_ps(_mm_load_ps(&b[0]), t4);
+    _mm_store_ps(&result[0], _mm_add_ps(x, y));
+
+    return result;
+}
+
 #endif  // APPLESEED_USE_SSE
 
 template <typename T, size_t N>
@@ -1617,6 +1790,16 @@ APPLESEED_FORCE_INLINE renderer::DynamicSpectrum<float, 31> sqrt(const renderer:
     return result;
 }
 
+template <>
+APPLESEED_FORCE_INLINE renderer::DynamicSpectrum<float, 3> sqrt(const renderer::DynamicSpectrum<float, 3>& s)
+{
+    renderer::DynamicSpectrum<float, 3> result(s.get_intent());
+
+    _mm_store_ps(&result[0], _mm_sqrt_ps(_mm_load_ps(&s[0])));
+
+    return result;
+}
+
 #endif  // APPLESEED_USE_SSE
 
 template <typename T, size_t N>
@@ -57,6 +57,12 @@ CommandLineHandler::CommandLineHandler()
             .add_name("--print-bounding-boxes")
             .add_name("-b")
             .set_description("print mesh bounding boxes"));
+
+    parser().add_option_handler(
+        &m_render_ready
+            .add_name("--render-ready")
+            .add_name("-r")
+            .set_description("write triangulated, uncompressed binarymesh files that load without processing"));
 }
 
 void CommandLineHandler::print_program_usage(
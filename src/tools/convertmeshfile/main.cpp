@@ -37,6 +37,7 @@
 // appleseed.foundation headers.
 #include "foundation/math/aabb.h"
 #include "foundation/math/vector.h"
+#include "foundation/mesh/binarymeshfilewriter.h"
 #include "foundation/mesh/genericmeshfilereader.h"
 #include "foundation/mesh/genericmeshfilewriter.h"
 #include "foundation/mesh/imeshbuilder.h"
@@ -332,6 +333,8 @@ int main(int argc, const char* argv[])
 
     // Write the output mesh file.
     GenericMeshFileWriter writer(output_filepath.c_str());
+    if (cl.m_render_ready.is_set())
+        writer.set_binarymesh_options(BinaryMeshFileWriter::RenderReady);
     try
     {
         for (const_each<list<Mesh> > i = builder.get_meshes(); i; ++i)